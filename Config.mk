@@ -43,14 +43,18 @@
 
         MOUNTING=0 # be able to mount multiple file systems
           GETCWD=0 # getcwd(3) syscall-like functionality
-        UPREEMPT=0 # userland preemption
+        UPREEMPT=1 # userland preemption
              MTP=0 # multiple kernel threads per process
-           PIPES=0 # pipe(2) functionality
+           PIPES=1 # pipe(2) functionality
          SHADOWD=1 # shadow page cleanup
+        SYSSTATS=1 # per-syscall counters and latency histograms
+       LOCKSTATS=1 # per-lock-class contention counters
+             SMP=0 # run on every CPU in the ACPI tables (experimental)
+            NOHZ=1 # stop the clock tick on idle CPUs
 
 # Boolean options specified in this specified in this file that should be
 # included as definitions at compile time
-        COMPILE_CONFIG_BOOLS=" DRIVERS VFS S5FS VM FI DYNAMIC MOUNTING MTP SHADOWD GETCWD UPREEMPT PIPES "
+        COMPILE_CONFIG_BOOLS=" DRIVERS VFS S5FS VM FI DYNAMIC MOUNTING MTP SHADOWD GETCWD UPREEMPT PIPES SYSSTATS LOCKSTATS SMP NOHZ "
 # As above, but not booleans
         COMPILE_CONFIG_DEFS=" NTERMS NDISKS DBG DISK_SIZE BOCHS_INSTALL_DIR "
 
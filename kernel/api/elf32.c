@@ -11,6 +11,7 @@
 
 #include "api/elf.h"
 #include "api/binfmt.h"
+#include "api/kdata.h"
 
 #include "util/init.h"
 #include "util/debug.h"
@@ -470,6 +471,10 @@ static int _elf32_load(const char *filename, int fd, char *const argv[],
                 err = -ENOMEM;
                 goto done;
         }
+        /* Map the kernel data pages first so nothing else lands on them */
+        if (0 > (err = kdata_map(map, curproc->p_pid))) {
+                goto done;
+        }
 
         size_t phtsize = header.e_phentsize * header.e_phnum;
         if (NULL == (pht = kmalloc(phtsize))) {
@@ -1,7 +1,11 @@
+#include "globals.h"
+
 #include "util/debug.h"
 
+#include "main/fpu.h"
 #include "main/interrupt.h"
 #include "main/gdt.h"
+#include "main/smp.h"
 
 #include "api/exec.h"
 #include "api/binfmt.h"
@@ -17,6 +21,7 @@ void userland_entry(const regs_t *regs)
 {
         intr_disable();
         intr_setipl(IPL_LOW);
+        smp_unlock_kernel();
         /* We "return from the interrupt" to get into userland */
         __asm__ __volatile__(
                 "movl %%eax, %%esp\n\t" /* Move stack pointer up to regs */
@@ -42,6 +47,8 @@ int do_execve(const char *filename, char *const *argv, char *const *envp, struct
         if (ret < 0) {
                 return ret;
         }
+        /* The new program starts with the FPU as fninit leaves it */
+        fpu_release(curthr);
         /* Make sure we "return" into the start of the newly loaded binary */
         regs->r_eip = eip;
         regs->r_useresp = esp;
@@ -0,0 +1,173 @@
+/*
+ *  FILE: futex.c
+ *  DESC: Waiting on a word of user memory. See api/futex.h for what
+ *        the process sees.
+ */
+
+#include "kernel.h"
+#include "config.h"
+#include "errno.h"
+#include "globals.h"
+
+#include "api/access.h"
+#include "api/futex.h"
+#include "api/time.h"
+
+#include "mm/mm.h"
+#include "mm/mman.h"
+#include "mm/page.h"
+
+#include "proc/proc.h"
+#include "proc/sched.h"
+
+#include "util/debug.h"
+#include "util/init.h"
+#include "util/list.h"
+#include "util/time.h"
+#include "util/timer.h"
+
+#include "vm/vmmap.h"
+
+/*
+ * A futex is named by the object that really holds its word: for a
+ * MAP_SHARED mapping the mmobj and the word's offset in it, which every
+ * process mapping it agrees on, and otherwise the process's own vmmap
+ * and the word's address. Nothing is kept for a futex nobody is waiting
+ * on. A waiter is kept on its stack, in a bucket of a hash on the name,
+ * asleep on a queue of its own, which only FUTEX_WAKE wakes.
+ *
+ * The buckets are only touched by threads in the kernel, where nothing
+ * preempts them; under SMP the kernel lock keeps the other CPUs out as
+ * well. So once FUTEX_WAIT has read the word, nothing can wake the
+ * futex before it is on its queue, and a waker that changed the word
+ * first cannot miss it.
+ */
+typedef struct futex_key {
+        void           *fk_base;        /* the mmobj, or the vmmap */
+        uint32_t        fk_off;         /* the offset, or the address */
+} futex_key_t;
+
+typedef struct futex_waiter {
+        list_link_t     fw_link;        /* link on its bucket */
+        futex_key_t     fw_key;
+        ktqueue_t       fw_q;
+} futex_waiter_t;
+
+#define futex_hash(key) ((((uint32_t)(key)->fk_base) + ((key)->fk_off >> 2)) \
+                         % FUTEX_HASH_SIZE)
+static list_t futex_buckets[FUTEX_HASH_SIZE];
+
+static __attribute__((unused)) void
+futex_init(void)
+{
+        int i;
+
+        for (i = 0; i < FUTEX_HASH_SIZE; i++) {
+                list_init(&futex_buckets[i]);
+        }
+}
+init_func(futex_init);
+
+static int
+futex_get_key(int *uaddr, futex_key_t *key)
+{
+        uint32_t vfn = ADDR_TO_PN(uaddr);
+        vmarea_t *vma;
+
+        if (0 != ((uintptr_t)uaddr & (sizeof(int) - 1))) {
+                return -EINVAL;
+        }
+        if (NULL == (vma = vmmap_lookup(curproc->p_vmmap, vfn))) {
+                return -EFAULT;
+        }
+        if (vma->vma_flags & MAP_SHARED) {
+                key->fk_base = vma->vma_obj;
+                key->fk_off = (uint32_t)PN_TO_ADDR(vfn - vma->vma_start + vma->vma_off)
+                              + PAGE_OFFSET(uaddr);
+        } else {
+                key->fk_base = curproc->p_vmmap;
+                key->fk_off = (uint32_t)uaddr;
+        }
+        return 0;
+}
+
+/*
+ * Reading the word may block to fault its page in, so it is read before
+ * the futex is named: after that we do not block until we are waiting.
+ */
+int
+do_futex_wait(int *uaddr, int val, const struct timespec *timeout)
+{
+        futex_waiter_t w;
+        uint32_t ticks = 0;
+        int cur, err;
+
+        if (NULL != timeout) {
+                if (timeout->tv_sec < 0 || timeout->tv_nsec < 0
+                    || timeout->tv_nsec >= NSEC_PER_SEC) {
+                        return -EINVAL;
+                }
+                /* A tick is already partly over; see sys_nanosleep() */
+                ticks = time_to_ticks(timeout);
+                if (0 != ticks && ticks < TIMER_MAX_TICKS) {
+                        ticks++;
+                }
+        }
+
+        if ((err = copy_from_user(&cur, uaddr, sizeof(cur))) < 0
+            || (err = futex_get_key(uaddr, &w.fw_key)) < 0) {
+                return err;
+        }
+        if (cur != val) {
+                return -EAGAIN;
+        }
+        if (NULL != timeout && 0 == ticks) {
+                return -ETIMEDOUT;
+        }
+
+        sched_queue_init(&w.fw_q);
+        list_insert_tail(&futex_buckets[futex_hash(&w.fw_key)], &w.fw_link);
+
+        if (NULL != timeout) {
+                err = sched_sleep_on_timeout(&w.fw_q, ticks);
+        } else {
+                err = sched_cancellable_sleep_on(&w.fw_q);
+        }
+
+        /* Still there unless FUTEX_WAKE took us off */
+        if (list_link_is_linked(&w.fw_link)) {
+                list_remove(&w.fw_link);
+        }
+        return err;
+}
+
+/*
+ * A waiter that timed out or was cancelled may still be on its bucket,
+ * waiting for its chance to take itself off. It is not asleep on its
+ * queue any more, so it is not counted as woken.
+ */
+int
+do_futex_wake(int *uaddr, int n)
+{
+        futex_key_t key;
+        futex_waiter_t *w;
+        list_t *bucket;
+        int err, woken = 0;
+
+        if ((err = futex_get_key(uaddr, &key)) < 0) {
+                return err;
+        }
+
+        bucket = &futex_buckets[futex_hash(&key)];
+        list_iterate_begin(bucket, w, futex_waiter_t, fw_link) {
+                if (woken < n && w->fw_key.fk_base == key.fk_base
+                    && w->fw_key.fk_off == key.fk_off) {
+                        list_remove(&w->fw_link);
+                        if (NULL != sched_wakeup_on(&w->fw_q)) {
+                                woken++;
+                        }
+                }
+        } list_iterate_end();
+
+        return woken;
+}
@@ -0,0 +1,228 @@
+/*
+ *  FILE: kdata.c
+ *  DESC: Kernel data pages mapped read-only into every process; see
+ *        api/kdata.h for what the process sees.
+ */
+
+#include "kernel.h"
+#include "errno.h"
+#include "globals.h"
+
+#include "main/interrupt.h"
+
+#include "api/kdata.h"
+#include "api/utsname.h"
+
+#include "fs/stat.h"
+#include "fs/vfs.h"
+#include "fs/vnode.h"
+
+#include "mm/mm.h"
+#include "mm/mman.h"
+#include "mm/page.h"
+#include "mm/pframe.h"
+
+#include "util/debug.h"
+#include "util/init.h"
+#include "util/string.h"
+
+#include "vm/vmmap.h"
+
+/*
+ * The shared page is page 0 of the only vnode of a private, never mounted
+ * file system, so that processes can map it like a file. It is pinned for
+ * good, and the kernel updates it through kdata_shared.
+ */
+
+static void kdata_read_vnode(vnode_t *vnode);
+static void kdata_delete_vnode(vnode_t *vnode);
+static int  kdata_query_vnode(vnode_t *vnode);
+
+static fs_ops_t kdata_fsops = {
+        .read_vnode = kdata_read_vnode,
+        .delete_vnode = kdata_delete_vnode,
+        .query_vnode = kdata_query_vnode,
+        .umount = NULL
+};
+
+static fs_t kdata_fs = {
+        .fs_dev = "kdata",
+        .fs_type = "kdata",
+        .fs_op = &kdata_fsops,
+        .fs_root = NULL,
+        .fs_i = NULL
+};
+
+static int kdata_mmap(vnode_t *file, vmarea_t *vma, mmobj_t **ret);
+static int kdata_fillpage(vnode_t *vnode, off_t offset, void *pagebuf);
+static int kdata_dirtypage(vnode_t *vnode, off_t offset);
+static int kdata_cleanpage(vnode_t *vnode, off_t offset, void *pagebuf);
+
+static vnode_ops_t kdata_vops = {
+        .read = NULL,
+        .write = NULL,
+        .mmap = kdata_mmap,
+        .create = NULL,
+        .mknod = NULL,
+        .lookup = NULL,
+        .link = NULL,
+        .unlink = NULL,
+        .mkdir = NULL,
+        .rmdir = NULL,
+        .readdir = NULL,
+        .readdirs = NULL,
+        .stat = NULL,
+        .poll = NULL,
+        .acquire = NULL,
+        .release = NULL,
+        .fillpage = kdata_fillpage,
+        .dirtypage = kdata_dirtypage,
+        .cleanpage = kdata_cleanpage
+};
+
+static vnode_t *kdata_vnode = NULL;
+kdata_t *kdata_shared = NULL;
+
+static void
+kdata_read_vnode(vnode_t *vnode)
+{
+        vnode->vn_ops = &kdata_vops;
+        /* Not S_IFCHR, or vget() would swap in the byte device ops */
+        vnode->vn_mode = S_IFREG;
+        vnode->vn_len = PAGE_SIZE;
+        vnode->vn_i = NULL;
+}
+
+static void
+kdata_delete_vnode(vnode_t *vnode)
+{
+        panic("the kernel data page vnode is never released\n");
+}
+
+static int
+kdata_query_vnode(vnode_t *vnode)
+{
+        return 1;
+}
+
+static int
+kdata_mmap(vnode_t *file, vmarea_t *vma, mmobj_t **ret)
+{
+        *ret = &file->vn_mmobj;
+        return 0;
+}
+
+static int
+kdata_fillpage(vnode_t *vnode, off_t offset, void *pagebuf)
+{
+        if (offset >= (off_t)PAGE_SIZE) {
+                return -EFAULT;
+        }
+        memset(pagebuf, 0, PAGE_SIZE);
+        return 0;
+}
+
+static int
+kdata_dirtypage(vnode_t *vnode, off_t offset)
+{
+        return 0;
+}
+
+static int
+kdata_cleanpage(vnode_t *vnode, off_t offset, void *pagebuf)
+{
+        return 0;
+}
+
+static __attribute__((unused)) void
+kdata_init(void)
+{
+        pframe_t *pf;
+        struct utsname *uts;
+
+        KASSERT(sizeof(kdata_t) <= PAGE_SIZE);
+
+        kdata_vnode = vget(&kdata_fs, 0);
+        KASSERT(NULL != kdata_vnode);
+        if (0 > pframe_get(&kdata_vnode->vn_mmobj, 0, &pf)) {
+                panic("could not allocate the kernel data page\n");
+        }
+        pframe_pin(pf);
+        kdata_shared = pf->pf_addr;
+
+        uts = &kdata_shared->kd_utsname;
+        strcpy(uts->sysname, "Weenix");
+        strcpy(uts->release, "1.2");
+        /* Version = last compilation time */
+        strcpy(uts->version, "#1 " __DATE__ " " __TIME__);
+        strcpy(uts->nodename, "");
+        strcpy(uts->machine, "");
+}
+init_func(kdata_init);
+init_depends(vfs_init);
+
+/*
+ * Map both kernel data pages into map (a new process image) and record
+ * pid in the per-process one. Returns 0 or -errno.
+ */
+int
+kdata_map(vmmap_t *map, pid_t pid)
+{
+        int err;
+
+        if (0 > (err = vmmap_map(map, kdata_vnode, ADDR_TO_PN(KDATA_BASE), 1,
+                                 PROT_READ, MAP_SHARED | MAP_FIXED, 0, 0, NULL))) {
+                return err;
+        }
+        if (0 > (err = vmmap_map(map, NULL, ADDR_TO_PN(KDATA_PROC_BASE), 1,
+                                 PROT_READ, MAP_PRIVATE | MAP_FIXED, 0, 0, NULL))) {
+                return err;
+        }
+
+        kdata_set_pid(map, pid);
+        return 0;
+}
+
+/*
+ * Record pid in map's per-process page. Fork uses this for the child,
+ * whose copy of the page is private, so the parent's is left alone. Does
+ * nothing if the process has unmapped the page.
+ */
+void
+kdata_set_pid(vmmap_t *map, pid_t pid)
+{
+        kdata_proc_t kdp;
+
+        if (NULL == vmmap_lookup(map, ADDR_TO_PN(KDATA_PROC_BASE))) {
+                return;
+        }
+
+        memset(&kdp, 0, sizeof(kdp));
+        kdp.kdp_pid = pid;
+        if (0 > vmmap_write(map, (void *)KDATA_PROC_BASE, &kdp, sizeof(kdp))) {
+                dbg(DBG_ERROR, "could not record pid %d in its kernel data page\n", pid);
+        }
+}
+
+/*
+ * Publish a new clock reading: the monotonic time mono_ns at TSC value
+ * tsc, and the factors for converting TSC ticks since then to ns. A mult
+ * of 0 means the TSC is not to be used.
+ */
+void
+kdata_update_clock(uint64_t mono_ns, uint64_t tsc, uint32_t mult, uint32_t shift)
+{
+        uint8_t oldipl = intr_getipl();
+        intr_setipl(IPL_HIGH);
+
+        kdata_shared->kd_seq++;
+        __asm__ volatile("" ::: "memory");
+        kdata_shared->kd_mono_ns = mono_ns;
+        kdata_shared->kd_tsc_stamp = tsc;
+        kdata_shared->kd_tsc_mult = mult;
+        kdata_shared->kd_tsc_shift = shift;
+        __asm__ volatile("" ::: "memory");
+        kdata_shared->kd_seq++;
+
+        intr_setipl(oldipl);
+}
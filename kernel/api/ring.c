@@ -0,0 +1,416 @@
+/*
+ *  FILE: ring.c
+ *  DESC: Shared submission/completion rings for batched I/O. See
+ *        api/ring.h for the layout the process sees.
+ */
+
+#include "kernel.h"
+#include "errno.h"
+#include "globals.h"
+
+#include "api/access.h"
+#include "api/ring.h"
+#include "api/syscall.h"
+
+#include "fs/fdtable.h"
+#include "fs/file.h"
+#include "fs/open.h"
+#include "fs/stat.h"
+#include "fs/vfs.h"
+#include "fs/vfs_syscall.h"
+#include "fs/vnode.h"
+
+#include "mm/kmalloc.h"
+#include "mm/mm.h"
+#include "mm/page.h"
+#include "mm/pframe.h"
+
+#include "util/debug.h"
+#include "util/string.h"
+
+/*
+ * Rings live on vnodes of a private, never mounted file system, much like
+ * pipes do. That way mmap(2) of a ring fd goes through the usual vnode
+ * mmobj, and the page the process maps is the same page the kernel reads.
+ */
+
+static void ring_read_vnode(vnode_t *vnode);
+static void ring_delete_vnode(vnode_t *vnode);
+static int  ring_query_vnode(vnode_t *vnode);
+
+static fs_ops_t ring_fsops = {
+        .read_vnode = ring_read_vnode,
+        .delete_vnode = ring_delete_vnode,
+        .query_vnode = ring_query_vnode,
+        .umount = NULL
+};
+
+static fs_t ring_fs = {
+        .fs_dev = "ring",
+        .fs_type = "ring",
+        .fs_op = &ring_fsops,
+        .fs_root = NULL,
+        .fs_i = NULL
+};
+
+static int ring_read(vnode_t *vnode, off_t offset, void *buf, size_t len);
+static int ring_write(vnode_t *vnode, off_t offset, const void *buf, size_t len);
+static int ring_mmap(vnode_t *file, vmarea_t *vma, mmobj_t **ret);
+static int ring_stat(vnode_t *vnode, struct stat *ss);
+static int ring_release(vnode_t *vnode, file_t *file);
+static int ring_fillpage(vnode_t *vnode, off_t offset, void *pagebuf);
+static int ring_dirtypage(vnode_t *vnode, off_t offset);
+static int ring_cleanpage(vnode_t *vnode, off_t offset, void *pagebuf);
+
+static vnode_ops_t ring_vops = {
+        .read = ring_read,
+        .write = ring_write,
+        .mmap = ring_mmap,
+        .create = NULL,
+        .mknod = NULL,
+        .lookup = NULL,
+        .link = NULL,
+        .unlink = NULL,
+        .mkdir = NULL,
+        .rmdir = NULL,
+        .readdir = NULL,
+        .readdirs = NULL,
+        .stat = ring_stat,
+        .poll = NULL,
+        .acquire = NULL,
+        .release = ring_release,
+        .fillpage = ring_fillpage,
+        .dirtypage = ring_dirtypage,
+        .cleanpage = ring_cleanpage
+};
+
+/*
+ * Kernel side of a ring, in vn_i. The shared page stays pinned for as
+ * long as the ring is open so that ring_enter() can use it directly; the
+ * process's mapping keeps its own reference through the vnode mmobj.
+ */
+typedef struct ring_kern {
+        pframe_t       *rk_pframe;
+        ring_shared_t  *rk_shared;
+        uint32_t        rk_entries;     /* our copy; the process can scribble on rs_entries */
+} ring_kern_t;
+
+#define VNODE_TO_RING(vn) ((ring_kern_t *)((vn)->vn_i))
+
+static int next_rno = 0;
+
+static void
+ring_read_vnode(vnode_t *vnode)
+{
+        vnode->vn_ops = &ring_vops;
+        /* Not S_IFCHR, or vget() would swap in the byte device ops */
+        vnode->vn_mode = S_IFREG;
+        vnode->vn_len = PAGE_SIZE;
+        vnode->vn_i = NULL;
+}
+
+static void
+ring_delete_vnode(vnode_t *vnode)
+{
+        ring_kern_t *rk = VNODE_TO_RING(vnode);
+        if (rk) {
+                KASSERT(NULL == rk->rk_pframe);
+                kfree(rk);
+        }
+}
+
+static int
+ring_query_vnode(vnode_t *vnode)
+{
+        /* Nothing refers to a ring once its vnode is unreferenced */
+        return 0;
+}
+
+static int
+ring_read(vnode_t *vnode, off_t offset, void *buf, size_t len)
+{
+        return -EINVAL;
+}
+
+static int
+ring_write(vnode_t *vnode, off_t offset, const void *buf, size_t len)
+{
+        return -EINVAL;
+}
+
+static int
+ring_mmap(vnode_t *file, vmarea_t *vma, mmobj_t **ret)
+{
+        *ret = &file->vn_mmobj;
+        return 0;
+}
+
+static int
+ring_stat(vnode_t *vnode, struct stat *ss)
+{
+        memset(ss, 0, sizeof(*ss));
+        ss->st_mode = vnode->vn_mode;
+        ss->st_ino = vnode->vn_vno;
+        ss->st_nlink = 1;
+        ss->st_size = vnode->vn_len;
+        ss->st_blksize = PAGE_SIZE;
+        return 0;
+}
+
+static int
+ring_release(vnode_t *vnode, file_t *file)
+{
+        ring_kern_t *rk = VNODE_TO_RING(vnode);
+
+        KASSERT(NULL != rk && NULL != rk->rk_pframe);
+        pframe_unpin(rk->rk_pframe);
+        rk->rk_pframe = NULL;
+        rk->rk_shared = NULL;
+        return 0;
+}
+
+static int
+ring_fillpage(vnode_t *vnode, off_t offset, void *pagebuf)
+{
+        if (offset >= (off_t)PAGE_SIZE) {
+                return -EFAULT;
+        }
+        memset(pagebuf, 0, PAGE_SIZE);
+        return 0;
+}
+
+/* The ring page has no backing store, so there is nothing to write back */
+static int
+ring_dirtypage(vnode_t *vnode, off_t offset)
+{
+        return 0;
+}
+
+static int
+ring_cleanpage(vnode_t *vnode, off_t offset, void *pagebuf)
+{
+        return 0;
+}
+
+/*
+ * Create a ring with the given number of submission and completion
+ * entries and return a file descriptor for it.
+ *
+ * Error cases:
+ *      o EINVAL
+ *        entries is not a power of 2 between 1 and RING_MAX_ENTRIES.
+ *      o EMFILE
+ *        The process already has the maximum number of files open.
+ *      o ENOMEM
+ *        Insufficient kernel memory was available.
+ */
+int
+do_ring_setup(unsigned int entries)
+{
+        vnode_t *vn;
+        ring_kern_t *rk;
+        file_t *f;
+        int fd, err;
+
+        if (0 == entries || entries > RING_MAX_ENTRIES || (entries & (entries - 1))) {
+                return -EINVAL;
+        }
+
+        if ((fd = get_empty_fd(curproc)) < 0) {
+                return fd;
+        }
+
+        if (NULL == (vn = vget(&ring_fs, next_rno++))) {
+                return -ENOMEM;
+        }
+        KASSERT(NULL == vn->vn_i);
+
+        if (NULL == (rk = kmalloc(sizeof(ring_kern_t)))) {
+                vput(vn);
+                return -ENOMEM;
+        }
+        rk->rk_pframe = NULL;
+        vn->vn_i = rk;
+
+        if ((err = pframe_get(&vn->vn_mmobj, 0, &rk->rk_pframe)) < 0) {
+                rk->rk_pframe = NULL;
+                vput(vn);
+                return err;
+        }
+        pframe_pin(rk->rk_pframe);
+        rk->rk_shared = rk->rk_pframe->pf_addr;
+        rk->rk_entries = entries;
+        rk->rk_shared->rs_entries = entries;
+
+        if (NULL == (f = fget(-1))) {
+                pframe_unpin(rk->rk_pframe);
+                rk->rk_pframe = NULL;
+                vput(vn);
+                return -ENOMEM;
+        }
+        f->f_mode = FMODE_READ | FMODE_WRITE;
+        f->f_pos = 0;
+        f->f_vnode = vn;        /* the file takes over our reference */
+        fdtable_install(curproc, fd, f);
+
+        return fd;
+}
+
+/*
+ * Read or write through a bounce page so that the file system only ever
+ * sees kernel buffers. Returns the number of bytes transferred, or -errno
+ * if nothing was.
+ */
+static int
+ring_rw(const ring_sqe_t *sqe, void *kbuf)
+{
+        char *ubuf = sqe->sqe_addr;
+        size_t left = sqe->sqe_len;
+        int total = 0;
+        int n, err;
+
+        while (left > 0) {
+                size_t chunk = MIN(left, PAGE_SIZE);
+
+                if (RING_OP_READ == sqe->sqe_opcode) {
+                        n = (sqe->sqe_off < 0)
+                            ? do_read(sqe->sqe_fd, kbuf, chunk)
+                            : do_pread(sqe->sqe_fd, kbuf, chunk, sqe->sqe_off + total);
+                        if (n > 0 && (err = copy_to_user(ubuf + total, kbuf, n)) < 0) {
+                                n = err;
+                        }
+                } else {
+                        if ((err = copy_from_user(kbuf, ubuf + total, chunk)) < 0) {
+                                n = err;
+                        } else {
+                                n = (sqe->sqe_off < 0)
+                                    ? do_write(sqe->sqe_fd, kbuf, chunk)
+                                    : do_pwrite(sqe->sqe_fd, kbuf, chunk, sqe->sqe_off + total);
+                        }
+                }
+
+                if (n < 0) {
+                        return (total > 0) ? total : n;
+                }
+                total += n;
+                left -= n;
+                if ((size_t)n != chunk) {
+                        break;
+                }
+        }
+
+        return total;
+}
+
+static int
+ring_execute(const ring_sqe_t *sqe, void *kbuf)
+{
+        switch (sqe->sqe_opcode) {
+                case RING_OP_NOP:
+                        return 0;
+
+                case RING_OP_READ:
+                case RING_OP_WRITE:
+                        return ring_rw(sqe, kbuf);
+
+                case RING_OP_OPEN: {
+                        argstr_t path;
+                        char *kpath;
+                        int ret;
+
+                        path.as_str = sqe->sqe_addr;
+                        path.as_len = sqe->sqe_len;
+                        if (NULL == (kpath = user_strdup(&path))) {
+                                return -EINVAL;
+                        }
+                        ret = do_open(kpath, sqe->sqe_open_flags);
+                        kfree(kpath);
+                        return ret;
+                }
+
+                case RING_OP_CLOSE:
+                        return do_close(sqe->sqe_fd);
+
+                case RING_OP_FSYNC:
+                        return do_fsync(sqe->sqe_fd);
+
+                default:
+                        return -EINVAL;
+        }
+}
+
+/*
+ * Consume up to to_submit entries from the submission queue of the ring
+ * open on fd, in order, posting a completion for each. Returns the number
+ * of entries consumed, which is less than to_submit if the submission
+ * queue runs dry or the completion queue fills up.
+ *
+ * There is no asynchronous block layer to hand requests to, so every
+ * entry is carried out before ring_enter() returns and its completion is
+ * already in the completion queue when it does.
+ *
+ * Error cases:
+ *      o EBADF
+ *        fd is not an open file descriptor.
+ *      o EINVAL
+ *        fd does not refer to a ring.
+ *      o ENOMEM
+ *        Insufficient kernel memory was available.
+ */
+int
+do_ring_enter(int fd, unsigned int to_submit)
+{
+        file_t *f;
+        ring_kern_t *rk;
+        ring_shared_t *rs;
+        void *kbuf = NULL;
+        uint32_t mask;
+        unsigned int submitted = 0;
+
+        if (fd < 0 || fd >= curproc->p_nfiles || NULL == (f = fget(fd))) {
+                return -EBADF;
+        }
+        if (&ring_fs != f->f_vnode->vn_fs) {
+                fput(f);
+                return -EINVAL;
+        }
+
+        rk = VNODE_TO_RING(f->f_vnode);
+        rs = rk->rk_shared;
+        mask = rk->rk_entries - 1;
+
+        while (submitted < to_submit) {
+                uint32_t head = rs->rs_sq_head;
+                ring_sqe_t sqe;
+                ring_cqe_t *cqe;
+                int res;
+
+                if (head == rs->rs_sq_tail
+                    || rs->rs_cq_tail - rs->rs_cq_head >= rk->rk_entries) {
+                        break;
+                }
+
+                /* Work from a copy the process can't change under us */
+                sqe = rs->rs_sqes[head & mask];
+                rs->rs_sq_head = head + 1;
+
+                if ((RING_OP_READ == sqe.sqe_opcode || RING_OP_WRITE == sqe.sqe_opcode)
+                    && NULL == kbuf && NULL == (kbuf = page_alloc())) {
+                        res = -ENOMEM;
+                } else {
+                        res = ring_execute(&sqe, kbuf);
+                }
+
+                cqe = &rs->rs_cqes[rs->rs_cq_tail & mask];
+                cqe->cqe_user_data = sqe.sqe_user_data;
+                cqe->cqe_res = res;
+                rs->rs_cq_tail++;
+                submitted++;
+        }
+
+        if (NULL != kbuf) {
+                page_free(kbuf);
+        }
+        fput(f);
+        return submitted;
+}
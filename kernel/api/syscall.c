@@ -2,8 +2,12 @@
 #include "globals.h"
 #include "errno.h"
 #include "types.h"
+#include "limits.h"
 
+#include "main/cpuid.h"
+#include "main/gdt.h"
 #include "main/interrupt.h"
+#include "main/smp.h"
 
 #include "proc/proc.h"
 #include "proc/kthread.h"
@@ -12,6 +16,8 @@
 #include "util/string.h"
 #include "util/debug.h"
 #include "util/list.h"
+#include "util/time.h"
+#include "util/timer.h"
 
 #include "mm/mman.h"
 #include "mm/mm.h"
@@ -21,6 +27,9 @@
 
 #include "fs/vfs_syscall.h"
 #include "fs/vnode.h"
+#include "fs/uio.h"
+#include "fs/pipe.h"
+#include "fs/poll.h"
 
 #include "test/kshell/kshell.h"
 
@@ -29,16 +38,109 @@
 #include "vm/vmmap.h"
 
 #include "api/syscall.h"
+#include "api/ring.h"
+#include "api/time.h"
+#include "api/resource.h"
+#include "api/times.h"
 #include "api/utsname.h"
+#include "api/kdata.h"
+#include "api/sysstat.h"
 #include "api/access.h"
 #include "api/exec.h"
+#include "api/futex.h"
 
 static void syscall_handler(regs_t *regs);
 static int syscall_dispatch(uint32_t sysnum, uint32_t args, regs_t *regs);
 
+/*
+ * Fast entry through sysenter. The processor loads esp from
+ * IA32_SYSENTER_ESP, which points at the TSS's esp0 slot, so the first
+ * thing to do is to switch to the thread's kernel stack. Userland passes
+ * its stack pointer in ecx, with the address to resume at on top of it
+ * (see weenix/trap.h).
+ *
+ * We build the same frame "int $INTR_SYSCALL" would have, so nothing
+ * past here can tell the two apart: fork copies it for the child, which
+ * leaves through iret, and execve's new eip and esp are picked up from
+ * it on the way out through sysexit.
+ */
+extern char __sysenter_entry[];
+__asm__(
+        ".global __sysenter_entry\n"
+        "__sysenter_entry:\n\t"
+        "movl (%esp), %esp\n\t"
+        "pushl $(" QUOTE(GDT_USER_DATA) " + 3)\n\t"  /* ss */
+        "pushl %ecx\n\t"                              /* useresp */
+        "pushfl\n\t"                                  /* eflags, but sysenter cleared IF */
+        "orl $0x200, (%esp)\n\t"
+        "pushl $(" QUOTE(GDT_USER_TEXT) " + 3)\n\t"  /* cs */
+        "pushl $0\n\t"                                /* eip, see __sysenter_handler() */
+        "pushl $0\n\t"                                /* err */
+        "pushl $" QUOTE(INTR_SYSCALL) "\n\t"
+        "pusha\n\t"
+        "push %ds\n\t"
+        "push %es\n\t"
+        "movl %ss, %edx\n\t"
+        "movl %edx, %ds\n\t"
+        "movl %edx, %es\n\t"
+        "pushl %esp\n\t"
+        "call __sysenter_handler\n\t"
+        "add $4, %esp\n\t"
+        "pop %es\n\t"
+        "pop %ds\n\t"
+        "popa\n\t"
+        "add $8, %esp\n\t"
+        "movl (%esp), %edx\n\t"                       /* eip for sysexit */
+        "movl 12(%esp), %ecx\n\t"                     /* esp for sysexit */
+        "add $8, %esp\n\t"
+        "andl $~0x200, (%esp)\n\t"                    /* interrupts stay off... */
+        "popfl\n\t"
+        "sti\n\t"                                     /* ...until sysexit is done */
+        "sysexit\n"
+);
+
+static __attribute__((used)) void __sysenter_handler(regs_t *regs)
+{
+        uint32_t eip;
+
+        smp_lock_kernel();
+        /* The syscall gate is a trap gate, so int leaves interrupts on */
+        intr_enable();
+
+        if (copy_from_user(&eip, (void *)regs->r_useresp, sizeof(eip)) < 0) {
+                do_exit(EFAULT);
+        }
+        regs->r_eip = eip;
+        regs->r_useresp += sizeof(eip);
+
+        syscall_handler(regs);
+        /* int 0x2e gets these from __intr_handler() */
+        if (curthr->kt_cancelled) {
+                kthread_exit(curthr->kt_retval);
+        }
+#ifdef __UPREEMPT__
+        sched_preempt();
+#endif
+        /* The sti just before sysexit turns them back on */
+        intr_disable();
+        smp_unlock_kernel();
+}
+
+void syscall_init_cpu(void)
+{
+        /* Userland makes the same check to decide whether to use sysenter */
+        if (cpuid_has_sysenter()) {
+                cpuid_set_msr(IA32_SYSENTER_CS_MSR, GDT_KERNEL_TEXT, 0);
+                cpuid_set_msr(IA32_SYSENTER_ESP_MSR, (uint32_t)gdt_kernel_stack_slot(), 0);
+                cpuid_set_msr(IA32_SYSENTER_EIP_MSR, (uint32_t)__sysenter_entry, 0);
+                dbg(DBG_SYSCALL, "sysenter enabled\n");
+        }
+}
+
 static __attribute__((unused)) void syscall_init(void)
 {
         intr_register(INTR_SYSCALL, syscall_handler);
+        syscall_init_cpu();
 }
 init_func(syscall_init);
 
@@ -94,6 +196,10 @@ sys_read(read_args_t *arg)
         if ((unsigned)actual_read != readlen) {
             break;
         }
+#ifdef __UPREEMPT__
+        /*nothing is held between pages, so a big read can be preempted*/
+        sched_preempt();
+#endif
     }
 /*
  *    err = do_read(kern_args.fd, kaddr, kern_args.nbytes);
@@ -133,6 +239,12 @@ sys_write(write_args_t *arg)
     while (count > 0) {
         size_t writelen = MIN(PAGE_SIZE, count);
 
+        /*a pipe may have kept our last page*/
+        if (kaddr == NULL && (kaddr = page_alloc()) == NULL) {
+            curthr->kt_errno = ENOMEM;
+            return total_write ? total_write : -1;
+        }
+
         err = copy_from_user(kaddr, buff, writelen);
         if (err < 0) {
             page_free(kaddr);
@@ -141,9 +253,25 @@ sys_write(write_args_t *arg)
         }
         KASSERT(err == 0);
 
-        int actual_write = do_write(kern_args.fd, kaddr, writelen);
+        /*full pages go into pipes without another copy*/
+        int actual_write = -ESPIPE;
+        if (writelen == PAGE_SIZE) {
+            actual_write = pipe_give_page(kern_args.fd, kaddr, writelen);
+            if (actual_write > 0) {
+                kaddr = NULL;
+            }
+        }
+        if (actual_write == -ESPIPE) {
+            actual_write = do_write(kern_args.fd, kaddr, writelen);
+        }
         if (actual_write < 0) {
-            page_free(kaddr);
+            if (kaddr) {
+                page_free(kaddr);
+            }
+            /*pages already in a pipe whose readers then left still count*/
+            if (total_write > 0) {
+                return total_write;
+            }
             curthr->kt_errno = -actual_write;
             return -1;
         }
@@ -155,6 +283,10 @@ sys_write(write_args_t *arg)
         if ((unsigned)actual_write != writelen) {
             break;
         }
+#ifdef __UPREEMPT__
+        /*nothing is held between pages, so a big write can be preempted*/
+        sched_preempt();
+#endif
     }
 
     /*
@@ -166,21 +298,524 @@ sys_write(write_args_t *arg)
      *}
      */
 
-    page_free(kaddr);
+    if (kaddr) {
+        page_free(kaddr);
+    }
 
     return total_write;
         /*NOT_YET_IMPLEMENTED("VM: sys_write");*/
         /*return -1;*/
 }
 
+/*
+ * Reads into the user segments described by the kernel copy of an iovec
+ * array. Data is read one page at a time into a bounce buffer and then
+ * scattered across as many segments as it covers, so the number of VFS
+ * reads depends on the total length and not on the number of segments.
+ *
+ * If pos is NULL the file position is used and advanced, otherwise the
+ * read starts at *pos and *pos is advanced instead.
+ *
+ * Returns the number of bytes read, or -errno.
+ */
+static int
+iov_read(int fd, const struct iovec *kiov, int iovcnt, off_t *pos)
+{
+        size_t total = 0;
+        int i;
+
+        for (i = 0; i < iovcnt; i++) {
+                if (kiov[i].iov_len > (size_t)INT_MAX - total) {
+                        return -EINVAL;
+                }
+                total += kiov[i].iov_len;
+        }
+
+        void *kaddr = page_alloc();
+        if (NULL == kaddr) {
+                return -ENOMEM;
+        }
+
+        int seg = 0;
+        size_t segoff = 0;
+        int total_read = 0;
+
+        while (total > 0) {
+                size_t readlen = MIN(PAGE_SIZE, total);
+                int actual_read;
+
+                if (NULL == pos) {
+                        actual_read = do_read(fd, kaddr, readlen);
+                } else {
+                        actual_read = do_pread(fd, kaddr, readlen, *pos);
+                }
+                if (actual_read < 0) {
+                        page_free(kaddr);
+                        return actual_read;
+                }
+                KASSERT((unsigned)actual_read <= readlen);
+
+                /* scatter the page across the user segments */
+                size_t copied = 0;
+                while (copied < (unsigned)actual_read) {
+                        KASSERT(seg < iovcnt);
+                        size_t n = MIN(kiov[seg].iov_len - segoff,
+                                       (unsigned)actual_read - copied);
+                        int err = copy_to_user((char *)kiov[seg].iov_base + segoff,
+                                               (char *)kaddr + copied, n);
+                        if (err < 0) {
+                                page_free(kaddr);
+                                return err;
+                        }
+                        copied += n;
+                        segoff += n;
+                        if (segoff == kiov[seg].iov_len) {
+                                seg++;
+                                segoff = 0;
+                        }
+                }
+
+                if (NULL != pos) {
+                        *pos += actual_read;
+                }
+                total -= actual_read;
+                total_read += actual_read;
+                if ((unsigned)actual_read != readlen) {
+                        break;
+                }
+        }
+
+        page_free(kaddr);
+        return total_read;
+}
+
+/*
+ * The dual of iov_read: gathers up to a page of data from consecutive user
+ * segments into a bounce buffer and hands the whole page to a single VFS
+ * write.
+ */
+static int
+iov_write(int fd, const struct iovec *kiov, int iovcnt, off_t *pos)
+{
+        size_t total = 0;
+        int i;
+
+        for (i = 0; i < iovcnt; i++) {
+                if (kiov[i].iov_len > (size_t)INT_MAX - total) {
+                        return -EINVAL;
+                }
+                total += kiov[i].iov_len;
+        }
+
+        void *kaddr = page_alloc();
+        if (NULL == kaddr) {
+                return -ENOMEM;
+        }
+
+        int seg = 0;
+        size_t segoff = 0;
+        int total_write = 0;
+
+        while (total > 0) {
+                size_t writelen = MIN(PAGE_SIZE, total);
+
+                /* gather the user segments into the page */
+                size_t copied = 0;
+                while (copied < writelen) {
+                        KASSERT(seg < iovcnt);
+                        size_t n = MIN(kiov[seg].iov_len - segoff, writelen - copied);
+                        int err = copy_from_user((char *)kaddr + copied,
+                                                 (char *)kiov[seg].iov_base + segoff, n);
+                        if (err < 0) {
+                                page_free(kaddr);
+                                return err;
+                        }
+                        copied += n;
+                        segoff += n;
+                        if (segoff == kiov[seg].iov_len) {
+                                seg++;
+                                segoff = 0;
+                        }
+                }
+
+                int actual_write;
+                if (NULL == pos) {
+                        actual_write = do_write(fd, kaddr, writelen);
+                } else {
+                        actual_write = do_pwrite(fd, kaddr, writelen, *pos);
+                }
+                if (actual_write < 0) {
+                        page_free(kaddr);
+                        return actual_write;
+                }
+                KASSERT((unsigned)actual_write <= writelen);
+
+                if (NULL != pos) {
+                        *pos += actual_write;
+                }
+                total -= actual_write;
+                total_write += actual_write;
+                if ((unsigned)actual_write != writelen) {
+                        break;
+                }
+        }
+
+        page_free(kaddr);
+        return total_write;
+}
+
+static int
+sys_pread(pread_args_t *arg)
+{
+        pread_args_t kern_args;
+        struct iovec iov;
+        int err;
+
+        if ((err = copy_from_user(&kern_args, arg, sizeof(pread_args_t))) < 0) {
+                curthr->kt_errno = -err;
+                return -1;
+        }
+
+        iov.iov_base = kern_args.buf;
+        iov.iov_len = kern_args.nbytes;
+        if ((err = iov_read(kern_args.fd, &iov, 1, &kern_args.offset)) < 0) {
+                curthr->kt_errno = -err;
+                return -1;
+        }
+        return err;
+}
+
+static int
+sys_pwrite(pwrite_args_t *arg)
+{
+        pwrite_args_t kern_args;
+        struct iovec iov;
+        int err;
+
+        if ((err = copy_from_user(&kern_args, arg, sizeof(pwrite_args_t))) < 0) {
+                curthr->kt_errno = -err;
+                return -1;
+        }
+
+        iov.iov_base = kern_args.buf;
+        iov.iov_len = kern_args.nbytes;
+        if ((err = iov_write(kern_args.fd, &iov, 1, &kern_args.offset)) < 0) {
+                curthr->kt_errno = -err;
+                return -1;
+        }
+        return err;
+}
+
+/*
+ * Copies in the user's iovec array. Returns a kmalloc'd kernel copy through
+ * kiovp (which the caller must kfree), or -errno.
+ */
+static int
+user_iovdup(const struct iovec *uiov, int iovcnt, struct iovec **kiovp)
+{
+        struct iovec *kiov;
+        int err;
+
+        if (iovcnt < 0 || iovcnt > IOV_MAX) {
+                return -EINVAL;
+        }
+        if (0 == iovcnt) {
+                *kiovp = NULL;
+                return 0;
+        }
+
+        if (NULL == (kiov = kmalloc(iovcnt * sizeof(struct iovec)))) {
+                return -ENOMEM;
+        }
+        if ((err = copy_from_user(kiov, uiov, iovcnt * sizeof(struct iovec))) < 0) {
+                kfree(kiov);
+                return err;
+        }
+
+        *kiovp = kiov;
+        return 0;
+}
+
+static int
+sys_readv(readv_args_t *arg)
+{
+        readv_args_t kern_args;
+        struct iovec *kiov;
+        int err;
+
+        if ((err = copy_from_user(&kern_args, arg, sizeof(readv_args_t))) < 0) {
+                curthr->kt_errno = -err;
+                return -1;
+        }
+
+        if ((err = user_iovdup(kern_args.iov, kern_args.iovcnt, &kiov)) < 0) {
+                curthr->kt_errno = -err;
+                return -1;
+        }
+
+        err = iov_read(kern_args.fd, kiov, kern_args.iovcnt, NULL);
+        if (NULL != kiov) {
+                kfree(kiov);
+        }
+
+        if (err < 0) {
+                curthr->kt_errno = -err;
+                return -1;
+        }
+        return err;
+}
+
+static int
+sys_writev(writev_args_t *arg)
+{
+        writev_args_t kern_args;
+        struct iovec *kiov;
+        int err;
+
+        if ((err = copy_from_user(&kern_args, arg, sizeof(writev_args_t))) < 0) {
+                curthr->kt_errno = -err;
+                return -1;
+        }
+
+        if ((err = user_iovdup(kern_args.iov, kern_args.iovcnt, &kiov)) < 0) {
+                curthr->kt_errno = -err;
+                return -1;
+        }
+
+        err = iov_write(kern_args.fd, kiov, kern_args.iovcnt, NULL);
+        if (NULL != kiov) {
+                kfree(kiov);
+        }
+
+        if (err < 0) {
+                curthr->kt_errno = -err;
+                return -1;
+        }
+        return err;
+}
+
+/*
+ * Copies the optional user offsets in and out around do_copy_file_range.
+ * No flags are defined yet, so flags must be zero.
+ */
+static int
+sys_copy_file_range(copy_file_range_args_t *arg)
+{
+        copy_file_range_args_t kern_args;
+        off_t off_in, off_out;
+        int err;
+
+        if ((err = copy_from_user(&kern_args, arg, sizeof(copy_file_range_args_t))) < 0) {
+                goto error;
+        }
+
+        if (0 != kern_args.flags) {
+                err = -EINVAL;
+                goto error;
+        }
+        if (NULL != kern_args.off_in &&
+            (err = copy_from_user(&off_in, kern_args.off_in, sizeof(off_t))) < 0) {
+                goto error;
+        }
+        if (NULL != kern_args.off_out &&
+            (err = copy_from_user(&off_out, kern_args.off_out, sizeof(off_t))) < 0) {
+                goto error;
+        }
+
+        int copied = do_copy_file_range(kern_args.fd_in,
+                                         kern_args.off_in ? &off_in : NULL,
+                                         kern_args.fd_out,
+                                         kern_args.off_out ? &off_out : NULL,
+                                         kern_args.len);
+        if (copied < 0) {
+                err = copied;
+                goto error;
+        }
+
+        if (NULL != kern_args.off_in &&
+            (err = copy_to_user(kern_args.off_in, &off_in, sizeof(off_t))) < 0) {
+                goto error;
+        }
+        if (NULL != kern_args.off_out &&
+            (err = copy_to_user(kern_args.off_out, &off_out, sizeof(off_t))) < 0) {
+                goto error;
+        }
+        return copied;
+
+error:
+        curthr->kt_errno = -err;
+        return -1;
+}
+
+static int
+sys_splice(splice_args_t *arg)
+{
+        splice_args_t kern_args;
+        off_t off_in, off_out;
+        int err;
+
+        if ((err = copy_from_user(&kern_args, arg, sizeof(splice_args_t))) < 0) {
+                goto error;
+        }
+
+        if (0 != kern_args.flags) {
+                err = -EINVAL;
+                goto error;
+        }
+        if (NULL != kern_args.off_in &&
+            (err = copy_from_user(&off_in, kern_args.off_in, sizeof(off_t))) < 0) {
+                goto error;
+        }
+        if (NULL != kern_args.off_out &&
+            (err = copy_from_user(&off_out, kern_args.off_out, sizeof(off_t))) < 0) {
+                goto error;
+        }
+
+        int moved = do_splice(kern_args.fd_in,
+                              kern_args.off_in ? &off_in : NULL,
+                              kern_args.fd_out,
+                              kern_args.off_out ? &off_out : NULL,
+                              kern_args.len);
+        if (moved < 0) {
+                err = moved;
+                goto error;
+        }
+
+        if (NULL != kern_args.off_in &&
+            (err = copy_to_user(kern_args.off_in, &off_in, sizeof(off_t))) < 0) {
+                goto error;
+        }
+        if (NULL != kern_args.off_out &&
+            (err = copy_to_user(kern_args.off_out, &off_out, sizeof(off_t))) < 0) {
+                goto error;
+        }
+        return moved;
+
+error:
+        curthr->kt_errno = -err;
+        return -1;
+}
+
+/*
+ * Userland's pages can't be lent to a pipe safely, since the process may
+ * exit or unmap them while they are still in it, so each piece of each
+ * segment is copied once, into a page which the pipe then takes as is.
+ */
+static int
+sys_vmsplice(vmsplice_args_t *arg)
+{
+        vmsplice_args_t kern_args;
+        struct iovec *kiov;
+        int moved = 0;
+        int err, i;
+
+        if ((err = copy_from_user(&kern_args, arg, sizeof(vmsplice_args_t))) < 0) {
+                curthr->kt_errno = -err;
+                return -1;
+        }
+        if (0 != kern_args.flags) {
+                curthr->kt_errno = EINVAL;
+                return -1;
+        }
+        if ((err = user_iovdup(kern_args.iov, kern_args.iovcnt, &kiov)) < 0) {
+                curthr->kt_errno = -err;
+                return -1;
+        }
+
+        for (i = 0; i < kern_args.iovcnt && 0 == err; i++) {
+                char *base = kiov[i].iov_base;
+                size_t left = kiov[i].iov_len;
+
+                while (left > 0) {
+                        size_t n = MIN(left, PAGE_SIZE);
+                        void *page;
+
+                        if (NULL == (page = page_alloc())) {
+                                err = -ENOMEM;
+                                break;
+                        }
+                        if ((err = copy_from_user(page, base, n)) < 0 ||
+                            (err = pipe_give_page(kern_args.fd, page, n)) < 0) {
+                                page_free(page);
+                                break;
+                        }
+                        err = 0;
+                        base += n;
+                        left -= n;
+                        moved += n;
+                }
+        }
+        if (NULL != kiov) {
+                kfree(kiov);
+        }
+
+        if (0 == moved && err < 0) {
+                /* splicing user memory only makes sense into a pipe */
+                curthr->kt_errno = (-ESPIPE == err) ? EBADF : -err;
+                return -1;
+        }
+        return moved;
+}
+
+static int
+sys_poll(poll_args_t *arg)
+{
+        poll_args_t kern_args;
+        struct pollfd *kfds = NULL;
+        size_t size;
+        int err;
+
+        if ((err = copy_from_user(&kern_args, arg, sizeof(poll_args_t))) < 0) {
+                curthr->kt_errno = -err;
+                return -1;
+        }
+
+        if (kern_args.nfds > NFILES_MAX) {
+                curthr->kt_errno = EINVAL;
+                return -1;
+        }
+
+        size = kern_args.nfds * sizeof(struct pollfd);
+        if (size > 0) {
+                if (NULL == (kfds = kmalloc(size))) {
+                        curthr->kt_errno = ENOMEM;
+                        return -1;
+                }
+                if ((err = copy_from_user(kfds, kern_args.fds, size)) < 0) {
+                        goto done;
+                }
+        }
+
+        if ((err = do_poll(kfds, kern_args.nfds, kern_args.timeout)) < 0) {
+                goto done;
+        }
+
+        if (size > 0) {
+                int nready = err;
+                if ((err = copy_to_user(kern_args.fds, kfds, size)) < 0) {
+                        goto done;
+                }
+                err = nready;
+        }
+
+done:
+        if (NULL != kfds) {
+                kfree(kfds);
+        }
+        if (err < 0) {
+                curthr->kt_errno = -err;
+                return -1;
+        }
+        return err;
+}
+
 /*
  * This is another tricly sys_* function that you will need to write.
- * It's pretty similar to sys_read(), but you don't need
- * to allocate a whole page, just a single dirent_t. call do_getdents in a
- * loop until you have read getdent_args_t->count bytes (or an error
- * occurs).  You should note that count is the number of bytes in the
- * buffer, not the number of dirents, which means that you'll need to loop
- * a max of something like count / sizeof(dirent_t) times.
+ * It's pretty similar to sys_read(): dirents are gathered a page at a time
+ * with do_getdents() into a kernel page and copied out, until
+ * getdent_args_t->count bytes have been read or the directory runs out.
+ * Note that count is the number of bytes in the buffer, not the number of
+ * dirents, and that only whole dirents are ever returned.
  */
 static int
 sys_getdents(getdents_args_t *arg)
@@ -193,35 +828,52 @@ sys_getdents(getdents_args_t *arg)
         return -1;
     }
 
-    dirent_t dirent;
-    size_t maxdir = kern_args.count / sizeof(dirent_t);
+    if (kern_args.count < sizeof(dirent_t)) {
+        curthr->kt_errno = EINVAL;
+        return -1;
+    }
+
+    void *kaddr = page_alloc();
+    if (kaddr == NULL) {
+        curthr->kt_errno = ENOMEM;
+        return -1;
+    }
 
-    size_t i;
+    size_t perpage = (PAGE_SIZE / sizeof(dirent_t)) * sizeof(dirent_t);
+    size_t remaining = (kern_args.count / sizeof(dirent_t)) * sizeof(dirent_t);
     int total_read = 0;
-    for (i = 0 ; i < maxdir ; i++) {
-        int actual_read = do_getdent(kern_args.fd, &dirent);
+
+    while (remaining > 0) {
+        size_t want = MIN(remaining, perpage);
+        int actual_read = do_getdents(kern_args.fd, kaddr, want);
         if (actual_read < 0) {
+            page_free(kaddr);
             curthr->kt_errno = -actual_read;
             return -1;
         }
-        KASSERT(actual_read == 0 || actual_read == sizeof(dirent_t));
+        KASSERT(actual_read % sizeof(dirent_t) == 0);
         /*no more dirents, just break out*/
         if (actual_read == 0) {
             break;
         }
 
-        char *uaddr = (char *)kern_args.dirp + i * sizeof(dirent_t);
-        err = copy_to_user(uaddr, &dirent, sizeof(dirent_t));
+        char *uaddr = (char *)kern_args.dirp + total_read;
+        err = copy_to_user(uaddr, kaddr, actual_read);
         if (err < 0) {
+            page_free(kaddr);
             curthr->kt_errno = -err;
             return -1;
         }
-        KASSERT(err == 0);
 
         /*only increment total_read when copy_to_user succeed*/
         total_read += actual_read;
+        remaining -= actual_read;
+        if ((size_t)actual_read < want) {
+            break;
+        }
     }
 
+    page_free(kaddr);
     return total_read;
         /*NOT_YET_IMPLEMENTED("VM: sys_getdents");*/
         /*return -1;*/
@@ -307,6 +959,39 @@ static int sys_close(int fd)
         } else return err;
 }
 
+static int sys_fsync(int fd)
+{
+        int err;
+
+        if ((err = do_fsync(fd)) < 0) {
+                curthr->kt_errno = -err;
+                return -1;
+        } else return err;
+}
+
+static int sys_ring_setup(unsigned int entries)
+{
+        int err;
+
+        if ((err = do_ring_setup(entries)) < 0) {
+                curthr->kt_errno = -err;
+                return -1;
+        } else return err;
+}
+
+static int sys_ring_enter(ring_enter_args_t *arg)
+{
+        ring_enter_args_t kern_args;
+        int err;
+
+        if ((err = copy_from_user(&kern_args, arg, sizeof(kern_args))) < 0
+            || (err = do_ring_enter(kern_args.fd, kern_args.to_submit)) < 0) {
+                curthr->kt_errno = -err;
+                return -1;
+        }
+        return err;
+}
+
 static int sys_dup(int fd)
 {
         int err;
@@ -611,6 +1296,231 @@ static pid_t sys_waitpid(waitpid_args_t *args)
         return p;
 }
 
+/* Find a process by pid for the priority syscalls; 0 means curproc */
+static proc_t *priority_proc(pid_t pid)
+{
+        return (0 == pid) ? curproc : proc_lookup(pid);
+}
+
+static int sys_setpriority(setpriority_args_t *args)
+{
+        setpriority_args_t kargs;
+        kthread_t *thr;
+        proc_t *p;
+
+        if (0 > copy_from_user(&kargs, args, sizeof(kargs))) {
+                curthr->kt_errno = EFAULT;
+                return -1;
+        }
+        if (NULL == (p = priority_proc(kargs.pid))) {
+                curthr->kt_errno = ESRCH;
+                return -1;
+        }
+
+        list_iterate_begin(&p->p_threads, thr, kthread_t, kt_plink) {
+                if (thr->kt_fixed) {
+                        curthr->kt_errno = EPERM;
+                        return -1;
+                }
+                sched_set_nice(thr, kargs.nice);
+        } list_iterate_end();
+        return 0;
+}
+
+/*
+ * Returns 20 - nice, which is never negative, so that a nice value of -1
+ * can't be mistaken for an error; libc undoes this.
+ */
+static int sys_getpriority(pid_t pid)
+{
+        proc_t *p;
+        kthread_t *thr;
+
+        if (NULL == (p = priority_proc(pid)) || list_empty(&p->p_threads)) {
+                curthr->kt_errno = ESRCH;
+                return -1;
+        }
+        thr = list_head(&p->p_threads, kthread_t, kt_plink);
+        return NICE_MAX + 1 - thr->kt_nice;
+}
+
+/*
+ * Sleeps on a queue of our own, which nothing else can wake, until the
+ * time is up or the thread is cancelled. The tick we are in is already
+ * partly over, so we sleep one more than asked for, which is never less
+ * than the time asked for.
+ */
+static int sys_nanosleep(nanosleep_args_t *args)
+{
+        nanosleep_args_t kargs;
+        struct timespec req, rem;
+        uint32_t ticks, start, slept;
+        ktqueue_t q;
+        int err;
+
+        if ((err = copy_from_user(&kargs, args, sizeof(kargs))) < 0
+            || (err = copy_from_user(&req, kargs.req, sizeof(req))) < 0) {
+                curthr->kt_errno = -err;
+                return -1;
+        }
+        if (req.tv_sec < 0 || req.tv_nsec < 0 || req.tv_nsec >= NSEC_PER_SEC) {
+                curthr->kt_errno = EINVAL;
+                return -1;
+        }
+        if (0 == (ticks = time_to_ticks(&req))) {
+                return 0;
+        }
+        if (ticks < TIMER_MAX_TICKS) {
+                ticks++;
+        }
+
+        sched_queue_init(&q);
+        start = jiffies;
+        if (-EINTR != (err = sched_sleep_on_timeout(&q, ticks))) {
+                KASSERT(-ETIMEDOUT == err);
+                return 0;
+        }
+
+        if (NULL != kargs.rem) {
+                slept = jiffies - start;
+                ticks_to_time((slept < ticks) ? ticks - slept : 0, &rem);
+                if ((err = copy_to_user(kargs.rem, &rem, sizeof(rem))) < 0) {
+                        curthr->kt_errno = -err;
+                        return -1;
+                }
+        }
+        curthr->kt_errno = EINTR;
+        return -1;
+}
+
+static int sys_clock_gettime(clock_gettime_args_t *args)
+{
+        clock_gettime_args_t kargs;
+        struct timespec ts;
+        uint64_t ns;
+        int err;
+
+        if ((err = copy_from_user(&kargs, args, sizeof(kargs))) < 0) {
+                curthr->kt_errno = -err;
+                return -1;
+        }
+        if (CLOCK_MONOTONIC != kargs.clock) {
+                curthr->kt_errno = EINVAL;
+                return -1;
+        }
+
+        ns = time_monotonic_ns();
+        ts.tv_sec = (time_t)(ns / NSEC_PER_SEC);
+        ts.tv_nsec = (long)(ns % NSEC_PER_SEC);
+        if ((err = copy_to_user(kargs.tp, &ts, sizeof(ts))) < 0) {
+                curthr->kt_errno = -err;
+                return -1;
+        }
+        return 0;
+}
+
+static void usage_timeval(uint32_t ticks, struct timeval *tv)
+{
+        tv->tv_sec = (time_t)(ticks / HZ);
+        tv->tv_usec = (long)(ticks % HZ) * TICK_MSECS * 1000;
+}
+
+static int sys_getrusage(getrusage_args_t *args)
+{
+        getrusage_args_t kargs;
+        struct rusage ru;
+        kt_usage_t u;
+        int err;
+
+        if ((err = copy_from_user(&kargs, args, sizeof(kargs))) < 0) {
+                curthr->kt_errno = -err;
+                return -1;
+        }
+        if (RUSAGE_SELF == kargs.who) {
+                proc_usage(curproc, &u);
+        } else if (RUSAGE_CHILDREN == kargs.who) {
+                u = curproc->p_cusage;
+        } else {
+                curthr->kt_errno = EINVAL;
+                return -1;
+        }
+
+        memset(&ru, 0, sizeof(ru));
+        usage_timeval(u.u_utime, &ru.ru_utime);
+        usage_timeval(u.u_stime, &ru.ru_stime);
+        ru.ru_nvcsw = (long)u.u_nvcsw;
+        ru.ru_nivcsw = (long)u.u_nivcsw;
+        ru.ru_wtime.tv_sec = (time_t)(u.u_wait_ns / NSEC_PER_SEC);
+        ru.ru_wtime.tv_usec = (long)(u.u_wait_ns % NSEC_PER_SEC / 1000);
+        if ((err = copy_to_user(kargs.ru, &ru, sizeof(ru))) < 0) {
+                curthr->kt_errno = -err;
+                return -1;
+        }
+        return 0;
+}
+
+/*
+ * Returns the ticks since boot, which only has to be a fixed point to
+ * measure from. The top bit is dropped, so that it is never mistaken
+ * for an error; it wraps every few months.
+ */
+static int sys_times(struct tms *buf)
+{
+        struct tms ktms;
+        kt_usage_t u;
+        int err;
+
+        proc_usage(curproc, &u);
+        ktms.tms_utime = (clock_t)u.u_utime;
+        ktms.tms_stime = (clock_t)u.u_stime;
+        ktms.tms_cutime = (clock_t)curproc->p_cusage.u_utime;
+        ktms.tms_cstime = (clock_t)curproc->p_cusage.u_stime;
+        if ((err = copy_to_user(buf, &ktms, sizeof(ktms))) < 0) {
+                curthr->kt_errno = -err;
+                return -1;
+        }
+        return (int)(jiffies & 0x7fffffff);
+}
+
+static int sys_futex(futex_args_t *args)
+{
+        futex_args_t kargs;
+        struct timespec timeout;
+        int err;
+
+        if ((err = copy_from_user(&kargs, args, sizeof(kargs))) < 0) {
+                curthr->kt_errno = -err;
+                return -1;
+        }
+        switch (kargs.op) {
+                case FUTEX_WAIT:
+                        if (NULL != kargs.timeout
+                            && (err = copy_from_user(&timeout, kargs.timeout,
+                                                     sizeof(timeout))) < 0) {
+                                break;
+                        }
+                        err = do_futex_wait(kargs.uaddr, kargs.val,
+                                            (NULL != kargs.timeout) ? &timeout : NULL);
+                        break;
+                case FUTEX_WAKE:
+                        err = (kargs.val < 0) ? -EINVAL : do_futex_wake(kargs.uaddr, kargs.val);
+                        break;
+                default:
+                        err = -EINVAL;
+                        break;
+        }
+        if (err < 0) {
+                curthr->kt_errno = -err;
+                return -1;
+        }
+        return err;
+}
+
+static int sys_alarm(unsigned int seconds)
+{
+        return (int)do_alarm(seconds);
+}
+
 static void *sys_brk(void *addr)
 {
         void *ret;
@@ -688,38 +1598,15 @@ static int sys_pipe(int arg[2])
 
 static int sys_uname(struct utsname *arg)
 {
-        static const char sysname[] = "Weenix";
-        static const char release[] = "1.2";
-        /* Version = last compilation time */
-        static const char version[] = "#1 " __DATE__ " " __TIME__;
-        static const char nodename[] = "";
-        static const char machine[] = "";
-        int ret = 0;
+        int ret;
 
-        ret = copy_to_user(arg->sysname, sysname, sizeof(sysname));
-        if (ret != 0) {
-                goto err;
-        }
-        ret = copy_to_user(arg->release, release, sizeof(release));
-        if (ret != 0) {
-                goto err;
-        }
-        ret = copy_to_user(arg->version, version, sizeof(version));
-        if (ret != 0) {
-                goto err;
-        }
-        ret = copy_to_user(arg->nodename, nodename, sizeof(nodename));
-        if (ret != 0) {
-                goto err;
-        }
-        ret = copy_to_user(arg->machine, machine, sizeof(machine));
+        /* The same data userland can read from the kernel data page */
+        ret = copy_to_user(arg, &kdata_shared->kd_utsname, sizeof(struct utsname));
         if (ret != 0) {
-                goto err;
+                curthr->kt_errno = -ret;
+                return -1;
         }
         return 0;
-err:
-        curthr->kt_errno = -ret;
-        return -1;
 }
 
 static int sys_fork(regs_t *regs)
@@ -845,7 +1732,13 @@ static void syscall_handler(regs_t *regs)
 
         dbginfo(DBG_VMMAP, vmmap_mapping_info, curproc->p_vmmap);
 
+#ifdef __SYSSTATS__
+        uint64_t start = cpuid_rdtsc();
+#endif
         int ret = syscall_dispatch(sysnum, args, regs);
+#ifdef __SYSSTATS__
+        sysstat_record(sysnum, ret, cpuid_rdtsc() - start);
+#endif
 
         if (curthr->kt_cancelled) {
                 dbg(DBG_SYSCALL, "trap: CANCELLING: thread %p of proc %d "
@@ -876,8 +1769,7 @@ static int syscall_dispatch(uint32_t sysnum, uint32_t args, regs_t *regs)
                         return 0;
 
                 case SYS_thr_yield:
-                        sched_make_runnable(curthr);
-                        sched_switch();
+                        sched_yield();
                         return 0;
 
                 case SYS_fork:
@@ -916,6 +1808,63 @@ static int syscall_dispatch(uint32_t sysnum, uint32_t args, regs_t *regs)
                 case SYS_write:
                         return sys_write((write_args_t *)args);
 
+                case SYS_pread:
+                        return sys_pread((pread_args_t *)args);
+
+                case SYS_pwrite:
+                        return sys_pwrite((pwrite_args_t *)args);
+
+                case SYS_readv:
+                        return sys_readv((readv_args_t *)args);
+
+                case SYS_writev:
+                        return sys_writev((writev_args_t *)args);
+
+                case SYS_copy_file_range:
+                        return sys_copy_file_range((copy_file_range_args_t *)args);
+
+                case SYS_splice:
+                        return sys_splice((splice_args_t *)args);
+
+                case SYS_vmsplice:
+                        return sys_vmsplice((vmsplice_args_t *)args);
+
+                case SYS_setpriority:
+                        return sys_setpriority((setpriority_args_t *)args);
+
+                case SYS_getpriority:
+                        return sys_getpriority((pid_t)args);
+
+                case SYS_nanosleep:
+                        return sys_nanosleep((nanosleep_args_t *)args);
+
+                case SYS_alarm:
+                        return sys_alarm((unsigned int)args);
+
+                case SYS_clock_gettime:
+                        return sys_clock_gettime((clock_gettime_args_t *)args);
+
+                case SYS_getrusage:
+                        return sys_getrusage((getrusage_args_t *)args);
+
+                case SYS_times:
+                        return sys_times((struct tms *)args);
+
+                case SYS_futex:
+                        return sys_futex((futex_args_t *)args);
+
+                case SYS_poll:
+                        return sys_poll((poll_args_t *)args);
+
+                case SYS_fsync:
+                        return sys_fsync((int)args);
+
+                case SYS_ring_setup:
+                        return sys_ring_setup((unsigned int)args);
+
+                case SYS_ring_enter:
+                        return sys_ring_enter((ring_enter_args_t *)args);
+
                 case SYS_dup:
                         return sys_dup((int)args);
 
@@ -0,0 +1,337 @@
+/*
+ *  FILE: sysstat.c
+ *  DESC: Per-syscall counters and latency histograms, and /dev/sysstat;
+ *        see api/sysstat.h for what is recorded.
+ */
+
+#include "kernel.h"
+#include "errno.h"
+#include "globals.h"
+
+#include "api/syscall.h"
+#include "api/sysstat.h"
+
+#include "drivers/bytedev.h"
+#include "drivers/dev.h"
+
+#include "mm/kmalloc.h"
+
+#include "proc/proc.h"
+
+#include "util/debug.h"
+#include "util/init.h"
+#include "util/printf.h"
+#include "util/string.h"
+
+#ifdef __SYSSTATS__
+
+#define SYSSTAT_SLOTS   (SYSSTAT_NSYS + 1)
+
+typedef struct sysstat_counts {
+        uint32_t        sc_calls[SYSSTAT_SLOTS];
+        uint32_t        sc_errors[SYSSTAT_SLOTS];
+        uint64_t        sc_cycles[SYSSTAT_SLOTS];
+} sysstat_counts_t;
+
+/* Hung off proc_t the first time the process makes a system call */
+typedef struct sysstat_proc {
+        sysstat_counts_t sp_counts;
+        uint32_t        sp_hist[SYSSTAT_HIST_BUCKETS];
+} sysstat_proc_t;
+
+static sysstat_counts_t sysstat_counts;
+static uint32_t sysstat_hist[SYSSTAT_SLOTS][SYSSTAT_HIST_BUCKETS];
+
+static const char *sysstat_names[SYSSTAT_NSYS] = {
+        [SYS_syscall] = "syscall",
+        [SYS_exit] = "exit",
+        [SYS_fork] = "fork",
+        [SYS_read] = "read",
+        [SYS_write] = "write",
+        [SYS_open] = "open",
+        [SYS_close] = "close",
+        [SYS_waitpid] = "waitpid",
+        [SYS_link] = "link",
+        [SYS_unlink] = "unlink",
+        [SYS_execve] = "execve",
+        [SYS_chdir] = "chdir",
+        [SYS_sleep] = "sleep",
+        [SYS_lseek] = "lseek",
+        [SYS_sync] = "sync",
+        [SYS_nuke] = "nuke",
+        [SYS_dup] = "dup",
+        [SYS_pipe] = "pipe",
+        [SYS_ioctl] = "ioctl",
+        [SYS_rmdir] = "rmdir",
+        [SYS_mkdir] = "mkdir",
+        [SYS_getdents] = "getdents",
+        [SYS_mmap] = "mmap",
+        [SYS_mprotect] = "mprotect",
+        [SYS_munmap] = "munmap",
+        [SYS_rename] = "rename",
+        [SYS_uname] = "uname",
+        [SYS_thr_create] = "thr_create",
+        [SYS_thr_cancel] = "thr_cancel",
+        [SYS_thr_exit] = "thr_exit",
+        [SYS_thr_yield] = "thr_yield",
+        [SYS_thr_join] = "thr_join",
+        [SYS_gettid] = "gettid",
+        [SYS_getpid] = "getpid",
+        [SYS_errno] = "errno",
+        [SYS_halt] = "halt",
+        [SYS_get_free_mem] = "get_free_mem",
+        [SYS_set_errno] = "set_errno",
+        [SYS_dup2] = "dup2",
+        [SYS_brk] = "brk",
+        [SYS_mount] = "mount",
+        [SYS_umount] = "umount",
+        [SYS_stat] = "stat",
+        [SYS_pread] = "pread",
+        [SYS_pwrite] = "pwrite",
+        [SYS_readv] = "readv",
+        [SYS_writev] = "writev",
+        [SYS_copy_file_range] = "copy_file_range",
+        [SYS_poll] = "poll",
+        [SYS_fsync] = "fsync",
+        [SYS_ring_setup] = "ring_setup",
+        [SYS_ring_enter] = "ring_enter",
+        [SYS_splice] = "splice",
+        [SYS_vmsplice] = "vmsplice",
+        [SYS_setpriority] = "setpriority",
+        [SYS_getpriority] = "getpriority",
+        [SYS_nanosleep] = "nanosleep",
+        [SYS_alarm] = "alarm",
+        [SYS_clock_gettime] = "clock_gettime",
+        [SYS_getrusage] = "getrusage",
+        [SYS_times] = "times",
+        [SYS_futex] = "futex"
+};
+
+/*
+ * The name of syscall slot sysnum (a number from 0 to SYSSTAT_NSYS - 1,
+ * SYSSTAT_OTHER or SYSSTAT_ALL).
+ */
+const char *
+sysstat_name(int sysnum)
+{
+        if (SYSSTAT_ALL == sysnum) {
+                return "total";
+        } else if (SYSSTAT_OTHER == sysnum) {
+                return "other";
+        } else if (NULL != sysstat_names[sysnum]) {
+                return sysstat_names[sysnum];
+        } else {
+                return "unknown";
+        }
+}
+
+static int
+sysstat_bucket(uint64_t cycles)
+{
+        int b = 0;
+
+        while (cycles > 1 && b < SYSSTAT_HIST_BUCKETS - 1) {
+                cycles >>= 1;
+                b++;
+        }
+        return b;
+}
+
+static void
+sysstat_count(sysstat_counts_t *sc, int slot, int ret, uint64_t cycles)
+{
+        sc->sc_calls[slot]++;
+        if (-1 == ret) {
+                sc->sc_errors[slot]++;
+        }
+        sc->sc_cycles[slot] += cycles;
+}
+
+/*
+ * Account a call to syscall sysnum by the current process, which returned
+ * ret after cycles TSC ticks.
+ */
+void
+sysstat_record(uint32_t sysnum, int ret, uint64_t cycles)
+{
+        int slot = (sysnum < SYSSTAT_NSYS) ? (int)sysnum : SYSSTAT_OTHER;
+        int bucket = sysstat_bucket(cycles);
+        sysstat_proc_t *sp;
+
+        sysstat_count(&sysstat_counts, slot, ret, cycles);
+        sysstat_hist[slot][bucket]++;
+
+        if (NULL == (sp = curproc->p_sysstats)) {
+                /* We'll try again next time */
+                if (NULL == (sp = kmalloc(sizeof(*sp)))) {
+                        return;
+                }
+                memset(sp, 0, sizeof(*sp));
+                curproc->p_sysstats = sp;
+        }
+        sysstat_count(&sp->sp_counts, slot, ret, cycles);
+        sp->sp_hist[bucket]++;
+}
+
+void
+sysstat_reset(void)
+{
+        proc_t *p;
+
+        memset(&sysstat_counts, 0, sizeof(sysstat_counts));
+        memset(sysstat_hist, 0, sizeof(sysstat_hist));
+
+        list_iterate_begin(proc_list(), p, proc_t, p_list_link) {
+                if (NULL != p->p_sysstats) {
+                        memset(p->p_sysstats, 0, sizeof(sysstat_proc_t));
+                }
+        } list_iterate_end();
+}
+
+void
+sysstat_proc_free(proc_t *p)
+{
+        if (NULL != p->p_sysstats) {
+                kfree(p->p_sysstats);
+                p->p_sysstats = NULL;
+        }
+}
+
+static void
+sysstat_fill(sysstat_rec_t *rec, pid_t pid, int sysnum, const sysstat_counts_t *sc)
+{
+        int i;
+
+        memset(rec, 0, sizeof(*rec));
+        rec->ss_pid = pid;
+        rec->ss_sysnum = sysnum;
+        strncpy(rec->ss_name, sysstat_name(sysnum), SYSSTAT_NAME_LEN - 1);
+
+        if (SYSSTAT_ALL != sysnum) {
+                rec->ss_calls = sc->sc_calls[sysnum];
+                rec->ss_errors = sc->sc_errors[sysnum];
+                rec->ss_cycles = sc->sc_cycles[sysnum];
+                return;
+        }
+        for (i = 0; i < SYSSTAT_SLOTS; i++) {
+                rec->ss_calls += sc->sc_calls[i];
+                rec->ss_errors += sc->sc_errors[i];
+                rec->ss_cycles += sc->sc_cycles[i];
+        }
+}
+
+/*
+ * Looks for record *index among those of one set of counts: the total,
+ * then the slots that have been used. Decrements *index past the ones
+ * skipped, and returns 1 if it found it.
+ */
+static int
+sysstat_find(const sysstat_counts_t *sc, pid_t pid, int *index, sysstat_rec_t *rec)
+{
+        int i;
+
+        sysstat_fill(rec, pid, SYSSTAT_ALL, sc);
+        if (0 == rec->ss_calls) {
+                return 0;
+        }
+        if (0 == (*index)--) {
+                return 1;
+        }
+        for (i = 0; i < SYSSTAT_SLOTS; i++) {
+                if (0 != sc->sc_calls[i] && 0 == (*index)--) {
+                        sysstat_fill(rec, pid, i, sc);
+                        return 1;
+                }
+        }
+        return 0;
+}
+
+int
+sysstat_get(int index, sysstat_rec_t *rec)
+{
+        sysstat_proc_t *sp;
+        proc_t *p;
+        int i;
+
+        if (sysstat_find(&sysstat_counts, SYSSTAT_SYSTEM, &index, rec)) {
+                if (SYSSTAT_ALL == rec->ss_sysnum) {
+                        for (i = 0; i < SYSSTAT_SLOTS; i++) {
+                                int b;
+                                for (b = 0; b < SYSSTAT_HIST_BUCKETS; b++) {
+                                        rec->ss_hist[b] += sysstat_hist[i][b];
+                                }
+                        }
+                } else {
+                        memcpy(rec->ss_hist, sysstat_hist[rec->ss_sysnum],
+                               sizeof(rec->ss_hist));
+                }
+                return 1;
+        }
+
+        list_iterate_begin(proc_list(), p, proc_t, p_list_link) {
+                if (NULL == (sp = p->p_sysstats)) {
+                        continue;
+                }
+                if (sysstat_find(&sp->sp_counts, p->p_pid, &index, rec)) {
+                        if (SYSSTAT_ALL == rec->ss_sysnum) {
+                                memcpy(rec->ss_hist, sp->sp_hist, sizeof(rec->ss_hist));
+                        }
+                        return 1;
+                }
+        } list_iterate_end();
+
+        return 0;
+}
+
+/*
+ * /dev/sysstat: reads return as much of the record stream as fits, from
+ * offset on. Each record is built at the time it is read, so a reader
+ * that wants a consistent snapshot should read it in one go.
+ */
+static int
+sysstat_read(bytedev_t *dev, int offset, void *buf, int count)
+{
+        sysstat_rec_t rec;
+        int index = offset / (int)sizeof(rec);
+        int skip = offset % (int)sizeof(rec);
+        int done = 0;
+
+        while (done < count && sysstat_get(index++, &rec)) {
+                int n = MIN(count - done, (int)sizeof(rec) - skip);
+                memcpy((char *)buf + done, (char *)&rec + skip, n);
+                done += n;
+                skip = 0;
+        }
+        return done;
+}
+
+static int
+sysstat_write(bytedev_t *dev, int offset, const void *buf, int count)
+{
+        sysstat_reset();
+        return count;
+}
+
+static bytedev_ops_t sysstat_dev_ops = {
+        sysstat_read,
+        sysstat_write,
+        NULL,
+        NULL,
+        NULL,
+        NULL,
+        NULL
+};
+
+static bytedev_t sysstat_dev = {
+        .cd_id = STAT_SYSSTAT_DEVID,
+        .cd_ops = &sysstat_dev_ops
+};
+
+static __attribute__((unused)) void
+sysstat_init(void)
+{
+        bytedev_register(&sysstat_dev);
+}
+init_func(sysstat_init);
+init_depends(bytedev_init);
+#endif /* __SYSSTATS__ */
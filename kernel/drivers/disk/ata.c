@@ -7,6 +7,7 @@
 #include "util/debug.h"
 #include "util/list.h"
 #include "util/delay.h"
+#include "util/workq.h"
 
 #include "drivers/blockdev.h"
 #include "drivers/dev.h"
@@ -223,6 +224,9 @@ typedef struct ata_disk {
          * queue, and disk interrupt wakes them up */
         ktqueue_t  ata_waitq;
 
+        /* Deferred by the disk interrupt to do the waking */
+        work_t     ata_work;
+
         /* Disk mutex since only one process can be using the disk at
          * any time */
         kmutex_t   ata_mutex;
@@ -244,6 +248,7 @@ static int ata_write(blockdev_t *bdev, const char *data,
 static int ata_do_operation(ata_disk_t *adisk, char *data, \
                             blocknum_t sectornum, int write);
 static void ata_intr(regs_t *regs, void *arg);
+static void ata_done(void *arg);
 
 static blockdev_ops_t ata_disk_ops = {
         .read_block  = ata_read,
@@ -339,6 +344,7 @@ ata_init()
                 adisk->ata_sectors_per_block = BLOCK_SIZE / ATA_SECTOR_SIZE;
 
                 sched_queue_init(&adisk->ata_waitq);
+                work_init(&adisk->ata_work, ata_done, adisk);
                 kmutex_init(&adisk->ata_mutex);
 
                 dbg(DBG_DISK, "Initialized ATA device %d, channel %s, drive %s, size %d\n",
@@ -616,10 +622,24 @@ static void
 ata_intr(regs_t *regs, void *arg)
 {
     ata_disk_t *adisk = (ata_disk_t *)arg;
-    sched_wakeup_on(&adisk->ata_waitq);
+    /*the wakeup is deferred until interrupts are back on*/
+    work_defer(&adisk->ata_work);
         /*NOT_YET_IMPLEMENTED("DRIVERS: ata_intr");*/
 }
 
+/**
+ * Deferred by ata_intr to wake the thread waiting for the operation to
+ * complete.
+ *
+ * @param arg the disk the operation was performed on
+ */
+static void
+ata_done(void *arg)
+{
+    ata_disk_t *adisk = (ata_disk_t *)arg;
+    sched_wakeup_on(&adisk->ata_waitq);
+}
+
 /*
  * This function takes in an ATA Disk struct and 
  * sets it up for busmastering DMA
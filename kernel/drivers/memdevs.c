@@ -15,9 +15,11 @@
 #include "vm/anon.h"
 
 #include "fs/vnode.h"
+#include "fs/poll.h"
 
 static int null_read(bytedev_t *dev, int offset, void *buf, int count);
 static int null_write(bytedev_t *dev, int offset, const void *buf, int count);
+static int null_poll(bytedev_t *dev, int events, struct polltable *pt);
 
 static int zero_read(bytedev_t *dev, int offset, void *buf, int count);
 static int zero_mmap(vnode_t *file, vmarea_t *vma, mmobj_t **ret);
@@ -28,7 +30,8 @@ bytedev_ops_t null_dev_ops = {
         NULL,
         NULL,
         NULL,
-        NULL
+        NULL,
+        null_poll
 };
 
 bytedev_ops_t zero_dev_ops = {
@@ -37,7 +40,8 @@ bytedev_ops_t zero_dev_ops = {
         zero_mmap,
         NULL,
         NULL,
-        NULL
+        NULL,
+        null_poll
 };
 
 /*
@@ -104,6 +108,22 @@ null_write(bytedev_t *dev, int offset, const void *buf, int count)
         /*NOT_YET_IMPLEMENTED("DRIVERS: null_write");*/
 }
 
+/**
+ * Reads and writes on the null and zero devices never block, so they
+ * are always ready.
+ *
+ * @param dev the null or zero device
+ * @param events the events being polled for
+ * @param pt the poll table to register on. Unused, since readiness never
+ * changes
+ * @return POLLIN | POLLOUT
+ */
+static int
+null_poll(bytedev_t *dev, int events, struct polltable *pt)
+{
+    return POLLIN | POLLOUT;
+}
+
 /**
  * Reads a given number of bytes from the zero device into a
  * buffer. Any read from the zero device should be a series of zeros.
@@ -7,6 +7,7 @@
 #include "main/interrupt.h"
 
 #include "util/debug.h"
+#include "util/workq.h"
 
 #define IRQ_KEYBOARD 1
 
@@ -79,17 +80,24 @@ static const char *shift_scancodes = "\0"
 
 static keyboard_char_handler_t keyboard_handler = NULL;
 
-/* This is the function we register with the interrupt handler - it reads the
- * scancode and, if appropriate, call's the tty's receive_char function */
+/* Scancodes read by the interrupt handler and not yet decoded. Only the
+ * handler moves the tail and only keyboard_work moves the head, so they
+ * need no other protection. If it fills up, keys are dropped. */
+#define SCANCODE_BUFSIZE 64
+static uint8_t scancodes[SCANCODE_BUFSIZE];
+static volatile uint32_t scancode_head = 0;
+static volatile uint32_t scancode_tail = 0;
+
+static work_t keyboard_work;
+
+/* Decodes a scancode and, if appropriate, calls the tty's receive_char
+ * function */
 static void
-keyboard_intr_handler(regs_t *regs)
+keyboard_scancode(uint8_t sc)
 {
-        uint8_t sc; /* The scancode we receive */
         int break_code; /* Was it a break code */
         /* the resulting character ('\0' -> ignored char) */
         uint8_t c = NO_CHAR;
-        /* Get the scancode */
-        sc = inb(KEYBOARD_IN_PORT);
 
         /* Separate out the break code */
         break_code = sc & BREAK_MASK;
@@ -165,9 +173,38 @@ keyboard_intr_handler(regs_t *regs)
         }
 }
 
+/* Deferred by the interrupt handler; the line discipline and the echo
+ * to the screen run from here, with interrupts enabled */
+static void
+keyboard_work_run(void *arg)
+{
+        uint8_t sc;
+
+        while (scancode_head != scancode_tail) {
+                sc = scancodes[scancode_head % SCANCODE_BUFSIZE];
+                scancode_head++;
+                keyboard_scancode(sc);
+        }
+}
+
+/* This is the function we register with the interrupt handler - it reads the
+ * scancode and leaves the rest to keyboard_work_run */
+static void
+keyboard_intr_handler(regs_t *regs)
+{
+        uint8_t sc = inb(KEYBOARD_IN_PORT);
+
+        if (scancode_tail - scancode_head < SCANCODE_BUFSIZE) {
+                scancodes[scancode_tail % SCANCODE_BUFSIZE] = sc;
+                scancode_tail++;
+        }
+        work_defer(&keyboard_work);
+}
+
 void
 keyboard_init()
 {
+        work_init(&keyboard_work, keyboard_work_run, NULL);
         intr_map(IRQ_KEYBOARD, INTR_KEYBOARD);
         intr_register(INTR_KEYBOARD, keyboard_intr_handler);
 }
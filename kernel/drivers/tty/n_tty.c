@@ -6,6 +6,8 @@
 #include "drivers/tty/ldisc.h"
 #include "drivers/tty/tty.h"
 
+#include "fs/poll.h"
+
 #include "mm/kmalloc.h"
 
 #include "proc/kthread.h"
@@ -23,6 +25,7 @@ static void n_tty_detach(tty_ldisc_t *ldisc, tty_device_t *tty);
 static int n_tty_read(tty_ldisc_t *ldisc, void *buf, int len);
 static const char *n_tty_receive_char(tty_ldisc_t *ldisc, char c);
 static const char *n_tty_process_char(tty_ldisc_t *ldisc, char c);
+static int n_tty_poll(tty_ldisc_t *ldisc, struct polltable *pt);
 
 int is_newline(char c);
 int is_ctrl_d(char c);
@@ -32,12 +35,14 @@ static tty_ldisc_ops_t n_tty_ops = {
         .detach       = n_tty_detach,
         .read         = n_tty_read,
         .receive_char = n_tty_receive_char,
-        .process_char = n_tty_process_char
+        .process_char = n_tty_process_char,
+        .poll         = n_tty_poll
 };
 
 struct n_tty {
         kmutex_t            ntty_rlock;
         ktqueue_t           ntty_rwaitq;
+        pollhead_t          ntty_pollhead;
         char               *ntty_inbuf;
         int                 ntty_rhead;
         int                 ntty_rawtail;
@@ -119,6 +124,7 @@ n_tty_attach(tty_ldisc_t *ldisc, tty_device_t *tty)
     /*initialize each field*/
     kmutex_init(&ntty->ntty_rlock);
     sched_queue_init(&ntty->ntty_rwaitq);
+    pollhead_init(&ntty->ntty_pollhead);
 
     ntty->ntty_inbuf = (char *)kmalloc(sizeof(char) * (TTY_BUF_SIZE + 1));
     KASSERT(NULL != ntty->ntty_inbuf);
@@ -369,6 +375,7 @@ n_tty_receive_char(tty_ldisc_t *ldisc, char c)
         s = "\n\r";
         n_tty_print_inbuf(ldisc);
         sched_wakeup_on(&ntty->ntty_rwaitq);
+        poll_wakeup(&ntty->ntty_pollhead);
         return s;
     }
     if (is_ctrl_d(c)) {
@@ -379,6 +386,7 @@ n_tty_receive_char(tty_ldisc_t *ldisc, char c)
         s = "\n\r";
         n_tty_print_inbuf(ldisc);
         sched_wakeup_on(&ntty->ntty_rwaitq);
+        poll_wakeup(&ntty->ntty_pollhead);
         return s;
     }
     ntty->ntty_inbuf[ntty->ntty_rawtail] = c;
@@ -398,6 +406,23 @@ n_tty_receive_char(tty_ldisc_t *ldisc, char c)
          * @return a null terminated string to be echoed to the tty
          */
 
+/*
+ * A read only blocks while there is no cooked line (ending in a newline
+ * or CTRL-D) waiting in the input buffer. n_tty_receive_char wakes the
+ * pollhead whenever it cooks one.
+ */
+int
+n_tty_poll(tty_ldisc_t *ldisc, struct polltable *pt)
+{
+    KASSERT(NULL != ldisc);
+    struct n_tty *ntty = ldisc_to_ntty(ldisc);
+    KASSERT(NULL != ntty);
+
+    poll_wait(pt, &ntty->ntty_pollhead);
+
+    return (ntty->ntty_rhead != ntty->ntty_ckdtail) ? POLLIN : 0;
+}
+
 /*
  * Process a character to be written to the screen.
  *
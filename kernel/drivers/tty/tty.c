@@ -9,6 +9,8 @@
 #include "drivers/tty/screen.h"
 #include "drivers/tty/virtterm.h"
 
+#include "fs/poll.h"
+
 #include "mm/kmalloc.h"
 
 #include "util/debug.h"
@@ -50,6 +52,17 @@ static int tty_read(bytedev_t *dev, int offset, void *buf, int count);
  */
 static int tty_write(bytedev_t *dev, int offset, const void *buf, int count);
 
+/**
+ * Reports whether a tty can be read from or written to without
+ * blocking.
+ *
+ * @param dev the tty to poll
+ * @param events the events being polled for
+ * @param pt the poll table to register on, or NULL
+ * @return the ready POLL* events
+ */
+static int tty_poll(bytedev_t *dev, int events, struct polltable *pt);
+
 /**
  * Echoes out to the tty driver.
  *
@@ -64,7 +77,8 @@ static bytedev_ops_t tty_bytedev_ops = {
         NULL,
         NULL,
         NULL,
-        NULL
+        NULL,
+        tty_poll
 };
 
 void
@@ -258,3 +272,30 @@ tty_write(bytedev_t *dev, int offset, const void *buf, int count)
 
     return i;
 }
+
+/*
+ * Writes never block, so a tty is always writable; whether it is
+ * readable is up to the line discipline.
+ */
+int
+tty_poll(bytedev_t *dev, int events, struct polltable *pt)
+{
+    KASSERT(NULL != dev);
+
+    tty_device_t *tty = bd_to_tty(dev);
+    tty_driver_t *ttyd = tty->tty_driver;
+
+    struct tty_ldisc *ldisc = tty->tty_ldisc;
+    KASSERT(NULL != ldisc);
+
+    int mask = POLLOUT;
+    if (NULL != ldisc->ld_ops->poll) {
+        /*block IO*/
+        void *ret = ttyd->ttd_ops->block_io(ttyd);
+        mask |= ldisc->ld_ops->poll(ldisc, pt);
+        /*unblock IO*/
+        ttyd->ttd_ops->unblock_io(ttyd, ret);
+    }
+
+    return mask;
+}
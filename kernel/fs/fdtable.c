@@ -0,0 +1,162 @@
+/*
+ *  FILE: fdtable.c
+ *  DESC: Per-process file descriptor tables; see fs/fdtable.h
+ */
+
+#include "kernel.h"
+#include "config.h"
+#include "errno.h"
+#include "globals.h"
+
+#include "fs/fdtable.h"
+#include "fs/file.h"
+
+#include "mm/kmalloc.h"
+
+#include "proc/proc.h"
+
+#include "util/debug.h"
+#include "util/string.h"
+
+void
+fdtable_init(proc_t *p)
+{
+        p->p_files = p->p_files_init;
+        p->p_fdmap = p->p_fdmap_init;
+        p->p_nfiles = NFILES;
+        memset(p->p_files_init, 0, sizeof(p->p_files_init));
+        memset(p->p_fdmap_init, 0, sizeof(p->p_fdmap_init));
+}
+
+int
+fdtable_grow(proc_t *p, int nfiles)
+{
+        file_t **files;
+        uint32_t *fdmap;
+        int size = p->p_nfiles;
+
+        if (nfiles <= size) {
+                return 0;
+        }
+        if (nfiles > NFILES_MAX) {
+                return -EMFILE;
+        }
+        while (size < nfiles) {
+                size *= 2;
+        }
+        size = MIN(size, NFILES_MAX);
+
+        files = kmalloc(size * sizeof(*files));
+        fdmap = kmalloc(FDMAP_WORDS(size) * sizeof(*fdmap));
+        if (NULL == files || NULL == fdmap) {
+                if (files) kfree(files);
+                if (fdmap) kfree(fdmap);
+                return -ENOMEM;
+        }
+
+        memcpy(files, p->p_files, p->p_nfiles * sizeof(*files));
+        memset(files + p->p_nfiles, 0, (size - p->p_nfiles) * sizeof(*files));
+        memcpy(fdmap, p->p_fdmap, FDMAP_WORDS(p->p_nfiles) * sizeof(*fdmap));
+        memset(fdmap + FDMAP_WORDS(p->p_nfiles), 0,
+               (FDMAP_WORDS(size) - FDMAP_WORDS(p->p_nfiles)) * sizeof(*fdmap));
+
+        if (p->p_files != p->p_files_init) {
+                kfree(p->p_files);
+                kfree(p->p_fdmap);
+        }
+        p->p_files = files;
+        p->p_fdmap = fdmap;
+        p->p_nfiles = size;
+
+        dbg(DBG_VFS, "pid %d now has room for %d open files\n", p->p_pid, size);
+        return 0;
+}
+
+int
+fdtable_lowest_free(proc_t *p)
+{
+        int w, fd, err;
+
+        for (w = 0; w < FDMAP_WORDS(p->p_nfiles); w++) {
+                if (~0U != p->p_fdmap[w]) {
+                        fd = w * FDMAP_BITS + __builtin_ctz(~p->p_fdmap[w]);
+                        if (fd < p->p_nfiles) {
+                                return fd;
+                        }
+                }
+        }
+
+        fd = p->p_nfiles;
+        if ((err = fdtable_grow(p, fd + 1)) < 0) {
+                return err;
+        }
+        return fd;
+}
+
+void
+fdtable_install(proc_t *p, int fd, file_t *f)
+{
+        KASSERT(fd >= 0 && fd < p->p_nfiles);
+        KASSERT(NULL == p->p_files[fd]);
+        KASSERT(NULL != f);
+
+        p->p_files[fd] = f;
+        p->p_fdmap[fd / FDMAP_BITS] |= 1U << (fd % FDMAP_BITS);
+}
+
+file_t *
+fdtable_remove(proc_t *p, int fd)
+{
+        file_t *f;
+
+        KASSERT(fd >= 0 && fd < p->p_nfiles);
+
+        f = p->p_files[fd];
+        p->p_files[fd] = NULL;
+        p->p_fdmap[fd / FDMAP_BITS] &= ~(1U << (fd % FDMAP_BITS));
+        return f;
+}
+
+/*
+ * Only the descriptors in use are visited: words of the bitmap with no
+ * bits set are skipped whole, and the set bits of the others are peeled
+ * off one at a time.
+ */
+int
+fdtable_copy(proc_t *child, proc_t *parent)
+{
+        uint32_t bits;
+        int w, fd, err;
+
+        if ((err = fdtable_grow(child, parent->p_nfiles)) < 0) {
+                return err;
+        }
+
+        for (w = 0; w < FDMAP_WORDS(parent->p_nfiles); w++) {
+                for (bits = parent->p_fdmap[w]; 0 != bits; bits &= bits - 1) {
+                        fd = w * FDMAP_BITS + __builtin_ctz(bits);
+                        fref(parent->p_files[fd]);
+                        fdtable_install(child, fd, parent->p_files[fd]);
+                }
+        }
+        return 0;
+}
+
+void
+fdtable_close_all(proc_t *p)
+{
+        uint32_t bits;
+        int w;
+
+        for (w = 0; w < FDMAP_WORDS(p->p_nfiles); w++) {
+                for (bits = p->p_fdmap[w]; 0 != bits; bits &= bits - 1) {
+                        fput(fdtable_remove(p, w * FDMAP_BITS + __builtin_ctz(bits)));
+                }
+        }
+
+        if (p->p_files != p->p_files_init) {
+                kfree(p->p_files);
+                kfree(p->p_fdmap);
+        }
+        fdtable_init(p);
+}
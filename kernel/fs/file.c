@@ -71,7 +71,7 @@ fget(int fd)
                 f = slab_obj_alloc(file_allocator);
                 if (f) memset(f, 0, sizeof(file_t));
         } else {
-                if (fd < 0 || fd >= NFILES)
+                if (fd < 0 || fd >= curproc->p_nfiles)
                         return NULL;
                 f = curproc->p_files[fd];
         }
@@ -13,25 +13,23 @@
 #include "fs/vfs.h"
 #include "fs/vnode.h"
 #include "fs/file.h"
+#include "fs/fdtable.h"
 #include "fs/vfs_syscall.h"
 #include "fs/open.h"
 #include "fs/stat.h"
 #include "util/debug.h"
 
-/* find empty index in p->p_files[] */
+/* find empty index in p->p_files[], growing it if it is full */
 int
 get_empty_fd(proc_t *p)
 {
         int fd;
 
-        for (fd = 0; fd < NFILES; fd++) {
-                if (!p->p_files[fd])
-                        return fd;
+        if ((fd = fdtable_lowest_free(p)) < 0) {
+                dbg(DBG_ERROR | DBG_VFS, "ERROR: get_empty_fd: out of file descriptors "
+                    "for pid %d\n", curproc->p_pid);
         }
-
-        dbg(DBG_ERROR | DBG_VFS, "ERROR: get_empty_fd: out of file descriptors "
-            "for pid %d\n", curproc->p_pid);
-        return -EMFILE;
+        return fd;
 }
 
 /*
@@ -87,9 +85,9 @@ do_open(const char *filename, int oflags)
 
     /*get file descriptor*/
     int fd;
-    if ((fd = get_empty_fd(curproc)) == -EMFILE) {
+    if ((fd = get_empty_fd(curproc)) < 0) {
         dbg(DBG_VFS, "too many open files.\n");
-        return -EMFILE;
+        return fd;
     }
 
     /*get a fresh file_t*/
@@ -100,7 +98,7 @@ do_open(const char *filename, int oflags)
     }
 
     /*save file_t in file descriptor table*/
-    curproc->p_files[fd] = f;
+    fdtable_install(curproc, fd, f);
 
     /*set f_mode*/
     int rw = oflags & lower_mask;
@@ -122,7 +120,7 @@ do_open(const char *filename, int oflags)
     int err = open_namev(filename, oflags, &vn, NULL);
     if (err < 0) {
         /*clean up*/
-        curproc->p_files[fd] = NULL;
+        fdtable_remove(curproc, fd);
         fput(f);
         return err;
     }
@@ -131,7 +129,7 @@ do_open(const char *filename, int oflags)
     if (S_ISDIR(vn->vn_mode) && ((oflags & O_WRONLY) || (oflags & O_RDWR))) {
         vput(vn);
         fput(f);
-        curproc->p_files[fd] = NULL;
+        fdtable_remove(curproc, fd);
         dbg(DBG_VFS, "it's a directory and write flag set\n");
         return -EISDIR;
     }
@@ -7,10 +7,13 @@
 
 #include "errno.h"
 #include "globals.h"
+#include "limits.h"
 
+#include "fs/fdtable.h"
 #include "fs/file.h"
 #include "fs/open.h"
 #include "fs/pipe.h"
+#include "fs/poll.h"
 #include "fs/stat.h"
 #include "fs/vfs_syscall.h"
 #include "fs/vfs.h"
@@ -18,13 +21,21 @@
 
 #include "mm/slab.h"
 #include "mm/kmalloc.h"
+#include "mm/page.h"
+#include "mm/pframe.h"
 
 #include "proc/sched.h"
 
 #include "util/debug.h"
 #include "util/string.h"
 
-#define PIPE_BUF_SIZE 4096
+/*
+ * A pipe holds up to PIPE_RING_PAGES page-sized buffers of data, in a
+ * ring. A buffer is usually a page the pipe owns, but it can also be a
+ * pinned page of a file that was spliced in; then nothing is copied into
+ * the pipe at all, and the page is unpinned when it has been read.
+ */
+#define PIPE_RING_PAGES 16
 
 static void pipe_read_vnode(vnode_t *vnode);
 static void pipe_delete_vnode(vnode_t *vnode);
@@ -49,6 +60,7 @@ static fs_t pipe_fs = {
 static int pipe_read(vnode_t *vnode, off_t offset, void *buf, size_t len);
 static int pipe_write(vnode_t *vnode, off_t offset, const void *buf, size_t len);
 static int pipe_stat(vnode_t *vnode, struct stat *ss);
+static int pipe_poll(vnode_t *vnode, int events, struct polltable *pt);
 static int pipe_acquire(vnode_t *vnode, file_t *file);
 static int pipe_release(vnode_t *vnode, file_t *file);
 
@@ -64,7 +76,9 @@ static vnode_ops_t pipe_vops = {
         .mkdir = NULL,
         .rmdir = NULL,
         .readdir = NULL,
+        .readdirs = NULL,
         .stat = pipe_stat,
+        .poll = pipe_poll,
         .acquire = pipe_acquire,
         .release = pipe_release,
         .fillpage = NULL,
@@ -72,17 +86,30 @@ static vnode_ops_t pipe_vops = {
         .cleanpage = NULL
 };
 
+/* One buffer of the ring: pb_len bytes of data at pb_page + pb_off. */
+typedef struct pipe_buf {
+        char      *pb_page;
+        size_t     pb_off;
+        size_t     pb_len;
+        /*
+         * If the page was spliced in from a file, the page frame (which we
+         * keep pinned) and the file's vnode (which we hold a reference
+         * on). Otherwise NULL, and the page is ours to page_free().
+         */
+        pframe_t  *pb_pframe;
+        vnode_t   *pb_vnode;
+} pipe_buf_t;
+
 /* struct pipe defines some data specific to pipes. One of these
    should be present in the vn_i field of each pipe vnode. */
 typedef struct pipe {
-        /* Buffer for data in the pipe, which has been written but not yet read. */
-        char      *pv_buf;
         /*
-         * Position of the head and number of characters in the buffer. You can
-         * write in characters at position head so long as size does not grow beyond
-         * the pipe buffer size.
+         * The ring of buffers: pv_nbufs of them in use, starting at
+         * pv_head, and holding pv_size bytes in all.
          */
-        off_t      pv_head;
+        pipe_buf_t pv_bufs[PIPE_RING_PAGES];
+        int        pv_head;
+        int        pv_nbufs;
         size_t     pv_size;
         /* Number of file descriptors using this pipe for read and write. */
         int        pv_readers;
@@ -96,16 +123,22 @@ typedef struct pipe {
         kmutex_t   pv_rdlock;
         kmutex_t   pv_wrlock;
         /*
-         * Waitqueues for threads attempting to read from an empty buffer, or
-         * write to a full buffer. When the pipe becomes non-empty (or non-full)
-         * then the corresponding waitq should be broadcasted on to make sure all
-         * of the threads get a chance to go.
+         * Waitqueues for threads attempting to read from an empty pipe, or
+         * write to a full one. Each read or write wakes the other side
+         * once, when it is done or about to block, rather than for every
+         * buffer it moves.
          */
         ktqueue_t  pv_read_waitq;
         ktqueue_t  pv_write_waitq;
+        /*
+         * Threads in poll() on either end. Whenever either waitq above is
+         * broadcast on, this should be woken with poll_wakeup() too.
+         */
+        pollhead_t pv_pollhead;
 } pipe_t;
 
 #define VNODE_TO_PIPE(vn) ((pipe_t *)((vn)->vn_i))
+#define PIPE_TAIL(p) (&(p)->pv_bufs[((p)->pv_head + (p)->pv_nbufs - 1) % PIPE_RING_PAGES])
 
 static slab_allocator_t *pipe_allocator = NULL;
 static int next_pno = 0;
@@ -119,26 +152,49 @@ pipe_init(void)
 init_func(pipe_init);
 init_depends(vfs_init);
 
-/*
- * Create a pipe struct here. You are going to need to allocate all
- * of the necessary structs and buffers, and then initialize all of
- * the necessary fields (head, size, readers, writers, and the locks
- * and queues.)
- */
 static pipe_t *
 pipe_create(void)
 {
-        NOT_YET_IMPLEMENTED("PIPES: pipe_create");
-        return NULL;
+        pipe_t *p;
+
+        if (NULL == (p = slab_obj_alloc(pipe_allocator))) {
+                return NULL;
+        }
+        memset(p->pv_bufs, 0, sizeof(p->pv_bufs));
+        p->pv_head = 0;
+        p->pv_nbufs = 0;
+        p->pv_size = 0;
+        p->pv_readers = 0;
+        p->pv_writers = 0;
+        kmutex_init(&p->pv_rdlock);
+        kmutex_init(&p->pv_wrlock);
+        sched_queue_init(&p->pv_read_waitq);
+        sched_queue_init(&p->pv_write_waitq);
+        pollhead_init(&p->pv_pollhead);
+        return p;
+}
+
+static void
+pipe_buf_release(pipe_buf_t *pb)
+{
+        if (NULL != pb->pb_pframe) {
+                pframe_unpin(pb->pb_pframe);
+                vput(pb->pb_vnode);
+        } else {
+                page_free(pb->pb_page);
+        }
+        memset(pb, 0, sizeof(*pb));
 }
 
-/*
- * Free all necessary memory.
- */
 static void
 pipe_destroy(pipe_t *pipe)
 {
-        NOT_YET_IMPLEMENTED("PIPES: pipe_destroy");
+        while (pipe->pv_nbufs > 0) {
+                pipe_buf_release(&pipe->pv_bufs[pipe->pv_head]);
+                pipe->pv_head = (pipe->pv_head + 1) % PIPE_RING_PAGES;
+                pipe->pv_nbufs--;
+        }
+        slab_obj_free(pipe_allocator, pipe);
 }
 
 /* pipefs vnode operations */
@@ -185,98 +241,572 @@ pipe_query_vnode(vnode_t *vnode)
 static vnode_t *
 pget(void)
 {
-        NOT_YET_IMPLEMENTED("PIPES: pget");
-        return NULL;
+        vnode_t *vn;
+        pipe_t *p;
+
+        if (NULL == (vn = vget(&pipe_fs, next_pno++))) {
+                return NULL;
+        }
+        if (NULL == (p = pipe_create())) {
+                vput(vn);
+                return NULL;
+        }
+        vn->vn_i = p;
+        return vn;
+}
+
+/* Open one end of the pipe vn as a new file descriptor. */
+static int
+pipe_open_end(vnode_t *vn, int mode)
+{
+        file_t *f;
+        int fd;
+
+        if ((fd = get_empty_fd(curproc)) < 0) {
+                return fd;
+        }
+        if (NULL == (f = fget(-1))) {
+                return -ENOMEM;
+        }
+        f->f_mode = mode;
+        f->f_pos = 0;
+        vref(vn);
+        facq(f, vn);
+        fdtable_install(curproc, fd, f);
+        return fd;
 }
 
 /*
- * An implementation of the pipe(2) system call. You really
- * only have to worry about a few things:
- *   o Running out of memory when allocating the vnode, at which
- *     point you should fail with ENOMEM;
- *   o Running out of file descriptors, in which case you should
- *     fail with EMFILE.
- * Once all of the structures are set up, just put the read-end
- * file descriptor of the pipe into pipefd[0], and the write-end
- * descriptor into pipefd[1].
+ * An implementation of the pipe(2) system call. Fails with ENOMEM if we
+ * run out of memory allocating the pipe, or EMFILE if we run out of file
+ * descriptors. The read end of the pipe goes in pipefd[0], and the write
+ * end in pipefd[1].
  */
 int
 do_pipe(int pipefd[2])
 {
-        NOT_YET_IMPLEMENTED("PIPES: do_pipe");
-        return -ENOTSUP;
+        vnode_t *vn;
+        int rfd, wfd;
+
+        if (NULL == (vn = pget())) {
+                return -ENOMEM;
+        }
+        if ((rfd = pipe_open_end(vn, FMODE_READ)) < 0) {
+                vput(vn);
+                return rfd;
+        }
+        if ((wfd = pipe_open_end(vn, FMODE_WRITE)) < 0) {
+                fput(fdtable_remove(curproc, rfd));
+                vput(vn);
+                return wfd;
+        }
+        /* Each file has its own reference now */
+        vput(vn);
+
+        pipefd[0] = rfd;
+        pipefd[1] = wfd;
+        return 0;
+}
+
+static void
+pipe_wake_readers(pipe_t *p)
+{
+        sched_broadcast_on(&p->pv_read_waitq);
+        poll_wakeup(&p->pv_pollhead);
+}
+
+static void
+pipe_wake_writers(pipe_t *p)
+{
+        sched_broadcast_on(&p->pv_write_waitq);
+        poll_wakeup(&p->pv_pollhead);
 }
 
 /*
- * When reading from a pipe, you should make sure there are enough characters in
- * the buffer to read. If there are, grab them and move up the tail by subtracting
- * from size. offset is ignored. Also, remember to take the reader lock to prevent
- * other threads from reading while you are waiting for more characters.
+ * Wait, with the reader lock held, until there is data in the pipe or no
+ * writers are left. Returns 0, or -EINTR if we were cancelled.
+ */
+static int
+pipe_wait_data(pipe_t *p)
+{
+        while (0 == p->pv_size && p->pv_writers > 0) {
+                if (sched_cancellable_sleep_on(&p->pv_read_waitq) < 0) {
+                        return -EINTR;
+                }
+        }
+        return 0;
+}
+
+/*
+ * Wait, with the writer lock held, until there is a free buffer in the
+ * ring. If we have already put data in the pipe (woke != 0), the readers
+ * are woken before we sleep. Returns 0, -EPIPE if no readers are left, or
+ * -EINTR if we were cancelled.
+ */
+static int
+pipe_wait_room(pipe_t *p, int woke)
+{
+        while (PIPE_RING_PAGES == p->pv_nbufs && p->pv_readers > 0) {
+                if (woke) {
+                        pipe_wake_readers(p);
+                }
+                if (sched_cancellable_sleep_on(&p->pv_write_waitq) < 0) {
+                        return -EINTR;
+                }
+        }
+        return (0 == p->pv_readers) ? -EPIPE : 0;
+}
+
+/* Append a buffer to the ring, which must have room for it. */
+static void
+pipe_push(pipe_t *p, void *page, size_t off, size_t len, pframe_t *pf, vnode_t *vn)
+{
+        pipe_buf_t *pb;
+
+        KASSERT(p->pv_nbufs < PIPE_RING_PAGES);
+
+        p->pv_nbufs++;
+        pb = PIPE_TAIL(p);
+        pb->pb_page = page;
+        pb->pb_off = off;
+        pb->pb_len = len;
+        pb->pb_pframe = pf;
+        pb->pb_vnode = vn;
+        p->pv_size += len;
+}
+
+/* Drop len bytes from the front of the ring, freeing emptied buffers. */
+static void
+pipe_consume(pipe_t *p, size_t len)
+{
+        pipe_buf_t *pb = &p->pv_bufs[p->pv_head];
+
+        KASSERT(p->pv_nbufs > 0 && len <= pb->pb_len);
+
+        pb->pb_off += len;
+        pb->pb_len -= len;
+        p->pv_size -= len;
+        if (0 == pb->pb_len) {
+                pipe_buf_release(pb);
+                p->pv_head = (p->pv_head + 1) % PIPE_RING_PAGES;
+                p->pv_nbufs--;
+        }
+}
+
+/*
+ * Reading from a pipe blocks only until there is some data in it, and
+ * then returns as much as there is, up to len. offset is ignored. The
+ * reader lock keeps other readers from interleaving with us.
  *
- * This might block, e.g. if there are no or not enough characters to read.
- * It might be the case that there are no more writers and we aren't done reading.
- * However, in situations like this, there is no way to open the pipe for writing
- * again so no more writers will ever put characters in the pipe. The reader should
- * just take as much as it needs (or barring that, as much as it can get) and
- * return with a partial buffer.
+ * Once there are no writers left nobody can ever put data in the pipe
+ * again, so if it is empty we return 0 (end of file).
  */
 static int
 pipe_read(vnode_t *vnode, off_t offset, void *buf, size_t len)
 {
-        NOT_YET_IMPLEMENTED("PIPES: pipe_read");
-        return -EINVAL;
+        pipe_t *p = VNODE_TO_PIPE(vnode);
+        size_t done = 0;
+        int err;
+
+        kmutex_lock(&p->pv_rdlock);
+        if ((err = pipe_wait_data(p)) < 0) {
+                kmutex_unlock(&p->pv_rdlock);
+                return err;
+        }
+
+        while (done < len && p->pv_size > 0) {
+                pipe_buf_t *pb = &p->pv_bufs[p->pv_head];
+                size_t n = MIN(len - done, pb->pb_len);
+
+                memcpy((char *)buf + done, pb->pb_page + pb->pb_off, n);
+                pipe_consume(p, n);
+                done += n;
+        }
+
+        if (done > 0) {
+                pipe_wake_writers(p);
+        }
+        kmutex_unlock(&p->pv_rdlock);
+        return done;
 }
 
 /*
  * Writing to a pipe is the dual of reading: if there is room, we can write our
  * data and go, but if not, we have to wait until there is more room and alert
- * any potential readers. Like above, you should take the writer lock to make
- * sure your write is contiguous.
+ * any potential readers. The writer lock keeps our write contiguous.
  *
- * If there are no more readers, we have a broken pipe, and should fail with
- * the EPIPE error number.
+ * Data goes into the free space at the end of the last buffer if that is
+ * one of ours, and into new pages after that.
+ *
+ * If there are no more readers, we have a broken pipe, and fail with the
+ * EPIPE error number.
  */
 static int
 pipe_write(vnode_t *vnode, off_t offset, const void *buf, size_t len)
 {
-        NOT_YET_IMPLEMENTED("PIPES: pipe_write");
-        return -EINVAL;
+        pipe_t *p = VNODE_TO_PIPE(vnode);
+        size_t done = 0;
+        int err = 0;
+
+        kmutex_lock(&p->pv_wrlock);
+        while (done < len) {
+                pipe_buf_t *pb = (p->pv_nbufs > 0) ? PIPE_TAIL(p) : NULL;
+                size_t n;
+
+                if (0 == p->pv_readers) {
+                        err = -EPIPE;
+                        break;
+                }
+
+                if (NULL != pb && NULL == pb->pb_pframe
+                    && pb->pb_off + pb->pb_len < PAGE_SIZE) {
+                        n = MIN(len - done, PAGE_SIZE - (pb->pb_off + pb->pb_len));
+                        memcpy(pb->pb_page + pb->pb_off + pb->pb_len,
+                               (const char *)buf + done, n);
+                        pb->pb_len += n;
+                        p->pv_size += n;
+                } else {
+                        void *page;
+
+                        if ((err = pipe_wait_room(p, done > 0)) < 0) {
+                                break;
+                        }
+                        if (NULL == (page = page_alloc())) {
+                                err = -ENOMEM;
+                                break;
+                        }
+                        n = MIN(len - done, PAGE_SIZE);
+                        memcpy(page, (const char *)buf + done, n);
+                        pipe_push(p, page, 0, n, NULL, NULL);
+                }
+                done += n;
+        }
+
+        if (done > 0) {
+                pipe_wake_readers(p);
+        }
+        kmutex_unlock(&p->pv_wrlock);
+
+        /* Whatever got in before the readers left or a signal came counts,
+         * as write(2) only fails outright when nothing was written */
+        return (done > 0) ? (int)done : err;
 }
 
 /*
- * It's still possible to stat a pipe using the fstat call, which takes a file descriptor.
- * Pipes don't have too much information, though. The only ones that matter here are
- * st_mode and st_ino, though you want to zero out some of the others.
+ * Pipes don't have too much information for stat. st_size is the number
+ * of bytes waiting to be read.
  */
 static int
 pipe_stat(vnode_t *vnode, struct stat *ss)
 {
-        NOT_YET_IMPLEMENTED("PIPES: pipe_stat");
-        return -EINVAL;
+        pipe_t *p = VNODE_TO_PIPE(vnode);
+
+        memset(ss, 0, sizeof(*ss));
+        ss->st_mode = vnode->vn_mode;
+        ss->st_ino = vnode->vn_vno;
+        ss->st_nlink = 1;
+        ss->st_size = p->pv_size;
+        ss->st_blksize = PAGE_SIZE;
+        return 0;
+}
+
+/*
+ * The read end is readable when there is data or no writers are left (a
+ * read returns 0 then), and the write end is writable while there is room.
+ * Once all readers are gone a write would fail with EPIPE, which we report
+ * as POLLERR.
+ */
+static int
+pipe_poll(vnode_t *vnode, int events, struct polltable *pt)
+{
+        pipe_t *p = VNODE_TO_PIPE(vnode);
+        int mask = 0;
+
+        KASSERT(NULL != p);
+        poll_wait(pt, &p->pv_pollhead);
+
+        if (p->pv_size > 0) {
+                mask |= POLLIN;
+        }
+        if (0 == p->pv_writers) {
+                mask |= POLLIN | POLLHUP;
+        }
+        if (0 == p->pv_readers) {
+                mask |= POLLERR;
+        } else if (p->pv_nbufs < PIPE_RING_PAGES) {
+                mask |= POLLOUT;
+        }
+
+        return mask;
 }
 
 /*
- * If someone is opening the read end of the pipe, we need to increment
- * the reader count, and the same for the writer count if a file open
- * for writing is acquiring this vnode. This count needs to be accurate
- * for correct reading and writing behavior.
+ * A file open for reading counts as a reader, and one open for writing as
+ * a writer; these counts are what tells readers about end of file and
+ * writers about broken pipes.
  */
 static int
 pipe_acquire(vnode_t *vnode, file_t *file)
 {
-        NOT_YET_IMPLEMENTED("PIPES: pipe_acquire");
+        pipe_t *p = VNODE_TO_PIPE(vnode);
+
+        if (file->f_mode & FMODE_READ) {
+                p->pv_readers++;
+        }
+        if (file->f_mode & FMODE_WRITE) {
+                p->pv_writers++;
+        }
         return 0;
 }
 
 /*
- * Subtract from the reader or writer count as necessary here. If either
- * count hits zero, you are going to need to wake up the other group of
- * threads so they can either return with their partial read or notice
- * the broken pipe.
+ * When the last writer goes, blocked readers must wake up to return their
+ * partial reads, and when the last reader goes, blocked writers must wake
+ * up to notice the broken pipe.
  */
 static int
 pipe_release(vnode_t *vnode, file_t *file)
 {
-        NOT_YET_IMPLEMENTED("PIPES: pipe_release");
+        pipe_t *p = VNODE_TO_PIPE(vnode);
+
+        if (file->f_mode & FMODE_READ) {
+                KASSERT(p->pv_readers > 0);
+                if (0 == --p->pv_readers) {
+                        pipe_wake_writers(p);
+                }
+        }
+        if (file->f_mode & FMODE_WRITE) {
+                KASSERT(p->pv_writers > 0);
+                if (0 == --p->pv_writers) {
+                        pipe_wake_readers(p);
+                }
+        }
         return 0;
 }
+
+/* The write end of a pipe at fd, with a reference, or NULL */
+static file_t *
+pipe_fget_write(int fd, int *errp)
+{
+        file_t *f;
+
+        if (NULL == (f = fget(fd))) {
+                *errp = -EBADF;
+                return NULL;
+        }
+        if (f->f_vnode->vn_ops != &pipe_vops) {
+                fput(f);
+                *errp = -ESPIPE;
+                return NULL;
+        }
+        if (0 == (f->f_mode & FMODE_WRITE)) {
+                fput(f);
+                *errp = -EBADF;
+                return NULL;
+        }
+        return f;
+}
+
+/*
+ * Hand page, a page_alloc()'d page holding len bytes of data, over to the
+ * pipe open for writing at fd, without copying it. Returns len if the pipe
+ * has taken the page, or -errno if the page is still the caller's:
+ * -ESPIPE if fd is not a pipe at all.
+ */
+int
+pipe_give_page(int fd, void *page, size_t len)
+{
+        file_t *f;
+        pipe_t *p;
+        int err;
+
+        KASSERT(len <= PAGE_SIZE);
+
+        if (NULL == (f = pipe_fget_write(fd, &err))) {
+                return err;
+        }
+        p = VNODE_TO_PIPE(f->f_vnode);
+
+        kmutex_lock(&p->pv_wrlock);
+        if (0 == (err = pipe_wait_room(p, 0))) {
+                pipe_push(p, page, 0, len, NULL, NULL);
+                pipe_wake_readers(p);
+        }
+        kmutex_unlock(&p->pv_wrlock);
+
+        fput(f);
+        return (err < 0) ? err : (int)len;
+}
+
+/*
+ * Move up to len bytes from the file in to the pipe, starting at *pos.
+ * Pages of regular files that live in the page cache are pinned and put
+ * in the ring as they are; anything else is read into pages of our own.
+ */
+static int
+pipe_splice_in(pipe_t *p, vnode_t *in, off_t *pos, size_t len)
+{
+        size_t done = 0;
+        int err = 0;
+
+        kmutex_lock(&p->pv_wrlock);
+        while (done < len) {
+                size_t off = PAGE_OFFSET(*pos);
+                size_t n = MIN(len - done, PAGE_SIZE - off);
+                pframe_t *pf;
+                void *page;
+                int got;
+
+                if ((err = pipe_wait_room(p, done > 0)) < 0) {
+                        break;
+                }
+
+                if (S_ISREG(in->vn_mode) && NULL != in->vn_ops->fillpage) {
+                        if (*pos >= in->vn_len) {
+                                break;
+                        }
+                        n = MIN(n, (size_t)(in->vn_len - *pos));
+                        if ((err = pframe_get(&in->vn_mmobj, ADDR_TO_PN(*pos), &pf)) < 0) {
+                                break;
+                        }
+                        pframe_pin(pf);
+                        vref(in);
+                        pipe_push(p, pf->pf_addr, off, n, pf, in);
+                        got = n;
+                } else {
+                        if (NULL == (page = page_alloc())) {
+                                err = -ENOMEM;
+                                break;
+                        }
+                        if ((got = in->vn_ops->read(in, *pos, page, n)) <= 0) {
+                                page_free(page);
+                                err = got;
+                                break;
+                        }
+                        pipe_push(p, page, 0, got, NULL, NULL);
+                }
+                *pos += got;
+                done += got;
+        }
+
+        if (done > 0) {
+                pipe_wake_readers(p);
+        }
+        kmutex_unlock(&p->pv_wrlock);
+        return (done > 0) ? (int)done : err;
+}
+
+/*
+ * Move up to len bytes from the pipe to the file out at *pos, writing
+ * straight from the ring's pages. Like a read, this waits for the pipe
+ * to have some data, and then takes only what is there.
+ */
+static int
+pipe_splice_out(pipe_t *p, vnode_t *out, off_t *pos, size_t len)
+{
+        size_t done = 0;
+        int err;
+
+        kmutex_lock(&p->pv_rdlock);
+        if ((err = pipe_wait_data(p)) < 0) {
+                kmutex_unlock(&p->pv_rdlock);
+                return err;
+        }
+
+        while (done < len && p->pv_size > 0) {
+                pipe_buf_t *pb = &p->pv_bufs[p->pv_head];
+                size_t n = MIN(len - done, pb->pb_len);
+                int wrote;
+
+                if ((wrote = out->vn_ops->write(out, *pos, pb->pb_page + pb->pb_off, n)) <= 0) {
+                        err = (wrote < 0) ? wrote : -ENOSPC;
+                        break;
+                }
+                pipe_consume(p, wrote);
+                *pos += wrote;
+                done += wrote;
+                if ((size_t)wrote < n) {
+                        break;
+                }
+        }
+
+        if (done > 0) {
+                pipe_wake_writers(p);
+        }
+        kmutex_unlock(&p->pv_rdlock);
+        return (done > 0) ? (int)done : err;
+}
+
+/*
+ * The implementation of splice(2): move up to len bytes between a pipe
+ * and a file descriptor that is not a pipe, in either direction, without
+ * copying them through userland. The file side reads or writes at *off,
+ * or at its file position if off is NULL; the pipe side must have a NULL
+ * offset. Returns the number of bytes moved, 0 at end of file.
+ *
+ * Error cases:
+ *      o EBADF
+ *        Either fd is not open, or not open in the right mode.
+ *      o EINVAL
+ *        Neither or both fds are pipes, or the file side is a directory.
+ *      o ESPIPE
+ *        An offset was given for the pipe side.
+ */
+int
+do_splice(int fd_in, off_t *off_in, int fd_out, off_t *off_out, size_t len)
+{
+        file_t *fin, *fout;
+        int in_pipe, out_pipe;
+        off_t pos;
+        int err;
+
+        if (NULL == (fin = fget(fd_in))) {
+                return -EBADF;
+        }
+        if (NULL == (fout = fget(fd_out))) {
+                fput(fin);
+                return -EBADF;
+        }
+
+        in_pipe = (fin->f_vnode->vn_ops == &pipe_vops);
+        out_pipe = (fout->f_vnode->vn_ops == &pipe_vops);
+
+        if (0 == (fin->f_mode & FMODE_READ) || 0 == (fout->f_mode & FMODE_WRITE)) {
+                err = -EBADF;
+        } else if (in_pipe == out_pipe
+                   || S_ISDIR(fin->f_vnode->vn_mode) || S_ISDIR(fout->f_vnode->vn_mode)) {
+                err = -EINVAL;
+        } else if ((in_pipe && NULL != off_in) || (out_pipe && NULL != off_out)) {
+                err = -ESPIPE;
+        } else if (in_pipe) {
+                if (NULL != off_out) {
+                        pos = *off_out;
+                } else if (fout->f_mode & FMODE_APPEND) {
+                        pos = fout->f_vnode->vn_len;
+                } else {
+                        pos = fout->f_pos;
+                }
+                err = (pos < 0) ? -EINVAL
+                      : pipe_splice_out(VNODE_TO_PIPE(fin->f_vnode), fout->f_vnode,
+                                        &pos, MIN(len, (size_t)INT_MAX));
+                if (NULL != off_out) {
+                        *off_out = pos;
+                } else if (err > 0) {
+                        fout->f_pos = pos;
+                }
+        } else {
+                pos = (NULL != off_in) ? *off_in : fin->f_pos;
+                err = (pos < 0) ? -EINVAL
+                      : pipe_splice_in(VNODE_TO_PIPE(fout->f_vnode), fin->f_vnode,
+                                       &pos, MIN(len, (size_t)INT_MAX));
+                if (NULL != off_in) {
+                        *off_in = pos;
+                } else if (err > 0) {
+                        fin->f_pos = pos;
+                }
+        }
+
+        fput(fout);
+        fput(fin);
+        return err;
+}
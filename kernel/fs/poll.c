@@ -0,0 +1,231 @@
+/*
+ *  FILE: poll.c
+ *  DESC: Implementation of poll(2) and the wait tables behind it.
+ */
+
+#include "kernel.h"
+#include "errno.h"
+#include "globals.h"
+
+#include "main/interrupt.h"
+
+#include "fs/file.h"
+#include "fs/poll.h"
+#include "fs/vnode.h"
+
+#include "mm/slab.h"
+
+#include "proc/sched.h"
+
+#include "util/debug.h"
+#include "util/init.h"
+#include "util/list.h"
+#include "util/time.h"
+#include "util/timer.h"
+
+/*
+ * One registration of a polltable on a pollhead. It is linked on both so
+ * that the poller can unhook itself from everything it registered on, and
+ * the object can find every poller to wake.
+ */
+typedef struct pollentry {
+        polltable_t    *pe_table;
+        list_link_t     pe_tlink;       /* link on pe_table->pt_entries */
+        list_link_t     pe_hlink;       /* link on the pollhead's ph_entries */
+} pollentry_t;
+
+static slab_allocator_t *pollentry_allocator = NULL;
+
+static __attribute__((unused)) void
+poll_init(void)
+{
+        pollentry_allocator = slab_allocator_create("pollentry", sizeof(pollentry_t));
+        KASSERT(NULL != pollentry_allocator);
+}
+init_func(poll_init);
+
+void
+pollhead_init(pollhead_t *ph)
+{
+        list_init(&ph->ph_entries);
+}
+
+/*
+ * Called by a poll callback to register the polling thread on ph. Does
+ * nothing if pt is NULL, which is how callers ask for a readiness check
+ * only. Callbacks must register before they sample their state, so that
+ * a change in between is never missed.
+ */
+void
+poll_wait(polltable_t *pt, pollhead_t *ph)
+{
+        pollentry_t *pe;
+        uint8_t oldipl;
+
+        if (NULL == pt) {
+                return;
+        }
+
+        if (NULL == (pe = slab_obj_alloc(pollentry_allocator))) {
+                /* We won't hear about ph; rescan instead of sleeping */
+                pt->pt_triggered = 1;
+                return;
+        }
+        pe->pe_table = pt;
+
+        /* Wakeups can come from interrupt context (e.g. the keyboard) */
+        oldipl = intr_getipl();
+        intr_setipl(IPL_HIGH);
+        list_insert_tail(&pt->pt_entries, &pe->pe_tlink);
+        list_insert_tail(&ph->ph_entries, &pe->pe_hlink);
+        intr_setipl(oldipl);
+}
+
+/*
+ * Wake every thread polling on ph. Safe to call from interrupt context.
+ */
+void
+poll_wakeup(pollhead_t *ph)
+{
+        pollentry_t *pe;
+        uint8_t oldipl;
+
+        oldipl = intr_getipl();
+        intr_setipl(IPL_HIGH);
+        list_iterate_begin(&ph->ph_entries, pe, pollentry_t, pe_hlink) {
+                pe->pe_table->pt_triggered = 1;
+                sched_broadcast_on(&pe->pe_table->pt_waitq);
+        } list_iterate_end();
+        intr_setipl(oldipl);
+}
+
+static void
+polltable_init(polltable_t *pt)
+{
+        sched_queue_init(&pt->pt_waitq);
+        list_init(&pt->pt_entries);
+        pt->pt_triggered = 0;
+}
+
+/* Unhook pt from every pollhead it was registered on. */
+static void
+polltable_destroy(polltable_t *pt)
+{
+        pollentry_t *pe;
+        uint8_t oldipl;
+
+        oldipl = intr_getipl();
+        intr_setipl(IPL_HIGH);
+        list_iterate_begin(&pt->pt_entries, pe, pollentry_t, pe_tlink) {
+                list_remove(&pe->pe_tlink);
+                list_remove(&pe->pe_hlink);
+                slab_obj_free(pollentry_allocator, pe);
+        } list_iterate_end();
+        intr_setipl(oldipl);
+}
+
+/*
+ * Fill in revents for every entry in fds, registering on each object if
+ * pt is non-NULL. Files whose vnode has no poll op (regular files and
+ * directories) never block, so they are always readable and writable.
+ *
+ * Returns the number of entries with a non-zero revents.
+ */
+static int
+poll_scan(struct pollfd *fds, nfds_t nfds, polltable_t *pt)
+{
+        nfds_t i;
+        int nready = 0;
+
+        for (i = 0; i < nfds; i++) {
+                file_t *f;
+                int mask;
+
+                fds[i].revents = 0;
+                if (fds[i].fd < 0) {
+                        continue;
+                }
+
+                if (fds[i].fd >= curproc->p_nfiles || NULL == (f = fget(fds[i].fd))) {
+                        mask = POLLNVAL;
+                } else {
+                        vnode_t *vn = f->f_vnode;
+                        if (NULL != vn->vn_ops->poll) {
+                                mask = vn->vn_ops->poll(vn, fds[i].events, pt);
+                        } else {
+                                mask = POLLIN | POLLOUT;
+                        }
+                        fput(f);
+                }
+
+                fds[i].revents = mask & (fds[i].events | POLLERR | POLLHUP | POLLNVAL);
+                if (fds[i].revents) {
+                        nready++;
+                }
+        }
+
+        return nready;
+}
+
+/*
+ * Wait until at least one of the nfds entries in fds (a kernel copy) is
+ * ready, or timeout milliseconds have passed, then fill in every revents
+ * and return the number of ready entries. A timeout of 0 never sleeps,
+ * and a negative one waits for as long as it takes.
+ *
+ * Returns -EINTR if the thread was cancelled while waiting.
+ */
+int
+do_poll(struct pollfd *fds, nfds_t nfds, int timeout)
+{
+        polltable_t pt;
+        int nready;
+        int registered = 0;
+        uint32_t deadline = 0;
+
+        /* The tick we are in is partly over, so wait for one more */
+        if (timeout > 0) {
+                deadline = jiffies + MIN(MSECS_TO_TICKS((uint32_t)timeout), TIMER_MAX_TICKS - 1) + 1;
+        }
+
+        polltable_init(&pt);
+
+        for (;;) {
+                nready = poll_scan(fds, nfds, registered ? NULL : &pt);
+                registered = 1;
+                if (nready > 0 || 0 == timeout) {
+                        break;
+                }
+
+                /*
+                 * A poll_wakeup() since we registered sets pt_triggered;
+                 * check it with interrupts blocked so one can't slip in
+                 * between the check and the sleep.
+                 */
+                int err = 0;
+                uint8_t oldipl = intr_getipl();
+                intr_setipl(IPL_HIGH);
+                if (!pt.pt_triggered) {
+                        if (timeout < 0) {
+                                err = sched_cancellable_sleep_on(&pt.pt_waitq);
+                        } else if ((int32_t)(deadline - jiffies) > 0) {
+                                err = sched_sleep_on_timeout(&pt.pt_waitq, deadline - jiffies);
+                        } else {
+                                err = -ETIMEDOUT;
+                        }
+                }
+                pt.pt_triggered = 0;
+                intr_setipl(oldipl);
+
+                /* Look one last time, then give up */
+                if (-ETIMEDOUT == err) {
+                        timeout = 0;
+                } else if (err < 0) {
+                        nready = err;
+                        break;
+                }
+        }
+
+        polltable_destroy(&pt);
+        return nready;
+}
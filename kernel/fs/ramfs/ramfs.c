@@ -75,7 +75,9 @@ static vnode_ops_t ramfs_dir_vops = {
         .mkdir = ramfs_mkdir,
         .rmdir = ramfs_rmdir,
         .readdir = ramfs_readdir,
+        .readdirs = NULL,
         .stat = ramfs_stat,
+        .poll = NULL,
         .acquire = NULL,
         .release = NULL,
         .fillpage = NULL,
@@ -95,6 +97,7 @@ static vnode_ops_t ramfs_file_vops = {
         .mkdir = NULL,
         .rmdir = NULL,
         .stat = ramfs_stat,
+        .poll = NULL,
         .acquire = NULL,
         .release = NULL,
         .fillpage = NULL,
@@ -60,6 +60,7 @@ static int  s5fs_unlink(vnode_t *vdir, const char *name, size_t namelen);
 static int  s5fs_mkdir(vnode_t *vdir, const char *name, size_t namelen);
 static int  s5fs_rmdir(vnode_t *parent, const char *name, size_t namelen);
 static int  s5fs_readdir(vnode_t *vnode, int offset, struct dirent *d);
+static int  s5fs_readdirs(vnode_t *vnode, off_t *offset, struct dirent *d, size_t count);
 static int  s5fs_stat(vnode_t *vnode, struct stat *ss);
 static int  s5fs_release(vnode_t *vnode, file_t *file);
 static int  s5fs_fillpage(vnode_t *vnode, off_t offset, void *pagebuf);
@@ -86,7 +87,9 @@ static vnode_ops_t s5fs_dir_vops = {
         .mkdir = s5fs_mkdir,
         .rmdir = s5fs_rmdir,
         .readdir = s5fs_readdir,
+        .readdirs = s5fs_readdirs,
         .stat = s5fs_stat,
+        .poll = NULL,
         .acquire = NULL,
         .release = NULL,
         .fillpage = s5fs_fillpage,
@@ -107,7 +110,9 @@ static vnode_ops_t s5fs_file_vops = {
         .mkdir = NULL,
         .rmdir = NULL,
         .readdir = NULL,
+        .readdirs = NULL,
         .stat = s5fs_stat,
+        .poll = NULL,
         .acquire = NULL,
         .release = NULL,
         .fillpage = s5fs_fillpage,
@@ -118,13 +123,30 @@ static vnode_ops_t s5fs_file_vops = {
 static void
 lock_vnode(vnode_t *vn)
 {
-    kmutex_lock(&vn->vn_mutex);
+    krwlock_wrlock(&vn->vn_rwlock);
 }
 
 static void
 unlock_vnode(vnode_t *vn)
 {
-    kmutex_unlock(&vn->vn_mutex);
+    krwlock_wrunlock(&vn->vn_rwlock);
+}
+
+/*
+ * For operations that only read the vnode: reading a file, and looking
+ * up, reading and stat()ing a directory. Any number of these can go on
+ * at once, say while one of them waits for the disk.
+ */
+static void
+lock_vnode_shared(vnode_t *vn)
+{
+    krwlock_rdlock(&vn->vn_rwlock);
+}
+
+static void
+unlock_vnode_shared(vnode_t *vn)
+{
+    krwlock_rdunlock(&vn->vn_rwlock);
 }
 
 /*
@@ -410,18 +432,18 @@ s5fs_umount(fs_t *fs)
 static int
 s5fs_read(vnode_t *vnode, off_t offset, void *buf, size_t len)
 {
-    lock_vnode(vnode);
+    lock_vnode_shared(vnode);
 
     /*read exceeds the end of the file*/
     if (offset >= vnode->vn_len) {
-        unlock_vnode(vnode);
+        unlock_vnode_shared(vnode);
 
         return 0;
     }
 
     int err = s5_read_file(vnode, offset, buf, len);
 
-    unlock_vnode(vnode);
+    unlock_vnode_shared(vnode);
 
     return err;
 }
@@ -555,19 +577,19 @@ s5fs_mknod(vnode_t *dir, const char *name, size_t namelen, int mode, devid_t dev
 int
 s5fs_lookup(vnode_t *base, const char *name, size_t namelen, vnode_t **result)
 {
-    lock_vnode(base);
+    lock_vnode_shared(base);
 
     int inodeno = s5_find_dirent(base, name, namelen);
     if (inodeno < 0) {
 
-        unlock_vnode(base);
+        unlock_vnode_shared(base);
 
         return inodeno;
     }
 
     *result = vget(base->vn_fs, inodeno);
 
-    unlock_vnode(base);
+    unlock_vnode_shared(base);
 
     return 0;
 }
@@ -807,11 +829,11 @@ s5fs_rmdir(vnode_t *parent, const char *name, size_t namelen)
 static int
 s5fs_readdir(vnode_t *vnode, off_t offset, struct dirent *d)
 {
-    lock_vnode(vnode);
+    lock_vnode_shared(vnode);
 
     if (offset > vnode->vn_len) {
 
-        unlock_vnode(vnode);
+        unlock_vnode_shared(vnode);
 
         return 0;
     }
@@ -820,13 +842,13 @@ s5fs_readdir(vnode_t *vnode, off_t offset, struct dirent *d)
     int err = s5_read_file(vnode, offset, (char *)(&s5_dirent), sizeof(s5_dirent_t));
     if (err < 0) {
 
-        unlock_vnode(vnode);
+        unlock_vnode_shared(vnode);
 
         return err;
     }
     if (err == 0) {
 
-        unlock_vnode(vnode);
+        unlock_vnode_shared(vnode);
 
         return 0;
     }
@@ -836,11 +858,59 @@ s5fs_readdir(vnode_t *vnode, off_t offset, struct dirent *d)
     strncpy(d->d_name, s5_dirent.s5d_name, S5_NAME_LEN - 1);
     d->d_name[S5_NAME_LEN - 1] = '\0';
 
-    unlock_vnode(vnode);
+    unlock_vnode_shared(vnode);
 
     return sizeof(s5_dirent_t);
 }
 
+/*
+ * See the comment in vnode.h for what is expected of this function.
+ *
+ * Rather than going through s5_read_file() for each 32-byte entry, pin each
+ * directory block once and convert every entry in it that fits in d.
+ */
+static int
+s5fs_readdirs(vnode_t *vnode, off_t *offset, struct dirent *d, size_t count)
+{
+    lock_vnode_shared(vnode);
+
+    off_t off = *offset;
+    size_t nread = 0;
+
+    while (nread < count && off + (off_t)sizeof(s5_dirent_t) <= vnode->vn_len) {
+        pframe_t *pf = NULL;
+        int err = pframe_get(&vnode->vn_mmobj, S5_DATA_BLOCK(off), &pf);
+        if (err < 0) {
+            unlock_vnode_shared(vnode);
+            if (nread > 0) {
+                *offset = off;
+                return nread;
+            }
+            return err;
+        }
+
+        pframe_pin(pf);
+        s5_dirent_t *s5d = (s5_dirent_t *)((char *)pf->pf_addr + S5_DATA_OFFSET(off));
+        s5_dirent_t *end = (s5_dirent_t *)((char *)pf->pf_addr + S5_BLOCK_SIZE);
+
+        for (; s5d < end && nread < count &&
+               off + (off_t)sizeof(s5_dirent_t) <= vnode->vn_len; s5d++) {
+            off += sizeof(s5_dirent_t);
+            d[nread].d_ino = s5d->s5d_inode;
+            d[nread].d_off = off;
+            strncpy(d[nread].d_name, s5d->s5d_name, S5_NAME_LEN - 1);
+            d[nread].d_name[S5_NAME_LEN - 1] = '\0';
+            nread++;
+        }
+        pframe_unpin(pf);
+    }
+
+    unlock_vnode_shared(vnode);
+
+    *offset = off;
+    return nread;
+}
+
 
 /*
  * See the comment in vnode.h for what is expected of this function.
@@ -857,7 +927,7 @@ s5fs_stat(vnode_t *vnode, struct stat *ss)
     s5_inode_t *i = VNODE_TO_S5INODE(vnode);
     KASSERT(i);
 
-    lock_vnode(vnode);
+    lock_vnode_shared(vnode);
 
     memset(ss, 0, sizeof(struct stat));
     ss->st_mode = vnode->vn_mode;
@@ -869,7 +939,7 @@ s5fs_stat(vnode_t *vnode, struct stat *ss)
     ss->st_blksize = (int) PAGE_SIZE;
     ss->st_blocks = s5_inode_blocks(vnode);
 
-    unlock_vnode(vnode);
+    unlock_vnode_shared(vnode);
 
     return 0;
 }
@@ -14,6 +14,7 @@
 #include "fs/vnode.h"
 #include "fs/vfs_syscall.h"
 #include "fs/open.h"
+#include "fs/fdtable.h"
 #include "fs/fcntl.h"
 #include "fs/lseek.h"
 #include "mm/kmalloc.h"
@@ -22,6 +23,10 @@
 #include "fs/stat.h"
 #include "util/debug.h"
 #include "drivers/dev.h"
+#include "mm/page.h"
+#include "mm/pframe.h"
+#include "limits.h"
+#include "proc/sched.h"
 
 /* To read a file:
  *      o fget(fd)
@@ -45,7 +50,7 @@ do_read(int fd, void *buf, size_t nbytes)
     dbg(DBG_VFS, "syscall hook\n");
     KASSERT(buf);
 
-    if (fd <= -1 || fd >= NFILES) {
+    if (fd <= -1 || fd >= curproc->p_nfiles) {
         return -EBADF;
     }
 
@@ -100,7 +105,7 @@ do_write(int fd, const void *buf, size_t nbytes)
     dbg(DBG_VFS, "syscall hook\n");
     KASSERT(buf);
 
-    if (fd < 0 || fd >= NFILES) {
+    if (fd < 0 || fd >= curproc->p_nfiles) {
         return -EBADF;
     }
 
@@ -127,9 +132,11 @@ do_write(int fd, const void *buf, size_t nbytes)
     }
     f->f_pos += writelen;
 
+    /*a pipe whose readers went away part way takes fewer bytes*/
+    int fifo = S_ISFIFO(f->f_vnode->vn_mode);
     fput(f);
 
-    if ((unsigned)writelen != nbytes) {
+    if ((unsigned)writelen != nbytes && !fifo) {
         return -ENOSPC;
     }
     return writelen;
@@ -137,6 +144,284 @@ do_write(int fd, const void *buf, size_t nbytes)
         /*return -1;*/
 }
 
+/*
+ * Like do_read, but read from the given offset instead of f_pos, and leave
+ * f_pos untouched. This lets callers do positional I/O without an lseek.
+ *
+ * Error cases you must handle for this function at the VFS level:
+ *      o EBADF
+ *        fd is not a valid file descriptor or is not open for reading.
+ *      o EISDIR
+ *        fd refers to a directory.
+ *      o ESPIPE
+ *        fd refers to a pipe, which has no file position.
+ *      o EINVAL
+ *        offset is negative.
+ */
+int
+do_pread(int fd, void *buf, size_t nbytes, off_t offset)
+{
+    dbg(DBG_VFS, "syscall hook\n");
+    KASSERT(buf);
+
+    if (fd < 0 || fd >= curproc->p_nfiles) {
+        return -EBADF;
+    }
+
+    file_t *f = fget(fd);
+    if (f == NULL) {
+        return -EBADF;
+    }
+
+    if ((f->f_mode & FMODE_READ) == 0) {
+        fput(f);
+        return -EBADF;
+    }
+
+    if (S_ISDIR(f->f_vnode->vn_mode)) {
+        fput(f);
+        return -EISDIR;
+    }
+
+    if (S_ISFIFO(f->f_vnode->vn_mode)) {
+        fput(f);
+        return -ESPIPE;
+    }
+
+    if (offset < 0) {
+        fput(f);
+        return -EINVAL;
+    }
+
+    int readlen = f->f_vnode->vn_ops->read(f->f_vnode, offset, buf, nbytes);
+
+    fput(f);
+    return readlen;
+}
+
+/*
+ * Like do_write, but write at the given offset instead of f_pos, and leave
+ * f_pos untouched. FMODE_APPEND is ignored: the caller asked for a position.
+ *
+ * Error cases you must handle for this function at the VFS level:
+ *      o EBADF
+ *        fd is not a valid file descriptor or is not open for writing.
+ *      o ESPIPE
+ *        fd refers to a pipe, which has no file position.
+ *      o EINVAL
+ *        offset is negative.
+ */
+int
+do_pwrite(int fd, const void *buf, size_t nbytes, off_t offset)
+{
+    dbg(DBG_VFS, "syscall hook\n");
+    KASSERT(buf);
+
+    if (fd < 0 || fd >= curproc->p_nfiles) {
+        return -EBADF;
+    }
+
+    file_t *f = fget(fd);
+    if (f == NULL) {
+        return -EBADF;
+    }
+
+    if ((f->f_mode & FMODE_WRITE) == 0) {
+        fput(f);
+        return -EBADF;
+    }
+
+    if (S_ISFIFO(f->f_vnode->vn_mode)) {
+        fput(f);
+        return -ESPIPE;
+    }
+
+    if (offset < 0) {
+        fput(f);
+        return -EINVAL;
+    }
+
+    int writelen = f->f_vnode->vn_ops->write(f->f_vnode, offset, buf, nbytes);
+
+    fput(f);
+
+    if (writelen >= 0 && (unsigned)writelen != nbytes) {
+        return -ENOSPC;
+    }
+    return writelen;
+}
+
+/*
+ * Copy at most one page worth of data from in at inpos to out at outpos.
+ *
+ * If both ends are regular files and the source is backed by the page
+ * cache, the data is handed to the destination's write op straight from
+ * the source's pinned pframe, so it is only copied once (page cache to page
+ * cache). Otherwise it is staged through the bounce page kbuf; device write
+ * ops are not trusted with a pointer into the page cache.
+ *
+ * Returns the number of bytes copied (0 at end of file), or -errno.
+ */
+static int
+copy_chunk(vnode_t *in, off_t inpos, vnode_t *out, off_t outpos,
+           size_t len, void *kbuf)
+{
+    size_t chunk = MIN(len, PAGE_SIZE - PAGE_OFFSET(inpos));
+
+    if (S_ISREG(in->vn_mode) && S_ISREG(out->vn_mode) &&
+        in->vn_ops->fillpage != NULL) {
+        if (inpos >= in->vn_len) {
+            return 0;
+        }
+        chunk = MIN(chunk, (size_t)(in->vn_len - inpos));
+
+        pframe_t *pf = NULL;
+        int err = pframe_get(&in->vn_mmobj, ADDR_TO_PN(inpos), &pf);
+        if (err < 0) {
+            return err;
+        }
+
+        pframe_pin(pf);
+        int writelen = out->vn_ops->write(out, outpos,
+                                          (char *)pf->pf_addr + PAGE_OFFSET(inpos),
+                                          chunk);
+        pframe_unpin(pf);
+        return (writelen == 0) ? -ENOSPC : writelen;
+    }
+
+    int readlen = in->vn_ops->read(in, inpos, kbuf, chunk);
+    if (readlen <= 0) {
+        return readlen;
+    }
+    int writelen = out->vn_ops->write(out, outpos, kbuf, readlen);
+    return (writelen == 0) ? -ENOSPC : writelen;
+}
+
+/*
+ * Copy up to len bytes from infd to outfd without going through user
+ * space. If inoff (outoff) is non-NULL the copy reads (writes) at *inoff
+ * (*outoff) and updates it, leaving that file's f_pos alone; otherwise
+ * f_pos is used and advanced, honoring FMODE_APPEND on the output.
+ *
+ * The copy stops early at end of file, or after a short read from a
+ * non-regular file (e.g. one line from a tty).
+ *
+ * Error cases you must handle for this function at the VFS level:
+ *      o EBADF
+ *        infd is not open for reading or outfd is not open for writing.
+ *      o EISDIR
+ *        either fd refers to a directory.
+ *      o ESPIPE
+ *        an offset was given for a pipe.
+ *      o EINVAL
+ *        an offset is negative, or infd and outfd refer to the same file
+ *        and the two ranges overlap.
+ *      o ENOSPC
+ *        nothing could be written to the output.
+ */
+int
+do_copy_file_range(int infd, off_t *inoff, int outfd, off_t *outoff, size_t len)
+{
+    dbg(DBG_VFS, "syscall hook\n");
+
+    if (infd < 0 || infd >= curproc->p_nfiles || outfd < 0 || outfd >= curproc->p_nfiles) {
+        return -EBADF;
+    }
+
+    file_t *fin = fget(infd);
+    if (fin == NULL) {
+        return -EBADF;
+    }
+    file_t *fout = fget(outfd);
+    if (fout == NULL) {
+        fput(fin);
+        return -EBADF;
+    }
+
+    int err = 0;
+    vnode_t *in = fin->f_vnode;
+    vnode_t *out = fout->f_vnode;
+
+    if ((fin->f_mode & FMODE_READ) == 0 || (fout->f_mode & FMODE_WRITE) == 0) {
+        err = -EBADF;
+        goto out;
+    }
+    if (S_ISDIR(in->vn_mode) || S_ISDIR(out->vn_mode)) {
+        err = -EISDIR;
+        goto out;
+    }
+    if ((inoff != NULL && S_ISFIFO(in->vn_mode)) ||
+        (outoff != NULL && S_ISFIFO(out->vn_mode))) {
+        err = -ESPIPE;
+        goto out;
+    }
+
+    off_t inpos = (inoff != NULL) ? *inoff : fin->f_pos;
+    off_t outpos;
+    if (outoff != NULL) {
+        outpos = *outoff;
+    } else if (fout->f_mode & FMODE_APPEND) {
+        outpos = out->vn_len;
+    } else {
+        outpos = fout->f_pos;
+    }
+    if (inpos < 0 || outpos < 0) {
+        err = -EINVAL;
+        goto out;
+    }
+
+    len = MIN(len, (size_t)INT_MAX);
+    if (in == out && (size_t)inpos < outpos + len && (size_t)outpos < inpos + len) {
+        err = -EINVAL;
+        goto out;
+    }
+
+    void *kbuf = page_alloc();
+    if (kbuf == NULL) {
+        err = -ENOMEM;
+        goto out;
+    }
+
+    int copied = 0;
+    while ((size_t)copied < len) {
+        size_t want = MIN(len - copied, PAGE_SIZE - PAGE_OFFSET(inpos));
+        int n = copy_chunk(in, inpos, out, outpos, want, kbuf);
+        if (n < 0) {
+            if (copied == 0) {
+                err = n;
+            }
+            break;
+        }
+        copied += n;
+        inpos += n;
+        outpos += n;
+        if ((size_t)n != want) {
+            break;
+        }
+    }
+    page_free(kbuf);
+
+    if (inoff != NULL) {
+        *inoff = inpos;
+    } else {
+        fin->f_pos = inpos;
+    }
+    if (outoff != NULL) {
+        *outoff = outpos;
+    } else {
+        fout->f_pos = outpos;
+    }
+
+    if (err == 0) {
+        err = copied;
+    }
+
+out:
+    fput(fout);
+    fput(fin);
+    return err;
+}
+
 /*
  * Zero curproc->p_files[fd], and fput() the file. Return 0 on success
  *
@@ -148,7 +433,7 @@ int
 do_close(int fd)
 {
     dbg(DBG_VFS, "syscall hook\n");
-    if (fd < 0 || fd >= NFILES ) {
+    if (fd < 0 || fd >= curproc->p_nfiles ) {
         return -EBADF;
     }
 
@@ -157,7 +442,7 @@ do_close(int fd)
         return -EBADF;
     }
 
-    curproc->p_files[fd] = NULL;
+    fdtable_remove(curproc, fd);
     fput(f);
 
     return 0;
@@ -165,6 +450,46 @@ do_close(int fd)
         /*return -1;*/
 }
 
+/*
+ * Write back every dirty resident page of the file. Pages that are pinned
+ * (e.g. a directory block being read) are skipped; they will be written by
+ * a later sync. Since pframe_clean() can block, and the page list may
+ * change while we sleep, the scan restarts after every page we clean.
+ *
+ * Error cases you must handle for this function at the VFS level:
+ *      o EBADF
+ *        fd is not a valid file descriptor.
+ */
+int
+do_fsync(int fd)
+{
+    file_t *f;
+    pframe_t *pf;
+    int err = 0;
+
+    if (fd < 0 || fd >= curproc->p_nfiles || NULL == (f = fget(fd))) {
+        return -EBADF;
+    }
+
+restart:
+    list_iterate_begin(&f->f_vnode->vn_mmobj.mmo_respages, pf, pframe_t, pf_olink) {
+        if (pframe_is_busy(pf)) {
+            sched_sleep_on(&pf->pf_waitq);
+            goto restart;
+        }
+        if (pframe_is_dirty(pf) && !pframe_is_pinned(pf)) {
+            if ((err = pframe_clean(pf)) < 0) {
+                goto out;
+            }
+            goto restart;
+        }
+    } list_iterate_end();
+
+out:
+    fput(f);
+    return err;
+}
+
 /* To dup a file:
  *      o fget(fd) to up fd's refcount
  *      o get_empty_fd()
@@ -185,7 +510,7 @@ int
 do_dup(int fd)
 {
     dbg(DBG_VFS, "syscall hook\n");
-    if (fd < 0 || fd >= NFILES) {
+    if (fd < 0 || fd >= curproc->p_nfiles) {
         return -EBADF;
     }
 
@@ -197,10 +522,10 @@ do_dup(int fd)
     int newfd = get_empty_fd(curproc);
     if (newfd < 0) {
         fput(f);
-        return -EMFILE;
+        return newfd;
     }
 
-    curproc->p_files[newfd] = f;
+    fdtable_install(curproc, newfd, f);
 
     return newfd;
         /*NOT_YET_IMPLEMENTED("VFS: do_dup");*/
@@ -220,7 +545,7 @@ int
 do_dup2(int ofd, int nfd)
 {
     dbg(DBG_VFS, "syscall hook\n");
-    if (ofd <= -1 || ofd >= NFILES) {
+    if (ofd <= -1 || ofd >= curproc->p_nfiles) {
         return -EBADF;
     }
 
@@ -229,7 +554,7 @@ do_dup2(int ofd, int nfd)
         return -EBADF;
     }
 
-    if (nfd < 0 || nfd >= NFILES) {
+    if (nfd < 0 || nfd >= NFILES_MAX) {
         fput(f);
         return -EBADF;
     }
@@ -239,17 +564,24 @@ do_dup2(int ofd, int nfd)
         return nfd;
     }
 
+    /*the table may have to grow to reach nfd*/
+    int err = fdtable_grow(curproc, nfd + 1);
+    if (err < 0) {
+        fput(f);
+        return err;
+    }
+
     /*look it up in the table or fget?*/
     file_t *nf = curproc->p_files[nfd];
     if (nf) {
-        int err = do_close(nfd);
+        err = do_close(nfd);
         if (err < 0) {
             fput(f);
             return err;
         }
     }
 
-    curproc->p_files[nfd] = f;
+    fdtable_install(curproc, nfd, f);
 
     return nfd;
         /*NOT_YET_IMPLEMENTED("VFS: do_dup2");*/
@@ -720,7 +1052,7 @@ do_getdent(int fd, struct dirent *dirp)
 {
     dbg(DBG_VFS, "syscall hook\n");
     KASSERT(dirp);
-    if (fd <= -1 || fd >= NFILES) {
+    if (fd <= -1 || fd >= curproc->p_nfiles) {
         dbg(DBG_VFS, "Bad file descriptor\n");
         return -EBADF;
     }
@@ -761,6 +1093,73 @@ do_getdent(int fd, struct dirent *dirp)
         /*return -1;*/
 }
 
+/*
+ * Like do_getdent, but fill as many whole dirent_t's as fit in count bytes
+ * of dirp with a single fget. Uses the readdirs f_op when the filesystem
+ * has one, and falls back to calling readdir once per entry otherwise.
+ *
+ * Return the number of bytes filled in (a multiple of sizeof(dirent_t)),
+ * 0 at the end of the directory, or -errno.
+ *
+ * Error cases you must handle for this function at the VFS level:
+ *      o EBADF
+ *        Invalid file descriptor fd.
+ *      o ENOTDIR
+ *        File descriptor does not refer to a directory.
+ *      o EINVAL
+ *        count is too small to hold a single dirent_t.
+ */
+int
+do_getdents(int fd, struct dirent *dirp, size_t count)
+{
+    dbg(DBG_VFS, "syscall hook\n");
+    KASSERT(dirp);
+
+    if (fd < 0 || fd >= curproc->p_nfiles) {
+        return -EBADF;
+    }
+
+    file_t *f = fget(fd);
+    if (f == NULL) {
+        return -EBADF;
+    }
+
+    vnode_t *dir_vn = f->f_vnode;
+    if (!S_ISDIR(dir_vn->vn_mode) || dir_vn->vn_ops->readdir == NULL) {
+        fput(f);
+        return -ENOTDIR;
+    }
+
+    size_t maxdir = count / sizeof(dirent_t);
+    if (maxdir == 0) {
+        fput(f);
+        return -EINVAL;
+    }
+
+    int nread = 0;
+    if (dir_vn->vn_ops->readdirs != NULL) {
+        nread = dir_vn->vn_ops->readdirs(dir_vn, &f->f_pos, dirp, maxdir);
+    } else {
+        while ((size_t)nread < maxdir) {
+            int offset = dir_vn->vn_ops->readdir(dir_vn, f->f_pos, &dirp[nread]);
+            if (offset <= 0) {
+                if (offset < 0 && nread == 0) {
+                    nread = offset;
+                }
+                break;
+            }
+            f->f_pos += offset;
+            nread++;
+        }
+    }
+
+    fput(f);
+    if (nread < 0) {
+        return nread;
+    }
+    return nread * sizeof(dirent_t);
+}
+
 /*
  * Modify f_pos according to offset and whence.
  *
@@ -775,7 +1174,7 @@ int
 do_lseek(int fd, int offset, int whence)
 {
     dbg(DBG_VFS, "syscall hook\n");
-    if (fd < 0 || fd >= NFILES) {
+    if (fd < 0 || fd >= curproc->p_nfiles) {
         return -EBADF;
     }
 
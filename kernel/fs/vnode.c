@@ -13,6 +13,7 @@
 #include "fs/stat.h"
 #include "fs/vfs.h"
 #include "fs/vnode.h"
+#include "fs/poll.h"
 #include "mm/slab.h"
 #include "proc/sched.h"
 #include "util/debug.h"
@@ -29,6 +30,7 @@ static int special_file_read(vnode_t *file, off_t offset, void *buf, size_t coun
 static int special_file_write(vnode_t *file, off_t offset, const void *buf, size_t count);
 static int special_file_mmap(vnode_t *file, vmarea_t *vma, mmobj_t **ret);
 static int special_file_stat(vnode_t *vnode, struct stat *ss);
+static int special_file_poll(vnode_t *file, int events, struct polltable *pt);
 static int special_file_fillpage(vnode_t *file, off_t offset, void *pagebuf);
 static int special_file_dirtypage(vnode_t *file, off_t offset);
 static int special_file_cleanpage(vnode_t *file, off_t offset, void *pagebuf);
@@ -63,7 +65,9 @@ static vnode_ops_t bytedev_spec_vops = {
         .mkdir = NULL,
         .rmdir = NULL,
         .readdir = NULL,
+        .readdirs = NULL,
         .stat = special_file_stat,
+        .poll = special_file_poll,
         .fillpage = special_file_fillpage,
         .dirtypage = special_file_dirtypage,
         .cleanpage = special_file_cleanpage
@@ -81,7 +85,9 @@ static vnode_ops_t blockdev_spec_vops = {
         .mkdir = NULL,
         .rmdir = NULL,
         .readdir = NULL,
+        .readdirs = NULL,
         .stat = special_file_stat,
+        .poll = NULL,
         .fillpage = NULL,
         .dirtypage = NULL,
         .cleanpage = NULL
@@ -165,7 +171,7 @@ find:
         /*     members that can be initialized here: */
         vn->vn_fs = fs;
         vn->vn_vno = vno;
-        kmutex_init(&vn->vn_mutex);
+        krwlock_init(&vn->vn_rwlock);
         mmobj_init(&vn->vn_mmobj, &vnode_mmobj_ops);
         sched_queue_init(&vn->vn_waitq);
 
@@ -507,6 +513,23 @@ special_file_stat(vnode_t *vnode, struct stat *ss)
         return vnode->vn_fs->fs_root->vn_ops->stat(vnode, ss);
 }
 
+/* Pass poll through to the byte device. Devices without a poll routine
+ * never block, so they are always ready.
+ */
+static int
+special_file_poll(vnode_t *file, int events, struct polltable *pt)
+{
+    KASSERT(S_ISCHR(file->vn_mode));
+    bytedev_t *bytedev = file->vn_cdev;
+    KASSERT(bytedev);
+    KASSERT(bytedev->cd_ops);
+
+    if (bytedev->cd_ops->poll == NULL) {
+        return POLLIN | POLLOUT;
+    }
+    return bytedev->cd_ops->poll(bytedev, events, pt);
+}
+
 /* Just as with mmap above, pass the call through to the
  * device-specific fillpage function.
  *
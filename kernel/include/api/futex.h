@@ -0,0 +1,46 @@
+/*
+ *  FILE: futex.h
+ *  DESC: Waiting on a word of user memory
+ */
+
+#pragma once
+
+/* Kernel and user header (via symlink) */
+
+#ifdef __KERNEL__
+#include "types.h"
+#else
+#include "sys/types.h"
+#endif
+
+/*
+ * futex() lets userland build locks that only enter the kernel when they
+ * are contended:
+ *
+ *  - FUTEX_WAIT sleeps until woken, but only if *uaddr still holds val
+ *    once the kernel has looked; otherwise it fails at once with EAGAIN.
+ *    It gives up with ETIMEDOUT after timeout, if that is not NULL.
+ *  - FUTEX_WAKE wakes up to val threads waiting on uaddr, and returns
+ *    how many it woke.
+ *
+ * A word in a MAP_SHARED mapping is the same futex in every process that
+ * maps it, wherever they have it mapped; any other word belongs to its
+ * process alone. uaddr must be aligned to 4 bytes. Waiters may be woken
+ * for no reason, so they should always check the word again.
+ */
+
+#define FUTEX_WAIT      0
+#define FUTEX_WAKE      1
+
+struct timespec;
+
+#ifdef __KERNEL__
+
+int do_futex_wait(int *uaddr, int val, const struct timespec *timeout);
+int do_futex_wake(int *uaddr, int n);
+
+#else
+
+int futex(int *uaddr, int op, int val, const struct timespec *timeout);
+
+#endif /* __KERNEL__ */
@@ -0,0 +1,64 @@
+/*
+ *  FILE: kdata.h
+ *  DESC: Kernel data pages mapped read-only into every process
+ */
+
+#pragma once
+
+/* Kernel and user header (via symlink) */
+
+#ifdef __KERNEL__
+#include "types.h"
+#include "api/utsname.h"
+#else
+#include "sys/types.h"
+#include "sys/utsname.h"
+#endif
+
+/*
+ * Every process image gets two read-only pages at the top of user memory,
+ * so that queries which only read kernel state need no system call:
+ *
+ *  - KDATA_BASE is one page shared by every process and kept up to date
+ *    by the kernel (kdata_t).
+ *  - KDATA_PROC_BASE is private to the process (kdata_proc_t); it is
+ *    filled in at exec and, for the child, at fork.
+ */
+#define KDATA_BASE              0xbfffe000
+#define KDATA_PROC_BASE         0xbffff000
+
+typedef struct kdata {
+        /*
+         * The clock fields may change at any time. The kernel makes kd_seq
+         * odd while it updates them, so readers retry if kd_seq was odd or
+         * changed while they read.
+         */
+        volatile uint32_t kd_seq;
+        uint32_t          kd_pad;
+        volatile uint64_t kd_mono_ns;   /* monotonic time at kd_tsc_stamp */
+        volatile uint64_t kd_tsc_stamp;
+        volatile uint32_t kd_tsc_mult;  /* ns since stamp = (tsc - stamp) * mult >> shift */
+        volatile uint32_t kd_tsc_shift;
+
+        struct utsname    kd_utsname;
+} kdata_t;
+
+typedef struct kdata_proc {
+        pid_t             kdp_pid;
+} kdata_proc_t;
+
+#ifdef __KERNEL__
+
+struct vmmap;
+
+extern kdata_t *kdata_shared;
+
+int kdata_map(struct vmmap *map, pid_t pid);
+void kdata_set_pid(struct vmmap *map, pid_t pid);
+void kdata_update_clock(uint64_t mono_ns, uint64_t tsc, uint32_t mult, uint32_t shift);
+
+#else
+
+uint64_t kdata_monotonic_ns(void);
+
+#endif /* __KERNEL__ */
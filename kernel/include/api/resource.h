@@ -0,0 +1,36 @@
+/*
+ *  FILE: resource.h
+ *  DESC: resource usage, for getrusage(2)
+ */
+
+#pragma once
+
+/* Kernel and user header (via symlink) */
+
+#ifdef __KERNEL__
+#include "api/time.h"
+#else
+#include "time.h"
+#endif
+
+#define RUSAGE_SELF     0       /* the calling process */
+#define RUSAGE_CHILDREN (-1)    /* its children that have been waited for */
+
+/*
+ * Times are measured by the clock tick: each tick is charged whole to
+ * whatever was running when it came, in user mode or in the kernel, so
+ * they are only accurate over many ticks. ru_wtime is measured exactly.
+ */
+struct rusage {
+        struct timeval  ru_utime;       /* time spent in user mode */
+        struct timeval  ru_stime;       /* time spent in the kernel */
+        long            ru_nvcsw;       /* times it blocked */
+        long            ru_nivcsw;      /* times it was switched out while runnable */
+        struct timeval  ru_wtime;       /* time spent waiting to run (not in POSIX) */
+};
+
+#ifndef __KERNEL__
+
+int getrusage(int who, struct rusage *usage);
+
+#endif /* __KERNEL__ */
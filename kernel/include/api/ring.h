@@ -0,0 +1,99 @@
+/*
+ *  FILE: ring.h
+ *  DESC: Shared submission/completion rings for batched I/O
+ */
+
+#pragma once
+
+/* Kernel and user header (via symlink) */
+
+#ifdef __KERNEL__
+#include "types.h"
+#else
+#include "sys/types.h"
+#endif
+
+/*
+ * ring_setup() returns a file descriptor for a new ring. Mapping one page
+ * of it MAP_SHARED gives the process a ring_shared_t, which it shares with
+ * the kernel:
+ *
+ *  - The process fills in rs_sqes[rs_sq_tail & (entries - 1)] and bumps
+ *    rs_sq_tail; ring_enter() consumes entries from rs_sq_head.
+ *  - For every entry it consumes the kernel posts a completion at
+ *    rs_cqes[rs_cq_tail & (entries - 1)] and bumps rs_cq_tail; the process
+ *    reads completions from rs_cq_head and bumps it when done with them.
+ *
+ * The head and tail counters are free-running; only their difference and
+ * their low bits are significant.
+ */
+
+#define RING_MAX_ENTRIES        64
+
+/* Submission opcodes */
+#define RING_OP_NOP             0
+#define RING_OP_READ            1
+#define RING_OP_WRITE           2
+#define RING_OP_OPEN            3
+#define RING_OP_CLOSE           4
+#define RING_OP_FSYNC           5
+
+typedef struct ring_sqe {
+        uint8_t         sqe_opcode;     /* RING_OP_* */
+        uint8_t         sqe_pad[3];
+        int             sqe_fd;         /* READ, WRITE, CLOSE, FSYNC */
+        off_t           sqe_off;        /* READ, WRITE; -1 to use the file position */
+        void           *sqe_addr;       /* READ, WRITE buffer; OPEN path */
+        uint32_t        sqe_len;        /* READ, WRITE byte count; OPEN path length */
+        int             sqe_open_flags; /* OPEN */
+        uint32_t        sqe_user_data;  /* copied to the completion untouched */
+} ring_sqe_t;
+
+typedef struct ring_cqe {
+        uint32_t        cqe_user_data;
+        int             cqe_res;        /* what the syscall would return, or -errno */
+} ring_cqe_t;
+
+typedef struct ring_shared {
+        volatile uint32_t rs_sq_head;   /* written by the kernel */
+        volatile uint32_t rs_sq_tail;   /* written by the process */
+        volatile uint32_t rs_cq_head;   /* written by the process */
+        volatile uint32_t rs_cq_tail;   /* written by the kernel */
+        uint32_t        rs_entries;     /* size of both rings, a power of 2 */
+        uint32_t        rs_pad;
+        ring_sqe_t      rs_sqes[RING_MAX_ENTRIES];
+        ring_cqe_t      rs_cqes[RING_MAX_ENTRIES];
+} ring_shared_t;
+
+#ifdef __KERNEL__
+
+int do_ring_setup(unsigned int entries);
+int do_ring_enter(int fd, unsigned int to_submit);
+
+#else
+
+int ring_setup(unsigned int entries);
+int ring_enter(int fd, unsigned int to_submit);
+
+/* A process's handle on a ring, managed by the helpers below */
+typedef struct ring {
+        int             r_fd;
+        ring_shared_t  *r_shared;
+        uint32_t        r_mask;
+        uint32_t        r_sq_pending;   /* queued but not yet submitted */
+} ring_t;
+
+int ring_init(ring_t *ring, unsigned int entries);
+void ring_destroy(ring_t *ring);
+ring_sqe_t *ring_get_sqe(ring_t *ring);
+int ring_submit(ring_t *ring);
+ring_cqe_t *ring_peek_cqe(ring_t *ring);
+void ring_cqe_seen(ring_t *ring);
+
+void ring_prep_read(ring_sqe_t *sqe, int fd, void *buf, size_t len, off_t off);
+void ring_prep_write(ring_sqe_t *sqe, int fd, const void *buf, size_t len, off_t off);
+void ring_prep_open(ring_sqe_t *sqe, const char *path, int flags);
+void ring_prep_close(ring_sqe_t *sqe, int fd);
+void ring_prep_fsync(ring_sqe_t *sqe, int fd);
+
+#endif /* __KERNEL__ */
@@ -56,6 +56,25 @@
 #define SYS_mount               45
 #define SYS_umount              46
 #define SYS_stat                47
+#define SYS_pread               48
+#define SYS_pwrite              49
+#define SYS_readv               50
+#define SYS_writev              51
+#define SYS_copy_file_range     52
+#define SYS_poll                53
+#define SYS_fsync               54
+#define SYS_ring_setup          55
+#define SYS_ring_enter          56
+#define SYS_splice              57
+#define SYS_vmsplice            58
+#define SYS_setpriority         59
+#define SYS_getpriority         60
+#define SYS_nanosleep           61
+#define SYS_alarm               62
+#define SYS_clock_gettime       63
+#define SYS_getrusage           64
+#define SYS_times               65
+#define SYS_futex               66
 
 /*
  * ... what does the scouter say about his syscall?
@@ -67,6 +86,10 @@
 
 struct regs;
 struct stat;
+struct iovec;
+struct pollfd;
+struct timespec;
+struct rusage;
 
 typedef struct argstr {
         const char *as_str;
@@ -116,6 +139,95 @@ typedef struct write_args {
         size_t  nbytes;
 } write_args_t;
 
+typedef struct pread_args {
+        int     fd;
+        void   *buf;
+        size_t  nbytes;
+        off_t   offset;
+} pread_args_t;
+
+typedef struct pwrite_args {
+        int     fd;
+        void   *buf;
+        size_t  nbytes;
+        off_t   offset;
+} pwrite_args_t;
+
+typedef struct readv_args {
+        int                 fd;
+        const struct iovec *iov;
+        int                 iovcnt;
+} readv_args_t;
+
+typedef struct writev_args {
+        int                 fd;
+        const struct iovec *iov;
+        int                 iovcnt;
+} writev_args_t;
+
+typedef struct copy_file_range_args {
+        int          fd_in;
+        off_t       *off_in;
+        int          fd_out;
+        off_t       *off_out;
+        size_t       len;
+        unsigned int flags;
+} copy_file_range_args_t;
+
+typedef struct splice_args {
+        int          fd_in;
+        off_t       *off_in;
+        int          fd_out;
+        off_t       *off_out;
+        size_t       len;
+        unsigned int flags;
+} splice_args_t;
+
+typedef struct vmsplice_args {
+        int                 fd;
+        const struct iovec *iov;
+        int                 iovcnt;
+        unsigned int        flags;
+} vmsplice_args_t;
+
+typedef struct setpriority_args {
+        pid_t pid;      /* 0 for the calling process */
+        int   nice;
+} setpriority_args_t;
+
+typedef struct nanosleep_args {
+        const struct timespec *req;
+        struct timespec       *rem;
+} nanosleep_args_t;
+
+typedef struct clock_gettime_args {
+        int              clock;
+        struct timespec *tp;
+} clock_gettime_args_t;
+
+typedef struct getrusage_args {
+        int            who;     /* RUSAGE_SELF or RUSAGE_CHILDREN */
+        struct rusage *ru;
+} getrusage_args_t;
+
+typedef struct futex_args {
+        int                    *uaddr;
+        int                     op;     /* FUTEX_WAIT or FUTEX_WAKE */
+        int                     val;
+        const struct timespec  *timeout; /* FUTEX_WAIT only; NULL for none */
+} futex_args_t;
+
+typedef struct poll_args {
+        struct pollfd *fds;
+        unsigned int   nfds;
+        int            timeout;
+} poll_args_t;
+
+typedef struct ring_enter_args {
+        int          fd;
+        unsigned int to_submit;
+} ring_enter_args_t;
+
 typedef struct mkdir_args {
         argstr_t path;
         int      mode;
@@ -168,3 +280,8 @@ typedef struct stat_args {
 } stat_args_t;
 
 struct utsname;
+
+#ifdef __KERNEL__
+/* Points an application processor's sysenter at its own kernel stack */
+void syscall_init_cpu(void);
+#endif /* __KERNEL__ */
@@ -0,0 +1,66 @@
+/*
+ *  FILE: sysstat.h
+ *  DESC: Per-syscall counters and latency histograms
+ */
+
+#pragma once
+
+/* Kernel and user header (via symlink) */
+
+#ifdef __KERNEL__
+#include "types.h"
+#else
+#include "sys/types.h"
+#endif
+
+/*
+ * Every system call is counted and timed with the TSC, from the moment
+ * syscall_handler() gets it until it is about to return, blocking
+ * included. A call "fails" if it returns -1. Calls that never return
+ * (exit, thr_exit) are not counted.
+ *
+ * Reading /dev/sysstat yields a sequence of sysstat_rec_t; writing
+ * anything to it resets all the counters. The records come in this
+ * order, with only syscalls that have been made since the last reset:
+ *
+ *  - system-wide: one total (ss_sysnum == SYSSTAT_ALL), then one per
+ *    syscall, each with its own histogram;
+ *  - for every live process: one total, with a histogram over all of its
+ *    calls, then one per syscall, without a histogram.
+ */
+
+#define SYSSTAT_NSYS            67      /* syscalls numbered at or past this... */
+#define SYSSTAT_OTHER           SYSSTAT_NSYS /* ...are counted together here */
+#define SYSSTAT_ALL             (-1)    /* ss_sysnum of a total */
+#define SYSSTAT_SYSTEM          (-1)    /* ss_pid of a system-wide record */
+
+/* Calls that took [2^i, 2^(i+1)) cycles go in bucket i; the last is open */
+#define SYSSTAT_HIST_BUCKETS    32
+#define SYSSTAT_NAME_LEN        16
+
+typedef struct sysstat_rec {
+        pid_t           ss_pid;
+        int             ss_sysnum;
+        char            ss_name[SYSSTAT_NAME_LEN];
+        uint32_t        ss_calls;
+        uint32_t        ss_errors;
+        uint64_t        ss_cycles;      /* total over all calls */
+        uint32_t        ss_hist[SYSSTAT_HIST_BUCKETS];
+} sysstat_rec_t;
+
+#ifdef __KERNEL__
+
+struct proc;
+
+void sysstat_record(uint32_t sysnum, int ret, uint64_t cycles);
+void sysstat_reset(void);
+void sysstat_proc_free(struct proc *p);
+const char *sysstat_name(int sysnum);
+
+/*
+ * Fill in rec with the index'th record in the order above. Returns 1, or
+ * 0 if there is no such record.
+ */
+int sysstat_get(int index, sysstat_rec_t *rec);
+
+#endif /* __KERNEL__ */
@@ -0,0 +1,42 @@
+/*
+ *  FILE: time.h
+ *  DESC: time values for nanosleep(2), clock_gettime(2) and getrusage(2)
+ */
+
+#pragma once
+
+/* Kernel and user header (via symlink) */
+
+#ifdef __KERNEL__
+#include "types.h"
+#else
+#include "sys/types.h"
+#endif
+
+#define NSEC_PER_SEC    1000000000L
+
+typedef int32_t time_t;
+typedef int32_t clockid_t;
+
+/*
+ * Time since boot, which never goes back. There is no real-time clock
+ * driver, and so no CLOCK_REALTIME.
+ */
+#define CLOCK_MONOTONIC 1
+
+struct timespec {
+        time_t  tv_sec;                 /* whole seconds */
+        long    tv_nsec;                /* and nanoseconds, below NSEC_PER_SEC */
+};
+
+struct timeval {
+        time_t  tv_sec;                 /* whole seconds */
+        long    tv_usec;                /* and microseconds, below a million */
+};
+
+#ifndef __KERNEL__
+
+int nanosleep(const struct timespec *req, struct timespec *rem);
+int clock_gettime(clockid_t clock, struct timespec *tp);
+
+#endif /* __KERNEL__ */
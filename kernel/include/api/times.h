@@ -0,0 +1,32 @@
+/*
+ *  FILE: times.h
+ *  DESC: process times, for times(2)
+ */
+
+#pragma once
+
+/* Kernel and user header (via symlink) */
+
+#ifdef __KERNEL__
+#include "config.h"
+#else
+#include "weenix/config.h"
+#endif
+
+/* Times are in clock ticks, of which there are CLK_TCK a second */
+#define CLK_TCK         (1000 / TICK_MSECS)
+
+typedef long clock_t;
+
+struct tms {
+        clock_t tms_utime;              /* user time */
+        clock_t tms_stime;              /* system time */
+        clock_t tms_cutime;             /* user time of children waited for */
+        clock_t tms_cstime;             /* system time of children waited for */
+};
+
+#ifndef __KERNEL__
+
+clock_t times(struct tms *buf);
+
+#endif /* __KERNEL__ */
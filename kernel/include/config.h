@@ -12,7 +12,20 @@
  * kernel configuration parameters
  */
 #define DEFAULT_STACK_SIZE      (56*1024) /* size of stacks */
+#define KSTACK_CACHE            16        /* freed kernel stacks kept for reuse */
 #define TICK_MSECS              10        /* msecs between clock interrupts */
+#define SCHED_QUANTUM_TICKS     5         /* shortest time slice, in clock ticks */
+#define NICE_MIN                (-20)     /* nice value of the most favored threads */
+#define NICE_MAX                19        /* nice value of the least favored threads */
+#define NWORKERS                2         /* kernel threads that run queued work */
+#define FUTEX_HASH_SIZE         31        /* buckets of threads waiting in futex() */
+#define PROC_HASH_SIZE          1024      /* buckets of processes by PID */
+
+#ifdef __SMP__
+#    define NCPUS               8         /* most CPUs that will be brought up */
+#else
+#    define NCPUS               1
+#endif
 
 /*
  * Memory-management-related:
@@ -40,7 +53,8 @@
 #define MAX_VFS                 8       /* max # of vfses */
 #define MAX_VNODES              1024    /* max number of in-core vnodes */
 #define NAME_LEN                28      /* maximum directory entry length */
-#define NFILES                  32      /* maximum number of open files */
+#define NFILES                  32      /* open files a process has room for at first */
+#define NFILES_MAX              1024    /* maximum number of open files */
 
 /* Note: if rootfs is ramfs, this is completely ignored */
 #define VFS_ROOTFS_DEV  "disk0" /* device containing root filesystem */
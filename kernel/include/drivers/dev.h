@@ -25,6 +25,9 @@
  *         - minor 1:          /dev/tty1       Second TTY device
  *         - and so on...
  *
+ *     - char major 3:         Kernel statistics (stat)
+ *         - minor 0:          /dev/sysstat    System call counters
+ *
  *     - block major 1:        Disk devices
  *         - minor 0:          first disk device
  *         - minor 1:          second disk device
@@ -47,3 +50,7 @@
 #define MEM_MAJOR       1
 #define MEM_NULL_MINOR  0
 #define MEM_ZERO_MINOR  1
+
+#define STAT_MAJOR      3
+#define STAT_SYSSTAT_MINOR 0
+#define STAT_SYSSTAT_DEVID (MKDEVID(STAT_MAJOR, STAT_SYSSTAT_MINOR))
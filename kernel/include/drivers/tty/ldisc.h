@@ -2,6 +2,7 @@
 
 struct tty_ldisc;
 struct tty_device;
+struct polltable;
 
 typedef struct tty_ldisc_ops {
         /**
@@ -51,6 +52,16 @@ typedef struct tty_ldisc_ops {
          * @return a null terminated string to be echoed to the tty
          */
         const char *(*process_char)(struct tty_ldisc *ldisc, char c);
+
+        /**
+         * Report whether a read would return without blocking, and
+         * register the poll table to be woken when that changes.
+         *
+         * @param ldisc the line discipline
+         * @param pt the poll table to register, or NULL to only check
+         * @return POLLIN if a read would not block, 0 otherwise
+         */
+        int (*poll)(struct tty_ldisc *ldisc, struct polltable *pt);
 } tty_ldisc_ops_t;
 
 typedef struct tty_ldisc {
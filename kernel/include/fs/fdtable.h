@@ -0,0 +1,50 @@
+/*
+ *  FILE: fdtable.h
+ *  DESC: Per-process file descriptor tables
+ */
+
+#pragma once
+
+#include "types.h"
+
+struct file;
+struct proc;
+
+/*
+ * A process's file descriptors index p_files, which has p_nfiles slots.
+ * It starts out as the NFILES slots built into the proc_t and is moved to
+ * a kmalloc'd array twice the size whenever it fills up, up to NFILES_MAX.
+ *
+ * p_fdmap has a bit set for every slot in use, so that the lowest free
+ * descriptor is found a word at a time. Slots must only be changed with
+ * fdtable_install() and fdtable_remove(), to keep the two in step.
+ */
+
+#define FDMAP_BITS              32
+#define FDMAP_WORDS(nfiles)     (((nfiles) + FDMAP_BITS - 1) / FDMAP_BITS)
+
+void fdtable_init(struct proc *p);
+
+/*
+ * Make room for descriptors up to (not including) nfiles. Returns 0,
+ * -EMFILE if that is more than NFILES_MAX, or -ENOMEM.
+ */
+int fdtable_grow(struct proc *p, int nfiles);
+
+/* The lowest free descriptor, or -EMFILE or -ENOMEM if none can be had */
+int fdtable_lowest_free(struct proc *p);
+
+/*
+ * Point fd, which must be free and within the table, at f. The table
+ * takes over the caller's reference.
+ */
+void fdtable_install(struct proc *p, int fd, struct file *f);
+
+/* Empty fd and return what it held; the caller gets its reference */
+struct file *fdtable_remove(struct proc *p, int fd);
+
+/* Give child a reference to every file open in parent, at the same fd */
+int fdtable_copy(struct proc *child, struct proc *parent);
+
+/* fput() every open file and go back to the built-in table */
+void fdtable_close_all(struct proc *p);
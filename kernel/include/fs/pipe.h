@@ -7,4 +7,8 @@
 
 #pragma once
 
+#include "types.h"
+
 int do_pipe(int pipefd[2]);
+int do_splice(int fd_in, off_t *off_in, int fd_out, off_t *off_out, size_t len);
+int pipe_give_page(int fd, void *page, size_t len);
@@ -0,0 +1,56 @@
+/*
+ *  FILE: poll.h
+ *  DESC: poll(2) readiness events and the kernel's poll wait tables
+ */
+
+#pragma once
+
+/* Kernel and user header (via symlink) */
+
+/* Events for pollfd.events and pollfd.revents */
+#define POLLIN          0x001   /* Data may be read without blocking. */
+#define POLLOUT         0x004   /* Data may be written without blocking. */
+#define POLLERR         0x008   /* An error has occurred (revents only). */
+#define POLLHUP         0x010   /* Device has been disconnected (revents only). */
+#define POLLNVAL        0x020   /* Invalid fd member (revents only). */
+
+struct pollfd {
+        int     fd;             /* file descriptor to poll, ignored if negative */
+        short   events;         /* requested events */
+        short   revents;        /* returned events */
+};
+
+typedef unsigned int nfds_t;
+
+#ifdef __KERNEL__
+
+#include "util/list.h"
+#include "proc/sched.h"
+
+/*
+ * Every pollable object embeds a pollhead_t. While a thread is in poll(),
+ * the object's poll callback hooks the thread's polltable_t onto the
+ * pollhead with poll_wait(); the object calls poll_wakeup() whenever its
+ * readiness may have changed, which wakes every poller registered on it.
+ */
+typedef struct pollhead {
+        list_t          ph_entries;     /* pollentry_t's hooked onto us */
+} pollhead_t;
+
+typedef struct polltable {
+        ktqueue_t       pt_waitq;       /* the polling thread sleeps here */
+        list_t          pt_entries;     /* pollentry_t's we have registered */
+        int             pt_triggered;   /* set by poll_wakeup() */
+} polltable_t;
+
+void pollhead_init(pollhead_t *ph);
+void poll_wait(polltable_t *pt, pollhead_t *ph);
+void poll_wakeup(pollhead_t *ph);
+
+int do_poll(struct pollfd *fds, nfds_t nfds, int timeout);
+
+#else
+
+int poll(struct pollfd *fds, nfds_t nfds, int timeout);
+
+#endif /* __KERNEL__ */
@@ -0,0 +1,22 @@
+/*
+ *  FILE: uio.h
+ *  DESC: scatter/gather I/O vectors for readv(2) and writev(2)
+ */
+
+#pragma once
+
+/* Kernel and user header (via symlink) */
+
+#ifdef __KERNEL__
+#include "types.h"
+#else
+#include "sys/types.h"
+#endif
+
+/* Maximum number of segments accepted by a single readv/writev */
+#define IOV_MAX         1024
+
+struct iovec {
+        void   *iov_base;               /* start of the segment */
+        size_t  iov_len;                /* length of the segment in bytes */
+};
@@ -9,8 +9,12 @@
 #include "fs/stat.h"
 
 int do_close(int fd);
+int do_fsync(int fd);
 int do_read(int fd, void *buf, size_t nbytes);
 int do_write(int fd, const void *buf, size_t nbytes);
+int do_pread(int fd, void *buf, size_t nbytes, off_t offset);
+int do_pwrite(int fd, const void *buf, size_t nbytes, off_t offset);
+int do_copy_file_range(int infd, off_t *inoff, int outfd, off_t *outoff, size_t len);
 int do_dup(int fd);
 int do_dup2(int ofd, int nfd);
 int do_mknod(const char *path, int mode, unsigned devid);
@@ -21,6 +25,7 @@ int do_link(const char *from, const char *to);
 int do_rename(const char *oldname, const char *newname);
 int do_chdir(const char *path);
 int do_getdent(int fd, struct dirent *dirp);
+int do_getdents(int fd, struct dirent *dirp, size_t count);
 int do_lseek(int fd, int offset, int whence);
 int do_stat(const char *path, struct stat *uf);
 
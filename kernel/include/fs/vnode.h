@@ -13,6 +13,7 @@
 #include "drivers/bytedev.h"
 #include "util/list.h"
 #include "proc/kmutex.h"
+#include "proc/krwlock.h"
 #include "mm/mmobj.h"
 #include "mm/pframe.h"
 
@@ -22,6 +23,7 @@ struct stat;
 struct file;
 struct vnode;
 struct vmarea;
+struct polltable;
 
 typedef struct vnode_ops {
         /* The following functions map directly to their corresponding
@@ -109,6 +111,15 @@ typedef struct vnode_ops {
          * read and 0 will be returned.
          */
         int (*readdir)(struct vnode *dir, off_t offset, struct dirent *d);
+        /*
+         * readdirs is an optional batched readdir. It reads up to count
+         * directory entries starting at *offset into the array d,
+         * advances *offset past the entries read, and returns the number
+         * of entries read (0 at the end of the directory). Filesystems
+         * that leave it NULL are read one entry at a time with readdir.
+         */
+        int (*readdirs)(struct vnode *dir, off_t *offset, struct dirent *d,
+                        size_t count);
 
         /* Operations that can be performed on any type of file: */
         /*
@@ -116,6 +127,13 @@ typedef struct vnode_ops {
          * information about file.
          */
         int (*stat)(struct vnode *vnode, struct stat *buf);
+        /*
+         * poll returns the POLL* events (see fs/poll.h) that are ready on
+         * the file right now. If pt is non-NULL it must also poll_wait()
+         * pt on whatever pollhead is woken when that may change, before
+         * sampling its state. A NULL poll means the file never blocks.
+         */
+        int (*poll)(struct vnode *vnode, int events, struct polltable *pt);
         /*
          * acquire is called on a vnode when a file takes its first
          * reference to the vnode. The file is passed in.
@@ -228,10 +246,11 @@ typedef struct vnode {
         off_t              vn_len;
 
         /*
-         * A mutex used to synchronize reads and writes. This is only used by
-         * the underlying filesystem implementation.
+         * A lock used to synchronize reads and writes; operations that
+         * only read can share it. This is only used by the underlying
+         * filesystem implementation.
          */
-        kmutex_t           vn_mutex;
+        krwlock_t          vn_rwlock;
 
         /*
          * A generic pointer which the file system can use to store any extra
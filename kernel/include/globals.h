@@ -3,5 +3,13 @@
 #include "proc/kthread.h"
 #include "proc/proc.h"
 
+#ifdef __SMP__
+#include "main/smp.h"
+
+/* Every CPU has its own; see main/smp.h */
+#define curthr (smp_cpu()->cpu_thr)
+#define curproc (smp_cpu()->cpu_proc)
+#else
 extern kthread_t *curthr;
 extern proc_t *curproc;
+#endif
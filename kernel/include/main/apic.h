@@ -10,9 +10,32 @@ void apic_init();
 /* Maps the given IRQ to the given interrupt number. */
 void apic_setredir(uint32_t irq, uint8_t intr);
 
-/* Starts the APIC timer */
+/* Starts the APIC timer, interrupting freq times a second. The timer's
+ * rate must have been set with apic_set_timer_hz() first. */
 void apic_enable_periodic_timer(uint32_t freq);
 
+/* How far the periodic timer counts down in each period, which
+ * is one clock tick. */
+uint32_t apic_timer_period();
+
+/* Starts the APIC timer counting down from count, interrupting
+ * once when it gets to 0. Replaces the periodic timer until that
+ * is enabled again. */
+void apic_enable_oneshot_timer(uint32_t count);
+
+/* How far the timer has counted down since it was last started,
+ * or since its last period began if it is periodic. */
+uint32_t apic_timer_elapsed();
+
+/* Sets how many times a second the APIC timer counts down (at the
+ * divide-by-16 setting apic_enable_periodic_timer() uses) */
+void apic_set_timer_hz(uint32_t hz);
+
+/* Starts the APIC timer counting down, without interrupting, and
+ * stops it again, returning how far it counted. For calibration. */
+void apic_timer_count_start();
+uint32_t apic_timer_count_stop();
+
 /* Stops the APIC timer */
 void apic_disable_periodic_timer();
 
@@ -33,3 +56,21 @@ uint8_t apic_getipl();
  * originating from the APIC has been finished. This function
  * should only be called from the interrupt subsystem. */
 void apic_eoi();
+
+/* The ID of the local APIC of the CPU we are running on. */
+uint8_t apic_current_id();
+
+/* Points ids at the local APIC IDs of every enabled CPU, the
+ * one we booted on first, and returns how many there are. */
+int apic_cpus(const uint8_t **ids);
+
+/* Enables the local APIC of an application processor. */
+void apic_init_cpu();
+
+/* Sends an INIT IPI, and then a startup IPI for the 4K
+ * aligned real mode code at paddr, to start up a CPU. */
+void apic_send_init(uint8_t apicid);
+void apic_send_startup(uint8_t apicid, uintptr_t paddr);
+
+/* Raises interrupt intr on the CPU with the given local APIC. */
+void apic_send_ipi(uint8_t apicid, uint8_t intr);
@@ -1,5 +1,13 @@
 #pragma once
 
+/* Kernel and user header (via symlink) */
+
+#ifdef __KERNEL__
+#include "types.h"
+#else
+#include "sys/types.h"
+#endif
+
 /* Vendor-strings. */
 #define CPUID_VENDOR_AMD          "AuthenticAMD"
 #define CPUID_VENDOR_INTEL        "GenuineIntel"
@@ -85,9 +93,48 @@ enum cpuid_requests {
         CPUID_INTELBRANDSTRINGEND,
 };
 
+/* MSRs that configure the sysenter instruction */
+#define IA32_SYSENTER_CS_MSR    0x174
+#define IA32_SYSENTER_ESP_MSR   0x175
+#define IA32_SYSENTER_EIP_MSR   0x176
+
 static inline void cpuid(int request, uint32_t *a, uint32_t *d)
 {
-        __asm__ volatile("cpuid":"=a"(*a), "=d"(*d):"0"(request));
+        /* cpuid also writes ebx and ecx, which we don't need */
+        __asm__ volatile("cpuid":"=a"(*a), "=d"(*d):"0"(request):"ebx", "ecx");
+}
+
+/*
+ * Whether sysenter/sysexit can be used. The earliest Pentium Pros
+ * (family 6, model < 3, stepping < 3) report SEP but don't implement it.
+ */
+static inline int cpuid_has_sysenter(void)
+{
+        uint32_t a, d;
+
+        cpuid(CPUID_GETFEATURES, &a, &d);
+        if (!(d & CPUID_FEAT_EDX_SEP)) {
+                return 0;
+        }
+        return !(((a >> 8) & 0xf) == 6 && ((a >> 4) & 0xf) < 3 && (a & 0xf) < 3);
+}
+
+/* Whether rdtsc can be used */
+static inline int cpuid_has_tsc(void)
+{
+        uint32_t a, d;
+
+        cpuid(CPUID_GETFEATURES, &a, &d);
+        return 0 != (d & CPUID_FEAT_EDX_TSC);
+}
+
+/* Whether the FPU and SSE registers can be saved with fxsave, and used */
+static inline int cpuid_has_sse(void)
+{
+        uint32_t a, d;
+
+        cpuid(CPUID_GETFEATURES, &a, &d);
+        return (d & CPUID_FEAT_EDX_FXSR) && (d & CPUID_FEAT_EDX_SSE);
 }
 
 static inline void cpuid_get_msr(uint32_t msr, uint32_t* lo, uint32_t* hi)
@@ -100,6 +147,14 @@ static inline void cpuid_set_msr(uint32_t msr, uint32_t lo, uint32_t hi)
 	__asm__ volatile("wrmsr"::"a"(lo),"d"(hi),"c"(msr));
 }
 
+/* The time stamp counter, in cycles since reset */
+static inline uint64_t cpuid_rdtsc(void)
+{
+	uint64_t t;
+	__asm__ volatile("rdtsc":"=A"(t));
+	return t;
+}
+
 static inline void io_wait(void)
 {
 	__asm__ volatile("jmp 1f\n\t"
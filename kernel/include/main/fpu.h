@@ -0,0 +1,35 @@
+#pragma once
+
+#include "types.h"
+
+/*
+ * The x87 FPU and SSE registers are switched lazily. A thread has
+ * nowhere to keep them until it first uses them, so one that never does
+ * costs nothing. Switching threads only sets CR0.TS, which makes the next
+ * FPU or SSE instruction trap; only then are the registers saved for the
+ * thread that had them and loaded for the one now running. A thread that
+ * only ever switches with threads that do not use the FPU keeps its
+ * state in the registers the whole time.
+ *
+ * The kernel never uses the FPU itself. Under SMP a thread may next run
+ * on another CPU, so its registers are saved as it is switched out, but
+ * they are still only loaded when it uses them again.
+ */
+
+struct kthread;
+
+/* Turns on the FPU and SSE for this CPU, if it has fxsave and SSE */
+void fpu_init_cpu(void);
+
+/* Called as prev, the thread running, is switched out for next */
+void fpu_switch(struct kthread *prev, struct kthread *next);
+
+/* Gives child a copy of parent's registers, if it has used them */
+void fpu_fork(struct kthread *child, struct kthread *parent);
+
+/* Forgets a thread's registers, when it is destroyed or calls exec */
+void fpu_release(struct kthread *thr);
+
+/* How many times a thread took the FPU, and how many times the
+ * registers were saved and loaded */
+void fpu_stats(uint32_t *traps, uint32_t *saves, uint32_t *loads);
@@ -13,7 +13,11 @@
 
 void gdt_init(void);
 
+/* Loads the GDT on an application processor, and its own TSS */
+void gdt_load_cpu(int cpu);
+
 void gdt_set_kernel_stack(void *addr);
+uint32_t *gdt_kernel_stack_slot(void);
 
 void gdt_set_entry(uint32_t segment, uint32_t base, uint32_t limit,
                    uint8_t ring, int exec, int dir, int rw);
@@ -7,11 +7,16 @@
 
 #define INTR_DIVIDE_BY_ZERO 0x00
 #define INTR_INVALID_OPCODE 0x06
+#define INTR_FPU_UNAVAILABLE 0x07
 #define INTR_GPF 0x0d
 #define INTR_PAGE_FAULT 0x0e
+#define INTR_FPU_ERROR 0x10
+#define INTR_SIMD_ERROR 0x13
 
 #define INTR_PIT 0xf1
 #define INTR_APICTIMER 0xf0
+#define INTR_IPI_RESCHED 0xf2
+#define INTR_IPI_TLB 0xf3
 #define INTR_KEYBOARD 0xe0
 #define INTR_DISK_PRIMARY 0xd0
 #define INTR_DISK_SECONDARY 0xd1
@@ -31,6 +36,9 @@ typedef struct regs {
 
 void intr_init();
 
+/* Loads the interrupt table on an application processor */
+void intr_init_cpu();
+
 /* The function pointer which should be implemented by functions
  * which will handle interrupts. These handlers should be registered
  * with the interrupt subsystem via the intr_register function.
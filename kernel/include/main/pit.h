@@ -7,3 +7,12 @@
  * (i.e., one every millisecond) to the given interrupt. */
 void pit_init(uint8_t intr);
 void pit_starttimer(uint8_t intr);
+
+/* Spins for at least usecs microseconds, without interrupts */
+void pit_delay(uint32_t usecs);
+
+/* Measures the TSC and the local APIC timer against the PIT, which
+ * counts at a known rate. Sets *apic_hz to how many times a second the
+ * APIC timer counts down at the divide-by-16 setting, and returns the
+ * TSC's rate in Hz, or 0 if there is no TSC. */
+uint64_t pit_calibrate(uint32_t *apic_hz);
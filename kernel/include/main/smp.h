@@ -0,0 +1,103 @@
+#pragma once
+
+#include "kernel.h"
+#include "types.h"
+#include "config.h"
+
+#include "main/gdt.h"
+
+/*
+ * Symmetric multiprocessing. Every CPU the ACPI tables list is started
+ * by smp_init() and parked until smp_release_aps(), after which each one
+ * runs threads from its own run queue (see proc/sched.c) and steals work
+ * from the others when it would otherwise go idle.
+ *
+ * The kernel itself is not yet safe to run on more than one CPU at a
+ * time, so it is serialized by a single kernel lock: a CPU takes it on
+ * the way in from userland or out of the idle loop, and gives it up on
+ * the way back out. Context switches happen with it held, so a thread
+ * always resumes on a CPU that holds it. Userland runs on every CPU at
+ * once, and the lock can be broken up a subsystem at a time from here.
+ */
+
+#ifdef __SMP__
+
+struct kthread;
+struct proc;
+
+typedef struct cpu {
+        int               cpu_id;           /* index into smp_cpus */
+        uint8_t           cpu_apicid;       /* local APIC ID, for IPIs */
+        volatile int      cpu_online;       /* 1 once it has started */
+        struct kthread   *cpu_thr;          /* curthr on this CPU */
+        struct proc      *cpu_proc;         /* curproc on this CPU */
+        struct kthread   *cpu_idle;         /* runs when nothing else can */
+        volatile int      cpu_tlb_pending;  /* set until a shootdown is done */
+
+        uint32_t          cpu_ticks;        /* clock ticks seen */
+        uint32_t          cpu_idle_ticks;   /* of which spent idle */
+        uint32_t          cpu_switches;     /* context switches */
+        uint32_t          cpu_steals;       /* threads taken from other CPUs */
+} cpu_t;
+
+extern cpu_t smp_cpus[NCPUS];
+extern int smp_ncpus;
+
+/*
+ * Each CPU loads its own TSS (see gdt_load_cpu()), so the task register
+ * says which CPU we are on without touching memory or the APIC. Before
+ * gdt_init() there is no task register and we can only be the BSP.
+ *
+ * This must be re-read after anything that can context switch, as the
+ * thread may come back on another CPU, hence the volatile.
+ */
+static inline int smp_cpu_id(void)
+{
+        uint16_t tr;
+        __asm__ volatile("str %0" : "=r"(tr));
+        return tr ? (tr - GDT_TSS) / 8 : 0;
+}
+
+static inline cpu_t *smp_cpu(void)
+{
+        return &smp_cpus[smp_cpu_id()];
+}
+
+/*
+ * Starts every application processor and leaves it spinning. Must be
+ * called from kmain() after gdt_init() and intr_init(), while low memory
+ * is still identity mapped for the startup code.
+ */
+void smp_init(void);
+
+/*
+ * Gives every CPU an idle thread in the current (idle) process and lets
+ * the parked ones start running threads. Called once the kernel is up.
+ */
+void smp_release_aps(void);
+
+/* The kernel lock; see above. Taking it leaves the interrupt flag as it was. */
+void smp_lock_kernel(void);
+void smp_unlock_kernel(void);
+
+/* 1 if this CPU holds the kernel lock */
+int smp_kernel_locked(void);
+
+/* Interrupts cpu so that it looks at its run queue */
+void smp_resched_cpu(int cpu);
+
+/*
+ * Flushes the TLB of every CPU in mask (bit i for smp_cpus[i]) but this
+ * one, and waits until they all have.
+ */
+void smp_tlb_flush_cpus(uint32_t mask);
+
+#else
+
+#define smp_cpu_id()            0
+#define smp_ncpus               1
+#define smp_lock_kernel()       do { } while (0)
+#define smp_unlock_kernel()     do { } while (0)
+#define smp_kernel_locked()     1
+
+#endif /* __SMP__ */
@@ -7,6 +7,10 @@
 #define USER_MEM_LOW          0x00400000 /* inclusive */
 #define USER_MEM_HIGH         0xc0000000 /* exclusive */
 
+/* Where kernel stacks are mapped, just below the temporary mappings */
+#define KSTACK_MEM_LOW        0xfdc00000 /* inclusive */
+#define KSTACK_MEM_HIGH       0xffc00000 /* exclusive */
+
 #define PTR_SIZE (sizeof(void *))
 #define PTR_MASK (PTR_SIZE - 1)
 
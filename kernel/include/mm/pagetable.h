@@ -51,20 +51,41 @@ int pt_map(pagedir_t *pd, uintptr_t vaddr, uintptr_t paddr, uint32_t pdflags, ui
 
 /* Unmaps the page for the given virtual page from the given page
  * directory. vaddr must be in the user address space. vaddr must
- * be page aligned. Note that the TLB is not flushed by this function. */
+ * be page aligned. Note that the TLB is not flushed by this function,
+ * except on other CPUs currently running on pd. */
 void pt_unmap(pagedir_t *pd, uintptr_t vaddr);
 
 /* Unmaps the given range of addresses [low, high). As with pt_unmap,
- * the addresses must be page aligned in the user address space */
+ * the addresses must be page aligned in the user address space, and
+ * only the TLBs of other CPUs are flushed */
 void pt_unmap_range(pagedir_t *pd, uintptr_t vlow, uintptr_t vhigh);
 
+/* Gives the kernel address range [vlow, vhigh) page tables of its own,
+ * to be filled in with pt_kmap_pages. This must be called before
+ * pt_template_init, so that every page directory shares them. Both
+ * ends must be aligned to the 4mb covered by a page table. Returns
+ * -EEXIST if any of the range is already mapped (the direct map of
+ * physical memory reaches into it) or -ENOMEM. */
+int pt_kmap_reserve(uintptr_t vlow, uintptr_t vhigh);
+
+/* Allocates npages pages and maps them in at vaddr, which must lie
+ * in a range given to pt_kmap_reserve and be unmapped. Unlike the
+ * rest of kernel memory these pages need not be physically
+ * contiguous. Returns -ENOMEM, with nothing left mapped, if there
+ * are not enough pages. */
+int pt_kmap_pages(uintptr_t vaddr, uint32_t npages);
+
+/* Unmaps npages pages mapped by pt_kmap_pages at vaddr, flushes them
+ * from every CPU's TLB and gives them back to the page allocator. */
+void pt_kunmap_pages(uintptr_t vaddr, uint32_t npages);
+
 /* Creates a new page directory which is initialized to contain
  * mappings for all kernel memory. If there is not enough memory
- * to allocate the directory NULL is returned. Note that destroying
- * a page diretory does not affect the TLB, it is assumed that the
- * page directory being destroyed is not currently in use. Destroying
- * a page directory frees all page tables for user memory referenced
- * by that page directory. */
+ * to allocate the directory NULL is returned. Destroying a page
+ * directory frees all page tables for user memory referenced by
+ * that page directory. It is assumed that no process is running on
+ * the page directory being destroyed, though a kernel-only thread
+ * may still be borrowing it; any CPU that is is moved off it first. */
 pagedir_t *pt_create_pagedir();
 void pt_destroy_pagedir(pagedir_t *pdir);
 
@@ -76,3 +97,13 @@ void pt_set(pagedir_t *pd);
 
 /* Retreives the virtual address of the page directory currently in cr3. */
 pagedir_t *pt_get();
+
+/* Tells the page table subsystem what an application processor's cr3
+ * holds when it first starts. */
+void pt_init_cpu(void);
+
+#ifdef __SMP__
+/* Does what another CPU asked of this one's TLB with
+ * smp_tlb_flush_cpus(). Called with interrupts off. */
+void pt_tlb_ack(void);
+#endif
@@ -15,7 +15,8 @@ typedef struct context {
         uint32_t   c_esp; /* stack pointer (ESP) */
         uint32_t   c_ebp; /* frame pointer (EBP) */
 
-        pagedir_t *c_pdptr; /* pointer to the page directory for this proc */
+        pagedir_t *c_pdptr; /* pointer to the page directory for this proc,
+                             * or NULL to borrow whichever is loaded */
 
         uintptr_t  c_kstack;
         size_t     c_kstacksz;
@@ -55,3 +56,16 @@ void context_make_active(context_t *c);
  * @param newc the context to switch to
  */
 void context_switch(context_t *oldc, context_t *newc);
+
+/**
+ * A thread that never leaves the kernel only touches the kernel's
+ * mappings, which every page directory shares, so its context may have
+ * a NULL page directory. Switching to it then leaves the previous
+ * thread's page directory, and everything in the TLB, where it is.
+ * Switching to a thread whose page directory is already loaded does the
+ * same. Reports how many switches loaded cr3 and how many kept it.
+ *
+ * @param loads where to put the number of page directories loaded
+ * @param kept where to put the number of loads avoided
+ */
+void context_pagedir_stats(uint32_t *loads, uint32_t *kept);
@@ -1,10 +1,16 @@
 #pragma once
 
+#include "config.h"
+
+#include "proc/lockstat.h"
 #include "proc/sched.h"
 
 typedef struct kmutex {
         ktqueue_t       km_waitq;       /* wait queue */
         struct kthread *km_holder;      /* current holder */
+#ifdef __LOCKSTATS__
+        lock_class_t   *km_class;       /* for contention counters */
+#endif
 } kmutex_t;
 
 /**
@@ -14,6 +20,20 @@ typedef struct kmutex {
  */
 void kmutex_init(kmutex_t *mtx);
 
+#ifdef __LOCKSTATS__
+/*
+ * Every place a mutex is initialized is a lock class of its own; see
+ * proc/lockstat.h. (The macro's use of its own name is the function.)
+ */
+#define kmutex_init(mtx)                                                \
+        do {                                                            \
+                static lock_class_t __kmutex_class = LOCK_CLASS_INITIALIZER; \
+                kmutex_init(mtx);                                       \
+                lockstat_register(&__kmutex_class);                     \
+                (mtx)->km_class = &__kmutex_class;                      \
+        } while (0)
+#endif
+
 /**
  * Locks the specified mutex.
  *
@@ -0,0 +1,103 @@
+#pragma once
+
+#include "config.h"
+
+#include "proc/lockstat.h"
+#include "proc/sched.h"
+
+/*
+ * A sleeping lock that any number of readers can hold at once, or a
+ * single writer. Writers are preferred: once a writer is waiting, new
+ * readers wait behind it, so a steady stream of readers cannot keep a
+ * writer out forever (though a steady stream of writers can keep the
+ * readers out).
+ *
+ * Like mutexes, these are only ever taken and released from a thread,
+ * never from an interrupt, and they are not re-entrant: a thread that
+ * already holds the lock for reading must not take it again, as a
+ * writer may have started waiting in between.
+ */
+typedef struct krwlock {
+        ktqueue_t       krw_rdq;        /* readers waiting */
+        ktqueue_t       krw_wrq;        /* writers waiting */
+        int             krw_readers;    /* readers holding it */
+        int             krw_writers;    /* writers holding it or waiting */
+        struct kthread *krw_writer;     /* the writer holding it */
+#ifdef __LOCKSTATS__
+        lock_class_t   *krw_class;      /* for contention counters */
+#endif
+} krwlock_t;
+
+/**
+ * Initializes the fields of the specified krwlock_t.
+ *
+ * @param rw the lock to initialize
+ */
+void krwlock_init(krwlock_t *rw);
+
+#ifdef __LOCKSTATS__
+/* Gives the lock a class, as kmutex_init() does */
+#define krwlock_init(rw)                                                \
+        do {                                                            \
+                static lock_class_t __krwlock_class = LOCK_CLASS_INITIALIZER; \
+                krwlock_init(rw);                                       \
+                lockstat_register(&__krwlock_class);                    \
+                (rw)->krw_class = &__krwlock_class;                     \
+        } while (0)
+#endif
+
+/**
+ * Locks the specified lock for reading, sharing it with other readers.
+ *
+ * Note: This function may block.
+ *
+ * @param rw the lock to lock
+ */
+void krwlock_rdlock(krwlock_t *rw);
+
+/**
+ * Locks the specified lock for reading, but puts the current thread
+ * into a cancellable sleep if the function blocks.
+ *
+ * Note: This function may block.
+ *
+ * @param rw the lock to lock
+ * @return 0 if the current thread now holds the lock and -EINTR if the
+ * sleep was cancelled and this thread does not hold the lock
+ */
+int  krwlock_rdlock_cancellable(krwlock_t *rw);
+
+/**
+ * Locks the specified lock for writing, so that nothing else holds it.
+ *
+ * Note: This function may block.
+ *
+ * @param rw the lock to lock
+ */
+void krwlock_wrlock(krwlock_t *rw);
+
+/**
+ * Locks the specified lock for writing, but puts the current thread
+ * into a cancellable sleep if the function blocks.
+ *
+ * Note: This function may block.
+ *
+ * @param rw the lock to lock
+ * @return 0 if the current thread now holds the lock and -EINTR if the
+ * sleep was cancelled and this thread does not hold the lock
+ */
+int  krwlock_wrlock_cancellable(krwlock_t *rw);
+
+/**
+ * Unlocks the specified lock, held for reading.
+ *
+ * @param rw the lock to unlock
+ */
+void krwlock_rdunlock(krwlock_t *rw);
+
+/**
+ * Unlocks the specified lock, held for writing.
+ *
+ * @param rw the lock to unlock
+ */
+void krwlock_wrunlock(krwlock_t *rw);
@@ -12,6 +12,19 @@
 
 typedef context_func_t kthread_func_t;
 
+/*
+ * What a thread has used of the CPU. Time in user mode and in the kernel
+ * is counted in clock ticks, each charged whole to whatever thread was
+ * running when it came; time spent waiting is measured exactly.
+ */
+typedef struct kt_usage {
+        uint32_t        u_utime;        /* clock ticks in user mode */
+        uint32_t        u_stime;        /* clock ticks in the kernel */
+        uint32_t        u_nvcsw;        /* times it blocked */
+        uint32_t        u_nivcsw;       /* times it was switched out while runnable */
+        uint64_t        u_wait_ns;      /* time spent runnable but not running */
+} kt_usage_t;
+
 struct proc;
 typedef struct kthread {
         context_t       kt_ctx;         /* this thread's context */
@@ -25,6 +38,17 @@ typedef struct kthread {
         int             kt_state;       /* this thread's state */
         list_link_t     kt_qlink;       /* link on ktqueue */
         list_link_t     kt_plink;       /* link on proc thread list */
+        int             kt_quantum;     /* clock ticks left in its time slice */
+        int             kt_prio;        /* run queue it goes on, see sched.h */
+        int             kt_nice;        /* NICE_MIN to NICE_MAX */
+        int             kt_penalty;     /* levels it has been moved down */
+        int             kt_fixed;       /* 1 if kt_prio never changes */
+        int             kt_cpu;         /* CPU whose run queue it last went on */
+        kt_usage_t      kt_usage;       /* CPU used, see above */
+        uint64_t        kt_runnable_ns; /* when it was made runnable, 0 if
+                                         * it is not waiting to run */
+        void           *kt_fpu;         /* its FPU and SSE registers, NULL
+                                         * until it uses them, see fpu.h */
 #ifdef __MTP__
         int             kt_detached;    /* if the thread has been detached */
         ktqueue_t       kt_joinq;       /* thread waiting to join with this thread */
@@ -82,6 +106,15 @@ void kthread_exit(void *retval);
  */
 kthread_t *kthread_clone(kthread_t *thr);
 
+/**
+ * Marks a thread that will never run in user space, so that switching
+ * to it need not load its process's page directory; see context.h. It
+ * must not have run yet.
+ *
+ * @param thr the thread to mark
+ */
+void kthread_set_kernel_only(kthread_t *thr);
+
 #ifdef __MTP__
 /**
  * Shuts down the reaper daemon.
@@ -0,0 +1,56 @@
+#pragma once
+
+#include "types.h"
+
+/*
+ * Contention counters for the sleeping locks, kmutex_t and krwlock_t,
+ * kept per lock class: all the locks initialized at one place in the
+ * source, such as every vnode's lock or every disk's mutex. A class is
+ * named by that place. An acquisition is contended if the thread had
+ * to sleep for the lock, and its wait is timed with the TSC from then
+ * until it has the lock. Only with LOCKSTATS.
+ */
+typedef struct lock_class {
+        const char        *lc_file;        /* where its locks are initialized */
+        int                lc_line;
+        int                lc_registered;  /* on the list of classes yet */
+        uint32_t           lc_locks;       /* locks initialized */
+        uint32_t           lc_acquired;    /* times one was locked */
+        uint32_t           lc_contended;   /* of which had to wait */
+        uint64_t           lc_wait;        /* cycles spent waiting */
+        uint64_t           lc_max_wait;    /* longest single wait */
+        struct lock_class *lc_next;
+} lock_class_t;
+
+/* For a static lock_class_t, as the lock initializers declare at each
+ * place they are used; see kmutex.h */
+#define LOCK_CLASS_INITIALIZER  { __FILE__, __LINE__, 0, 0, 0, 0, 0, 0, NULL }
+
+/**
+ * Counts a lock as belonging to the given class, putting the class on
+ * the list the first time.
+ *
+ * @param lc the class
+ */
+void lockstat_register(lock_class_t *lc);
+
+/**
+ * Counts an acquisition of a lock of the given class.
+ *
+ * @param lc the class, or NULL for none
+ * @param wait_start the TSC when the thread first had to wait, or 0 if
+ * it did not
+ */
+void lockstat_acquired(lock_class_t *lc, uint64_t wait_start);
+
+/**
+ * Sorts the classes, those that spent longest waiting first.
+ *
+ * @return the first class, with the rest following on lc_next
+ */
+lock_class_t *lockstat_sorted(void);
+
+/**
+ * Sets every class's counters back to 0.
+ */
+void lockstat_reset(void);
@@ -4,10 +4,14 @@
 
 #include "proc/kthread.h"
 
+#include "util/timer.h"
+
 #include "mm/pagetable.h"
 
 #include "vm/vmmap.h"
 
+#include "fs/fdtable.h"
+
 #include "config.h"
 
 #define PROC_MAX_COUNT  65536
@@ -26,14 +30,22 @@ typedef struct proc {
         int             p_status;        /* exit status */
         int             p_state;         /* running/sleeping/etc. */
         ktqueue_t       p_wait;          /* queue for wait(2) */
+        ktimer_t        p_alarm;         /* see alarm(2) */
+        kt_usage_t      p_cusage;        /* CPU used by children that have
+                                          * been waited for, and theirs */
 
         pagedir_t      *p_pagedir;
 
         list_link_t     p_list_link;     /* link on the list of all processes */
+        list_link_t     p_hash_link;     /* link on its bucket of the PID hash */
         list_link_t     p_child_link;    /* link on proc list of children */
 
         /* VFS-related: */
-        struct file    *p_files[NFILES]; /* open files */
+        struct file   **p_files;         /* open files; see fs/fdtable.h */
+        uint32_t       *p_fdmap;         /* slots of p_files in use */
+        int             p_nfiles;        /* size of p_files */
+        struct file    *p_files_init[NFILES];
+        uint32_t        p_fdmap_init[FDMAP_WORDS(NFILES)];
         struct vnode   *p_cwd;           /* current working dir */
 
         /* VM */
@@ -42,6 +54,11 @@ typedef struct proc {
         struct vmmap   *p_vmmap;         /* list of areas mapped into
                                           * process' user address
                                           * space */
+
+#ifdef __SYSSTATS__
+        struct sysstat_proc *p_sysstats; /* syscall counters, see
+                                          * api/sysstat.h */
+#endif
 } proc_t;
 
 /* Process states. */
@@ -49,6 +66,12 @@ typedef struct proc {
 #define PROC_DEAD       2       /* has already exited, hasn't been wait'ed */
 
 
+/*
+ * Exit status of a process killed by its alarm going off: what a shell
+ * reports for an unhandled SIGALRM, as Weenix has no signals to deliver.
+ */
+#define PROC_STATUS_ALARM (128 + 14)
+
 /* Special PIDs for Kernel Deamons */
 #define PID_IDLE     0
 #define PID_INIT     1
@@ -59,10 +82,19 @@ void proc_init(void);
  * This function allocates and initializes a new process.
  *
  * @param name the name to give the newly created process
- * @return the newly created process
+ * @return the newly created process, or NULL if every PID is in use
  */
 proc_t *proc_create(char *name);
 
+/**
+ * Frees a process that proc_create() made but that never ran, as when
+ * fork runs out of memory part way. It must have no threads or
+ * children.
+ *
+ * @param proc the process to free
+ */
+void proc_discard(proc_t *proc);
+
 /**
  * Finds the process with the specified PID.
  *
@@ -79,6 +111,15 @@ proc_t *proc_lookup(int pid);
  */
 list_t *proc_list(void);
 
+/**
+ * Adds up the CPU used by the threads of a process. It does not include
+ * its children; see p_cusage for those.
+ *
+ * @param p the process
+ * @param u where to put the total
+ */
+void proc_usage(proc_t *p, kt_usage_t *u);
+
 /**
  * Stops another process from running again by cancelling all its
  * threads.
@@ -120,6 +161,18 @@ void do_exit(int status);
  */
 pid_t do_waitpid(pid_t pid, int options, int *status);
 
+/**
+ * This function implements the alarm(2) system call. When the alarm
+ * goes off, every thread in the process is cancelled, and it exits with
+ * PROC_STATUS_ALARM.
+ *
+ * @param seconds how long until the alarm goes off, or 0 to only cancel
+ * the one that is set
+ * @return the seconds that were left on the alarm it replaces, rounded
+ * up, or 0 if none was set
+ */
+unsigned int do_alarm(unsigned int seconds);
+
 /**
  * This function implements the fork(2) system call.
  *
@@ -1,7 +1,29 @@
 #pragma once
 
+#include "types.h"
+
 #include "util/list.h"
 
+/*
+ * Run queue priorities; lower numbers run first. The levels below
+ * SCHED_PRIO_DYN_MIN are reserved for kernel daemons that are given a
+ * fixed priority. Every other thread starts at SCHED_PRIO_USER, offset
+ * by half its nice value, and then moves by its penalty: up a level for
+ * each time it blocks, down a level for each time slice it uses up, by
+ * at most SCHED_BOOST_MAX and SCHED_DECAY_MAX levels.
+ */
+#define SCHED_NPRIO             32
+#define SCHED_PRIO_PAGEOUTD     0
+#define SCHED_PRIO_SHADOWD      1
+#define SCHED_PRIO_WORKERD      2
+#define SCHED_PRIO_DYN_MIN      4
+#define SCHED_PRIO_USER         14
+#define SCHED_BOOST_MAX         4
+#define SCHED_DECAY_MAX         8
+
+/* Threads waiting to run move up a level this often, in clock ticks */
+#define SCHED_AGE_TICKS         100
+
 struct kthread;
 typedef struct ktqueue {
         list_t          tq_list;
@@ -13,6 +35,35 @@ typedef struct ktqueue {
  */
 void sched_switch(void);
 
+/**
+ * Puts the current thread at the back of the run queue and switches to
+ * the thread at the front.
+ */
+void sched_yield(void);
+
+/**
+ * Called on every clock tick. Charges it to the current thread's user or
+ * system time; see kt_usage_t in proc/kthread.h.
+ *
+ * @param user whether the tick interrupted user mode
+ */
+void sched_account_tick(int user);
+
+/**
+ * Called on every clock tick. Charges the tick to the current thread's
+ * time slice, and asks for it to be preempted once its time slice runs out and
+ * another thread is waiting to run.
+ */
+void sched_tick(void);
+
+/**
+ * Yields if the current thread has used up its time slice. This must
+ * only be called where the kernel could have blocked anyway: on the way
+ * back to userland, or between steps of a long system call with no locks
+ * held and no data structures half-updated.
+ */
+void sched_preempt(void);
+
 /**
  * Marks the given thread as runnable, and adds it to the run queue.
  *
@@ -52,6 +103,17 @@ void sched_sleep_on(ktqueue_t *q);
  */
 int sched_cancellable_sleep_on(ktqueue_t *q);
 
+/**
+ * Like sched_cancellable_sleep_on(), but gives up after the given number
+ * of clock ticks. A timeout of 0 returns at once.
+ *
+ * @param q the queue to sleep on
+ * @param ticks how long to sleep for at most
+ * @return 0 if woken, -ETIMEDOUT if the time ran out first, and -EINTR if
+ * the thread was cancelled
+ */
+int sched_sleep_on_timeout(ktqueue_t *q, uint32_t ticks);
+
 /**
  * Wakes a single thread from sleep if there are any waiting on the
  * queue.
@@ -74,3 +136,40 @@ void sched_broadcast_on(ktqueue_t *q);
  * @param the thread to cancel sleep from
  */
 void sched_cancel(struct kthread *kthr);
+
+/**
+ * Sets a thread's nice value, clamped to NICE_MIN..NICE_MAX. Higher
+ * values mean a lower priority. It has no effect on a thread with a
+ * fixed priority.
+ *
+ * @param thr the thread
+ * @param nice the new nice value
+ */
+void sched_set_nice(struct kthread *thr, int nice);
+
+/**
+ * Pins a thread that is not yet runnable to one of the priorities
+ * below SCHED_PRIO_DYN_MIN, where it is never boosted or decayed.
+ *
+ * @param thr the thread
+ * @param prio the priority
+ */
+void sched_set_fixed_prio(struct kthread *thr, int prio);
+
+/**
+ * Whether every other CPU is idle with nothing waiting to run, so that
+ * none of them will do anything until this CPU wakes one up. Always
+ * true without SMP.
+ */
+int sched_cpus_idle(void);
+
+#ifdef __SMP__
+/**
+ * The body of each CPU's idle thread, which runs whenever there is
+ * nothing else for that CPU to do. See smp_release_aps().
+ *
+ * @param cpu the CPU the thread belongs to
+ * @param arg unused
+ */
+void *sched_idle(int cpu, void *arg);
+#endif
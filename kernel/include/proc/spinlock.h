@@ -0,0 +1,67 @@
+#pragma once
+
+#include "types.h"
+
+/*
+ * A spinlock protects data that is touched from more than one CPU where
+ * sleeping is not an option, such as from an interrupt handler. It sits
+ * beside the IPL rather than replacing it: spinlock_lock() first masks
+ * interrupts on this CPU by raising the IPL, as code guarding against
+ * interrupt handlers already does, and then spins until no other CPU
+ * holds the lock. Without SMP nothing ever spins, and a spinlock is just
+ * a saved IPL and a check that it is not taken twice.
+ */
+typedef struct spinlock {
+        volatile uint32_t sl_locked;    /* 1 while some CPU holds it */
+        uint8_t           sl_ipl;       /* IPL to go back to on unlock */
+} spinlock_t;
+
+#define SPINLOCK_INITIALIZER { 0, 0 }
+
+/**
+ * Initializes a spinlock to be unlocked.
+ *
+ * @param lock the spinlock
+ */
+void spinlock_init(spinlock_t *lock);
+
+/**
+ * Raises the IPL to high and takes the lock.
+ *
+ * Note: These locks are not re-entrant, and must not be held across
+ * anything that may block.
+ *
+ * @param lock the spinlock
+ */
+void spinlock_lock(spinlock_t *lock);
+
+/**
+ * Releases the lock and puts the IPL back where it was.
+ *
+ * @param lock the spinlock
+ */
+void spinlock_unlock(spinlock_t *lock);
+
+/**
+ * Takes the lock, leaving the IPL alone. For callers that have already
+ * raised the IPL themselves, or that hold the lock across a context
+ * switch and must restore the IPL on the other side.
+ *
+ * @param lock the spinlock
+ */
+void spinlock_acquire(spinlock_t *lock);
+
+/**
+ * Releases a lock taken with spinlock_acquire() or spinlock_trylock().
+ *
+ * @param lock the spinlock
+ */
+void spinlock_release(spinlock_t *lock);
+
+/**
+ * Takes the lock if nobody holds it, leaving the IPL alone.
+ *
+ * @param lock the spinlock
+ * @return 1 if the lock was taken and 0 otherwise
+ */
+int spinlock_trylock(spinlock_t *lock);
@@ -27,6 +27,10 @@
 ksyscall(close, (int fd), (fd))
 ksyscall(read, (int fd, void *buf, size_t nbytes), (fd, buf, nbytes))
 ksyscall(write, (int fd, const void *buf, size_t nbytes), (fd, buf, nbytes))
+ksyscall(pread, (int fd, void *buf, size_t nbytes, off_t offset), (fd, buf, nbytes, offset))
+ksyscall(pwrite, (int fd, const void *buf, size_t nbytes, off_t offset), (fd, buf, nbytes, offset))
+ksyscall(copy_file_range, (int infd, off_t *inoff, int outfd, off_t *outoff, size_t len),
+         (infd, inoff, outfd, outoff, len))
 ksyscall(dup, (int fd), (fd))
 ksyscall(dup2, (int ofd, int nfd), (ofd, nfd))
 ksyscall(mkdir, (const char *path), (path))
@@ -39,38 +43,9 @@ ksyscall(lseek, (int fd, int offset, int whence), (fd, offset, whence))
 ksyscall(getdent, (int fd, struct dirent *dirp), (fd, dirp))
 ksyscall(stat, (const char *path, struct stat *uf), (path, uf))
 ksyscall(open, (const char *filename, int flags), (filename, flags))
+ksyscall(getdents, (int fd, struct dirent *dirp, unsigned int count), (fd, dirp, count))
 #define ksys_exit do_exit
 
-/* Kill me now */
-int ksys_getdents(int fd, struct dirent *dirp, unsigned int count)
-{
-        size_t numbytesread = 0;
-        int nbr = 0;
-        dirent_t tempdirent;
-
-        if (count < sizeof(dirent_t)) {
-                curthr->kt_errno = EINVAL;
-                return -1;
-        }
-
-        while (numbytesread < count) {
-                if ((nbr = do_getdent(fd, &tempdirent)) < 0) {
-                        curthr->kt_errno = -nbr;
-                        return -1;
-                }
-                if (nbr == 0) {
-                        return numbytesread;
-                }
-                memcpy(dirp, &tempdirent, sizeof(dirent_t));
-
-                KASSERT(nbr == sizeof(dirent_t));
-
-                dirp++;
-                numbytesread += nbr;
-        }
-        return numbytesread;
-}
-
 /*
  * Redirect system calls to kernel system calls.
  */
@@ -85,6 +60,9 @@ int ksys_getdents(int fd, struct dirent *dirp, unsigned int count)
 #define unlink          ksys_unlink
 #define read            ksys_read
 #define write           ksys_write
+#define pread           ksys_pread
+#define pwrite          ksys_pwrite
+#define copy_file_range(a,b,c,d,e,f) ksys_copy_file_range(a,b,c,d,e)
 #define lseek           ksys_lseek
 #define dup             ksys_dup
 #define dup2            ksys_dup2
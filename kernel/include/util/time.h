@@ -0,0 +1,57 @@
+#pragma once
+
+#include "config.h"
+#include "types.h"
+
+/* Clock ticks per second; a tick is TICK_MSECS milliseconds */
+#define HZ      (1000 / TICK_MSECS)
+
+/*
+ * Clock ticks since the timer was started. Only the clock interrupt
+ * writes it (or, when the tick was stopped, the first interrupt after),
+ * so reading it needs no locking, but it wraps after about 500 days at
+ * the default tick rate.
+ */
+extern volatile uint32_t jiffies;
+
+/*
+ * Nanoseconds since the clock was started at boot. It never goes back,
+ * and with a TSC it has a resolution of a few nanoseconds; without one,
+ * of a clock tick.
+ */
+uint64_t time_monotonic_ns(void);
+
+/* How many times a second the TSC counts, as measured at boot, or 0 if
+ * there is no TSC */
+uint64_t time_tsc_hz(void);
+
+/* Starts the clock ticking on an application processor too */
+void time_init_cpu(void);
+
+/*
+ * Stops the clock tick on a CPU that is about to halt with nothing to
+ * run, if nothing needs it before the next kernel timer is due, and
+ * starts it again when the CPU is woken. Both are called with
+ * interrupts off: time_idle_enter() just before halting, and
+ * time_idle_exit() as soon as any interrupt comes in, which brings
+ * jiffies up to date. Only with NOHZ.
+ */
+void time_idle_enter(void);
+void time_idle_exit(void);
+
+/* How many times the tick has been stopped, and how many tick
+ * interrupts that has saved */
+void time_nohz_stats(uint32_t *sleeps, uint32_t *avoided);
+
+/* Clock ticks in ms milliseconds, rounded up */
+#define MSECS_TO_TICKS(ms)      (((ms) + TICK_MSECS - 1) / TICK_MSECS)
+
+struct timespec;
+
+/*
+ * Converts between time values and clock ticks. Times are rounded up to
+ * a whole tick, and anything too long for a uint32_t of ticks is cut
+ * short to the longest that fits.
+ */
+uint32_t time_to_ticks(const struct timespec *ts);
+void ticks_to_time(uint32_t ticks, struct timespec *ts);
@@ -0,0 +1,82 @@
+#pragma once
+
+#include "types.h"
+
+#include "util/list.h"
+
+/*
+ * One-shot kernel timers, kept on a hierarchical timing wheel driven by
+ * the clock tick. Adding and cancelling a timer are constant time. Every
+ * timer due on a tick is run from the clock interrupt on that tick,
+ * after jiffies has been advanced.
+ *
+ * The callback runs in interrupt context, so it must not block; waking
+ * a thread with the scheduler's functions is fine. Like the run queues,
+ * the wheel is guarded by raising the IPL, so a timer may be added or
+ * cancelled from anywhere, including from a callback.
+ */
+
+/* The furthest off a timer can be; any longer is cut short to this */
+#define TIMER_MAX_TICKS 0x7fffffff
+
+typedef void (*timer_func_t)(void *arg);
+
+typedef struct ktimer {
+        list_link_t     t_link;         /* link on a wheel slot */
+        uint32_t        t_expires;      /* value of jiffies to run at */
+        timer_func_t    t_func;
+        void           *t_arg;
+} ktimer_t;
+
+/**
+ * Initializes a timer that is not pending. It must be initialized once
+ * before it is first added.
+ *
+ * @param t the timer
+ * @param func called with arg when the timer expires
+ * @param arg passed to func
+ */
+void timer_init(ktimer_t *t, timer_func_t func, void *arg);
+
+/**
+ * Arranges for the timer to run after the given number of clock ticks,
+ * replacing any time it was already pending for. A timer for 0 ticks
+ * runs at the next tick.
+ *
+ * @param t the timer
+ * @param ticks how many ticks from now it should run
+ */
+void timer_add(ktimer_t *t, uint32_t ticks);
+
+/**
+ * Stops the timer if it has not run yet.
+ *
+ * @param t the timer
+ * @return 1 if it was pending, 0 if it had run or was never added
+ */
+int timer_cancel(ktimer_t *t);
+
+/**
+ * @param t the timer
+ * @return the number of ticks until the timer runs, or 0 if it is not
+ * pending
+ */
+uint32_t timer_remaining(ktimer_t *t);
+
+/**
+ * How long until any timer is next due, for stopping the clock tick
+ * while there is nothing else for it to do. The answer may be early
+ * (the timer wheel does not know exactly when far off timers are due)
+ * but it is never late.
+ *
+ * @param max the longest answer wanted
+ * @return the number of ticks until the next tick that may run a timer,
+ * at least 1 and at most max
+ */
+uint32_t timer_next(uint32_t max);
+
+/**
+ * Runs every timer that has come due. Called by the clock interrupt
+ * after it advances jiffies.
+ */
+void timer_tick(void);
@@ -0,0 +1,85 @@
+#pragma once
+
+#include "types.h"
+
+#include "util/list.h"
+
+/*
+ * Work that an interrupt handler hands off so as not to do it with
+ * interrupts disabled. There are two ways to run it:
+ *
+ * Deferred work (work_defer()) runs before the interrupt returns, once
+ * the handler has finished and sent its EOI, with interrupts enabled and
+ * the IPL at IPL_LOW. It runs only if the interrupted code was itself at
+ * IPL_LOW; otherwise it waits for an interrupt that was, or for the
+ * scheduler to go idle. Like an interrupt handler, it must not block,
+ * and it can be interrupted, but not by other deferred work.
+ *
+ * Queued work (work_queue()) runs in one of the worker threads, in
+ * thread context, so it may block.
+ *
+ * Either may be asked for from anywhere, including interrupt handlers
+ * and from the work itself. Asking again for work that is still waiting
+ * to run does nothing, so it runs once however many times it is asked.
+ */
+
+typedef void (*work_func_t)(void *arg);
+
+typedef struct work {
+        list_link_t     w_link;         /* link on the deferred or queued list */
+        work_func_t     w_func;
+        void           *w_arg;
+} work_t;
+
+/**
+ * Initializes a piece of work that is not waiting to run. It must be
+ * initialized once before it is first deferred or queued.
+ *
+ * @param w the work
+ * @param func called with arg to do the work
+ * @param arg passed to func
+ */
+void work_init(work_t *w, work_func_t func, void *arg);
+
+/**
+ * Has the work run before the current interrupt returns (or soon after,
+ * if that cannot be done safely). It must not block.
+ *
+ * @param w the work, which must not be queued
+ */
+void work_defer(work_t *w);
+
+/**
+ * Has the work run in a worker thread, where it may block.
+ *
+ * @param w the work, which must not be deferred
+ */
+void work_queue(work_t *w);
+
+/**
+ * Stops the work from running if it has not started yet.
+ *
+ * @param w the work
+ * @return 1 if it was waiting to run, 0 otherwise
+ */
+int work_cancel(work_t *w);
+
+/**
+ * Runs all deferred work, including any deferred while it runs. Called
+ * with interrupts disabled and the IPL at IPL_LOW by the interrupt
+ * handler on its way out and by the scheduler before it goes idle;
+ * returns the same way. Does nothing if deferred work is already
+ * running further up the stack.
+ */
+void work_run_deferred(void);
+
+/**
+ * @return whether there is deferred work waiting to run
+ */
+int work_deferred_pending(void);
+
+/**
+ * Stops the worker threads, and waits for them to exit. Work still
+ * queued is not run. Called by the idle process when shutting down.
+ */
+void workq_shutdown(void);
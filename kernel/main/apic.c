@@ -1,4 +1,5 @@
 #include "types.h"
+#include "config.h"
 
 #include "main/io.h"
 #include "main/acpi.h"
@@ -84,6 +85,13 @@
 #define LOCAL_APIC_TMR_PERIODIC 0x20000
 #define LOCAL_APIC_TMR_BASEDIV (1<<20)
 
+/* Interrupt command register, for IPIs */
+#define LOCAL_APIC_ICR_FIXED 0x000
+#define LOCAL_APIC_ICR_INIT 0x500
+#define LOCAL_APIC_ICR_STARTUP 0x600
+#define LOCAL_APIC_ICR_PENDING 0x1000
+#define LOCAL_APIC_ICR_ASSERT 0x4000
+
 #define LOCAL_APIC_SPUR_ADDR (*(volatile uint32)t*)(apic->at_addr + LOCAL_APIC_SPURIOUS)
 #define LAPICID (*(volatile uint32_t*)(apic->at_addr + LOCAL_APIC_ID))
 #define LAPICVER (*(volatile uint32_t*)(apic->at_addr + LOCAL_APIC_VERSION))
@@ -133,10 +141,19 @@ static struct apic_table *apic = NULL;
 static struct lapic_table *lapic = NULL;
 static struct ioapic_table *ioapic = NULL;
 
+/* Every enabled local APIC, the BSP's first */
+static uint8_t lapic_ids[NCPUS];
+static int lapic_count = 0;
+
+/* Rate the APIC timer counts at, divided by 16; see pit_calibrate() */
+static uint32_t timer_hz = 0;
+/* How far it counts in a period of the periodic timer */
+static uint32_t timer_period = 0;
+
 
 static uint32_t __lapic_getid(void)
 {
-	return (LAPICID >> 24) & 0x0f;
+	return (LAPICID >> 24) & 0xff;
 }
 
 static uint32_t __lapic_getver(void)
@@ -249,40 +266,52 @@ void apic_disable_periodic_timer() {
 	*(uint32_t*)(apic->at_addr + LOCAL_APIC_TASKPRIOR) = 0;
 }
 
+void apic_set_timer_hz(uint32_t hz) {
+	timer_hz = hz;
+}
+
+void apic_timer_count_start() {
+	/* Masked and one-shot, counting down from as far as it can */
+	*(uint32_t*)(apic->at_addr + LOCAL_APIC_LVT_TMR) = LOCAL_APIC_DISABLE;
+	*(uint32_t*)(apic->at_addr + LOCAL_APIC_TMRDIV) = 0x03;
+	*(uint32_t*)(apic->at_addr + LOCAL_APIC_TMRINITCNT) = 0xffffffff;
+}
+
+uint32_t apic_timer_count_stop() {
+	uint32_t left = *(uint32_t*)(apic->at_addr + LOCAL_APIC_TMRCURRCNT);
+	*(uint32_t*)(apic->at_addr + LOCAL_APIC_TMRINITCNT) = 0;
+	return 0xffffffff - left;
+}
+
 void apic_enable_periodic_timer(uint32_t freq) {
-	uint32_t tmp;
-	uint32_t cpubusfreq;
+	uint32_t count;
 
-	dbgq(DBG_CORE, "--- Enabling APIC Timer ---\n");
+	KASSERT(0 != timer_hz && "the APIC timer has not been calibrated");
+	count = timer_hz / freq;
+	count = (count < 16 ? 16 : count);
+	timer_period = count;
 
+	/* The timer counts down at the bus frequency divided by 16 */
 	*(uint32_t*)(apic->at_addr + LOCAL_APIC_TMRDIV) = 0x03;
-	/* Initialize PIT Ch 2 in one-shot mode */
-	/* Some crazy magic numbers here */
-	outb(0x61, (inb(0x61) & 0xfd) | 1);
-	outb(0x43, 0xb2);
-	outb(0x42, 0x9b);
-	inb(0x60);
-	outb(0x42, 0x2e);
-	
-	/* reset PIT one-shot counter (start counting) */
-	tmp = (uint32_t)(inb(0x61) & 0xfe);
-	outb(0x61, (uint8_t)tmp);
-	outb(0x61, (uint8_t)tmp | 1);
-	/* reset APIC timer (set counter to -1) */
-	*(uint32_t*)(apic->at_addr + LOCAL_APIC_TMRINITCNT) = 0xffffffff;
-	/* wait until the PIT reaches zero */
-	while(!(inb(0x61) & 0x20));
-	/* Stop the APIC timer */
-	*(uint32_t*)(apic->at_addr + LOCAL_APIC_LVT_TMR) = LOCAL_APIC_DISABLE;
-	/* some math */
-	cpubusfreq = ((0xffffffff - *(uint32_t*)(apic->at_addr + LOCAL_APIC_TMRINITCNT)) + 1) * 16 * 100;
-	tmp = (cpubusfreq / freq / 16) * 10000;
-	dbgq(DBG_CORE, "CPU Bus Freq: %u\n", cpubusfreq);
-	dbgq(DBG_CORE, "APIC Timer initial count %u\n", tmp);
-	/* Set up the APIC timer for periodic mode */
-	*(uint32_t*)(apic->at_addr + LOCAL_APIC_TMRINITCNT) = (tmp < 16 ? 16 : tmp);
+	*(uint32_t*)(apic->at_addr + LOCAL_APIC_TMRINITCNT) = count;
 	*(uint32_t*)(apic->at_addr + LOCAL_APIC_LVT_TMR) = 32 | LOCAL_APIC_TMR_PERIODIC;
+}
+
+uint32_t apic_timer_period() {
+	return timer_period;
+}
+
+void apic_enable_oneshot_timer(uint32_t count) {
+	KASSERT(0 != count);
+	/* Unmask it in one-shot mode first, as writing the count starts it */
 	*(uint32_t*)(apic->at_addr + LOCAL_APIC_TMRDIV) = 0x03;
+	*(uint32_t*)(apic->at_addr + LOCAL_APIC_LVT_TMR) = 32;
+	*(uint32_t*)(apic->at_addr + LOCAL_APIC_TMRINITCNT) = count;
+}
+
+uint32_t apic_timer_elapsed() {
+	return *(uint32_t*)(apic->at_addr + LOCAL_APIC_TMRINITCNT)
+	       - *(uint32_t*)(apic->at_addr + LOCAL_APIC_TMRCURRCNT);
 }
 
 static void apic_disable_8259() {
@@ -325,10 +354,11 @@ void apic_init()
         KASSERT(PAGE_ALIGNED(apic->at_addr));
         apic->at_addr = pt_phys_perm_map(apic->at_addr, 1);
 
-        /* Get the tables for the local APIC and IO APICS,
-         * Weenix currently only supports one of each, in order
-         * to enforce this a KASSERT will fail this if more than one
-         * of each type is found */
+        /* Get the tables for the local APICs and IO APICS. There is
+         * a local APIC for every CPU, and lapic is left pointing at
+         * the one we are booting on. Weenix currently only supports
+         * one IO APIC, in order to enforce this a KASSERT will fail
+         * if more than one is found */
         uint8_t off = sizeof(*apic);
         while (off < apic->at_header.ah_size) {
                 uint8_t type = *(ptr + off);
@@ -336,13 +366,21 @@ void apic_init()
                 if (TYPE_LAPIC == type) {
                         KASSERT(apic_exists() && "Local APIC does not exist");
                         KASSERT(sizeof(struct lapic_table) == size);
-                        KASSERT(NULL == lapic && "Weenix only supports a single local APIC");
-                        lapic = (struct lapic_table *)(ptr + off);
+                        struct lapic_table *entry = (struct lapic_table *)(ptr + off);
                         dbgq(DBG_CORE, "LAPIC:\n");
-                        dbgq(DBG_CORE, "   id:         0x%.2x\n", (uint32_t)lapic->at_apicid);
-                        dbgq(DBG_CORE, "   processor:  0x%.3x\n", (uint32_t)lapic->at_procid);
-                        dbgq(DBG_CORE, "   enabled:    %i\n", lapic->at_flags & 0x1);
-                        KASSERT(lapic->at_flags & 0x1 && "The local APIC is disabled");
+                        dbgq(DBG_CORE, "   id:         0x%.2x\n", (uint32_t)entry->at_apicid);
+                        dbgq(DBG_CORE, "   processor:  0x%.3x\n", (uint32_t)entry->at_procid);
+                        dbgq(DBG_CORE, "   enabled:    %i\n", entry->at_flags & 0x1);
+                        if (entry->at_apicid == __lapic_getid()) {
+                                KASSERT(entry->at_flags & 0x1 && "The local APIC is disabled");
+                                lapic = entry;
+                                lapic_ids[lapic_count] = lapic_ids[0];
+                                lapic_ids[0] = entry->at_apicid;
+                                lapic_count++;
+                        } else if ((entry->at_flags & 0x1) && lapic_count < NCPUS - (NULL == lapic)) {
+                                /* keeping room for ours if it has not come up yet */
+                                lapic_ids[lapic_count++] = entry->at_apicid;
+                        }
                 } else if (TYPE_IOAPIC == type) {
                         KASSERT(apic_exists() && "IO APIC does not exist");
                         KASSERT(sizeof(struct ioapic_table) == size);
@@ -396,6 +434,46 @@ void apic_eoi()
         LAPICEOI = 0x0;
 }
 
+uint8_t apic_current_id()
+{
+        return (NULL == apic) ? 0 : __lapic_getid();
+}
+
+int apic_cpus(const uint8_t **ids)
+{
+        *ids = lapic_ids;
+        return lapic_count;
+}
+
+void apic_init_cpu()
+{
+        apic_enable();
+}
+
+static void __lapic_send(uint8_t apicid, uint32_t cmd)
+{
+        *(volatile uint32_t*)(apic->at_addr + LOCAL_APIC_ICRH) = (uint32_t)apicid << 24;
+        *(volatile uint32_t*)(apic->at_addr + LOCAL_APIC_ICRL) = cmd;
+        while (*(volatile uint32_t*)(apic->at_addr + LOCAL_APIC_ICRL) & LOCAL_APIC_ICR_PENDING)
+                ;
+}
+
+void apic_send_init(uint8_t apicid)
+{
+        __lapic_send(apicid, LOCAL_APIC_ICR_INIT | LOCAL_APIC_ICR_ASSERT);
+}
+
+void apic_send_startup(uint8_t apicid, uintptr_t paddr)
+{
+        KASSERT(PAGE_ALIGNED(paddr) && paddr < 0x100000);
+        __lapic_send(apicid, LOCAL_APIC_ICR_STARTUP | LOCAL_APIC_ICR_ASSERT | (paddr >> PAGE_SHIFT));
+}
+
+void apic_send_ipi(uint8_t apicid, uint8_t intr)
+{
+        __lapic_send(apicid, LOCAL_APIC_ICR_FIXED | LOCAL_APIC_ICR_ASSERT | intr);
+}
+
 void apic_setredir(uint32_t irq, uint8_t intr)
 {
         dbg(DBG_CORE, "redirecting irq %u to interrupt %hhu\n", irq, intr);
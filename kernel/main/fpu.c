@@ -0,0 +1,255 @@
+#include "kernel.h"
+#include "config.h"
+#include "errno.h"
+#include "globals.h"
+
+#include "main/cpuid.h"
+#include "main/fpu.h"
+#include "main/interrupt.h"
+#include "main/smp.h"
+
+#include "mm/slab.h"
+
+#include "proc/kthread.h"
+#include "proc/proc.h"
+
+#include "util/debug.h"
+#include "util/init.h"
+#include "util/string.h"
+
+#define CR0_MP          0x00000002      /* wait traps too while TS is set */
+#define CR0_EM          0x00000004      /* there is no FPU, always trap */
+#define CR0_TS          0x00000008      /* trap the next FPU instruction */
+#define CR0_NE          0x00000020      /* report FPU errors as #MF */
+#define CR4_OSFXSR      0x00000200      /* fxsave, fxrstor and SSE */
+#define CR4_OSXMMEXCPT  0x00000400      /* report SSE errors as #XM */
+
+#define MXCSR_DEFAULT   0x1f80          /* every SSE exception masked */
+
+/* What fxsave stores, which must be 16-byte aligned. A slab object is
+ * only word aligned, so each is big enough to be aligned within. */
+#define FPU_AREA_SIZE   512
+#define FPU_AREA_ALIGN  16
+#define fpu_area(thr)   ((void *)(((uintptr_t)(thr)->kt_fpu + FPU_AREA_ALIGN - 1) \
+                                  & ~(FPU_AREA_ALIGN - 1)))
+
+static slab_allocator_t *fpu_allocator = NULL;
+static int fpu_enabled = 0;
+
+/*
+ * The thread whose registers each CPU holds. Under SMP that can only be
+ * the thread it is running, as any other was saved when it switched out.
+ * TS is clear exactly when the thread running is the owner.
+ */
+static kthread_t *fpu_owner[NCPUS];
+
+/* What a thread starts with, the state fninit leaves */
+static char fpu_initial[FPU_AREA_SIZE] __attribute__((aligned(FPU_AREA_ALIGN)));
+
+static uint32_t fpu_traps = 0;
+static uint32_t fpu_saves = 0;
+static uint32_t fpu_loads = 0;
+
+static inline uint32_t
+fpu_get_cr0(void)
+{
+        uint32_t cr0;
+        __asm__ volatile("movl %%cr0, %0" : "=r"(cr0));
+        return cr0;
+}
+
+static inline void
+fpu_set_cr0(uint32_t cr0)
+{
+        __asm__ volatile("movl %0, %%cr0" :: "r"(cr0) : "memory");
+}
+
+static inline void
+fpu_clts(void)
+{
+        __asm__ volatile("clts" ::: "memory");
+}
+
+static inline void
+fpu_stts(void)
+{
+        fpu_set_cr0(fpu_get_cr0() | CR0_TS);
+}
+
+static inline void
+fpu_save(kthread_t *thr)
+{
+        __asm__ volatile("fxsave (%0)" :: "r"(fpu_area(thr)) : "memory");
+        fpu_saves++;
+}
+
+static inline void
+fpu_load(kthread_t *thr)
+{
+        __asm__ volatile("fxrstor (%0)" :: "r"(fpu_area(thr)) : "memory");
+        fpu_loads++;
+}
+
+/*
+ * The thread running used the FPU for the first time since it was
+ * switched in, so the registers are handed over to it. A thread that has
+ * never used them before starts with fpu_initial.
+ */
+static void
+fpu_unavailable_handler(regs_t *regs)
+{
+        int cpu = smp_cpu_id();
+        kthread_t *owner = fpu_owner[cpu];
+
+        if (0x3 != (regs->r_cs & 0x3)) {
+                panic("\nFPU used by the kernel at eip=0x%08x\n", regs->r_eip);
+        }
+        if (!fpu_enabled) {
+                dbg(DBG_INTR, "%s (pid %d) used the FPU, which this CPU cannot save\n",
+                    curproc->p_comm, curproc->p_pid);
+                do_exit(EFAULT);
+        }
+
+        fpu_traps++;
+        fpu_clts();
+        if (owner == curthr) {
+                return;
+        }
+        if (NULL != owner) {
+                fpu_save(owner);
+                fpu_owner[cpu] = NULL;
+        }
+
+        if (NULL == curthr->kt_fpu) {
+                if (NULL == (curthr->kt_fpu = slab_obj_alloc(fpu_allocator))) {
+                        fpu_stts();
+                        do_exit(ENOMEM);
+                }
+                memcpy(fpu_area(curthr), fpu_initial, FPU_AREA_SIZE);
+        }
+        fpu_load(curthr);
+        fpu_owner[cpu] = curthr;
+}
+
+/* An x87 or SSE exception, which the process must have unmasked itself */
+static void
+fpu_error_handler(regs_t *regs)
+{
+        if (0x3 != (regs->r_cs & 0x3)) {
+                panic("\nFPU error in the kernel at eip=0x%08x\n", regs->r_eip);
+        }
+        dbg(DBG_INTR, "%s (pid %d) had a floating point exception at eip=0x%08x\n",
+            curproc->p_comm, curproc->p_pid, regs->r_eip);
+        fpu_release(curthr);
+        do_exit(EFAULT);
+}
+
+/* Without fxsave there is no saving the registers, so they are kept from
+ * userland altogether */
+void
+fpu_init_cpu(void)
+{
+        uint32_t cr4;
+
+        if (!cpuid_has_sse()) {
+                fpu_set_cr0(fpu_get_cr0() | CR0_EM);
+                return;
+        }
+
+        __asm__ volatile("movl %%cr4, %0" : "=r"(cr4));
+        cr4 |= CR4_OSFXSR | CR4_OSXMMEXCPT;
+        __asm__ volatile("movl %0, %%cr4" :: "r"(cr4));
+
+        fpu_set_cr0((fpu_get_cr0() & ~CR0_EM) | CR0_MP | CR0_NE | CR0_TS);
+        fpu_owner[smp_cpu_id()] = NULL;
+}
+
+static __attribute__((unused)) void
+fpu_init(void)
+{
+        uint32_t mxcsr = MXCSR_DEFAULT;
+
+        intr_register(INTR_FPU_UNAVAILABLE, fpu_unavailable_handler);
+        intr_register(INTR_FPU_ERROR, fpu_error_handler);
+        intr_register(INTR_SIMD_ERROR, fpu_error_handler);
+
+        fpu_init_cpu();
+        if (!(fpu_enabled = cpuid_has_sse())) {
+                dbg(DBG_CORE, "no fxsave or SSE, userland cannot use the FPU\n");
+                return;
+        }
+
+        fpu_allocator = slab_allocator_create("fpu", FPU_AREA_SIZE + FPU_AREA_ALIGN - 1);
+        KASSERT(NULL != fpu_allocator);
+
+        /* Nothing has used the registers yet, so they hold nothing else */
+        fpu_clts();
+        __asm__ volatile("fninit\n\t"
+                         "ldmxcsr %0\n\t"
+                         "fxsave %1"
+                         :: "m"(mxcsr), "m"(fpu_initial) : "memory");
+        fpu_stts();
+}
+init_func(fpu_init);
+
+void
+fpu_switch(kthread_t *prev, kthread_t *next)
+{
+        int cpu = smp_cpu_id();
+
+        if (!fpu_enabled) {
+                return;
+        }
+#ifdef __SMP__
+        if (fpu_owner[cpu] == prev) {
+                fpu_save(prev);
+                fpu_owner[cpu] = NULL;
+        }
+#endif
+        if (fpu_owner[cpu] == next) {
+                fpu_clts();
+        } else {
+                fpu_stts();
+        }
+}
+
+void
+fpu_fork(kthread_t *child, kthread_t *parent)
+{
+        child->kt_fpu = NULL;
+        if (NULL == parent->kt_fpu) {
+                return;
+        }
+
+        child->kt_fpu = slab_obj_alloc(fpu_allocator);
+        KASSERT(NULL != child->kt_fpu);
+        /* The parent's latest state may only be in the registers */
+        if (fpu_owner[smp_cpu_id()] == parent) {
+                fpu_save(parent);
+        }
+        memcpy(fpu_area(child), fpu_area(parent), FPU_AREA_SIZE);
+}
+
+/* A thread being released is running here or not running at all, and
+ * under SMP only a running thread owns registers, so only this CPU's
+ * need be looked at */
+void
+fpu_release(kthread_t *thr)
+{
+        if (fpu_owner[smp_cpu_id()] == thr) {
+                fpu_owner[smp_cpu_id()] = NULL;
+                fpu_stts();
+        }
+        if (NULL != thr->kt_fpu) {
+                slab_obj_free(fpu_allocator, thr->kt_fpu);
+                thr->kt_fpu = NULL;
+        }
+}
+
+void
+fpu_stats(uint32_t *traps, uint32_t *saves, uint32_t *loads)
+{
+        *traps = fpu_traps;
+        *saves = fpu_saves;
+        *loads = fpu_loads;
+}
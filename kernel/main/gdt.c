@@ -1,4 +1,7 @@
+#include "config.h"
+
 #include "main/gdt.h"
+#include "main/smp.h"
 
 #include "util/printf.h"
 #include "util/debug.h"
@@ -48,7 +51,8 @@ struct gdt_location {
 } __attribute__((packed));
 
 static struct gdt_entry gdt[GDT_COUNT];
-static struct tss_entry tss;
+/* One TSS per CPU, at GDT_TSS + 8 * cpu; see smp_cpu_id() */
+static struct tss_entry tss[NCPUS];
 static struct gdt_location gdtl = {
         .gl_size = GDT_COUNT * 8,
         .gl_offset = (uint32_t) &gdt
@@ -67,22 +71,44 @@ void gdt_init(void)
 
         __asm__ volatile("lgdt (%0)" :: "p"(data));
 
-        gdt_set_entry(GDT_TSS, (uint32_t)&tss, sizeof(tss), 0, 1, 0, 0);
-        gdt[GDT_TSS / 8].ge_access &= ~(0b10000);
-        gdt[GDT_TSS / 8].ge_access |= 0b1;
-        gdt[GDT_TSS / 8].ge_flags &= ~(0b10000000);
+        KASSERT(GDT_TSS / 8 + NCPUS <= GDT_COUNT);
+        int cpu;
+        for (cpu = 0; cpu < NCPUS; cpu++) {
+                uint32_t segment = GDT_TSS + 8 * cpu;
+                gdt_set_entry(segment, (uint32_t)&tss[cpu], sizeof(tss[cpu]), 0, 1, 0, 0);
+                gdt[segment / 8].ge_access &= ~(0b10000);
+                gdt[segment / 8].ge_access |= 0b1;
+                gdt[segment / 8].ge_flags &= ~(0b10000000);
 
-        memset(&tss, 0, sizeof(tss));
-        tss.ts_ss0 = GDT_KERNEL_DATA;
-        tss.ts_iopb = sizeof(tss);
+                memset(&tss[cpu], 0, sizeof(tss[cpu]));
+                tss[cpu].ts_ss0 = GDT_KERNEL_DATA;
+                tss[cpu].ts_iopb = sizeof(tss[cpu]);
+        }
 
         int segment = GDT_TSS;
         __asm__ volatile("ltr %0" :: "m"(segment));
 }
 
+void gdt_load_cpu(int cpu)
+{
+        struct gdt_location *data = &gdtl;
+
+        KASSERT(cpu > 0 && cpu < NCPUS);
+        __asm__ volatile("lgdt (%0)" :: "p"(data));
+
+        int segment = GDT_TSS + 8 * cpu;
+        __asm__ volatile("ltr %0" :: "m"(segment));
+}
+
 void gdt_set_kernel_stack(void *addr)
 {
-        tss.ts_esp0 = (uint32_t)addr;
+        tss[smp_cpu_id()].ts_esp0 = (uint32_t)addr;
+}
+
+/* Where the current thread's kernel stack top is kept, for sysenter */
+uint32_t *gdt_kernel_stack_slot(void)
+{
+        return &tss[smp_cpu_id()].ts_esp0;
 }
 
 void gdt_set_entry(uint32_t segment, uint32_t base, uint32_t limit,
@@ -122,8 +148,11 @@ size_t gdt_tss_info(const void *arg, char *buf, size_t osize)
 
         KASSERT(NULL == arg);
 
-        iprintf(&buf, &size, "TSS:\n");
-        iprintf(&buf, &size, "kstack: %#.8x\n", tss.ts_esp0);
+        int cpu;
+        for (cpu = 0; cpu < smp_ncpus; cpu++) {
+                iprintf(&buf, &size, "TSS %d:\n", cpu);
+                iprintf(&buf, &size, "kstack: %#.8x\n", tss[cpu].ts_esp0);
+        }
 
         return size;
 }
@@ -1,12 +1,19 @@
 #include "types.h"
+#include "globals.h"
 
 #include "util/debug.h"
 #include "util/string.h"
+#include "util/time.h"
+#include "util/workq.h"
 
 #include "main/io.h"
 #include "main/apic.h"
 #include "main/interrupt.h"
 #include "main/gdt.h"
+#include "main/smp.h"
+
+#include "proc/sched.h"
+#include "proc/kthread.h"
 
 #define MAX_INTERRUPTS          256
 
@@ -372,6 +379,26 @@ int32_t intr_map(uint16_t irq, uint8_t intr)
 static __attribute__((used)) void __intr_handler(regs_t regs)
 {
         intr_handler_t handler = intr_handlers[regs.r_intr];
+#ifdef __SMP__
+        int took;
+
+        /* A shootdown must be answered even by a CPU that is waiting for
+         * the kernel lock, or the CPU holding it would wait forever */
+        if (INTR_IPI_TLB == regs.r_intr) {
+                handler(&regs);
+                return;
+        }
+        /* The lock is already ours if we interrupted the kernel, unless
+         * it was the idle loop */
+        if ((took = !smp_kernel_locked())) {
+                smp_lock_kernel();
+        }
+#endif
+#ifdef __NOHZ__
+        /* If the tick was stopped, bring jiffies up to date before
+         * anything can look at it */
+        time_idle_exit();
+#endif
         _intr_regs = &regs;
         if (NULL != handler) {
                 handler(&regs);
@@ -384,6 +411,31 @@ static __attribute__((used)) void __intr_handler(regs_t regs)
         }
 
         _intr_regs = NULL;
+
+        /* What the handler deferred runs now, with interrupts on, unless
+         * the code we interrupted had some of them masked */
+        if (IPL_LOW == intr_getipl() && work_deferred_pending()) {
+                work_run_deferred();
+        }
+
+        /* Nothing in the kernel was interrupted, so it is safe to switch */
+        if ((regs.r_cs & 0x3) == 0x3) {
+                /* Cancelled from an interrupt, as by alarm(); see do_alarm() */
+                if (curthr->kt_cancelled) {
+                        intr_enable();
+                        kthread_exit(curthr->kt_retval);
+                }
+#ifdef __UPREEMPT__
+                sched_preempt();
+#endif
+        }
+#ifdef __SMP__
+        if (took) {
+                /* iret turns interrupts back on if they were */
+                intr_disable();
+                smp_unlock_kernel();
+        }
+#endif
 }
 
 static void __intr_divide_by_zero_handler(regs_t *regs)
@@ -703,3 +755,12 @@ void intr_init()
         intr_register(INTR_GPF, __intr_gpf_handler);
         intr_register(INTR_INVALID_OPCODE, __intr_inval_opcode_handler);
 }
+
+/* The IDT is shared, so an application processor only has to load it */
+void intr_init_cpu()
+{
+        intr_info_t *data = &intr_data;
+
+        __asm__("lidt (%0)" :: "p"(data));
+        apic_setspur(INTR_SPURIOUS);
+}
@@ -7,6 +7,7 @@
 #include "util/debug.h"
 #include "util/string.h"
 #include "util/printf.h"
+#include "util/workq.h"
 
 #include "mm/mm.h"
 #include "mm/page.h"
@@ -22,6 +23,7 @@
 #include "main/apic.h"
 #include "main/interrupt.h"
 #include "main/gdt.h"
+#include "main/smp.h"
 
 #include "proc/sched.h"
 #include "proc/proc.h"
@@ -86,6 +88,9 @@ kmain()
         intr_init();
 
         gdt_init();
+#ifdef __SMP__
+        smp_init();
+#endif
 
         /* initialize slab allocators */
 #ifdef __VM__
@@ -136,6 +141,7 @@ bootstrap(int arg1, void *arg2)
 
     kthread_t *idle_thr;
     idle_thr = kthread_create(idle_proc, idleproc_run, 0, NULL);
+    kthread_set_kernel_only(idle_thr);
     curthr = idle_thr;
 
     dbg(DBG_THR, "Before context_make_active\n");
@@ -190,6 +196,9 @@ idleproc_run(int arg1, void *arg2)
         /*still need to figure out how to set the vnode for special device*/
         do_mknod("/dev/null", S_IFCHR, MEM_NULL_DEVID);
         do_mknod("/dev/zero", S_IFCHR, MEM_ZERO_DEVID);
+#ifdef __SYSSTATS__
+        do_mknod("/dev/sysstat", S_IFCHR, STAT_SYSSTAT_DEVID);
+#endif
         int nterms = vt_num_terminals();
         int i = 0;
         char *path = "/dev/tty0";
@@ -202,6 +211,9 @@ idleproc_run(int arg1, void *arg2)
         /* Finally, enable interrupts (we want to make sure interrupts
          * are enabled AFTER all drivers are initialized) */
         intr_enable();
+#ifdef __SMP__
+        smp_release_aps();
+#endif
 
         /* Run initproc */
         sched_make_runnable(initthr);
@@ -209,6 +221,9 @@ idleproc_run(int arg1, void *arg2)
         child = do_waitpid(PID_INIT, 0, &status);
         KASSERT(PID_INIT == child);
         dbg(DBG_PROC, "The return value is %d\n", status);
+
+        /* The other daemons wait for any child, so reap the workers first */
+        workq_shutdown();
         
         /*panic("inspect the value\n");*/
 
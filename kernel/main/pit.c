@@ -4,6 +4,9 @@
 #include "main/interrupt.h"
 #include "util/delay.h"
 #include "main/apic.h"
+#include "main/cpuid.h"
+
+#include "util/debug.h"
 
 #include "proc/sched.h"
 #include "proc/kthread.h"
@@ -31,3 +34,88 @@ void pit_handler(regs_t* regs) {
 
 void pit_init(uint8_t intr) {
 }
+
+/* The rate PIT channels count down at */
+#define PIT_HZ          1193182
+
+/* How long, and how many times, to measure the other clocks for */
+#define CALIBRATE_USECS 50000
+#define CALIBRATE_RUNS  3
+
+/*
+ * Starts PIT channel 2 counting down once from usecs microseconds, at
+ * most 55ms as the counter is only 16 bits. Channel 2 only drives the
+ * speaker, which stays off, so it is ours to time things with.
+ */
+static void pit_oneshot_start(uint32_t usecs)
+{
+        uint32_t count = (uint32_t)((uint64_t)usecs * PIT_HZ / 1000000) + 1;
+        uint32_t tmp;
+
+        KASSERT(count <= 0xffff);
+        outb(0x61, (inb(0x61) & 0xfd) | 1);
+        outb(0x43, 0xb2);
+        outb(0x42, count & 0xff);
+        outb(0x42, (count >> 8) & 0xff);
+
+        /* A rising edge on the gate starts the count */
+        tmp = (uint32_t)(inb(0x61) & 0xfe);
+        outb(0x61, (uint8_t)tmp);
+        outb(0x61, (uint8_t)tmp | 1);
+}
+
+static int pit_oneshot_done(void)
+{
+        return 0 != (inb(0x61) & 0x20);
+}
+
+/*
+ * Busy-waits for at least usecs microseconds. For use before the clock
+ * is running.
+ */
+void pit_delay(uint32_t usecs)
+{
+        uint32_t chunk;
+
+        while (usecs > 0) {
+                chunk = (usecs > 50000) ? 50000 : usecs;
+                pit_oneshot_start(chunk);
+                while (!pit_oneshot_done());
+                usecs -= chunk;
+        }
+}
+
+/*
+ * The TSC and the APIC timer are started just after the PIT and stopped
+ * just after it runs out, so each run counts the same stretch of time on
+ * all three. Anything that holds us up while polling the PIT (an SMI, or
+ * the host descheduling an emulator) only makes a run longer, so the
+ * shortest of a few runs is kept.
+ */
+uint64_t pit_calibrate(uint32_t *apic_hz)
+{
+        uint64_t tsc, best_tsc = 0;
+        uint32_t apic, best_apic = 0;
+        int has_tsc = cpuid_has_tsc();
+        int i;
+
+        for (i = 0; i < CALIBRATE_RUNS; i++) {
+                pit_oneshot_start(CALIBRATE_USECS);
+                tsc = has_tsc ? cpuid_rdtsc() : 0;
+                apic_timer_count_start();
+                while (!pit_oneshot_done());
+                apic = apic_timer_count_stop();
+                tsc = has_tsc ? cpuid_rdtsc() - tsc : 0;
+
+                if (0 == i || (has_tsc ? tsc < best_tsc : apic < best_apic)) {
+                        best_tsc = tsc;
+                        best_apic = apic;
+                }
+        }
+
+        *apic_hz = (uint32_t)((uint64_t)best_apic * 1000000 / CALIBRATE_USECS);
+        tsc = has_tsc ? best_tsc * 1000000 / CALIBRATE_USECS : 0;
+        dbg(DBG_CORE, "TSC runs at %u kHz, APIC timer at %u Hz\n",
+            (uint32_t)(tsc / 1000), *apic_hz);
+        return tsc;
+}
@@ -0,0 +1,319 @@
+#include "kernel.h"
+#include "config.h"
+#include "globals.h"
+
+#include "main/apic.h"
+#include "main/gdt.h"
+#include "main/fpu.h"
+#include "main/interrupt.h"
+#include "main/pit.h"
+#include "main/smp.h"
+
+#include "mm/page.h"
+#include "mm/pagetable.h"
+#include "mm/tlb.h"
+
+#include "proc/kthread.h"
+#include "proc/sched.h"
+#include "proc/spinlock.h"
+
+#include "api/syscall.h"
+
+#include "util/debug.h"
+#include "util/string.h"
+#include "util/time.h"
+
+#ifdef __SMP__
+
+/* Where the startup code is copied; a startup IPI names its page */
+#define SMP_TRAMPOLINE  0x7000
+
+cpu_t smp_cpus[NCPUS];
+int smp_ncpus = 1;
+
+/* The application processor being started, and whether they may run */
+static volatile int smp_booting = 0;
+static volatile int smp_released = 0;
+
+static spinlock_t kernel_lock = SPINLOCK_INITIALIZER;
+static volatile int kernel_lock_owner = -1;
+
+/*
+ * An application processor wakes up in real mode at SMP_TRAMPOLINE, so
+ * this is copied there and only ever runs from there; every address in
+ * it is worked out relative to that. It gets into protected mode with
+ * its own flat GDT (whose selectors match the kernel's), turns paging on
+ * with the page directory pt_init() built, which still identity maps
+ * low memory, and jumps into the kernel proper on the stack it was
+ * given. The four slots at the end are filled in by smp_init().
+ */
+#define TRAMP(sym) "(" #sym " - smp_trampoline + " QUOTE(SMP_TRAMPOLINE) ")"
+
+extern char smp_trampoline[], smp_trampoline_end[];
+extern char smp_tramp_cr3[], smp_tramp_cr4[], smp_tramp_stack[], smp_tramp_entry[];
+__asm__(
+        ".pushsection .text\n"
+        ".global smp_trampoline, smp_trampoline_end\n"
+        ".global smp_tramp_cr3, smp_tramp_cr4, smp_tramp_stack, smp_tramp_entry\n"
+        ".code16\n"
+        "smp_trampoline:\n\t"
+        "cli\n\t"
+        "xorw %ax, %ax\n\t"
+        "movw %ax, %ds\n\t"
+        "lgdtl " TRAMP(smp_tramp_gdtr) "\n\t"
+        "movl %cr0, %eax\n\t"
+        "orl $1, %eax\n\t"
+        "movl %eax, %cr0\n\t"
+        "ljmpl $" QUOTE(GDT_KERNEL_TEXT) ", $" TRAMP(smp_tramp_32) "\n"
+        ".code32\n"
+        "smp_tramp_32:\n\t"
+        "movw $" QUOTE(GDT_KERNEL_DATA) ", %ax\n\t"
+        "movw %ax, %ds\n\t"
+        "movw %ax, %es\n\t"
+        "movw %ax, %fs\n\t"
+        "movw %ax, %gs\n\t"
+        "movw %ax, %ss\n\t"
+        "movl " TRAMP(smp_tramp_cr4) ", %eax\n\t"
+        "movl %eax, %cr4\n\t"
+        "movl " TRAMP(smp_tramp_cr3) ", %eax\n\t"
+        "movl %eax, %cr3\n\t"
+        "movl %cr0, %eax\n\t"
+        "orl $0x80000000, %eax\n\t"
+        "movl %eax, %cr0\n\t"
+        "movl " TRAMP(smp_tramp_stack) ", %esp\n\t"
+        "jmp *" TRAMP(smp_tramp_entry) "\n"
+        ".balign 8\n"
+        "smp_tramp_gdt:\n\t"
+        ".quad 0\n\t"
+        ".quad 0x00cf9a000000ffff\n\t"  /* GDT_KERNEL_TEXT */
+        ".quad 0x00cf92000000ffff\n"    /* GDT_KERNEL_DATA */
+        "smp_tramp_gdtr:\n\t"
+        ".word 3 * 8 - 1\n\t"
+        ".long " TRAMP(smp_tramp_gdt) "\n"
+        "smp_tramp_cr3:\n\t.long 0\n"
+        "smp_tramp_cr4:\n\t.long 0\n"
+        "smp_tramp_stack:\n\t.long 0\n"
+        "smp_tramp_entry:\n\t.long 0\n"
+        "smp_trampoline_end:\n"
+        ".code32\n"
+        ".popsection\n"
+);
+
+#define TRAMP_SLOT(sym) \
+        (*(volatile uint32_t *)(SMP_TRAMPOLINE + ((sym) - smp_trampoline)))
+
+static inline uint32_t
+smp_save_flags(void)
+{
+        uint32_t flags;
+        __asm__ volatile("pushfl\n\tpopl %0" : "=r"(flags));
+        return flags;
+}
+
+static inline void
+smp_restore_flags(uint32_t flags)
+{
+        __asm__ volatile("pushl %0\n\tpopfl" :: "r"(flags) : "memory", "cc");
+}
+
+/*
+ * A CPU holding the kernel lock may be waiting for us to flush our TLB,
+ * so do that while we wait for it, in case our interrupts are off.
+ */
+static void
+smp_tlb_ack(cpu_t *cpu)
+{
+        if (cpu->cpu_tlb_pending) {
+                pt_tlb_ack();
+                cpu->cpu_tlb_pending = 0;
+        }
+}
+
+void
+smp_lock_kernel(void)
+{
+        uint32_t flags = smp_save_flags();
+        cpu_t *cpu = smp_cpu();
+
+        intr_disable();
+        KASSERT(kernel_lock_owner != cpu->cpu_id && "the kernel lock is not re-entrant");
+        while (!spinlock_trylock(&kernel_lock)) {
+                smp_tlb_ack(cpu);
+                __asm__ volatile("pause");
+        }
+        kernel_lock_owner = cpu->cpu_id;
+        smp_restore_flags(flags);
+}
+
+void
+smp_unlock_kernel(void)
+{
+        KASSERT(kernel_lock_owner == smp_cpu_id());
+        kernel_lock_owner = -1;
+        spinlock_release(&kernel_lock);
+}
+
+int
+smp_kernel_locked(void)
+{
+        return kernel_lock_owner == smp_cpu_id();
+}
+
+void
+smp_resched_cpu(int cpu)
+{
+        KASSERT(cpu >= 0 && cpu < smp_ncpus);
+        apic_send_ipi(smp_cpus[cpu].cpu_apicid, INTR_IPI_RESCHED);
+}
+
+void
+smp_tlb_flush_cpus(uint32_t mask)
+{
+        int cpu;
+
+        KASSERT(smp_kernel_locked());
+        for (cpu = 0; cpu < smp_ncpus; cpu++) {
+                if ((mask & (1U << cpu)) && cpu != smp_cpu_id()) {
+                        smp_cpus[cpu].cpu_tlb_pending = 1;
+                        apic_send_ipi(smp_cpus[cpu].cpu_apicid, INTR_IPI_TLB);
+                }
+        }
+        for (cpu = 0; cpu < smp_ncpus; cpu++) {
+                while (smp_cpus[cpu].cpu_tlb_pending) {
+                        __asm__ volatile("pause");
+                }
+        }
+}
+
+/* The sender has already put work on our run queue; see sched_kick() */
+static void
+smp_resched_ipi(regs_t *regs)
+{
+        apic_eoi();
+}
+
+/* Runs without the kernel lock; see __intr_handler() */
+static void
+smp_tlb_ipi(regs_t *regs)
+{
+        smp_tlb_ack(smp_cpu());
+        apic_eoi();
+}
+
+/*
+ * Where an application processor comes out of the trampoline. It has a
+ * stack of its own but nothing else, and must not touch anything shared
+ * until it has the kernel lock.
+ */
+static void
+smp_ap_entry(void)
+{
+        cpu_t *cpu = &smp_cpus[smp_booting];
+
+        gdt_load_cpu(cpu->cpu_id);
+        KASSERT(cpu == smp_cpu());
+        cpu->cpu_online = 1;
+
+        while (!smp_released) {
+                __asm__ volatile("pause");
+        }
+        smp_lock_kernel();
+
+        intr_init_cpu();
+        apic_init_cpu();
+        pt_init_cpu();
+        syscall_init_cpu();
+        time_init_cpu();
+        fpu_init_cpu();
+
+        KASSERT(NULL != cpu->cpu_idle);
+        curthr = cpu->cpu_idle;
+        curproc = curthr->kt_proc;
+        dbg(DBG_CORE, "cpu %d (apic 0x%x) is running\n", cpu->cpu_id, cpu->cpu_apicid);
+        context_make_active(&curthr->kt_ctx);
+
+        panic("\nReturned to smp_ap_entry()!!!\n");
+}
+
+void
+smp_init(void)
+{
+        const uint8_t *ids;
+        int n, i, wait;
+        uint32_t cr;
+        cpu_t *cpu;
+        void *stack;
+
+        /* The boot CPU runs the rest of the boot with it */
+        smp_lock_kernel();
+
+        n = apic_cpus(&ids);
+        smp_cpus[0].cpu_id = 0;
+        smp_cpus[0].cpu_apicid = ids[0];
+        smp_cpus[0].cpu_online = 1;
+
+        intr_register(INTR_IPI_RESCHED, smp_resched_ipi);
+        intr_register(INTR_IPI_TLB, smp_tlb_ipi);
+
+        if (n < 2) {
+                return;
+        }
+
+        memcpy((void *)SMP_TRAMPOLINE, smp_trampoline, smp_trampoline_end - smp_trampoline);
+        __asm__ volatile("movl %%cr3, %0" : "=r"(cr));
+        TRAMP_SLOT(smp_tramp_cr3) = cr;
+        __asm__ volatile("movl %%cr4, %0" : "=r"(cr));
+        TRAMP_SLOT(smp_tramp_cr4) = cr;
+        TRAMP_SLOT(smp_tramp_entry) = (uint32_t)smp_ap_entry;
+
+        /* One at a time, so each knows which it is from smp_booting */
+        for (i = 1; i < n; i++) {
+                cpu = &smp_cpus[smp_ncpus];
+                cpu->cpu_id = smp_ncpus;
+                cpu->cpu_apicid = ids[i];
+
+                stack = page_alloc();
+                KASSERT(NULL != stack && "Ran out of memory while booting.");
+                TRAMP_SLOT(smp_tramp_stack) = (uint32_t)stack + PAGE_SIZE;
+                smp_booting = cpu->cpu_id;
+
+                /* The INIT, startup, startup dance from the MP spec */
+                apic_send_init(cpu->cpu_apicid);
+                pit_delay(10000);
+                apic_send_startup(cpu->cpu_apicid, SMP_TRAMPOLINE);
+                pit_delay(200);
+                if (!cpu->cpu_online) {
+                        apic_send_startup(cpu->cpu_apicid, SMP_TRAMPOLINE);
+                }
+                for (wait = 0; wait < 100 && !cpu->cpu_online; wait++) {
+                        pit_delay(1000);
+                }
+
+                if (cpu->cpu_online) {
+                        smp_ncpus++;
+                } else {
+                        dbg(DBG_CORE, "cpu with apic 0x%x did not start\n", cpu->cpu_apicid);
+                        page_free(stack);
+                }
+        }
+        dbg(DBG_CORE, "%d cpus online\n", smp_ncpus);
+}
+
+void
+smp_release_aps(void)
+{
+        kthread_t *idle;
+        int cpu;
+
+        for (cpu = 0; cpu < smp_ncpus; cpu++) {
+                idle = kthread_create(curproc, sched_idle, cpu, NULL);
+                KASSERT(NULL != idle);
+                kthread_set_kernel_only(idle);
+                idle->kt_state = KT_RUN;
+                idle->kt_cpu = cpu;
+                smp_cpus[cpu].cpu_idle = idle;
+        }
+        smp_released = 1;
+}
+
+#endif /* __SMP__ */
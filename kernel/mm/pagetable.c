@@ -6,6 +6,7 @@
 #include "globals.h"
 
 #include "main/interrupt.h"
+#include "main/smp.h"
 
 #include "mm/mm.h"
 #include "mm/page.h"
@@ -41,9 +42,10 @@ struct pagedir {
 #define vaddr_to_offset(vaddr) \
         (((uint32_t)(vaddr)) & (~PAGE_MASK))
 
-/* the virtual address of the page directory in cr3 */
-static pagedir_t *current_pagedir = NULL;
+/* the virtual address of the page directory in each CPU's cr3 */
+static pagedir_t *current_pagedir[NCPUS];
 static pagedir_t *template_pagedir = NULL;
+static pagedir_t *boot_pagedir = NULL;
 
 static uint32_t phys_map_count = 1;
 static pte_t *final_page;
@@ -85,7 +87,7 @@ pt_virt_to_phys(uintptr_t vaddr)
         uint32_t entry = vaddr_to_ptindex(vaddr);
         uint32_t offset = vaddr_to_offset(vaddr);
 
-        pte_t *pagetable = (pte_t *)pt_phys_tmp_map(current_pagedir->pd_physical[table] & PAGE_MASK);
+        pte_t *pagetable = (pte_t *)pt_phys_tmp_map(current_pagedir[smp_cpu_id()]->pd_physical[table] & PAGE_MASK);
         uintptr_t page = pagetable[entry] & PAGE_MASK;
         return page + offset;
 }
@@ -94,14 +96,87 @@ void
 pt_set(pagedir_t *pd)
 {
         uintptr_t pdir = pt_virt_to_phys((uintptr_t)pd->pd_physical);
-        current_pagedir = pd;
+        current_pagedir[smp_cpu_id()] = pd;
         __asm__ volatile("movl %0, %%cr3" :: "r"(pdir) : "memory");
 }
 
+#ifdef __SMP__
+/*
+ * Other CPUs may still have entries for pd in their TLBs. Only those
+ * running on pd right now can, as loading cr3 flushes everything else.
+ */
+static void
+pt_shootdown(pagedir_t *pd)
+{
+        uint32_t mask = 0;
+        int cpu;
+
+        for (cpu = 0; cpu < smp_ncpus; cpu++) {
+                if (cpu != smp_cpu_id() && current_pagedir[cpu] == pd) {
+                        mask |= 1U << cpu;
+                }
+        }
+        if (0 != mask) {
+                smp_tlb_flush_cpus(mask);
+        }
+}
+
+/* The page directory being destroyed, while the CPUs still on it leave it */
+static pagedir_t *volatile pt_evicting = NULL;
+
+void
+pt_tlb_ack(void)
+{
+        if (NULL != pt_evicting && pt_evicting == current_pagedir[smp_cpu_id()]) {
+                pt_set(boot_pagedir);
+        } else {
+                tlb_flush_all();
+        }
+}
+#else
+#define pt_shootdown(pd) do { } while (0)
+#endif
+
+/*
+ * A CPU running a kernel-only thread stays on whatever page directory it
+ * had loaded (see context.h), which may belong to a process that has
+ * since been reaped. Every CPU still on pd is moved to boot_pagedir,
+ * which maps the kernel just the same, before pd is freed.
+ */
+static void
+pt_evict(pagedir_t *pd)
+{
+#ifdef __SMP__
+        uint32_t mask = 0;
+        int cpu;
+
+        for (cpu = 0; cpu < smp_ncpus; cpu++) {
+                if (cpu != smp_cpu_id() && current_pagedir[cpu] == pd) {
+                        mask |= 1U << cpu;
+                }
+        }
+        if (0 != mask) {
+                pt_evicting = pd;
+                smp_tlb_flush_cpus(mask);
+                pt_evicting = NULL;
+        }
+#endif
+        if (current_pagedir[smp_cpu_id()] == pd) {
+                pt_set(boot_pagedir);
+        }
+}
+
+/* An application processor starts out on the page directory pt_init() built */
+void
+pt_init_cpu(void)
+{
+        current_pagedir[smp_cpu_id()] = boot_pagedir;
+}
+
 pagedir_t *
 pt_get(void)
 {
-        return current_pagedir;
+        return current_pagedir[smp_cpu_id()];
 }
 
 int
@@ -149,6 +224,12 @@ pt_unmap(pagedir_t *pd, uintptr_t vaddr)
 
                 index = vaddr_to_ptindex(vaddr);
                 pt[index] = 0;
+                /* A kernel-only thread may be borrowing pd (see context.h),
+                 * and switching back to pd's process will not reload cr3 */
+                if (pd == pt_get()) {
+                        tlb_flush(vaddr);
+                }
+                pt_shootdown(pd);
         }
 }
 
@@ -185,8 +266,100 @@ pt_unmap_range(pagedir_t *pd, uintptr_t vlow, uintptr_t vhigh)
                         pd->pd_physical[i] = 0;
                 }
         }
+        pt_shootdown(pd);
+}
+
+
+/*
+ * The page tables of a reserved range are shared by every page directory,
+ * so they must be in place before the template is copied. The boot page
+ * directory gets them too, for the application processors.
+ */
+int
+pt_kmap_reserve(uintptr_t vlow, uintptr_t vhigh)
+{
+        pagedir_t *pd = current_pagedir[smp_cpu_id()];
+        uint32_t i;
+        pte_t *pt;
+
+        KASSERT(NULL == template_pagedir);
+        KASSERT(0 == vlow % PT_VADDR_SIZE && 0 == vhigh % PT_VADDR_SIZE);
+        KASSERT(USER_MEM_HIGH <= vlow && vlow < vhigh);
+        KASSERT(vaddr_to_pdindex(vhigh - 1) < PT_ENTRY_COUNT - 1);
+
+        for (i = vaddr_to_pdindex(vlow); i <= vaddr_to_pdindex(vhigh - 1); ++i) {
+                if (PT_PRESENT & pd->pd_physical[i]) {
+                        return -EEXIST;
+                }
+        }
+        for (i = vaddr_to_pdindex(vlow); i <= vaddr_to_pdindex(vhigh - 1); ++i) {
+                if (NULL == (pt = page_alloc())) {
+                        return -ENOMEM;
+                }
+                memset(pt, 0, PAGE_SIZE);
+                pd->pd_physical[i] = pt_virt_to_phys((uintptr_t)pt) | PD_PRESENT | PD_WRITE;
+                pd->pd_virtual[i] = (uintptr_t *)pt;
+        }
+        return 0;
+}
+
+int
+pt_kmap_pages(uintptr_t vaddr, uint32_t npages)
+{
+        pagedir_t *pd = current_pagedir[smp_cpu_id()];
+        uint32_t i;
+        pte_t *pt;
+        void *page;
+
+        KASSERT(PAGE_ALIGNED(vaddr) && USER_MEM_HIGH <= vaddr);
+
+        for (i = 0; i < npages; ++i, vaddr += PAGE_SIZE) {
+                KASSERT(PT_PRESENT & pd->pd_physical[vaddr_to_pdindex(vaddr)]);
+                pt = (pte_t *)pd->pd_virtual[vaddr_to_pdindex(vaddr)];
+                KASSERT(!(PT_PRESENT & pt[vaddr_to_ptindex(vaddr)]));
+
+                if (NULL == (page = page_alloc())) {
+                        pt_kunmap_pages(vaddr - i * PAGE_SIZE, i);
+                        return -ENOMEM;
+                }
+                pt[vaddr_to_ptindex(vaddr)] = pt_virt_to_phys((uintptr_t)page) | PT_PRESENT | PT_WRITE;
+        }
+        return 0;
 }
 
+/*
+ * Every CPU may have the pages in its TLB, whatever page directory it is
+ * on, so they are only freed once all of them have let go. That is done
+ * a batch at a time, to keep what we remember of them off the stack.
+ */
+#define PT_KUNMAP_BATCH 16
+
+void
+pt_kunmap_pages(uintptr_t vaddr, uint32_t npages)
+{
+        pagedir_t *pd = current_pagedir[smp_cpu_id()];
+        uintptr_t paddr[PT_KUNMAP_BATCH];
+        uint32_t i, n;
+        pte_t *pt;
+
+        KASSERT(PAGE_ALIGNED(vaddr) && USER_MEM_HIGH <= vaddr);
+
+        for (; npages > 0; npages -= n, vaddr += n * PAGE_SIZE) {
+                n = MIN(npages, PT_KUNMAP_BATCH);
+                for (i = 0; i < n; ++i) {
+                        pt = (pte_t *)pd->pd_virtual[vaddr_to_pdindex(vaddr + i * PAGE_SIZE)];
+                        paddr[i] = pt[vaddr_to_ptindex(vaddr + i * PAGE_SIZE)] & PAGE_MASK;
+                        pt[vaddr_to_ptindex(vaddr + i * PAGE_SIZE)] = 0;
+                }
+                tlb_flush_range(vaddr, n);
+#ifdef __SMP__
+                smp_tlb_flush_cpus(~0U);
+#endif
+                for (i = 0; i < n; ++i) {
+                        page_free((void *)(paddr[i] - KERNEL_PHYS_BASE + (uintptr_t)&kernel_start));
+                }
+        }
+}
 
 pagedir_t *
 pt_create_pagedir()
@@ -217,6 +390,7 @@ pt_destroy_pagedir(pagedir_t *pdir)
                         page_free(pdir->pd_virtual[i]);
                 }
         }
+        pt_evict(pdir);
         page_free_n(pdir, 2);
 }
 
@@ -300,7 +474,7 @@ pt_init(void)
         _pt_fill_page(pagedir, pagetable, PD_PRESENT | PD_WRITE, PT_PRESENT | PT_WRITE,
                       (uintptr_t)&kernel_start, KERNEL_PHYS_BASE);
 
-        current_pagedir = pagedir;
+        current_pagedir[smp_cpu_id()] = boot_pagedir = pagedir;
         /* swap the temporary page table with our identical, but more
          * permanant page table */
         pt_set(pagedir);
@@ -328,12 +502,12 @@ pt_template_init()
          * the pt_init function above, it needs to be slighly modified
          * to remove the mapping of the first 4mb and then saved in a
          * seperate page as the template */
-        memset(current_pagedir->pd_virtual[0], 0, PAGE_SIZE);
+        memset(current_pagedir[smp_cpu_id()]->pd_virtual[0], 0, PAGE_SIZE);
         tlb_flush_all();
 
         template_pagedir = page_alloc_n(2);
         KASSERT(NULL != template_pagedir);
-        memcpy(template_pagedir, current_pagedir, sizeof(*template_pagedir));
+        memcpy(template_pagedir, current_pagedir[smp_cpu_id()], sizeof(*template_pagedir));
 
         intr_register(INTR_PAGE_FAULT, _pt_fault_handler);
 }
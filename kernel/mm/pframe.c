@@ -644,7 +644,9 @@ pageoutd_init(void)
         KASSERT(NULL != pageoutd);
         pageoutd_thr = kthread_create(pageoutd, pageoutd_run, 0, NULL);
         KASSERT(NULL != pageoutd_thr);
+        kthread_set_kernel_only(pageoutd_thr);
 
+        sched_set_fixed_prio(pageoutd_thr, SCHED_PRIO_PAGEOUTD);
         sched_make_runnable(pageoutd_thr);
 }
 init_func(pageoutd_init);
@@ -12,6 +12,32 @@
 
 #include "util/debug.h"
 
+static uint32_t context_pd_loads = 0;
+static uint32_t context_pd_kept = 0;
+
+/*
+ * A context with no page directory of its own runs on whichever one is
+ * loaded already, and a context whose page directory is loaded already
+ * need not load it again; either way the TLB survives the switch.
+ */
+static void
+context_load_pagedir(context_t *c)
+{
+        if (NULL == c->c_pdptr || c->c_pdptr == pt_get()) {
+                context_pd_kept++;
+        } else {
+                context_pd_loads++;
+                pt_set(c->c_pdptr);
+        }
+}
+
+void
+context_pagedir_stats(uint32_t *loads, uint32_t *kept)
+{
+        *loads = context_pd_loads;
+        *kept = context_pd_kept;
+}
+
 static void
 __context_initial_func(context_func_t func, int arg1, void *arg2)
 {
@@ -56,7 +82,7 @@ void
 context_make_active(context_t *c)
 {
         gdt_set_kernel_stack((void *)((uintptr_t)c->c_kstack + c->c_kstacksz));
-        pt_set(c->c_pdptr);
+        context_load_pagedir(c);
 
         /* Switch stacks and run the thread */
         __asm__ volatile(
@@ -72,7 +98,7 @@ void
 context_switch(context_t *oldc, context_t *newc)
 {
         gdt_set_kernel_stack((void *)((uintptr_t)newc->c_kstack + newc->c_kstacksz));
-        pt_set(newc->c_pdptr);
+        context_load_pagedir(newc);
 
         /*
          * Save the current value of the stack pointer and the frame pointer into
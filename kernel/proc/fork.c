@@ -16,6 +16,7 @@
 #include "mm/pagetable.h"
 #include "mm/tlb.h"
 
+#include "fs/fdtable.h"
 #include "fs/file.h"
 #include "fs/vnode.h"
 
@@ -23,6 +24,7 @@
 #include "vm/vmmap.h"
 
 #include "api/exec.h"
+#include "api/kdata.h"
 
 #include "main/interrupt.h"
 
@@ -154,7 +156,11 @@ do_fork(struct regs *regs)
     /*bulletin 1*/
     /*bulletin 7 set up p_cwd is also handled by proc_create*/
     proc_t *newproc = proc_create(curproc->p_comm);
-    KASSERT(newproc != NULL);
+    if (newproc == NULL) {
+        /*out of pids; the parent keeps its new shadow objects*/
+        vmmap_destroy(newmap);
+        return -EAGAIN;
+    }
     /**2** p_threads*/
     /**3** p_brk, p_start_brk*/
 
@@ -165,16 +171,16 @@ do_fork(struct regs *regs)
     /**1** DONE*/
     newmap->vmm_proc = newproc;
     newproc->p_vmmap = newmap;
+    /*the child's copy of the kernel data page shows its own pid*/
+    kdata_set_pid(newmap, newproc->p_pid);
 
     /*bulletin 6*/
-    int i = 0;
-    for (i = 0 ; i < NFILES ; i++) {
-        if (curproc->p_files[i]) {
-            newproc->p_files[i] = curproc->p_files[i];
-            fref(newproc->p_files[i]);
-        } else {
-            KASSERT(newproc->p_files[i] == NULL);
-        }
+    /*only the populated parts of the table are walked*/
+    int err = fdtable_copy(newproc, curproc);
+    if (err < 0) {
+        /*the child has no threads yet, so it can just be thrown away*/
+        proc_discard(newproc);
+        return err;
     }
 
     /*bulletin 8*/
@@ -1,11 +1,16 @@
 #include "globals.h"
 #include "errno.h"
 
+#include "main/cpuid.h"
+
 #include "util/debug.h"
 
 #include "proc/kthread.h"
 #include "proc/kmutex.h"
 
+/* Here it is the function itself; see kmutex.h */
+#undef kmutex_init
+
 /*
  * IMPORTANT: Mutexes can _NEVER_ be locked or unlocked from an
  * interrupt context. Mutexes are _ONLY_ lock or unlocked from a
@@ -17,6 +22,9 @@ kmutex_init(kmutex_t *mtx)
 {
     sched_queue_init(&mtx->km_waitq);
     mtx->km_holder = NULL;
+#ifdef __LOCKSTATS__
+    mtx->km_class = NULL;
+#endif
 
         /*NOT_YET_IMPLEMENTED("PROCS: kmutex_init");*/
 }
@@ -30,12 +38,21 @@ kmutex_init(kmutex_t *mtx)
 void
 kmutex_lock(kmutex_t *mtx)
 {
+#ifdef __LOCKSTATS__
+    uint64_t wait_start = 0;
+#endif
     if (NULL == mtx->km_holder) {
         mtx->km_holder = curthr;
     } else {
+#ifdef __LOCKSTATS__
+        wait_start = cpuid_rdtsc();
+#endif
         sched_sleep_on(&mtx->km_waitq);
     }
     KASSERT(mtx->km_holder = curthr);
+#ifdef __LOCKSTATS__
+    lockstat_acquired(mtx->km_class, wait_start);
+#endif
 
         /*NOT_YET_IMPLEMENTED("PROCS: kmutex_lock");*/
 }
@@ -47,11 +64,23 @@ kmutex_lock(kmutex_t *mtx)
 int
 kmutex_lock_cancellable(kmutex_t *mtx)
 {
+#ifdef __LOCKSTATS__
+    uint64_t wait_start;
+#endif
     if (NULL == mtx->km_holder) {
         mtx->km_holder = curthr;
+#ifdef __LOCKSTATS__
+        lockstat_acquired(mtx->km_class, 0);
+#endif
         return 0;
     } else {
+#ifdef __LOCKSTATS__
+        wait_start = cpuid_rdtsc();
+#endif
         if (0 == sched_cancellable_sleep_on(&mtx->km_waitq)) {
+#ifdef __LOCKSTATS__
+            lockstat_acquired(mtx->km_class, wait_start);
+#endif
             return 0;
         } else {
             return EINTR;
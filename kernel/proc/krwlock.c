@@ -0,0 +1,174 @@
+#include "globals.h"
+#include "errno.h"
+
+#include "main/cpuid.h"
+
+#include "util/debug.h"
+
+#include "proc/kthread.h"
+#include "proc/krwlock.h"
+
+/* Here it is the function itself; see krwlock.h */
+#undef krwlock_init
+
+/*
+ * Unlike kmutex_unlock(), unlocking does not hand the lock to the thread
+ * it wakes; a woken thread looks again, and sleeps again if it lost out.
+ * That way a thread whose sleep is cancelled never finds itself holding
+ * the lock by surprise, and readers can all be let in at once. A thread
+ * cancelled while it waits, even for krwlock_wrlock(), leaves the lock
+ * as though it had never asked for it before it exits.
+ *
+ * A writer counts in krw_writers from when it starts waiting until it
+ * unlocks, and readers wait for that to be 0, which is what gives
+ * writers preference.
+ */
+
+void
+krwlock_init(krwlock_t *rw)
+{
+        sched_queue_init(&rw->krw_rdq);
+        sched_queue_init(&rw->krw_wrq);
+        rw->krw_readers = 0;
+        rw->krw_writers = 0;
+        rw->krw_writer = NULL;
+#ifdef __LOCKSTATS__
+        rw->krw_class = NULL;
+#endif
+}
+
+/*
+ * The sleep is cancellable even when the caller is not. sched_sleep_on()
+ * would have a cancelled thread exit as soon as it was woken, before a
+ * waiting writer could take itself out of krw_writers or pass on the
+ * wakeup it may have been given. Instead the caller puts the lock right
+ * first, then calls krwlock_cancelled().
+ */
+static int
+krwlock_sleep(ktqueue_t *q)
+{
+        return sched_cancellable_sleep_on(q);
+}
+
+/* What sched_sleep_on() would have done, now that the lock is consistent */
+static int
+krwlock_cancelled(int cancellable, int err)
+{
+        if (!cancellable) {
+                kthread_exit(curthr->kt_retval);
+        }
+        return err;
+}
+
+/* With nothing holding it, lets in the next writer, or else every reader */
+static void
+krwlock_wake(krwlock_t *rw)
+{
+        if (rw->krw_writers > 0) {
+                sched_wakeup_on(&rw->krw_wrq);
+        } else {
+                sched_broadcast_on(&rw->krw_rdq);
+        }
+}
+
+static int
+krwlock_rdlock_common(krwlock_t *rw, int cancellable)
+{
+#ifdef __LOCKSTATS__
+        uint64_t wait_start = 0;
+#endif
+        int err;
+
+        while (rw->krw_writers > 0) {
+#ifdef __LOCKSTATS__
+                if (0 == wait_start) {
+                        wait_start = cpuid_rdtsc();
+                }
+#endif
+                if ((err = krwlock_sleep(&rw->krw_rdq)) < 0) {
+                        return krwlock_cancelled(cancellable, err);
+                }
+        }
+        rw->krw_readers++;
+#ifdef __LOCKSTATS__
+        lockstat_acquired(rw->krw_class, wait_start);
+#endif
+        return 0;
+}
+
+static int
+krwlock_wrlock_common(krwlock_t *rw, int cancellable)
+{
+#ifdef __LOCKSTATS__
+        uint64_t wait_start = 0;
+#endif
+        int err;
+
+        KASSERT(rw->krw_writer != curthr && "krwlocks are not re-entrant");
+        rw->krw_writers++;
+        while (NULL != rw->krw_writer || rw->krw_readers > 0) {
+#ifdef __LOCKSTATS__
+                if (0 == wait_start) {
+                        wait_start = cpuid_rdtsc();
+                }
+#endif
+                if ((err = krwlock_sleep(&rw->krw_wrq)) < 0) {
+                        /* Readers may have been waiting only for us, or
+                         * we may have been woken to take it */
+                        rw->krw_writers--;
+                        if (NULL == rw->krw_writer && 0 == rw->krw_readers) {
+                                krwlock_wake(rw);
+                        } else if (0 == rw->krw_writers) {
+                                sched_broadcast_on(&rw->krw_rdq);
+                        }
+                        return krwlock_cancelled(cancellable, err);
+                }
+        }
+        rw->krw_writer = curthr;
+#ifdef __LOCKSTATS__
+        lockstat_acquired(rw->krw_class, wait_start);
+#endif
+        return 0;
+}
+
+void
+krwlock_rdlock(krwlock_t *rw)
+{
+        krwlock_rdlock_common(rw, 0);
+}
+
+int
+krwlock_rdlock_cancellable(krwlock_t *rw)
+{
+        return krwlock_rdlock_common(rw, 1);
+}
+
+void
+krwlock_wrlock(krwlock_t *rw)
+{
+        krwlock_wrlock_common(rw, 0);
+}
+
+int
+krwlock_wrlock_cancellable(krwlock_t *rw)
+{
+        return krwlock_wrlock_common(rw, 1);
+}
+
+void
+krwlock_rdunlock(krwlock_t *rw)
+{
+        KASSERT(rw->krw_readers > 0 && NULL == rw->krw_writer);
+        if (0 == --rw->krw_readers) {
+                krwlock_wake(rw);
+        }
+}
+
+void
+krwlock_wrunlock(krwlock_t *rw)
+{
+        KASSERT(curthr == rw->krw_writer);
+        rw->krw_writer = NULL;
+        rw->krw_writers--;
+        krwlock_wake(rw);
+}
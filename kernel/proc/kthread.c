@@ -12,12 +12,43 @@
 #include "proc/proc.h"
 #include "proc/sched.h"
 
+#include "mm/mm.h"
 #include "mm/slab.h"
 #include "mm/page.h"
+#include "mm/pagetable.h"
 
+#include "main/fpu.h"
+
+#ifndef __SMP__
 kthread_t *curthr; /* global */
+#endif
 static slab_allocator_t *kthread_allocator = NULL;
 
+/*
+ * Kernel stacks are mapped a page at a time into slots of the stack area,
+ * so they need not be physically contiguous, with an unmapped guard page
+ * below each one. A stack that overflows faults on its guard page rather
+ * than quietly writing over whatever memory lies below it. (The fault
+ * cannot be handled on the stack that overflowed, so it ends in a triple
+ * fault, but that is easier to track down.) Each stack has a page above
+ * the top for "magic" data, as it always has.
+ *
+ * Only when every slot is taken does a stack come straight from the page
+ * allocator instead, as one physically contiguous block with no guard.
+ * Either way, up to KSTACK_CACHE freed stacks are kept, still mapped, for
+ * the next threads to be created, so that creating and destroying threads
+ * in quick succession (every fork and exit) need not touch the page
+ * allocator or the page tables at all.
+ */
+#define KSTACK_PAGES    (1 + (DEFAULT_STACK_SIZE >> PAGE_SHIFT))
+#define KSTACK_SLOT     ((KSTACK_PAGES + 1) * PAGE_SIZE)
+#define KSTACK_SLOTS    ((KSTACK_MEM_HIGH - KSTACK_MEM_LOW) / KSTACK_SLOT)
+
+static int kstack_area = 0;                     /* if the stack area was reserved */
+static uint32_t kstack_slots[KSTACK_SLOTS / 32];        /* bitmap of slots in use */
+static char *kstack_cache = NULL;               /* linked through their first words */
+static int kstack_ncached = 0;
+
 #ifdef __MTP__
 /* Stuff for the reaper daemon, which cleans up dead detached threads */
 static proc_t *reapd = NULL;
@@ -33,6 +64,38 @@ kthread_init()
 {
         kthread_allocator = slab_allocator_create("kthread", sizeof(kthread_t));
         KASSERT(NULL != kthread_allocator);
+
+        /* Fails only if there is so much memory that its direct map reaches this far */
+        if (0 == pt_kmap_reserve(KSTACK_MEM_LOW, KSTACK_MEM_HIGH)) {
+                kstack_area = 1;
+        } else {
+                dbg(DBG_THR, "no room for the kernel stack area, stacks will have no guard pages\n");
+        }
+}
+
+/* Returns a free slot of the stack area and marks it used, or -1 */
+static int
+kstack_slot_alloc(void)
+{
+        uint32_t i, bit;
+
+        for (i = 0; i < KSTACK_SLOTS / 32; i++) {
+                if (0xffffffff != kstack_slots[i]) {
+                        for (bit = 0; kstack_slots[i] & (1U << bit); bit++) {
+                                ;
+                        }
+                        kstack_slots[i] |= 1U << bit;
+                        return i * 32 + bit;
+                }
+        }
+        return -1;
+}
+
+static void
+kstack_slot_free(int slot)
+{
+        KASSERT(kstack_slots[slot / 32] & (1U << (slot % 32)));
+        kstack_slots[slot / 32] &= ~(1U << (slot % 32));
 }
 
 /**
@@ -44,12 +107,26 @@ kthread_init()
 static char *
 alloc_stack(void)
 {
-        /* extra page for "magic" data */
         char *kstack;
-        int npages = 1 + (DEFAULT_STACK_SIZE >> PAGE_SHIFT);
-        kstack = (char *)page_alloc_n(npages);
+        int slot;
+
+        if (NULL != (kstack = kstack_cache)) {
+                kstack_cache = *(char **)kstack;
+                kstack_ncached--;
+                return kstack;
+        }
+
+        if (kstack_area && 0 <= (slot = kstack_slot_alloc())) {
+                kstack = (char *)KSTACK_MEM_LOW + slot * KSTACK_SLOT + PAGE_SIZE;
+                if (0 > pt_kmap_pages((uintptr_t)kstack, KSTACK_PAGES)) {
+                        kstack_slot_free(slot);
+                        return NULL;
+                }
+                return kstack;
+        }
 
-        return kstack;
+        /* extra page for "magic" data */
+        return (char *)page_alloc_n(KSTACK_PAGES);
 }
 
 /**
@@ -60,7 +137,18 @@ alloc_stack(void)
 static void
 free_stack(char *stack)
 {
-        page_free_n(stack, 1 + (DEFAULT_STACK_SIZE >> PAGE_SHIFT));
+        uintptr_t addr = (uintptr_t)stack;
+
+        if (kstack_ncached < KSTACK_CACHE) {
+                *(char **)stack = kstack_cache;
+                kstack_cache = stack;
+                kstack_ncached++;
+        } else if (KSTACK_MEM_LOW <= addr && addr < KSTACK_MEM_HIGH) {
+                pt_kunmap_pages(addr, KSTACK_PAGES);
+                kstack_slot_free((addr - KSTACK_MEM_LOW) / KSTACK_SLOT);
+        } else {
+                page_free_n(stack, KSTACK_PAGES);
+        }
 }
 
 /*
@@ -103,6 +191,15 @@ kthread_create(struct proc *p, kthread_func_t func, long arg1, void *arg2)
     /*not sure about the thread state init value*/
 
     kthread_struct->kt_wchan = NULL;
+    kthread_struct->kt_quantum = SCHED_QUANTUM_TICKS;
+    kthread_struct->kt_prio = SCHED_PRIO_USER;
+    kthread_struct->kt_nice = 0;
+    kthread_struct->kt_penalty = 0;
+    kthread_struct->kt_fixed = 0;
+    kthread_struct->kt_cpu = 0;
+    memset(&kthread_struct->kt_usage, 0, sizeof(kt_usage_t));
+    kthread_struct->kt_runnable_ns = 0;
+    kthread_struct->kt_fpu = NULL;
     
     list_link_init(&kthread_struct->kt_qlink);
     list_link_init(&kthread_struct->kt_plink);
@@ -116,11 +213,20 @@ kthread_create(struct proc *p, kthread_func_t func, long arg1, void *arg2)
         /*NOT_YET_IMPLEMENTED("PROCS: kthread_create");*/
 }
 
+void
+kthread_set_kernel_only(kthread_t *thr)
+{
+        KASSERT(KT_NO_STATE == thr->kt_state);
+        thr->kt_ctx.c_pdptr = NULL;
+}
+
 void
 kthread_destroy(kthread_t *t)
 {
-        KASSERT(t && t->kt_kstack);
+        KASSERT(t && t->kt_kstack && t->kt_ctx.c_kstack);
         free_stack(t->kt_kstack);
+        free_stack((char *)t->kt_ctx.c_kstack);
+        fpu_release(t);
         if (list_link_is_linked(&t->kt_plink))
                 list_remove(&t->kt_plink);
 
@@ -211,6 +317,7 @@ kthread_clone(kthread_t *thr)
     newthr->kt_state = thr->kt_state;
     /*it's gonna be made runnable soon*/
 
+    /*set before sched_set_nice, which looks at whether it is queued*/
     newthr->kt_wchan = thr->kt_wchan;
     /*assert for now, just my assumption*/
     KASSERT(newthr->kt_wchan == NULL);
@@ -218,6 +325,20 @@ kthread_clone(kthread_t *thr)
     list_link_init(&newthr->kt_qlink);
     list_link_init(&newthr->kt_plink);
 
+    newthr->kt_quantum = SCHED_QUANTUM_TICKS;
+    /*a child starts out with its parent's niceness but a clean slate*/
+    newthr->kt_prio = SCHED_PRIO_USER;
+    newthr->kt_nice = 0;
+    newthr->kt_penalty = 0;
+    newthr->kt_fixed = 0;
+    newthr->kt_cpu = thr->kt_cpu;
+    /*and none of its parent's CPU time*/
+    memset(&newthr->kt_usage, 0, sizeof(kt_usage_t));
+    newthr->kt_runnable_ns = 0;
+    sched_set_nice(newthr, thr->kt_nice);
+    /*and a copy of its FPU registers*/
+    fpu_fork(newthr, thr);
+
     return newthr;
         /*NOT_YET_IMPLEMENTED("VM: kthread_clone");*/
         /*return NULL;*/
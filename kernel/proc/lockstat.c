@@ -0,0 +1,80 @@
+#include "kernel.h"
+#include "config.h"
+
+#include "main/cpuid.h"
+
+#include "proc/lockstat.h"
+
+#include "util/debug.h"
+
+#ifdef __LOCKSTATS__
+
+/*
+ * Classes live in static storage at the places their locks are
+ * initialized, and are only ever added to this list. Nothing here runs
+ * from an interrupt, and the kernel does not switch threads in the
+ * middle of it, so it needs no locking of its own.
+ */
+static lock_class_t *lock_classes = NULL;
+
+void
+lockstat_register(lock_class_t *lc)
+{
+        if (!lc->lc_registered) {
+                lc->lc_registered = 1;
+                lc->lc_next = lock_classes;
+                lock_classes = lc;
+        }
+        lc->lc_locks++;
+}
+
+void
+lockstat_acquired(lock_class_t *lc, uint64_t wait_start)
+{
+        uint64_t wait;
+
+        if (NULL == lc) {
+                return;
+        }
+        lc->lc_acquired++;
+        if (0 != wait_start) {
+                wait = cpuid_rdtsc() - wait_start;
+                lc->lc_contended++;
+                lc->lc_wait += wait;
+                lc->lc_max_wait = MAX(lc->lc_max_wait, wait);
+        }
+}
+
+/* An insertion sort of the list in place; there are only a few dozen */
+lock_class_t *
+lockstat_sorted(void)
+{
+        lock_class_t *sorted = NULL, *lc, *next, **pos;
+
+        for (lc = lock_classes; NULL != lc; lc = next) {
+                next = lc->lc_next;
+                for (pos = &sorted; NULL != *pos && (*pos)->lc_wait >= lc->lc_wait;
+                     pos = &(*pos)->lc_next) {
+                        ;
+                }
+                lc->lc_next = *pos;
+                *pos = lc;
+        }
+        lock_classes = sorted;
+        return sorted;
+}
+
+void
+lockstat_reset(void)
+{
+        lock_class_t *lc;
+
+        for (lc = lock_classes; NULL != lc; lc = lc->lc_next) {
+                lc->lc_acquired = 0;
+                lc->lc_contended = 0;
+                lc->lc_wait = 0;
+                lc->lc_max_wait = 0;
+        }
+}
+
+#endif /* __LOCKSTATS__ */
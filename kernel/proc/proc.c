@@ -7,6 +7,8 @@
 #include "util/list.h"
 #include "util/string.h"
 #include "util/printf.h"
+#include "util/time.h"
+#include "util/timer.h"
 
 #include "proc/kthread.h"
 #include "proc/proc.h"
@@ -25,50 +27,119 @@
 #include "fs/vfs_syscall.h"
 #include "fs/vnode.h"
 #include "fs/file.h"
+#include "fs/fdtable.h"
+#include "api/sysstat.h"
 
+#ifndef __SMP__
 proc_t *curproc = NULL; /* global */
+#endif
 static slab_allocator_t *proc_allocator = NULL;
 
 static list_t _proc_list;
 static proc_t *proc_initproc = NULL; /* Pointer to the init process (PID 1) */
 
+/* Every process that has not been waited for, by PID */
+#define hash_pid(pid)   ((uint32_t)(pid) % PROC_HASH_SIZE)
+static list_t proc_hash[PROC_HASH_SIZE];
+
+/*
+ * A bit is set in pid_map for every PID in use, until the process is
+ * waited for, and one in pid_full for every word of pid_map with all
+ * its bits set; so finding a free PID looks at no more than a word of
+ * each, and a scan of pid_full's 64 words.
+ */
+#define PID_MAP_WORDS   (PROC_MAX_COUNT / 32)
+static uint32_t pid_map[PID_MAP_WORDS];
+static uint32_t pid_full[PID_MAP_WORDS / 32];
+
 void
 proc_init()
 {
+        int i;
+
         list_init(&_proc_list);
+        for (i = 0; i < PROC_HASH_SIZE; i++) {
+                list_init(&proc_hash[i]);
+        }
         proc_allocator = slab_allocator_create("proc", sizeof(proc_t));
         KASSERT(proc_allocator != NULL);
 }
 
 static pid_t next_pid = 0;
 
+/* The first free PID at or after pid, or -1 if there is none */
+static pid_t
+pid_find_from(pid_t pid)
+{
+        uint32_t word = pid / 32, avail;
+        uint32_t i;
+
+        if (0 != (avail = ~pid_map[word] & (0xffffffff << (pid % 32)))) {
+                return word * 32 + __builtin_ctz(avail);
+        }
+        if (++word == PID_MAP_WORDS) {
+                return -1;
+        }
+        avail = ~pid_full[word / 32] & (0xffffffff << (word % 32));
+        for (i = word / 32; ; ) {
+                if (0 != avail) {
+                        word = i * 32 + __builtin_ctz(avail);
+                        return word * 32 + __builtin_ctz(~pid_map[word]);
+                }
+                if (++i == PID_MAP_WORDS / 32) {
+                        return -1;
+                }
+                avail = ~pid_full[i];
+        }
+}
+
+static void
+pid_free(pid_t pid)
+{
+        KASSERT(pid_map[pid / 32] & (1U << (pid % 32)));
+        pid_map[pid / 32] &= ~(1U << (pid % 32));
+        pid_full[pid / 1024] &= ~(1U << (pid / 32 % 32));
+}
+
 /**
- * Returns the next available PID.
- *
- * Note: Where n is the number of running processes, this algorithm is
- * worst case O(n^2). As long as PIDs never wrap around it is O(n).
+ * Returns the next available PID, searching on from the last one
+ * handed out so that a PID is not soon reused.
  *
- * @return the next available PID
+ * @return the next available PID, or -1 if all are in use
  */
 static int
 _proc_getid()
 {
-        proc_t *p;
-        pid_t pid = next_pid;
-        while (1) {
-failed:
-                list_iterate_begin(&_proc_list, p, proc_t, p_list_link) {
-                        if (p->p_pid == pid) {
-                                if ((pid = (pid + 1) % PROC_MAX_COUNT) == next_pid) {
-                                        return -1;
-                                } else {
-                                        goto failed;
-                                }
-                        }
-                } list_iterate_end();
-                next_pid = (pid + 1) % PROC_MAX_COUNT;
-                return pid;
+        pid_t pid;
+
+        if (0 > (pid = pid_find_from(next_pid)) && 0 > (pid = pid_find_from(0))) {
+                return -1;
         }
+        pid_map[pid / 32] |= 1U << (pid % 32);
+        if (0xffffffff == pid_map[pid / 32]) {
+                pid_full[pid / 1024] |= 1U << (pid / 32 % 32);
+        }
+        next_pid = (pid + 1) % PROC_MAX_COUNT;
+        return pid;
+}
+
+/*
+ * Runs from the clock interrupt when a process's alarm goes off. It can
+ * only mark the threads: a sleeping one is woken to exit, and one that
+ * is running exits the next time it enters the kernel or is interrupted
+ * in userland (see __intr_handler()).
+ */
+static void
+proc_alarm_expired(void *arg)
+{
+        proc_t *p = (proc_t *)arg;
+        kthread_t *thr;
+
+        dbg(DBG_PROC, "alarm of process %d (%s) went off\n", p->p_pid, p->p_comm);
+        list_iterate_begin(&p->p_threads, thr, kthread_t, kt_plink) {
+                thr->kt_retval = (void *)PROC_STATUS_ALARM;
+                sched_cancel(thr);
+        } list_iterate_end();
 }
 
 /*
@@ -90,6 +161,11 @@ proc_create(char *name)
     /*it should not be null*/
 
     proc_struct->p_pid = _proc_getid();
+    if (0 > proc_struct->p_pid) {
+        dbg(DBG_PROC, "Out of PIDs.\n");
+        slab_obj_free(proc_allocator, proc_struct);
+        return NULL;
+    }
     if (proc_struct->p_pid == PID_INIT) {
         /*setting the init process if pid is 1*/
         dbg(DBG_PROC, "proc_initproc is set\n");
@@ -107,6 +183,8 @@ proc_create(char *name)
     proc_struct->p_state = PROC_RUNNING;
 
     sched_queue_init(&proc_struct->p_wait);
+    timer_init(&proc_struct->p_alarm, proc_alarm_expired, proc_struct);
+    memset(&proc_struct->p_cusage, 0, sizeof(kt_usage_t));
 
     proc_struct->p_pagedir = pt_create_pagedir();
     KASSERT(proc_struct->p_pagedir);
@@ -114,6 +192,7 @@ proc_create(char *name)
     list_link_init(&proc_struct->p_list_link);
     list_insert_tail(&_proc_list, &proc_struct->p_list_link);
     /*add itself to _proc_list*/
+    list_insert_head(&proc_hash[hash_pid(proc_struct->p_pid)], &proc_struct->p_hash_link);
 
     list_link_init(&proc_struct->p_child_link);
 
@@ -130,10 +209,7 @@ proc_create(char *name)
 
     /* VFS-related: */
     /*p_files*/
-    int i = 0;
-    for (i = 0 ; i < NFILES ; i++) {
-        proc_struct->p_files[i] = NULL;
-    }
+    fdtable_init(proc_struct);
     /*p_cwd*/
     if (proc_struct->p_pid != PID_IDLE && proc_struct->p_pid != PID_INIT) {
         proc_struct->p_cwd = curproc->p_cwd;
@@ -149,6 +225,10 @@ proc_create(char *name)
     KASSERT(proc_struct->p_vmmap);
     proc_struct->p_vmmap->vmm_proc = proc_struct;
 
+#ifdef __SYSSTATS__
+    proc_struct->p_sysstats = NULL;
+#endif
+
     dbg(DBG_PROC, "Created process with name: %s\n", name);
     dbginfo(DBG_PROC, proc_info, proc_struct);
     dbginfo(DBG_PROC, proc_list_info, NULL);
@@ -158,6 +238,36 @@ proc_create(char *name)
         /*NOT_YET_IMPLEMENTED("PROCS: proc_create");*/
 }
 
+void
+proc_discard(proc_t *proc)
+{
+    KASSERT(NULL != proc);
+    KASSERT(list_empty(&proc->p_threads));
+    KASSERT(list_empty(&proc->p_children));
+
+    /*undo proc_create, and whatever the caller has since set up*/
+    fdtable_close_all(proc);
+    if (NULL != proc->p_cwd) {
+        vput(proc->p_cwd);
+        proc->p_cwd = NULL;
+    }
+    if (NULL != proc->p_vmmap) {
+        vmmap_destroy(proc->p_vmmap);
+        proc->p_vmmap = NULL;
+    }
+
+    list_remove(&proc->p_list_link);
+    list_remove(&proc->p_child_link);
+    list_remove(&proc->p_hash_link);
+    pid_free(proc->p_pid);
+
+    pt_destroy_pagedir(proc->p_pagedir);
+#ifdef __SYSSTATS__
+    sysstat_proc_free(proc);
+#endif
+    slab_obj_free(proc_allocator, proc);
+}
+
 /**
  * Cleans up as much as the process as can be done from within the
  * process. This involves:
@@ -205,18 +315,15 @@ proc_cleanup(int status)
     dbg(DBG_PROC, "After reparenting:\n");
     dbginfo(DBG_PROC, proc_list_info, NULL);
 
+    timer_cancel(&curproc->p_alarm);
+
     /*setting state and status*/
     curproc->p_state = PROC_DEAD;
     curproc->p_status = status;
 
     /*clean up file descriptors*/
     /*VFS*/
-    int i = 0;
-    for (i = 0 ; i < NFILES ; i++) {
-        if (curproc->p_files[i]) {
-            fput(curproc->p_files[i]);
-        }
-    }
+    fdtable_close_all(curproc);
 
     if (curproc->p_cwd) {
         vput(curproc->p_cwd);
@@ -249,7 +356,7 @@ proc_kill(proc_t *p, int status)
             /*remove it from parent's thread list*/
             /*list_remove(&kthr->kt_plink);*/
             /*cancel the thread*/
-            kthread_cancel(kthr, (void *)(&status));
+            kthread_cancel(kthr, (void *)status);
         } list_iterate_end();
         p->p_status = status;
         /*p->p_state = PROC_DEAD;*/
@@ -290,7 +397,11 @@ proc_t *
 proc_lookup(int pid)
 {
         proc_t *p;
-        list_iterate_begin(&_proc_list, p, proc_t, p_list_link) {
+
+        if (pid < 0) {
+                return NULL;
+        }
+        list_iterate_begin(&proc_hash[hash_pid(pid)], p, proc_t, p_hash_link) {
                 if (p->p_pid == pid) {
                         return p;
                 }
@@ -304,6 +415,27 @@ proc_list()
         return &_proc_list;
 }
 
+static void
+proc_usage_add(kt_usage_t *sum, const kt_usage_t *u)
+{
+        sum->u_utime += u->u_utime;
+        sum->u_stime += u->u_stime;
+        sum->u_nvcsw += u->u_nvcsw;
+        sum->u_nivcsw += u->u_nivcsw;
+        sum->u_wait_ns += u->u_wait_ns;
+}
+
+void
+proc_usage(proc_t *p, kt_usage_t *u)
+{
+        kthread_t *kthr;
+
+        memset(u, 0, sizeof(*u));
+        list_iterate_begin(&p->p_threads, kthr, kthread_t, kt_plink) {
+                proc_usage_add(u, &kthr->kt_usage);
+        } list_iterate_end();
+}
+
 /*
  * This function is only called from kthread_exit.
  *
@@ -439,11 +571,13 @@ CheckAgain:
     }
     KASSERT(NULL != child_proc);
 
+    /*the child's CPU time, and its children's, becomes ours*/
+    proc_usage_add(&curproc->p_cusage, &child_proc->p_cusage);
+
     /*cleanup the thread*/
     kthread_t *kthr;
     list_iterate_begin(&child_proc->p_threads, kthr, kthread_t, kt_plink) {
-        /*work around for now*/
-        page_free_n((void *)kthr->kt_ctx.c_kstack, 1 + (DEFAULT_STACK_SIZE >> PAGE_SHIFT));
+        proc_usage_add(&curproc->p_cusage, &kthr->kt_usage);
         kthread_destroy(kthr);
     } list_iterate_end();
     KASSERT(list_empty(&child_proc->p_threads));
@@ -459,9 +593,14 @@ CheckAgain:
 
     list_remove(&child_proc->p_list_link);
     list_remove(&child_proc->p_child_link);
+    list_remove(&child_proc->p_hash_link);
+    pid_free(child_proc->p_pid);
 
     /*destroy page table and the struct*/
     pt_destroy_pagedir(child_proc->p_pagedir);
+#ifdef __SYSSTATS__
+    sysstat_proc_free(child_proc);
+#endif
     slab_obj_free(proc_allocator, child_proc);
 
     return child_pid;
@@ -484,12 +623,25 @@ do_exit(int status)
         /*NOT_YET_IMPLEMENTED("PROCS: do_exit");*/
 }
 
+unsigned int
+do_alarm(unsigned int seconds)
+{
+        uint32_t left = timer_remaining(&curproc->p_alarm);
+
+        timer_cancel(&curproc->p_alarm);
+        if (0 != seconds) {
+                timer_add(&curproc->p_alarm, MIN(seconds, TIMER_MAX_TICKS / HZ) * HZ);
+        }
+        return left / HZ + (0 != left % HZ);
+}
+
 size_t
 proc_info(const void *arg, char *buf, size_t osize)
 {
         const proc_t *p = (proc_t *) arg;
         size_t size = osize;
         proc_t *child;
+        kt_usage_t usage;
 
         KASSERT(NULL != p);
         KASSERT(NULL != buf);
@@ -523,6 +675,11 @@ proc_info(const void *arg, char *buf, size_t osize)
 
         iprintf(&buf, &size, "status:       %i\n", p->p_status);
         iprintf(&buf, &size, "state:        %i\n", p->p_state);
+        proc_usage((proc_t *)p, &usage);
+        iprintf(&buf, &size, "cpu ticks:    %u user, %u system\n",
+                usage.u_utime, usage.u_stime);
+        iprintf(&buf, &size, "switches:     %u voluntary, %u involuntary\n",
+                usage.u_nvcsw, usage.u_nivcsw);
 
 #ifdef __VFS__
 #ifdef __GETCWD__
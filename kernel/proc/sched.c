@@ -1,20 +1,54 @@
+#include "config.h"
 #include "globals.h"
 #include "errno.h"
 
+#include "main/fpu.h"
 #include "main/interrupt.h"
+#include "main/smp.h"
 
 #include "proc/sched.h"
 #include "proc/kthread.h"
+#include "proc/spinlock.h"
 
 #include "util/init.h"
 #include "util/debug.h"
+#include "util/time.h"
+#include "util/timer.h"
+#include "util/workq.h"
 
-static ktqueue_t kt_runq;
+/*
+ * Every CPU has its own run queues: one per priority, and a bitmap with
+ * bit p set whenever rq_prio[p] is non-empty, so the next thread to run
+ * is found with a single bit scan however many threads are runnable.
+ * rq_lock guards them against other CPUs, as raising the IPL guards
+ * them against interrupts on this one.
+ */
+typedef struct runq {
+        spinlock_t      rq_lock;
+        ktqueue_t       rq_prio[SCHED_NPRIO];
+        uint32_t        rq_map;
+        int             rq_size;        /* threads on all of rq_prio */
+        volatile int    rq_need_resched; /* curthr should give up the CPU
+                                          * at the next preemption point */
+} runq_t;
+
+static runq_t runqs[NCPUS];
+
+#define this_runq() (&runqs[smp_cpu_id()])
+
+/* Ticks until waiting threads are next aged */
+static int sched_age_ticks = SCHED_AGE_TICKS;
 
 static __attribute__((unused)) void
 sched_init(void)
 {
-        sched_queue_init(&kt_runq);
+        int cpu, i;
+        for (cpu = 0; cpu < NCPUS; cpu++) {
+                spinlock_init(&runqs[cpu].rq_lock);
+                for (i = 0; i < SCHED_NPRIO; i++) {
+                        sched_queue_init(&runqs[cpu].rq_prio[i]);
+                }
+        }
 }
 init_func(sched_init);
 
@@ -76,6 +110,298 @@ ktqueue_remove(ktqueue_t *q, kthread_t *thr)
         q->tq_size--;
 }
 
+/*** PRIVATE RUN QUEUE FUNCTIONS ***/
+/* All of these must be called with interrupts masked and the lock held */
+
+static void
+runq_enqueue(runq_t *rq, kthread_t *thr)
+{
+        ktqueue_enqueue(&rq->rq_prio[thr->kt_prio], thr);
+        rq->rq_map |= 1U << thr->kt_prio;
+        rq->rq_size++;
+        thr->kt_cpu = rq - runqs;
+}
+
+static kthread_t *
+runq_dequeue(runq_t *rq)
+{
+        int prio;
+        kthread_t *thr;
+
+        if (0 == rq->rq_map) {
+                return NULL;
+        }
+        prio = __builtin_ctz(rq->rq_map);
+        thr = ktqueue_dequeue(&rq->rq_prio[prio]);
+        if (sched_queue_empty(&rq->rq_prio[prio])) {
+                rq->rq_map &= ~(1U << prio);
+        }
+        rq->rq_size--;
+        return thr;
+}
+
+static void
+runq_remove(kthread_t *thr)
+{
+        runq_t *rq = &runqs[thr->kt_cpu];
+
+        ktqueue_remove(&rq->rq_prio[thr->kt_prio], thr);
+        if (sched_queue_empty(&rq->rq_prio[thr->kt_prio])) {
+                rq->rq_map &= ~(1U << thr->kt_prio);
+        }
+        rq->rq_size--;
+}
+
+static int
+runq_queued(kthread_t *thr)
+{
+        return thr->kt_wchan == &runqs[thr->kt_cpu].rq_prio[thr->kt_prio];
+}
+
+/* Is anything waiting to run at prio or better? */
+static int
+runq_has_prio(runq_t *rq, int prio)
+{
+        return 0 != (rq->rq_map & (~0U >> (SCHED_NPRIO - 1 - prio)));
+}
+
+/*
+ * Locks the run queue thr is or would be on. A thread only moves to
+ * another CPU's queue with both locks held, so once we hold the lock of
+ * the queue it says it is on, it stays there.
+ */
+static runq_t *
+runq_lock_thr(kthread_t *thr)
+{
+        runq_t *rq;
+
+        for (;;) {
+                rq = &runqs[thr->kt_cpu];
+                spinlock_lock(&rq->rq_lock);
+                if (rq == &runqs[thr->kt_cpu]) {
+                        return rq;
+                }
+                spinlock_unlock(&rq->rq_lock);
+        }
+}
+
+/*
+ * Recompute thr's priority from its nice value and how it has been
+ * behaving, moving it to the right run queue if it is on one, in which
+ * case that queue must be locked.
+ */
+static void
+sched_reprioritize(kthread_t *thr)
+{
+        int prio, queued;
+
+        if (thr->kt_fixed) {
+                return;
+        }
+
+        prio = SCHED_PRIO_USER + thr->kt_nice / 2 + thr->kt_penalty;
+        prio = MAX(prio, SCHED_PRIO_DYN_MIN);
+        prio = MIN(prio, SCHED_NPRIO - 1);
+        if (prio == thr->kt_prio) {
+                return;
+        }
+
+        if ((queued = runq_queued(thr))) {
+                runq_remove(thr);
+        }
+        thr->kt_prio = prio;
+        if (queued) {
+                runq_enqueue(&runqs[thr->kt_cpu], thr);
+        }
+}
+
+/* Higher priorities get shorter slices, as their threads rarely use them up */
+static int
+sched_quantum(int prio)
+{
+        return SCHED_QUANTUM_TICKS * (1 + prio / 8);
+}
+
+/*
+ * Threads that block before using up their slice, as interactive
+ * threads waiting on a tty or disk do, work their way up.
+ */
+static void
+sched_wake(kthread_t *thr)
+{
+        if (thr->kt_penalty > -SCHED_BOOST_MAX) {
+                thr->kt_penalty--;
+                sched_reprioritize(thr);
+        }
+        sched_make_runnable(thr);
+}
+
+/*
+ * Give every thread still waiting to run a step up, so that threads at
+ * the bottom are not starved forever by busier ones above them.
+ */
+static void
+sched_age(void)
+{
+        kthread_t *thr;
+        runq_t *rq;
+        int cpu, prio;
+
+        for (cpu = 0; cpu < smp_ncpus; cpu++) {
+                rq = &runqs[cpu];
+                spinlock_lock(&rq->rq_lock);
+                for (prio = SCHED_PRIO_DYN_MIN + 1; prio < SCHED_NPRIO; prio++) {
+                        list_iterate_begin(&rq->rq_prio[prio].tq_list, thr, kthread_t, kt_qlink) {
+                                if (thr->kt_penalty > -SCHED_BOOST_MAX) {
+                                        thr->kt_penalty--;
+                                        sched_reprioritize(thr);
+                                }
+                        } list_iterate_end();
+                }
+                spinlock_unlock(&rq->rq_lock);
+        }
+}
+
+#ifdef __SMP__
+/* Is cpu sitting in its idle thread? */
+static int
+sched_cpu_idle(int cpu)
+{
+        return NULL != smp_cpus[cpu].cpu_idle
+               && smp_cpus[cpu].cpu_thr == smp_cpus[cpu].cpu_idle;
+}
+
+/*
+ * Where a thread that has become runnable should go: back where it last
+ * ran, where its cache footprint may still be, unless some other CPU
+ * has nothing at all to do. A thread giving up the CPU stays put.
+ */
+static int
+sched_pick_cpu(kthread_t *thr)
+{
+        int cpu;
+
+        if (thr == curthr || sched_cpu_idle(thr->kt_cpu)) {
+                return thr->kt_cpu;
+        }
+        for (cpu = 0; cpu < smp_ncpus; cpu++) {
+                if (sched_cpu_idle(cpu) && 0 == runqs[cpu].rq_size) {
+                        return cpu;
+                }
+        }
+        return thr->kt_cpu;
+}
+
+/*
+ * Called with nothing on this CPU's queues: take the best thread from
+ * the busiest other CPU. Its lock is only tried, never waited for, so
+ * two CPUs stealing from each other cannot deadlock; a CPU that misses
+ * out just tries again the next time it looks for work.
+ *
+ * A thread is only put on a run queue with the kernel lock held, and
+ * its context is saved before the lock is given up, so any thread we
+ * find here is safe to resume on this CPU.
+ */
+static kthread_t *
+sched_steal(void)
+{
+        runq_t *rq, *victim = NULL;
+        kthread_t *thr = NULL;
+        int cpu, most = 0;
+
+        for (cpu = 0; cpu < smp_ncpus; cpu++) {
+                rq = &runqs[cpu];
+                if (cpu != smp_cpu_id() && rq->rq_size > most) {
+                        most = rq->rq_size;
+                        victim = rq;
+                }
+        }
+        if (NULL != victim && spinlock_trylock(&victim->rq_lock)) {
+                thr = runq_dequeue(victim);
+                spinlock_release(&victim->rq_lock);
+        }
+        if (NULL != thr) {
+                dbg(DBG_SCHED, "cpu %d takes %s from cpu %d\n", smp_cpu_id(),
+                    thr->kt_proc->p_comm, thr->kt_cpu);
+                thr->kt_cpu = smp_cpu_id();
+                smp_cpu()->cpu_steals++;
+        }
+        return thr;
+}
+#endif /* __SMP__ */
+
+/*
+ * The next thread this CPU should run, or NULL if there is none. With
+ * SMP that means stealing one, or failing that the idle thread, which is
+ * only missing until smp_release_aps().
+ */
+static kthread_t *
+sched_next(void)
+{
+        runq_t *rq = this_runq();
+        kthread_t *thr;
+
+        spinlock_acquire(&rq->rq_lock);
+        thr = runq_dequeue(rq);
+        spinlock_release(&rq->rq_lock);
+#ifdef __SMP__
+        if (NULL == thr) {
+                thr = sched_steal();
+        }
+        if (NULL == thr) {
+                thr = smp_cpu()->cpu_idle;
+        }
+#endif
+        return thr;
+}
+
+/*
+ * thr has just gone on cpu's run queue. If it is better than what cpu is
+ * running, cpu should switch at its next chance, and another CPU has to
+ * be interrupted to notice. An idle CPU is always woken.
+ */
+static void
+sched_kick(int cpu, kthread_t *thr)
+{
+#ifdef __SMP__
+        kthread_t *running = smp_cpus[cpu].cpu_thr;
+
+        if (sched_cpu_idle(cpu)) {
+                if (cpu != smp_cpu_id()) {
+                        smp_resched_cpu(cpu);
+                }
+                return;
+        }
+#else
+        kthread_t *running = curthr;
+#endif
+        if (NULL != running && thr != running && KT_RUN == running->kt_state
+            && thr->kt_prio < running->kt_prio) {
+                runqs[cpu].rq_need_resched = 1;
+#ifdef __SMP__
+                if (cpu != smp_cpu_id()) {
+                        smp_resched_cpu(cpu);
+                }
+#endif
+        }
+}
+
+int
+sched_cpus_idle(void)
+{
+#ifdef __SMP__
+        int cpu;
+
+        for (cpu = 0; cpu < smp_ncpus; cpu++) {
+                if (cpu != smp_cpu_id()
+                    && (!sched_cpu_idle(cpu) || 0 != runqs[cpu].rq_size)) {
+                        return 0;
+                }
+        }
+#endif
+        return 1;
+}
+
 /*** PUBLIC KTQUEUE MANIPULATION FUNCTIONS ***/
 void
 sched_queue_init(ktqueue_t *q)
@@ -114,8 +440,9 @@ sched_sleep_on(ktqueue_t *q)
     /*it should already be set to KT_RUN when it's added to runq*/
     KASSERT(curthr->kt_state == KT_RUN);
 
+    /*exit with whatever status the canceller gave, as by alarm()*/
     if (curthr->kt_cancelled == 1) {
-        kthread_exit((void *)curproc->p_status);
+        kthread_exit(curthr->kt_retval);
     }
 
     return;
@@ -156,6 +483,63 @@ sched_cancellable_sleep_on(ktqueue_t *q)
         /*NOT_YET_IMPLEMENTED("PROCS: sched_cancellable_sleep_on");*/
 }
 
+/* What the timer of sched_sleep_on_timeout() needs to wake its thread */
+typedef struct sleep_timeout {
+        ktimer_t        st_timer;
+        kthread_t      *st_thr;
+        int             st_expired;
+} sleep_timeout_t;
+
+/*
+ * Runs from the clock interrupt. The thread may have been woken in the
+ * meantime, and is then only waiting for its chance to cancel us.
+ */
+static void
+sched_timeout(void *arg)
+{
+        sleep_timeout_t *st = (sleep_timeout_t *)arg;
+        kthread_t *thr = st->st_thr;
+
+        if (KT_SLEEP_CANCELLABLE == thr->kt_state) {
+                st->st_expired = 1;
+                ktqueue_remove(thr->kt_wchan, thr);
+                sched_wake(thr);
+        }
+}
+
+/*
+ * The timer lives on our stack, so it must be cancelled before we
+ * return. It is started with interrupts blocked, so that it cannot go
+ * off before we are on the queue, and then never wake us.
+ */
+int
+sched_sleep_on_timeout(ktqueue_t *q, uint32_t ticks)
+{
+        sleep_timeout_t st;
+        uint8_t oldipl;
+        int err;
+
+        if (0 == ticks) {
+                return -ETIMEDOUT;
+        }
+
+        st.st_thr = curthr;
+        st.st_expired = 0;
+        timer_init(&st.st_timer, sched_timeout, &st);
+
+        oldipl = intr_getipl();
+        intr_setipl(IPL_HIGH);
+        timer_add(&st.st_timer, ticks);
+        err = sched_cancellable_sleep_on(q);
+        timer_cancel(&st.st_timer);
+        intr_setipl(oldipl);
+
+        if (0 == err && st.st_expired) {
+                err = -ETIMEDOUT;
+        }
+        return err;
+}
+
 kthread_t *
 sched_wakeup_on(ktqueue_t *q)
 {
@@ -165,7 +549,7 @@ sched_wakeup_on(ktqueue_t *q)
     kthread_t *kthr_tmp = ktqueue_dequeue(q);
     if (NULL != kthr_tmp) {
         kthr_tmp->kt_state = KT_RUN;
-        sched_make_runnable(kthr_tmp);
+        sched_wake(kthr_tmp);
     }
     return kthr_tmp;
         /*NOT_YET_IMPLEMENTED("PROCS: sched_wakeup_on");*/
@@ -211,7 +595,7 @@ sched_cancel(struct kthread *kthr)
         /*remove it from the queue*/
         ktqueue_remove(kthr->kt_wchan, kthr);
         /*make it runnable*/
-        sched_make_runnable(kthr);
+        sched_wake(kthr);
     }
         /*NOT_YET_IMPLEMENTED("PROCS: sched_cancel");*/
 }
@@ -260,8 +644,20 @@ sched_switch(void)
     intr_setipl(IPL_HIGH);
 
     /*no threads on the run queue*/
-    while (sched_queue_empty(&kt_runq)) {
+    kthread_t *next;
+    while (NULL == (next = sched_next())) {
         intr_disable();
+        /* Deferred work may be what wakes a thread up */
+        if (work_deferred_pending()) {
+            intr_setipl(IPL_LOW);
+            work_run_deferred();
+            intr_setipl(IPL_HIGH);
+            intr_enable();
+            continue;
+        }
+#ifdef __NOHZ__
+        time_idle_enter();
+#endif
         intr_setipl(IPL_LOW);
         intr_wait();
         intr_setipl(IPL_HIGH);
@@ -269,13 +665,30 @@ sched_switch(void)
 
     /*extract a thread from runq*/
     kthread_t *old_kthr = curthr;
-    curthr = ktqueue_dequeue(&kt_runq);
+    if (0 != next->kt_runnable_ns) {
+        next->kt_usage.u_wait_ns += time_monotonic_ns() - next->kt_runnable_ns;
+        next->kt_runnable_ns = 0;
+    }
+    curthr = next;
     curproc = curthr->kt_proc;
-
-    dbg(DBG_SCHED, "Switching: %s -> %s\n", old_kthr->kt_proc->p_comm, curproc->p_comm);
-
-    /*do the switching*/
-    context_switch(&old_kthr->kt_ctx, &curthr->kt_ctx);
+    curthr->kt_quantum = sched_quantum(curthr->kt_prio);
+    this_runq()->rq_need_resched = 0;
+
+    /*do the switching, unless it was the only thing to run*/
+    if (curthr != old_kthr) {
+        dbg(DBG_SCHED, "Switching: %s -> %s\n", old_kthr->kt_proc->p_comm, curproc->p_comm);
+        /*still runnable means it was preempted or yielded*/
+        if (KT_RUN == old_kthr->kt_state) {
+            old_kthr->kt_usage.u_nivcsw++;
+        } else {
+            old_kthr->kt_usage.u_nvcsw++;
+        }
+#ifdef __SMP__
+        smp_cpu()->cpu_switches++;
+#endif
+        fpu_switch(old_kthr, curthr);
+        context_switch(&old_kthr->kt_ctx, &curthr->kt_ctx);
+    }
 
     /*unblock interrupts*/
     intr_setipl(old_ipl);
@@ -308,15 +721,160 @@ sched_switch(void)
 void
 sched_make_runnable(kthread_t *thr)
 {
-    uint8_t old_ipl = intr_getipl();
-    intr_setipl(IPL_HIGH);
+#ifdef __SMP__
+    int cpu = sched_pick_cpu(thr);
+#else
+    int cpu = 0;
+#endif
+    runq_t *rq = &runqs[cpu];
+    spinlock_lock(&rq->rq_lock);
 
     /*set it to KT_RUN state*/
     thr->kt_state = KT_RUN;
+    /*start the clock on its wait for a CPU*/
+    thr->kt_runnable_ns = time_monotonic_ns();
     /*Add it to the runq*/
-    ktqueue_enqueue(&kt_runq, thr);
+    runq_enqueue(rq, thr);
 
-    intr_setipl(old_ipl);
+    /*a better thread than the one running gets the CPU at the next chance*/
+    sched_kick(cpu, thr);
+
+    spinlock_unlock(&rq->rq_lock);
     return;
         /*NOT_YET_IMPLEMENTED("PROCS: sched_make_runnable");*/
 }
+
+void
+sched_yield(void)
+{
+        sched_make_runnable(curthr);
+        sched_switch();
+}
+
+/*
+ * Runs from the clock interrupt. A thread that is asleep may still be
+ * curthr while sched_switch() waits for work, so only count ticks
+ * against a thread that is actually running.
+ */
+void
+sched_account_tick(int user)
+{
+#ifdef __SMP__
+        if (sched_cpu_idle(smp_cpu_id())) {
+                return;
+        }
+#endif
+        if (NULL == curthr || KT_RUN != curthr->kt_state) {
+                return;
+        }
+        if (user) {
+                curthr->kt_usage.u_utime++;
+        } else {
+                curthr->kt_usage.u_stime++;
+        }
+}
+
+/*
+ * Runs from the clock interrupt, after sched_account_tick().
+ *
+ * A thread that uses up its whole slice drops a level. It is preempted
+ * then if anything as good is waiting, or later when something better
+ * wakes up.
+ */
+void
+sched_tick(void)
+{
+        if (0 == smp_cpu_id() && --sched_age_ticks <= 0) {
+                sched_age_ticks = SCHED_AGE_TICKS;
+                sched_age();
+        }
+
+#ifdef __SMP__
+        smp_cpu()->cpu_ticks++;
+        if (sched_cpu_idle(smp_cpu_id())) {
+                smp_cpu()->cpu_idle_ticks++;
+                return;
+        }
+#endif
+        if (NULL == curthr || KT_RUN != curthr->kt_state) {
+                return;
+        }
+        if (curthr->kt_quantum > 0 && 0 == --curthr->kt_quantum
+            && curthr->kt_penalty < SCHED_DECAY_MAX) {
+                curthr->kt_penalty++;
+                sched_reprioritize(curthr);
+        }
+        if (0 == curthr->kt_quantum && runq_has_prio(this_runq(), curthr->kt_prio)) {
+                this_runq()->rq_need_resched = 1;
+        }
+}
+
+void
+sched_preempt(void)
+{
+        if (this_runq()->rq_need_resched) {
+                dbg(DBG_SCHED, "%s used up its time slice\n", curproc->p_comm);
+                sched_yield();
+        }
+}
+
+void
+sched_set_nice(kthread_t *thr, int nice)
+{
+        runq_t *rq = runq_lock_thr(thr);
+
+        thr->kt_nice = MAX(NICE_MIN, MIN(nice, NICE_MAX));
+        sched_reprioritize(thr);
+
+        spinlock_unlock(&rq->rq_lock);
+}
+
+void
+sched_set_fixed_prio(kthread_t *thr, int prio)
+{
+        runq_t *rq = runq_lock_thr(thr);
+
+        KASSERT(prio >= 0 && prio < SCHED_PRIO_DYN_MIN);
+        KASSERT(!runq_queued(thr));
+        thr->kt_fixed = 1;
+        thr->kt_prio = prio;
+
+        spinlock_unlock(&rq->rq_lock);
+}
+
+#ifdef __SMP__
+/*
+ * The idle thread of a CPU. sched_switch() comes back here whenever it
+ * finds nothing for this CPU to do, and we halt with the kernel lock
+ * given up so that the other CPUs can carry on. The run queue is looked
+ * at again with interrupts off, as something may have been put on it
+ * by an interrupt since sched_switch() looked; after that, anything
+ * that puts a thread on it will interrupt us.
+ */
+void *
+sched_idle(int cpu, void *arg)
+{
+        KASSERT(cpu == smp_cpu_id());
+
+        for (;;) {
+                sched_switch();
+
+                intr_disable();
+                if (work_deferred_pending()) {
+                        intr_setipl(IPL_LOW);
+                        work_run_deferred();
+                } else if (0 == this_runq()->rq_size) {
+#ifdef __NOHZ__
+                        time_idle_enter();
+#endif
+                        smp_unlock_kernel();
+                        intr_setipl(IPL_LOW);
+                        intr_wait();
+                        intr_disable();
+                        smp_lock_kernel();
+                }
+                intr_enable();
+        }
+        return NULL;
+}
+#endif
@@ -0,0 +1,72 @@
+#include "kernel.h"
+#include "config.h"
+
+#include "main/interrupt.h"
+
+#include "proc/spinlock.h"
+
+#include "util/debug.h"
+
+static inline uint32_t
+spinlock_xchg(volatile uint32_t *addr, uint32_t val)
+{
+        __asm__ volatile("xchgl %0, %1"
+                         : "+m"(*addr), "+r"(val)
+                         :: "memory");
+        return val;
+}
+
+void
+spinlock_init(spinlock_t *lock)
+{
+        lock->sl_locked = 0;
+        lock->sl_ipl = IPL_LOW;
+}
+
+int
+spinlock_trylock(spinlock_t *lock)
+{
+        return 0 == spinlock_xchg(&lock->sl_locked, 1);
+}
+
+void
+spinlock_acquire(spinlock_t *lock)
+{
+#ifdef __SMP__
+        while (!spinlock_trylock(lock)) {
+                /* Spin on a plain read so waiters do not fight over the line */
+                while (lock->sl_locked) {
+                        __asm__ volatile("pause");
+                }
+        }
+#else
+        KASSERT(!lock->sl_locked && "spinlocks are not re-entrant");
+        lock->sl_locked = 1;
+#endif
+}
+
+void
+spinlock_release(spinlock_t *lock)
+{
+        KASSERT(lock->sl_locked);
+        spinlock_xchg(&lock->sl_locked, 0);
+}
+
+void
+spinlock_lock(spinlock_t *lock)
+{
+        uint8_t ipl = intr_getipl();
+
+        intr_setipl(IPL_HIGH);
+        spinlock_acquire(lock);
+        lock->sl_ipl = ipl;
+}
+
+void
+spinlock_unlock(spinlock_t *lock)
+{
+        uint8_t ipl = lock->sl_ipl;
+
+        spinlock_release(lock);
+        intr_setipl(ipl);
+}
@@ -11,10 +11,29 @@
 #include "fs/vnode.h"
 #endif
 
+#ifdef __SYSSTATS__
+#include "api/sysstat.h"
+#endif
+
+#ifdef __LOCKSTATS__
+#include "proc/lockstat.h"
+#endif
+
+#ifdef __SMP__
+#include "globals.h"
+#include "main/smp.h"
+#endif
+
+#include "main/fpu.h"
+#include "proc/context.h"
+#include "proc/proc.h"
+#include "proc/sched.h"
+
 #include "test/kshell/io.h"
 
 #include "util/debug.h"
 #include "util/string.h"
+#include "util/time.h"
 
 int kshell_help(kshell_t *ksh, int argc, char **argv)
 {
@@ -321,3 +340,283 @@ int kshell_stat(kshell_t *ksh, int argc, char **argv)
         return exit_val;
 }
 #endif
+
+#ifdef __SYSSTATS__
+/*
+ * Prints the system call counters (see api/sysstat.h): system-wide, or
+ * of the process with the given pid. "-r" resets them.
+ */
+int kshell_syscalls(kshell_t *ksh, int argc, char **argv)
+{
+        KASSERT(NULL != ksh);
+        KASSERT(NULL != argv);
+
+        sysstat_rec_t rec;
+        pid_t pid = SYSSTAT_SYSTEM;
+        const char *s;
+        int i;
+
+        if (argc > 2) {
+                kprintf(ksh, "Usage: syscalls [-r | PID]\n");
+                return 1;
+        }
+        if (argc == 2 && 0 == strcmp(argv[1], "-r")) {
+                sysstat_reset();
+                return 0;
+        }
+        if (argc == 2) {
+                pid = 0;
+                for (s = argv[1]; *s; s++) {
+                        if (*s < '0' || *s > '9') {
+                                kprintf(ksh, "Usage: syscalls [-r | PID]\n");
+                                return 1;
+                        }
+                        pid = pid * 10 + (*s - '0');
+                }
+        }
+
+        kprintf(ksh, "%-16s %10s %8s %12s %14s\n",
+                "syscall", "calls", "errors", "cycles/call", "cycles");
+        for (i = 0; sysstat_get(i, &rec); i++) {
+                if (rec.ss_pid != pid) {
+                        continue;
+                }
+                kprintf(ksh, "%-16s %10u %8u %12llu %14llu\n",
+                        rec.ss_name, rec.ss_calls, rec.ss_errors,
+                        rec.ss_cycles / rec.ss_calls, rec.ss_cycles);
+        }
+        return 0;
+}
+#endif
+
+#ifdef __LOCKSTATS__
+/*
+ * Prints the lock classes (see proc/lockstat.h) that have spent longest
+ * waiting, by default the top 10. "-r" resets the counters.
+ */
+int kshell_locks(kshell_t *ksh, int argc, char **argv)
+{
+        KASSERT(NULL != ksh);
+        KASSERT(NULL != argv);
+
+        lock_class_t *lc;
+        int n = 10, i;
+        const char *s;
+
+        if (argc > 2) {
+                kprintf(ksh, "Usage: locks [-r | N]\n");
+                return 1;
+        }
+        if (argc == 2 && 0 == strcmp(argv[1], "-r")) {
+                lockstat_reset();
+                return 0;
+        }
+        if (argc == 2) {
+                n = 0;
+                for (s = argv[1]; *s; s++) {
+                        if (*s < '0' || *s > '9') {
+                                kprintf(ksh, "Usage: locks [-r | N]\n");
+                                return 1;
+                        }
+                        n = n * 10 + (*s - '0');
+                }
+        }
+
+        kprintf(ksh, "%-28s %6s %10s %10s %14s %12s\n",
+                "class", "locks", "acquired", "contended", "wait cycles", "max wait");
+        for (lc = lockstat_sorted(), i = 0; NULL != lc && i < n; lc = lc->lc_next, i++) {
+                kprintf(ksh, "%-22s:%-5d %6u %10u %10u %14llu %12llu\n",
+                        lc->lc_file, lc->lc_line, lc->lc_locks, lc->lc_acquired,
+                        lc->lc_contended, lc->lc_wait, lc->lc_max_wait);
+        }
+        return 0;
+}
+#endif
+
+/*
+ * Prints the state of the clock, and with NOHZ how much the clock tick
+ * has been stopped.
+ */
+int kshell_clock(kshell_t *ksh, int argc, char **argv)
+{
+        KASSERT(NULL != ksh);
+        KASSERT(NULL != argv);
+
+        uint64_t ns = time_monotonic_ns();
+#ifdef __NOHZ__
+        uint32_t sleeps, avoided;
+#endif
+
+        kprintf(ksh, "ticks:    %u at %d Hz\n", jiffies, HZ);
+        kprintf(ksh, "uptime:   %llu.%09llu s\n", ns / 1000000000, ns % 1000000000);
+        kprintf(ksh, "tsc:      %llu Hz\n", time_tsc_hz());
+#ifdef __NOHZ__
+        time_nohz_stats(&sleeps, &avoided);
+        kprintf(ksh, "stopped:  %u times, %u ticks avoided\n", sleeps, avoided);
+#endif
+        return 0;
+}
+
+/*
+ * Prints how many context switches loaded a page directory, and how
+ * many kept the one that was loaded; see context.h.
+ */
+int kshell_cr3(kshell_t *ksh, int argc, char **argv)
+{
+        KASSERT(NULL != ksh);
+        KASSERT(NULL != argv);
+
+        uint32_t loads, kept;
+
+        context_pagedir_stats(&loads, &kept);
+        kprintf(ksh, "loaded:   %u\n", loads);
+        kprintf(ksh, "kept:     %u\n", kept);
+        return 0;
+}
+
+/*
+ * Prints how many times a thread took the FPU over, and how many times
+ * that saved and loaded its registers; see fpu.h.
+ */
+int kshell_fpu(kshell_t *ksh, int argc, char **argv)
+{
+        KASSERT(NULL != ksh);
+        KASSERT(NULL != argv);
+
+        uint32_t traps, saves, loads;
+
+        fpu_stats(&traps, &saves, &loads);
+        kprintf(ksh, "traps:    %u\n", traps);
+        kprintf(ksh, "saves:    %u\n", saves);
+        kprintf(ksh, "loads:    %u\n", loads);
+        return 0;
+}
+
+#ifdef __SMP__
+int kshell_cpus(kshell_t *ksh, int argc, char **argv)
+{
+        KASSERT(NULL != ksh);
+        KASSERT(NULL != argv);
+
+        cpu_t *cpu;
+        int i;
+
+        kprintf(ksh, "%3s %4s %10s %10s %10s %8s  %s\n",
+                "cpu", "apic", "ticks", "idle", "switches", "steals", "running");
+        for (i = 0; i < smp_ncpus; i++) {
+                cpu = &smp_cpus[i];
+                kprintf(ksh, "%3d %#4x %10u %10u %10u %8u  %s\n",
+                        cpu->cpu_id, cpu->cpu_apicid, cpu->cpu_ticks,
+                        cpu->cpu_idle_ticks, cpu->cpu_switches, cpu->cpu_steals,
+                        (cpu->cpu_thr == cpu->cpu_idle) ? "(idle)"
+                        : cpu->cpu_proc->p_comm);
+        }
+        return 0;
+}
+#endif
+
+#define TOP_MAX_PROCS   32
+
+typedef struct top_entry {
+        pid_t           te_pid;
+        kt_usage_t      te_usage;
+        uint32_t        te_ticks;       /* CPU ticks used while we slept */
+} top_entry_t;
+
+static int
+top_snapshot(top_entry_t *tab)
+{
+        proc_t *p;
+        int n = 0;
+
+        list_iterate_begin(proc_list(), p, proc_t, p_list_link) {
+                if (n == TOP_MAX_PROCS) {
+                        break;
+                }
+                tab[n].te_pid = p->p_pid;
+                proc_usage(p, &tab[n].te_usage);
+                tab[n].te_ticks = 0;
+                n++;
+        } list_iterate_end();
+        return n;
+}
+
+/*
+ * Takes two snapshots of every process's CPU usage, the given number of
+ * seconds apart, and lists the processes by how much CPU they used in
+ * between. The other columns are totals since each process started:
+ * ticks in user mode and in the kernel, voluntary and involuntary
+ * context switches, and milliseconds spent waiting on a run queue.
+ */
+int kshell_top(kshell_t *ksh, int argc, char **argv)
+{
+        KASSERT(NULL != ksh);
+        KASSERT(NULL != argv);
+
+        top_entry_t before[TOP_MAX_PROCS], after[TOP_MAX_PROCS], tmp;
+        ktqueue_t q;
+        proc_t *p;
+        uint32_t secs = 1, ticks;
+        int nbefore, nafter, i, j;
+        const char *s;
+
+        if (argc > 2) {
+                kprintf(ksh, "Usage: top [secs]\n");
+                return 1;
+        }
+        if (argc == 2) {
+                secs = 0;
+                for (s = argv[1]; *s; s++) {
+                        if (*s < '0' || *s > '9') {
+                                kprintf(ksh, "Usage: top [secs]\n");
+                                return 1;
+                        }
+                        secs = secs * 10 + (*s - '0');
+                }
+                if (0 == secs) {
+                        kprintf(ksh, "Usage: top [secs]\n");
+                        return 1;
+                }
+        }
+
+        nbefore = top_snapshot(before);
+        sched_queue_init(&q);
+        if (-EINTR == sched_sleep_on_timeout(&q, secs * HZ)) {
+                return 1;
+        }
+        nafter = top_snapshot(after);
+
+        for (i = 0; i < nafter; i++) {
+                after[i].te_ticks = after[i].te_usage.u_utime + after[i].te_usage.u_stime;
+                for (j = 0; j < nbefore; j++) {
+                        if (before[j].te_pid == after[i].te_pid) {
+                                after[i].te_ticks -= before[j].te_usage.u_utime
+                                                     + before[j].te_usage.u_stime;
+                                break;
+                        }
+                }
+        }
+        for (i = 1; i < nafter; i++) {
+                tmp = after[i];
+                for (j = i; j > 0 && after[j - 1].te_ticks < tmp.te_ticks; j--) {
+                        after[j] = after[j - 1];
+                }
+                after[j] = tmp;
+        }
+
+        ticks = secs * HZ;
+        kprintf(ksh, "%5s %-13s %5s %8s %8s %8s %8s %10s\n",
+                "PID", "NAME", "%CPU", "USER", "SYS", "VCSW", "IVCSW", "WAIT ms");
+        for (i = 0; i < nafter; i++) {
+                if (NULL == (p = proc_lookup(after[i].te_pid))) {
+                        continue;
+                }
+                kprintf(ksh, "%5d %-13s %5u %8u %8u %8u %8u %10llu\n",
+                        after[i].te_pid, p->p_comm,
+                        after[i].te_ticks * 100 / ticks,
+                        after[i].te_usage.u_utime, after[i].te_usage.u_stime,
+                        after[i].te_usage.u_nvcsw, after[i].te_usage.u_nivcsw,
+                        after[i].te_usage.u_wait_ns / 1000000);
+        }
+        return 0;
+}
@@ -18,3 +18,16 @@ KSHELL_CMD(rmdir);
 KSHELL_CMD(mkdir);
 KSHELL_CMD(stat);
 #endif
+#ifdef __SYSSTATS__
+KSHELL_CMD(syscalls);
+#endif
+#ifdef __LOCKSTATS__
+KSHELL_CMD(locks);
+#endif
+KSHELL_CMD(clock);
+KSHELL_CMD(top);
+KSHELL_CMD(cr3);
+KSHELL_CMD(fpu);
+#ifdef __SMP__
+KSHELL_CMD(cpus);
+#endif
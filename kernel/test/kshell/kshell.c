@@ -47,6 +47,26 @@ static __attribute__((unused)) void kshell_init()
         kshell_add_command("mkdir", kshell_mkdir, "make directories");
         kshell_add_command("stat", kshell_stat, "display file status");
 #endif
+#ifdef __SYSSTATS__
+        kshell_add_command("syscalls", kshell_syscalls,
+                           "display system call counts and latencies");
+#endif
+#ifdef __LOCKSTATS__
+        kshell_add_command("locks", kshell_locks,
+                           "display the most contended kernel locks");
+#endif
+        kshell_add_command("clock", kshell_clock,
+                           "display the clock and how often its tick stopped");
+        kshell_add_command("top", kshell_top,
+                           "display the processes using the most CPU");
+        kshell_add_command("cr3", kshell_cr3,
+                           "display how often a context switch loaded cr3");
+        kshell_add_command("fpu", kshell_fpu,
+                           "display how often the FPU registers changed hands");
+#ifdef __SMP__
+        kshell_add_command("cpus", kshell_cpus,
+                           "display what each CPU has been doing");
+#endif
 
         kshell_add_command("exit", kshell_exit, "exits the shell");
 }
@@ -1,36 +1,281 @@
 #include "globals.h"
+#include "config.h"
 
 #include "main/interrupt.h"
 #include "main/apic.h"
+#include "main/cpuid.h"
 #include "main/pit.h"
+#include "main/smp.h"
 
 #include "util/debug.h"
 #include "util/init.h"
+#include "util/time.h"
+#include "util/timer.h"
+
+#include "api/kdata.h"
+#include "api/time.h"
 
 #include "proc/sched.h"
 #include "proc/kthread.h"
 
 #define APIC_TIMER_IRQ 32 /* Map interrupt 32 */
 
-#ifdef __UPREEMPT__
-static unsigned int ms = 0;
+volatile uint32_t jiffies = 0;
 
-static void pit_handler(regs_t *regs)
+#define NSEC_PER_TICK   (NSEC_PER_SEC / HZ)
+
+uint32_t time_to_ticks(const struct timespec *ts)
+{
+        uint32_t ticks = (ts->tv_nsec + NSEC_PER_TICK - 1) / NSEC_PER_TICK;
+
+        if ((uint32_t)ts->tv_sec >= (0xffffffff - ticks) / HZ) {
+                return 0xffffffff;
+        }
+        return ts->tv_sec * HZ + ticks;
+}
+
+void ticks_to_time(uint32_t ticks, struct timespec *ts)
+{
+        ts->tv_sec = ticks / HZ;
+        ts->tv_nsec = (ticks % HZ) * NSEC_PER_TICK;
+}
+
+/*
+ * The monotonic clock. With a TSC it is extrapolated from the last base
+ * reading the clock interrupt took, clock_base_ns at TSC clock_base_tsc,
+ * converting cycles since then to nanoseconds as (cycles * clock_mult) >>
+ * clock_shift; without one it only moves on a tick. A new base is taken
+ * every second, long before the cycles since the last could overflow
+ * the conversion (a second or so late if the tick was stopped; see
+ * NOHZ_MAX_TICKS), and each is published to userland in the kernel data
+ * page (see api/kdata.h). Only the clock interrupt on CPU 0 writes them.
+ *
+ * Under SMP this assumes the CPUs' TSCs run in step, as they do on
+ * anything recent enough to have more than one.
+ */
+static uint64_t clock_tsc_hz = 0;
+static uint32_t clock_mult = 0;
+static uint32_t clock_shift = 0;
+static uint64_t clock_base_ns = 0;
+static uint64_t clock_base_tsc = 0;
+static uint32_t clock_base_jiffies = 0;
+
+/*
+ * The largest shift (for the most precision) that keeps clock_mult below
+ * 2^28, so that (cycles * clock_mult) has room for 2^36 cycles, which is
+ * tens of seconds on any CPU.
+ */
+static void clock_init(uint64_t tsc_hz)
+{
+        clock_tsc_hz = tsc_hz;
+        if (0 != tsc_hz) {
+                for (clock_shift = 32; clock_shift > 0; clock_shift--) {
+                        clock_mult = (uint32_t)(((uint64_t)NSEC_PER_SEC << clock_shift) / tsc_hz);
+                        if (clock_mult < (1U << 28)) {
+                                break;
+                        }
+                }
+                clock_base_tsc = cpuid_rdtsc();
+        }
+        kdata_update_clock(clock_base_ns, clock_base_tsc, clock_mult, clock_shift);
+}
+
+static void clock_tick(void)
+{
+        uint64_t tsc;
+
+        if (0 == clock_mult) {
+                clock_base_ns = (uint64_t)jiffies * NSEC_PER_TICK;
+        } else if (jiffies - clock_base_jiffies >= HZ) {
+                tsc = cpuid_rdtsc();
+                clock_base_ns += ((tsc - clock_base_tsc) * clock_mult) >> clock_shift;
+                clock_base_tsc = tsc;
+                clock_base_jiffies = jiffies;
+        } else {
+                return;
+        }
+        kdata_update_clock(clock_base_ns, clock_base_tsc, clock_mult, clock_shift);
+}
+
+uint64_t time_monotonic_ns(void)
+{
+        uint64_t ns, tsc;
+        uint8_t oldipl = intr_getipl();
+        intr_setipl(IPL_HIGH);
+
+        ns = clock_base_ns;
+        if (0 != clock_mult) {
+                tsc = cpuid_rdtsc();
+                if (tsc > clock_base_tsc) {
+                        ns += ((tsc - clock_base_tsc) * clock_mult) >> clock_shift;
+                }
+        }
+
+        intr_setipl(oldipl);
+        return ns;
+}
+
+uint64_t time_tsc_hz(void)
+{
+        return clock_tsc_hz;
+}
+
+/* Moves time on by some ticks and runs whatever timers that makes due */
+static void time_advance(uint32_t ticks)
+{
+        jiffies += ticks;
+        clock_tick();
+        timer_tick();
+}
+
+#ifdef __NOHZ__
+/*
+ * Dynamic ticks. A CPU with nothing to run has no use for the clock
+ * tick but to keep time and run timers, so before it halts it swaps the
+ * periodic timer for a one-shot timer for when the next timer is due,
+ * and when something wakes it (that timer, or any other interrupt) it
+ * works out from the APIC timer's count how many ticks went by, catches
+ * jiffies up and goes back to ticking. Counts left over from part of a
+ * tick are carried over, so that no time is lost.
+ *
+ * The tick is kept whenever a thread is running, even alone: jiffies is
+ * read throughout the kernel, and it could only be kept up to date
+ * without the tick by catching it up on every entry to the kernel.
+ *
+ * Only CPU 0 keeps time, so the others stop for as long as they like.
+ * CPU 0 only stops if they are all idle as well, as otherwise they could
+ * read jiffies while it was out of date; while they are, anything that
+ * could wake one of them must first interrupt CPU 0, which catches up.
+ */
+
+/* The longest a CPU goes without a tick, which keeps the TSC clock's
+ * conversion from overflowing; see clock_tick() */
+#define NOHZ_MAX_TICKS  HZ
+
+typedef struct nohz {
+        int             nz_stopped;     /* on the one-shot timer */
+        int             nz_expired;     /* and it ran out; see pit_handler() */
+        uint32_t        nz_count;       /* what the one-shot counts down from */
+        uint32_t        nz_carry;       /* counts since the last whole tick */
+} nohz_t;
+
+static nohz_t nohz[NCPUS];
+
+static uint32_t nohz_sleeps = 0;        /* times the tick was stopped */
+static uint32_t nohz_avoided = 0;       /* ticks that never interrupted */
+
+void time_nohz_stats(uint32_t *sleeps, uint32_t *avoided)
+{
+        *sleeps = nohz_sleeps;
+        *avoided = nohz_avoided;
+}
+
+void time_idle_enter(void)
 {
-  dbg(DBG_CORE, "PIT HANDLER FIRED\n");
+        nohz_t *nz = &nohz[smp_cpu_id()];
+        uint32_t period = apic_timer_period();
+        uint32_t ticks;
+
+        /* Before time_init() there is no tick to stop */
+        if (nz->nz_stopped || 0 == period) {
+                return;
+        }
+        /* Leaves room for the carry in the count; see time_idle_exit() */
+        ticks = MIN(NOHZ_MAX_TICKS, 0xffffffff / period - 2);
+        if (0 == smp_cpu_id()) {
+                if (!sched_cpus_idle()) {
+                        return;
+                }
+                ticks = timer_next(ticks);
+        }
+        /* Not worth it if the next tick would wake us anyway */
+        if (ticks < 2) {
+                return;
+        }
+
+        /* The part of a tick gone by since the last one is counted
+         * towards the first of the one-shot's; it is less than two */
+        nz->nz_carry += apic_timer_elapsed();
+        nz->nz_count = ticks * period - nz->nz_carry;
+        apic_enable_oneshot_timer(nz->nz_count);
+        nz->nz_stopped = 1;
+        nohz_sleeps++;
 }
 
-/* Uncomment this to enable the apic timer to 
- * call the pit_handler for userland preemption
+void time_idle_exit(void)
+{
+        nohz_t *nz = &nohz[smp_cpu_id()];
+        uint32_t period, elapsed, ticks;
+
+        if (!nz->nz_stopped) {
+                return;
+        }
+
+        period = apic_timer_period();
+        elapsed = apic_timer_elapsed();
+        apic_enable_periodic_timer(HZ);
+        nz->nz_stopped = 0;
+        nz->nz_expired = (elapsed == nz->nz_count);
+
+        elapsed += nz->nz_carry;
+        ticks = elapsed / period;
+        nz->nz_carry = elapsed % period;
+        nohz_avoided += ticks - nz->nz_expired;
+
+#ifdef __SMP__
+        smp_cpu()->cpu_ticks += ticks;
+        smp_cpu()->cpu_idle_ticks += ticks;
+#endif
+        if (0 == smp_cpu_id() && 0 != ticks) {
+                time_advance(ticks);
+        }
+}
+#endif /* __NOHZ__ */
+
+/*
+ * The clock keeps time, runs any kernel timers that are due, and charges
+ * the tick to the running thread. If that thread's slice is up it is
+ * switched out on the way back to userland (see __intr_handler()), never
+ * from here.
  */
+static void pit_handler(regs_t *regs)
+{
+#ifdef __NOHZ__
+        /* The one-shot timer ran out on an idle CPU, which has already
+         * caught up (see __intr_handler()) and has nothing to charge */
+        if (nohz[smp_cpu_id()].nz_expired) {
+                nohz[smp_cpu_id()].nz_expired = 0;
+                return;
+        }
+#endif
+        /* Every CPU has a clock, but only one of them keeps time */
+        if (0 == smp_cpu_id()) {
+                time_advance(1);
+        }
+        sched_account_tick(3 == (regs->r_cs & 3));
+#ifdef __UPREEMPT__
+        sched_tick();
+#endif
+}
 
 static __attribute__((unused)) void time_init(void)
 {
-  intr_map(APIC_TIMER_IRQ, APIC_TIMER_IRQ);
-  intr_register(APIC_TIMER_IRQ, pit_handler);
-  /* TODO: figure out how this argument converts to hertz */
-  apic_enable_periodic_timer(8);
+        uint32_t apic_hz;
+
+        clock_init(pit_calibrate(&apic_hz));
+        apic_set_timer_hz(apic_hz);
+
+        intr_map(APIC_TIMER_IRQ, APIC_TIMER_IRQ);
+        intr_register(APIC_TIMER_IRQ, pit_handler);
+        apic_enable_periodic_timer(HZ);
+        dbg(DBG_CORE, "clock ticks at %d Hz (%u APIC counts), time slices are %d ticks\n",
+            HZ, apic_timer_period(), SCHED_QUANTUM_TICKS);
 }
 init_func(time_init);
+init_depends(kdata_init);
+init_depends(timer_wheel_init);
 
-#endif
+void time_init_cpu(void)
+{
+        apic_enable_periodic_timer(HZ);
+}
@@ -0,0 +1,234 @@
+#include "kernel.h"
+
+#include "main/interrupt.h"
+
+#include "util/debug.h"
+#include "util/init.h"
+#include "util/time.h"
+#include "util/timer.h"
+
+/*
+ * The wheel has five levels. The first has a slot for each of the next
+ * 256 ticks; each of the others has 64 slots, each slot covering a whole
+ * turn of the level below it. A timer goes straight into the slot for
+ * its tick if that is less than a turn of the first level away, and
+ * otherwise into the coarsest slot that holds it. Whenever the first
+ * level comes round to slot 0, the next slot of the level above is
+ * emptied back into the wheel, which spreads its timers over the level
+ * below ("cascading"), and so on up. Between them the levels cover the
+ * whole 32-bit range of jiffies, and a timer is cascaded at most four
+ * times however far off it is.
+ *
+ * All of this is only touched with the IPL raised. Under SMP only CPU 0
+ * runs the wheel, and the kernel lock keeps the others out of it.
+ */
+#define TV1_BITS        8
+#define TVN_BITS        6
+#define TV1_SIZE        (1 << TV1_BITS)
+#define TVN_SIZE        (1 << TVN_BITS)
+#define TV1_MASK        (TV1_SIZE - 1)
+#define TVN_MASK        (TVN_SIZE - 1)
+#define TVN_LEVELS      4
+
+/* The slot of level n (0 being the first level above tv1) that t falls in */
+#define TVN_INDEX(t, n) (((t) >> (TV1_BITS + (n) * TVN_BITS)) & TVN_MASK)
+
+static list_t tv1[TV1_SIZE];
+static list_t tvn[TVN_LEVELS][TVN_SIZE];
+
+/* The next tick whose timers have not been run */
+static uint32_t timer_jiffies;
+
+static __attribute__((unused)) void
+timer_wheel_init(void)
+{
+        int i, n;
+
+        for (i = 0; i < TV1_SIZE; i++) {
+                list_init(&tv1[i]);
+        }
+        for (n = 0; n < TVN_LEVELS; n++) {
+                for (i = 0; i < TVN_SIZE; i++) {
+                        list_init(&tvn[n][i]);
+                }
+        }
+        timer_jiffies = jiffies;
+}
+init_func(timer_wheel_init);
+
+static void
+timer_enqueue(ktimer_t *t)
+{
+        uint32_t expires = t->t_expires;
+        uint32_t delta = expires - timer_jiffies;
+        list_t *slot;
+        int n;
+
+        if ((int32_t)delta < 0) {
+                /* Already due; it runs with the next tick */
+                slot = &tv1[timer_jiffies & TV1_MASK];
+        } else if (delta < TV1_SIZE) {
+                slot = &tv1[expires & TV1_MASK];
+        } else {
+                for (n = 0; n < TVN_LEVELS - 1; n++) {
+                        if (delta < 1U << (TV1_BITS + (n + 1) * TVN_BITS)) {
+                                break;
+                        }
+                }
+                slot = &tvn[n][TVN_INDEX(expires, n)];
+        }
+        list_insert_tail(slot, &t->t_link);
+}
+
+/*
+ * Spreads the timers of slot index of level n over the levels below.
+ * Returns index, so that the caller knows to go on to the level above
+ * when this level has come round to 0 as well.
+ */
+static int
+timer_cascade(int n, int index)
+{
+        list_t *slot = &tvn[n][index];
+        ktimer_t *t;
+
+        list_iterate_begin(slot, t, ktimer_t, t_link) {
+                list_remove(&t->t_link);
+                timer_enqueue(t);
+        } list_iterate_end();
+        KASSERT(list_empty(slot));
+        return index;
+}
+
+void
+timer_init(ktimer_t *t, timer_func_t func, void *arg)
+{
+        list_link_init(&t->t_link);
+        t->t_expires = 0;
+        t->t_func = func;
+        t->t_arg = arg;
+}
+
+void
+timer_add(ktimer_t *t, uint32_t ticks)
+{
+        uint8_t oldipl = intr_getipl();
+        intr_setipl(IPL_HIGH);
+
+        if (list_link_is_linked(&t->t_link)) {
+                list_remove(&t->t_link);
+        }
+        t->t_expires = jiffies + MIN(MAX(ticks, 1), TIMER_MAX_TICKS);
+        timer_enqueue(t);
+
+        intr_setipl(oldipl);
+}
+
+int
+timer_cancel(ktimer_t *t)
+{
+        int pending;
+        uint8_t oldipl = intr_getipl();
+        intr_setipl(IPL_HIGH);
+
+        if ((pending = list_link_is_linked(&t->t_link))) {
+                list_remove(&t->t_link);
+        }
+
+        intr_setipl(oldipl);
+        return pending;
+}
+
+uint32_t
+timer_remaining(ktimer_t *t)
+{
+        uint32_t left = 0;
+        uint8_t oldipl = intr_getipl();
+        intr_setipl(IPL_HIGH);
+
+        if (list_link_is_linked(&t->t_link) && (int32_t)(t->t_expires - jiffies) > 0) {
+                left = t->t_expires - jiffies;
+        }
+
+        intr_setipl(oldipl);
+        return left;
+}
+
+/*
+ * The first level is searched slot by slot. A timer on a coarser level
+ * cannot run before the first level next comes round to slot 0 and
+ * cascades it down, so if there are any, that is as far as we look. The
+ * coarser levels are not searched any further.
+ */
+uint32_t
+timer_next(uint32_t max)
+{
+        uint32_t ahead, k, limit = max;
+        int i, n;
+        uint8_t oldipl = intr_getipl();
+        intr_setipl(IPL_HIGH);
+
+        /* How many ticks from now timer_jiffies's timers run; normally 1 */
+        ahead = MAX(timer_jiffies - jiffies, 1);
+
+        for (n = 0; n < TVN_LEVELS; n++) {
+                for (i = 0; i < TVN_SIZE; i++) {
+                        if (!list_empty(&tvn[n][i])) {
+                                k = (TV1_SIZE - (timer_jiffies & TV1_MASK)) & TV1_MASK;
+                                limit = MIN(limit, ahead + k);
+                                n = TVN_LEVELS;
+                                break;
+                        }
+                }
+        }
+        for (k = 0; k < TV1_SIZE && ahead + k < limit; k++) {
+                if (!list_empty(&tv1[(timer_jiffies + k) & TV1_MASK])) {
+                        limit = ahead + k;
+                        break;
+                }
+        }
+
+        intr_setipl(oldipl);
+        return MAX(limit, 1);
+}
+
+/*
+ * Normally there is one tick to run, but there may be more if interrupts
+ * were off for a while. The slot is moved off the wheel before any of
+ * its timers run, so a callback that adds a timer can never have it run
+ * on this same tick.
+ */
+void
+timer_tick(void)
+{
+        list_t due;
+        list_t *slot;
+        ktimer_t *t;
+        int index;
+
+        while ((int32_t)(jiffies - timer_jiffies) >= 0) {
+                index = timer_jiffies & TV1_MASK;
+                if (0 == index
+                    && 0 == timer_cascade(0, TVN_INDEX(timer_jiffies, 0))
+                    && 0 == timer_cascade(1, TVN_INDEX(timer_jiffies, 1))
+                    && 0 == timer_cascade(2, TVN_INDEX(timer_jiffies, 2))) {
+                        timer_cascade(3, TVN_INDEX(timer_jiffies, 3));
+                }
+                timer_jiffies++;
+
+                slot = &tv1[index];
+                if (list_empty(slot)) {
+                        continue;
+                }
+                due.l_next = slot->l_next;
+                due.l_prev = slot->l_prev;
+                due.l_next->l_prev = &due;
+                due.l_prev->l_next = &due;
+                list_init(slot);
+
+                while (!list_empty(&due)) {
+                        t = list_head(&due, ktimer_t, t_link);
+                        list_remove(&t->t_link);
+                        t->t_func(t->t_arg);
+                }
+        }
+}
@@ -0,0 +1,190 @@
+#include "globals.h"
+#include "config.h"
+#include "kernel.h"
+
+#include "main/interrupt.h"
+
+#include "proc/kthread.h"
+#include "proc/proc.h"
+#include "proc/sched.h"
+
+#include "util/debug.h"
+#include "util/init.h"
+#include "util/workq.h"
+
+/*
+ * Both lists are only touched with the IPL raised, or with interrupts
+ * off, which is how the interrupt handler and the idle loop get here.
+ * Under SMP the kernel lock keeps the other CPUs out as well, so there
+ * is one of each for the whole machine rather than one per CPU. They
+ * are ready before any init function runs, as the disk driver defers
+ * work while the root file system is being mounted.
+ */
+static list_t deferred = { &deferred, &deferred };
+static list_t queued = { &queued, &queued };
+
+/* Whether work_run_deferred() is already running somewhere on the stack */
+static int deferred_running = 0;
+
+static proc_t *workerd[NWORKERS];
+static kthread_t *workerd_thr[NWORKERS];
+static ktqueue_t workerd_waitq;
+
+static void *workerd_run(int arg1, void *arg2);
+
+static __attribute__((unused)) void
+workq_init(void)
+{
+        int i;
+
+        sched_queue_init(&workerd_waitq);
+
+        KASSERT(NULL != curproc && (PID_IDLE == curproc->p_pid));
+        for (i = 0; i < NWORKERS; i++) {
+                workerd[i] = proc_create("workerd");
+                KASSERT(NULL != workerd[i]);
+                workerd_thr[i] = kthread_create(workerd[i], workerd_run, i, NULL);
+                KASSERT(NULL != workerd_thr[i]);
+                kthread_set_kernel_only(workerd_thr[i]);
+
+                sched_set_fixed_prio(workerd_thr[i], SCHED_PRIO_WORKERD);
+                sched_make_runnable(workerd_thr[i]);
+        }
+}
+init_func(workq_init);
+init_depends(sched_init);
+
+void
+work_init(work_t *w, work_func_t func, void *arg)
+{
+        list_link_init(&w->w_link);
+        w->w_func = func;
+        w->w_arg = arg;
+}
+
+void
+work_defer(work_t *w)
+{
+        uint8_t oldipl = intr_getipl();
+        intr_setipl(IPL_HIGH);
+
+        if (!list_link_is_linked(&w->w_link)) {
+                list_insert_tail(&deferred, &w->w_link);
+        }
+
+        intr_setipl(oldipl);
+}
+
+void
+work_queue(work_t *w)
+{
+        uint8_t oldipl = intr_getipl();
+        intr_setipl(IPL_HIGH);
+
+        if (!list_link_is_linked(&w->w_link)) {
+                list_insert_tail(&queued, &w->w_link);
+                sched_wakeup_on(&workerd_waitq);
+        }
+
+        intr_setipl(oldipl);
+}
+
+int
+work_cancel(work_t *w)
+{
+        int pending;
+        uint8_t oldipl = intr_getipl();
+        intr_setipl(IPL_HIGH);
+
+        if ((pending = list_link_is_linked(&w->w_link))) {
+                list_remove(&w->w_link);
+        }
+
+        intr_setipl(oldipl);
+        return pending;
+}
+
+int
+work_deferred_pending(void)
+{
+        return !list_empty(&deferred);
+}
+
+/*
+ * Interrupts are on while each piece of work runs, so the list is only
+ * looked at between them, with interrupts off again. Anything deferred
+ * meanwhile, even by the work that is running, is run before we return.
+ */
+void
+work_run_deferred(void)
+{
+        work_t *w;
+
+        KASSERT(IPL_LOW == intr_getipl());
+        if (deferred_running) {
+                return;
+        }
+        deferred_running = 1;
+
+        while (!list_empty(&deferred)) {
+                w = list_head(&deferred, work_t, w_link);
+                list_remove(&w->w_link);
+
+                intr_enable();
+                w->w_func(w->w_arg);
+                KASSERT(IPL_LOW == intr_getipl() && "deferred work left the IPL raised");
+                intr_disable();
+        }
+
+        deferred_running = 0;
+}
+
+/*
+ * A worker sleeps with the IPL raised, so nothing can be queued between
+ * its finding the list empty and its going to sleep. Each piece of work
+ * wakes one worker, which then runs whatever it finds, so a worker that
+ * is blocked in one piece does not hold up the rest while another is
+ * free.
+ */
+static void *
+workerd_run(int arg1, void *arg2)
+{
+        work_t *w;
+
+        intr_setipl(IPL_HIGH);
+        for (;;) {
+                while (list_empty(&queued)) {
+                        if (curthr->kt_cancelled
+                            || 0 > sched_cancellable_sleep_on(&workerd_waitq)) {
+                                intr_setipl(IPL_LOW);
+                                return NULL;
+                        }
+                }
+                w = list_head(&queued, work_t, w_link);
+                list_remove(&w->w_link);
+
+                intr_setipl(IPL_LOW);
+                w->w_func(w->w_arg);
+                intr_setipl(IPL_HIGH);
+        }
+        return NULL;
+}
+
+void
+workq_shutdown(void)
+{
+        pid_t pid, child;
+        int i;
+
+        KASSERT(PID_IDLE == curproc->p_pid);
+        for (i = 0; i < NWORKERS; i++) {
+                KASSERT(NULL != workerd_thr[i]);
+                kthread_cancel(workerd_thr[i], (void *)0);
+                workerd_thr[i] = NULL;
+        }
+        for (i = 0; i < NWORKERS; i++) {
+                pid = workerd[i]->p_pid;
+                child = do_waitpid(pid, 0, NULL);
+                KASSERT(child == pid && "waited on process other than workerd");
+        }
+}
@@ -72,7 +72,7 @@ do_mmap(void *addr, size_t len, int prot, int flags,
     int err = 0;
 
     if ((flags & MAP_ANON) == 0)  {
-        if (fd < 0 || fd >= NFILES) {
+        if (fd < 0 || fd >= curproc->p_nfiles) {
             return -EBADF;
         }
         file = fget(fd);
@@ -127,7 +127,9 @@ shadowd_init()
         KASSERT(NULL != shadowd_proc);
         shadowd_thr = kthread_create(shadowd_proc, shadowd, 0, NULL);
         KASSERT(NULL != shadowd_thr);
+        kthread_set_kernel_only(shadowd_thr);
 
+        sched_set_fixed_prio(shadowd_thr, SCHED_PRIO_SHADOWD);
         sched_make_runnable(shadowd_thr);
 
         shadowd_initialized = 1;
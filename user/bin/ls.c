@@ -15,9 +15,10 @@ static int do_ls(const char *dir)
         char            tmpbuf[256];
         struct stat     sbuf;
 
-        union {
+        /* big enough that a large directory takes only a few getdents */
+        static union {
                 struct dirent   dirent;
-                char            buf[4096];
+                char            buf[32768];
         } lsb;
 
         fd = open(dir, O_RDONLY, 0600);
@@ -774,6 +774,7 @@ static int do_cp(ioenv_t *io, const char *cmd,
                  const char *out_file, int out_fd)
 {
 #define buffer_sz 4096
+#define copy_sz   (16 * buffer_sz)
 
         static char             buffer[buffer_sz];
         int                     nbytes_in;
@@ -784,6 +785,20 @@ static int do_cp(ioenv_t *io, const char *cmd,
         if (is_std_stream(out_fd))
                 out_fd = io->io_map_fd[out_fd];
 
+        /* Let the kernel move the data without bouncing it through us;
+         * fall back to read/write if it can't. */
+        while ((nbytes_in = copy_file_range(in_fd, NULL, out_fd, NULL,
+                                            copy_sz, 0)) > 0)
+                ;
+        if (nbytes_in == 0)
+                return 1;
+        if (errno != ENOSYS && errno != EINVAL) {
+                fprintf(stderr,
+                        "%s: unable to copy %s to %s: %s\n",
+                        cmd, in_file, out_file, strerror(errno));
+                return 0;
+        }
+
         while ((nbytes_in = read(in_fd, buffer, buffer_sz)) > 0) {
                 if ((nbytes_out = write(out_fd, buffer, nbytes_in)) < 0) {
                         fprintf(stderr,
@@ -800,6 +815,7 @@ static int do_cp(ioenv_t *io, const char *cmd,
         }
         return 1;
 
+#undef copy_sz
 #undef buffer_sz
 }
 
@@ -0,0 +1 @@
+../../kernel/include/fs/poll.h
\ No newline at end of file
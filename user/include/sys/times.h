@@ -0,0 +1 @@
+../../../kernel/include/api/times.h
\ No newline at end of file
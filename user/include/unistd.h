@@ -14,6 +14,7 @@
 #endif
 
 struct dirent;
+struct iovec;
 
 /* User exec-related */
 int     fork(void);
@@ -32,6 +33,12 @@ void    thr_set_errno(int n);
 void    yield(void);
 pid_t   getpid(void);
 int     halt(void);
+int     setpriority(pid_t pid, int nice);
+int     getpriority(pid_t pid);
+int     nice(int incr);
+unsigned int sleep(unsigned int seconds);
+int     usleep(unsigned int usecs);
+unsigned int alarm(unsigned int seconds);
 void    sync(void);
 
 size_t  get_free_mem(void);
@@ -39,8 +46,19 @@ size_t  get_free_mem(void);
 /* VFS-related */
 int     open(const char *filename, int flags, int mode);
 int     close(int fd);
+int     fsync(int fd);
 int     read(int fd, void *buf, size_t nbytes);
 int     write(int fd, const void *buf, size_t nbytes);
+int     pread(int fd, void *buf, size_t nbytes, off_t offset);
+int     pwrite(int fd, const void *buf, size_t nbytes, off_t offset);
+int     readv(int fd, const struct iovec *iov, int iovcnt);
+int     writev(int fd, const struct iovec *iov, int iovcnt);
+int     copy_file_range(int fd_in, off_t *off_in, int fd_out, off_t *off_out,
+                        size_t len, unsigned int flags);
+int     sendfile(int out_fd, int in_fd, off_t *offset, size_t count);
+int     splice(int fd_in, off_t *off_in, int fd_out, off_t *off_out,
+               size_t len, unsigned int flags);
+int     vmsplice(int fd, const struct iovec *iov, int iovcnt, unsigned int flags);
 off_t   lseek(int fd, off_t offset, int whence);
 int     dup(int fd);
 int     dup2(int ofd, int nfd);
@@ -0,0 +1 @@
+../../../kernel/include/main/cpuid.h
\ No newline at end of file
@@ -0,0 +1 @@
+../../../kernel/include/api/futex.h
\ No newline at end of file
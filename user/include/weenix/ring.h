@@ -0,0 +1 @@
+../../../kernel/include/api/ring.h
\ No newline at end of file
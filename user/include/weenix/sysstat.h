@@ -0,0 +1 @@
+../../../kernel/include/api/sysstat.h
\ No newline at end of file
@@ -7,19 +7,65 @@
 
 #define TRAP_INTR_STRING QUOTE(INTR_SYSCALL)
 
-static inline int trap(uint32_t num, uint32_t arg)
+/* How trap() enters the kernel, chosen by __trap_select() on first use */
+#define TRAP_UNKNOWN    0
+#define TRAP_INT        1
+#define TRAP_SYSENTER   2
+
+extern int __trap_method;
+void __trap_select(void);
+
+static inline int __trap_int(uint32_t num, uint32_t arg)
 {
         int ret;
         __asm__ volatile(
                 "int $" TRAP_INTR_STRING
                 : "=a"(ret)
                 : "a"(num), "d"(arg)
+                : "memory"
         );
-        /* Copy in errno */
+        return ret;
+}
+
+/*
+ * To the kernel, sysenter looks like a call: it resumes at the return
+ * address on top of the stack we pass in ecx, with that address popped.
+ * It hands back our eip and esp in edx and ecx; every other register
+ * but eax is preserved.
+ */
+static inline int __trap_sysenter(uint32_t num, uint32_t arg)
+{
+        int ret;
         __asm__ volatile(
-                "int $" TRAP_INTR_STRING
-                : "=a"(errno)
-                : "a"(SYS_errno)
+                "call 1f\n\t"
+                "jmp 2f\n"
+                "1:\n\t"
+                "movl %%esp, %%ecx\n\t"
+                "sysenter\n"
+                "2:"
+                : "=a"(ret), "+d"(arg)
+                : "a"(num)
+                : "ecx", "memory", "cc"
         );
         return ret;
 }
+
+static inline int trap(uint32_t num, uint32_t arg)
+{
+        int ret;
+
+        if (TRAP_UNKNOWN == __trap_method) {
+                __trap_select();
+        }
+
+        if (TRAP_SYSENTER == __trap_method) {
+                ret = __trap_sysenter(num, arg);
+                /* Copy in errno */
+                errno = __trap_sysenter(SYS_errno, 0);
+        } else {
+                ret = __trap_int(num, arg);
+                /* Copy in errno */
+                errno = __trap_int(SYS_errno, 0);
+        }
+        return ret;
+}
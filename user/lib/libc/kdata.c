@@ -0,0 +1,81 @@
+/*
+ * Queries answered from the kernel data pages (see weenix/kdata.h)
+ * instead of with a system call.
+ */
+
+#include "sys/types.h"
+#include "sys/utsname.h"
+
+#include "string.h"
+#include "time.h"
+#include "unistd.h"
+
+#include "weenix/kdata.h"
+#include "weenix/trap.h"
+
+#define KDATA           ((const kdata_t *) KDATA_BASE)
+#define KDATA_PROC      ((const kdata_proc_t *) KDATA_PROC_BASE)
+
+pid_t getpid(void)
+{
+        return KDATA_PROC->kdp_pid;
+}
+
+int uname(struct utsname *buf)
+{
+        memcpy(buf, &KDATA->kd_utsname, sizeof(*buf));
+        return 0;
+}
+
+static inline uint64_t rdtsc(void)
+{
+        uint64_t t;
+        __asm__ volatile("rdtsc" : "=A"(t));
+        return t;
+}
+
+/*
+ * Nanoseconds of monotonic time, extrapolated from the kernel's last
+ * update with the TSC when the kernel says it can be trusted.
+ */
+uint64_t kdata_monotonic_ns(void)
+{
+        uint32_t seq, mult, shift;
+        uint64_t ns, stamp, tsc;
+
+        do {
+                while ((seq = KDATA->kd_seq) & 1) {
+                        ;
+                }
+                __asm__ volatile("" ::: "memory");
+                ns = KDATA->kd_mono_ns;
+                stamp = KDATA->kd_tsc_stamp;
+                mult = KDATA->kd_tsc_mult;
+                shift = KDATA->kd_tsc_shift;
+                tsc = rdtsc();
+                __asm__ volatile("" ::: "memory");
+        } while (seq != KDATA->kd_seq);
+
+        if (0 != mult && tsc > stamp) {
+                ns += ((tsc - stamp) * mult) >> shift;
+        }
+        return ns;
+}
+
+/* The monotonic clock needs no system call; anything else is refused */
+int clock_gettime(clockid_t clock, struct timespec *tp)
+{
+        clock_gettime_args_t args;
+        uint64_t ns;
+
+        if (CLOCK_MONOTONIC != clock) {
+                args.clock = clock;
+                args.tp = tp;
+                return trap(SYS_clock_gettime, (uint32_t) &args);
+        }
+
+        ns = kdata_monotonic_ns();
+        tp->tv_sec = (time_t)(ns / NSEC_PER_SEC);
+        tp->tv_nsec = (long)(ns % NSEC_PER_SEC);
+        return 0;
+}
@@ -0,0 +1,146 @@
+/*
+ * Mutexes and condition variables on top of futex(2); see
+ * pthread/pthread.h. The mutex is the three-state one from Drepper's
+ * "Futexes Are Tricky": a thread that finds it free takes it with a
+ * single compare-and-swap, and only a thread that finds it taken, or
+ * releases it when someone may be waiting, makes a system call.
+ */
+
+#include "errno.h"
+
+#include "pthread/pthread.h"
+#include "weenix/futex.h"
+
+/* Returns what *p held; stores val there if that was old */
+static int
+atomic_cmpxchg(volatile int *p, int old, int val)
+{
+        int prev;
+        __asm__ __volatile__("lock; cmpxchgl %2, %1"
+                             : "=a"(prev), "+m"(*p) : "r"(val), "0"(old) : "memory");
+        return prev;
+}
+
+/* Stores val in *p and returns what it held */
+static int
+atomic_xchg(volatile int *p, int val)
+{
+        __asm__ __volatile__("xchgl %0, %1" : "+r"(val), "+m"(*p) : : "memory");
+        return val;
+}
+
+static void
+atomic_add(volatile int *p, int val)
+{
+        __asm__ __volatile__("lock; addl %1, %0" : "+m"(*p) : "ir"(val) : "memory");
+}
+
+int pthread_mutex_init(pthread_mutex_t *mtx, const pthread_mutexattr_t *attr)
+{
+        mtx->pm_state = 0;
+        return 0;
+}
+
+int pthread_mutex_destroy(pthread_mutex_t *mtx)
+{
+        return (0 != mtx->pm_state) ? EBUSY : 0;
+}
+
+/*
+ * Once it has had to wait, a thread takes the mutex as 2 rather than 1,
+ * as it cannot know whether anyone else is still waiting; at worst that
+ * costs one needless wake-up when it unlocks.
+ */
+int pthread_mutex_lock(pthread_mutex_t *mtx)
+{
+        int c;
+
+        if (0 == (c = atomic_cmpxchg(&mtx->pm_state, 0, 1))) {
+                return 0;
+        }
+        if (2 != c) {
+                c = atomic_xchg(&mtx->pm_state, 2);
+        }
+        while (0 != c) {
+                futex((int *)&mtx->pm_state, FUTEX_WAIT, 2, NULL);
+                c = atomic_xchg(&mtx->pm_state, 2);
+        }
+        return 0;
+}
+
+int pthread_mutex_trylock(pthread_mutex_t *mtx)
+{
+        return (0 == atomic_cmpxchg(&mtx->pm_state, 0, 1)) ? 0 : EBUSY;
+}
+
+int pthread_mutex_unlock(pthread_mutex_t *mtx)
+{
+        int c = atomic_xchg(&mtx->pm_state, 0);
+
+        if (0 == c) {
+                return EPERM;
+        }
+        if (2 == c) {
+                futex((int *)&mtx->pm_state, FUTEX_WAKE, 1, NULL);
+        }
+        return 0;
+}
+
+int pthread_cond_init(pthread_cond_t *cond, const pthread_condattr_t *attr)
+{
+        cond->pc_seq = 0;
+        cond->pc_waiters = 0;
+        return 0;
+}
+
+int pthread_cond_destroy(pthread_cond_t *cond)
+{
+        return (0 != cond->pc_waiters) ? EBUSY : 0;
+}
+
+/*
+ * A waiter notes pc_seq while it still holds the mutex, and only sleeps
+ * if it has not changed, so a signal that comes after it unlocks is
+ * never lost. It counts itself in pc_waiters before that, so a signal
+ * that finds no waiters need not enter the kernel. Waking up may be
+ * spurious, as the caller must allow for anyway.
+ */
+int pthread_cond_wait(pthread_cond_t *cond, pthread_mutex_t *mtx)
+{
+        int seq;
+
+        atomic_add(&cond->pc_waiters, 1);
+        seq = cond->pc_seq;
+        pthread_mutex_unlock(mtx);
+
+        futex((int *)&cond->pc_seq, FUTEX_WAIT, seq, NULL);
+        atomic_add(&cond->pc_waiters, -1);
+
+        /* Others may have been woken along with us */
+        while (0 != atomic_xchg(&mtx->pm_state, 2)) {
+                futex((int *)&mtx->pm_state, FUTEX_WAIT, 2, NULL);
+        }
+        return 0;
+}
+
+int pthread_cond_signal(pthread_cond_t *cond)
+{
+        atomic_add(&cond->pc_seq, 1);
+        if (0 != cond->pc_waiters) {
+                futex((int *)&cond->pc_seq, FUTEX_WAKE, 1, NULL);
+        }
+        return 0;
+}
+
+/*
+ * Every waiter is woken to fight over the mutex; there is no requeueing
+ * them onto the mutex's futex instead.
+ */
+int pthread_cond_broadcast(pthread_cond_t *cond)
+{
+        atomic_add(&cond->pc_seq, 1);
+        if (0 != cond->pc_waiters) {
+                futex((int *)&cond->pc_seq, FUTEX_WAKE, 0x7fffffff, NULL);
+        }
+        return 0;
+}
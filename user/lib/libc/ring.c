@@ -0,0 +1,133 @@
+/*
+ * Helpers for driving a submission/completion ring; see weenix/ring.h for
+ * the shared layout.
+ */
+
+#include "sys/types.h"
+#include "sys/mman.h"
+
+#include "string.h"
+#include "unistd.h"
+
+#include "weenix/ring.h"
+
+int ring_init(ring_t *ring, unsigned int entries)
+{
+        void *addr;
+
+        if ((ring->r_fd = ring_setup(entries)) < 0) {
+                return -1;
+        }
+
+        addr = mmap(NULL, sizeof(ring_shared_t), PROT_READ | PROT_WRITE,
+                    MAP_SHARED, ring->r_fd, 0);
+        if (MAP_FAILED == addr) {
+                close(ring->r_fd);
+                return -1;
+        }
+
+        ring->r_shared = addr;
+        ring->r_mask = entries - 1;
+        ring->r_sq_pending = 0;
+        return 0;
+}
+
+void ring_destroy(ring_t *ring)
+{
+        munmap(ring->r_shared, sizeof(ring_shared_t));
+        close(ring->r_fd);
+}
+
+/*
+ * Returns a zeroed submission entry to fill in, or NULL if the submission
+ * queue is full. It is passed to the kernel by the next ring_submit().
+ */
+ring_sqe_t *ring_get_sqe(ring_t *ring)
+{
+        ring_shared_t *rs = ring->r_shared;
+        uint32_t tail = rs->rs_sq_tail + ring->r_sq_pending;
+        ring_sqe_t *sqe;
+
+        if (tail - rs->rs_sq_head > ring->r_mask) {
+                return NULL;
+        }
+
+        sqe = &rs->rs_sqes[tail & ring->r_mask];
+        memset(sqe, 0, sizeof(*sqe));
+        ring->r_sq_pending++;
+        return sqe;
+}
+
+/*
+ * Publish every entry obtained since the last submit and have the kernel
+ * consume them. Returns the number consumed, or -1 on error.
+ */
+int ring_submit(ring_t *ring)
+{
+        ring_shared_t *rs = ring->r_shared;
+        uint32_t queued;
+
+        rs->rs_sq_tail += ring->r_sq_pending;
+        ring->r_sq_pending = 0;
+
+        queued = rs->rs_sq_tail - rs->rs_sq_head;
+        if (0 == queued) {
+                return 0;
+        }
+        return ring_enter(ring->r_fd, queued);
+}
+
+/* Returns the oldest unconsumed completion, or NULL if there is none. */
+ring_cqe_t *ring_peek_cqe(ring_t *ring)
+{
+        ring_shared_t *rs = ring->r_shared;
+
+        if (rs->rs_cq_head == rs->rs_cq_tail) {
+                return NULL;
+        }
+        return &rs->rs_cqes[rs->rs_cq_head & ring->r_mask];
+}
+
+/* Hand the completion returned by ring_peek_cqe() back to the kernel. */
+void ring_cqe_seen(ring_t *ring)
+{
+        ring->r_shared->rs_cq_head++;
+}
+
+void ring_prep_read(ring_sqe_t *sqe, int fd, void *buf, size_t len, off_t off)
+{
+        sqe->sqe_opcode = RING_OP_READ;
+        sqe->sqe_fd = fd;
+        sqe->sqe_addr = buf;
+        sqe->sqe_len = len;
+        sqe->sqe_off = off;
+}
+
+void ring_prep_write(ring_sqe_t *sqe, int fd, const void *buf, size_t len, off_t off)
+{
+        sqe->sqe_opcode = RING_OP_WRITE;
+        sqe->sqe_fd = fd;
+        sqe->sqe_addr = (void *) buf;
+        sqe->sqe_len = len;
+        sqe->sqe_off = off;
+}
+
+void ring_prep_open(ring_sqe_t *sqe, const char *path, int flags)
+{
+        sqe->sqe_opcode = RING_OP_OPEN;
+        sqe->sqe_addr = (void *) path;
+        sqe->sqe_len = strlen(path);
+        sqe->sqe_open_flags = flags;
+}
+
+void ring_prep_close(ring_sqe_t *sqe, int fd)
+{
+        sqe->sqe_opcode = RING_OP_CLOSE;
+        sqe->sqe_fd = fd;
+}
+
+void ring_prep_fsync(ring_sqe_t *sqe, int fd)
+{
+        sqe->sqe_opcode = RING_OP_FSYNC;
+        sqe->sqe_fd = fd;
+}
@@ -6,8 +6,16 @@
 
 #include "unistd.h"
 #include "weenix/trap.h"
+#include "weenix/cpuid.h"
 
 #include "dirent.h"
+#include "sys/uio.h"
+#include "poll.h"
+#include "time.h"
+#include "sys/resource.h"
+#include "sys/times.h"
+#include "weenix/ring.h"
+#include "weenix/futex.h"
 
 static void *__curbrk = NULL;
 #define MAX_EXIT_HANDLERS 32
@@ -15,6 +23,16 @@ static void *__curbrk = NULL;
 static void     (*atexit_func[MAX_EXIT_HANDLERS])();
 static int      atexit_handlers = 0;
 
+int __trap_method = TRAP_UNKNOWN;
+
+/*
+ * Use sysenter when the CPU has it; the kernel makes the same check when
+ * it sets up the sysenter MSRs. Otherwise fall back to the interrupt.
+ */
+void __trap_select(void)
+{
+        __trap_method = cpuid_has_sysenter() ? TRAP_SYSENTER : TRAP_INT;
+}
 
 void *sbrk(intptr_t incr)
 {
@@ -125,14 +143,100 @@ void thr_exit(int status)
         trap(SYS_thr_exit, (uint32_t) status);
 }
 
-pid_t getpid(void)
+int halt(void)
 {
-        return trap(SYS_getpid, 0);
+        return trap(SYS_halt, 0);
 }
 
-int halt(void)
+int setpriority(pid_t pid, int nice)
 {
-        return trap(SYS_halt, 0);
+        setpriority_args_t args;
+
+        args.pid = pid;
+        args.nice = nice;
+
+        return trap(SYS_setpriority, (uint32_t) &args);
+}
+
+int getpriority(pid_t pid)
+{
+        int ret = trap(SYS_getpriority, (uint32_t) pid);
+
+        /* The kernel hands back 20 - nice to keep it positive */
+        return (ret < 0) ? ret : 20 - ret;
+}
+
+int nice(int incr)
+{
+        int ret = trap(SYS_getpriority, 0);
+
+        if (0 > ret || 0 > setpriority(0, 20 - ret + incr)) {
+                return -1;
+        }
+        return getpriority(0);
+}
+
+int nanosleep(const struct timespec *req, struct timespec *rem)
+{
+        nanosleep_args_t args;
+
+        args.req = req;
+        args.rem = rem;
+
+        return trap(SYS_nanosleep, (uint32_t) &args);
+}
+
+unsigned int sleep(unsigned int seconds)
+{
+        struct timespec req, rem;
+
+        req.tv_sec = seconds;
+        req.tv_nsec = 0;
+        if (0 > nanosleep(&req, &rem)) {
+                return rem.tv_sec + (0 != rem.tv_nsec);
+        }
+        return 0;
+}
+
+int usleep(unsigned int usecs)
+{
+        struct timespec req;
+
+        req.tv_sec = usecs / 1000000;
+        req.tv_nsec = (usecs % 1000000) * 1000;
+        return nanosleep(&req, NULL);
+}
+
+unsigned int alarm(unsigned int seconds)
+{
+        return (unsigned int) trap(SYS_alarm, (uint32_t) seconds);
+}
+
+int getrusage(int who, struct rusage *usage)
+{
+        getrusage_args_t args;
+
+        args.who = who;
+        args.ru = usage;
+
+        return trap(SYS_getrusage, (uint32_t) &args);
+}
+
+clock_t times(struct tms *buf)
+{
+        return (clock_t) trap(SYS_times, (uint32_t) buf);
+}
+
+int futex(int *uaddr, int op, int val, const struct timespec *timeout)
+{
+        futex_args_t args;
+
+        args.uaddr = uaddr;
+        args.op = op;
+        args.val = val;
+        args.timeout = timeout;
+
+        return trap(SYS_futex, (uint32_t) &args);
 }
 
 void *mmap(void *addr, size_t len, int prot, int flags, int fd, off_t off)
@@ -211,11 +315,135 @@ int write(int fd, const void *buf, size_t nbytes)
         return trap(SYS_write, (uint32_t) &args);
 }
 
+int pread(int fd, void *buf, size_t nbytes, off_t offset)
+{
+        pread_args_t args;
+
+        args.fd = fd;
+        args.buf = buf;
+        args.nbytes = nbytes;
+        args.offset = offset;
+
+        return trap(SYS_pread, (uint32_t) &args);
+}
+
+int pwrite(int fd, const void *buf, size_t nbytes, off_t offset)
+{
+        pwrite_args_t args;
+
+        args.fd = fd;
+        args.buf = (void *) buf;
+        args.nbytes = nbytes;
+        args.offset = offset;
+
+        return trap(SYS_pwrite, (uint32_t) &args);
+}
+
+int readv(int fd, const struct iovec *iov, int iovcnt)
+{
+        readv_args_t args;
+
+        args.fd = fd;
+        args.iov = iov;
+        args.iovcnt = iovcnt;
+
+        return trap(SYS_readv, (uint32_t) &args);
+}
+
+int writev(int fd, const struct iovec *iov, int iovcnt)
+{
+        writev_args_t args;
+
+        args.fd = fd;
+        args.iov = iov;
+        args.iovcnt = iovcnt;
+
+        return trap(SYS_writev, (uint32_t) &args);
+}
+
+int copy_file_range(int fd_in, off_t *off_in, int fd_out, off_t *off_out,
+                    size_t len, unsigned int flags)
+{
+        copy_file_range_args_t args;
+
+        args.fd_in = fd_in;
+        args.off_in = off_in;
+        args.fd_out = fd_out;
+        args.off_out = off_out;
+        args.len = len;
+        args.flags = flags;
+
+        return trap(SYS_copy_file_range, (uint32_t) &args);
+}
+
+int sendfile(int out_fd, int in_fd, off_t *offset, size_t count)
+{
+        return copy_file_range(in_fd, offset, out_fd, NULL, count, 0);
+}
+
+int splice(int fd_in, off_t *off_in, int fd_out, off_t *off_out,
+           size_t len, unsigned int flags)
+{
+        splice_args_t args;
+
+        args.fd_in = fd_in;
+        args.off_in = off_in;
+        args.fd_out = fd_out;
+        args.off_out = off_out;
+        args.len = len;
+        args.flags = flags;
+
+        return trap(SYS_splice, (uint32_t) &args);
+}
+
+int vmsplice(int fd, const struct iovec *iov, int iovcnt, unsigned int flags)
+{
+        vmsplice_args_t args;
+
+        args.fd = fd;
+        args.iov = iov;
+        args.iovcnt = iovcnt;
+        args.flags = flags;
+
+        return trap(SYS_vmsplice, (uint32_t) &args);
+}
+
+int poll(struct pollfd *fds, nfds_t nfds, int timeout)
+{
+        poll_args_t args;
+
+        args.fds = fds;
+        args.nfds = nfds;
+        args.timeout = timeout;
+
+        return trap(SYS_poll, (uint32_t) &args);
+}
+
 int close(int fd)
 {
         return trap(SYS_close, (uint32_t) fd);
 }
 
+int fsync(int fd)
+{
+        return trap(SYS_fsync, (uint32_t) fd);
+}
+
+int ring_setup(unsigned int entries)
+{
+        return trap(SYS_ring_setup, (uint32_t) entries);
+}
+
+int ring_enter(int fd, unsigned int to_submit)
+{
+        ring_enter_args_t args;
+
+        args.fd = fd;
+        args.to_submit = to_submit;
+
+        return trap(SYS_ring_enter, (uint32_t) &args);
+}
+
 int dup(int fd)
 {
         return trap(SYS_dup, (uint32_t) fd);
@@ -401,12 +629,6 @@ pipe(int pipefd[2])
         return trap(SYS_pipe, (uint32_t) pipefd);
 }
 
-int
-uname(struct utsname *buf)
-{
-        return trap(SYS_uname, (uint32_t) buf);
-}
-
 int
 debug(const char *str)
 {
@@ -0,0 +1,40 @@
+/*
+ * Runs a command with its nice value adjusted, or prints the current
+ * nice value. Higher values get less of the CPU.
+ *
+ * Usage: nice [-n increment] command [args...]
+ *            Run command with increment (10 by default) added to our
+ *            nice value.
+ *        nice
+ *            Print our nice value.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+int main(int argc, char **argv, char **envp)
+{
+        int incr = 10;
+
+        if (argc == 1) {
+                printf("%d\n", getpriority(0));
+                return 0;
+        }
+        if (0 == strcmp(argv[1], "-n")) {
+                if (argc < 4) {
+                        fprintf(stderr, "USAGE: nice [-n increment] command [args...]\n");
+                        return 1;
+                }
+                incr = atoi(argv[2]);
+                argv += 2;
+        }
+
+        if (0 > setpriority(0, getpriority(0) + incr)) {
+                fprintf(stderr, "nice: cannot change priority\n");
+        }
+        execve(argv[1], argv + 1, envp);
+        fprintf(stderr, "nice: cannot execute %s\n", argv[1]);
+        return 127;
+}
@@ -0,0 +1,204 @@
+/*
+ * Prints a summary of the system calls a program makes, from the kernel's
+ * counters in /dev/sysstat: how many calls to each syscall, how many
+ * failed, and how long they took, in TSC cycles.
+ *
+ * Usage: syscount command [args...]
+ *            Run command and summarize the calls made by it (and by any
+ *            other process but this one) until it exits.
+ *        syscount -p pid
+ *            Summarize the calls made so far by a live process.
+ *        syscount
+ *            Summarize the calls made system-wide since the last reset.
+ *        syscount -r
+ *            Reset the counters.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+
+#include <weenix/sysstat.h>
+
+#define SYSSTAT_DEV     "/dev/sysstat"
+#define SLOTS           (SYSSTAT_NSYS + 1)
+
+/* The records of one process (or of the whole system), by syscall */
+typedef struct counts {
+        sysstat_rec_t   c_total;
+        sysstat_rec_t   c_sys[SLOTS];
+} counts_t;
+
+static void
+snapshot(pid_t pid, counts_t *c)
+{
+        sysstat_rec_t rec;
+        int fd;
+
+        memset(c, 0, sizeof(*c));
+        if (0 > (fd = open(SYSSTAT_DEV, O_RDONLY, 0))) {
+                fprintf(stderr, "syscount: cannot open %s\n", SYSSTAT_DEV);
+                exit(1);
+        }
+        while (sizeof(rec) == read(fd, &rec, sizeof(rec))) {
+                if (rec.ss_pid != pid) {
+                        continue;
+                }
+                if (SYSSTAT_ALL == rec.ss_sysnum) {
+                        c->c_total = rec;
+                } else if (rec.ss_sysnum >= 0 && rec.ss_sysnum < SLOTS) {
+                        c->c_sys[rec.ss_sysnum] = rec;
+                }
+        }
+        close(fd);
+}
+
+/* a -= b, with a name kept from either */
+static void
+subtract(sysstat_rec_t *a, const sysstat_rec_t *b)
+{
+        int i;
+
+        if ('\0' == a->ss_name[0]) {
+                memcpy(a->ss_name, b->ss_name, sizeof(a->ss_name));
+        }
+        a->ss_calls -= b->ss_calls;
+        a->ss_errors -= b->ss_errors;
+        a->ss_cycles -= b->ss_cycles;
+        for (i = 0; i < SYSSTAT_HIST_BUCKETS; i++) {
+                a->ss_hist[i] -= b->ss_hist[i];
+        }
+}
+
+static void
+counts_subtract(counts_t *a, const counts_t *b)
+{
+        int i;
+
+        subtract(&a->c_total, &b->c_total);
+        for (i = 0; i < SLOTS; i++) {
+                subtract(&a->c_sys[i], &b->c_sys[i]);
+        }
+}
+
+static void
+print_row(const sysstat_rec_t *rec, unsigned long long total)
+{
+        unsigned long long permille = total ? rec->ss_cycles * 1000 / total : 0;
+
+        printf("%3llu.%llu %14llu %12llu %9u %9u %s\n",
+               permille / 10, permille % 10, rec->ss_cycles,
+               rec->ss_calls ? rec->ss_cycles / rec->ss_calls : 0,
+               rec->ss_calls, rec->ss_errors, rec->ss_name);
+}
+
+static void
+print_summary(counts_t *c)
+{
+        int done[SLOTS];
+        int i, best;
+
+        printf("%% time         cycles  cycles/call     calls    errors syscall\n");
+        printf("------ -------------- ------------ --------- --------- ----------------\n");
+
+        /* Busiest first */
+        memset(done, 0, sizeof(done));
+        for (;;) {
+                best = -1;
+                for (i = 0; i < SLOTS; i++) {
+                        if (!done[i] && 0 != c->c_sys[i].ss_calls
+                            && (-1 == best || c->c_sys[i].ss_cycles > c->c_sys[best].ss_cycles)) {
+                                best = i;
+                        }
+                }
+                if (-1 == best) {
+                        break;
+                }
+                print_row(&c->c_sys[best], c->c_total.ss_cycles);
+                done[best] = 1;
+        }
+
+        printf("------ -------------- ------------ --------- --------- ----------------\n");
+        print_row(&c->c_total, c->c_total.ss_cycles);
+
+        printf("\nlatency (cycles)           calls\n");
+        for (i = 0; i < SYSSTAT_HIST_BUCKETS; i++) {
+                if (0 != c->c_total.ss_hist[i]) {
+                        printf("  %10u - %10u %9u\n", 1U << i,
+                               (i == SYSSTAT_HIST_BUCKETS - 1) ? ~0U : (2U << i) - 1,
+                               c->c_total.ss_hist[i]);
+                }
+        }
+}
+
+static void
+usage(void)
+{
+        fprintf(stderr, "USAGE: syscount [-r | -p pid | command [args...]]\n");
+        exit(1);
+}
+
+int main(int argc, char **argv, char **envp)
+{
+        static counts_t sys_before, sys_after, self_before, self_after;
+        pid_t self = getpid();
+        pid_t child;
+        int fd, status;
+
+        if (argc == 1) {
+                snapshot(SYSSTAT_SYSTEM, &sys_after);
+                print_summary(&sys_after);
+                return 0;
+        }
+        if (0 == strcmp(argv[1], "-r")) {
+                if (argc != 2) {
+                        usage();
+                }
+                if (0 > (fd = open(SYSSTAT_DEV, O_WRONLY, 0)) || 1 != write(fd, "", 1)) {
+                        fprintf(stderr, "syscount: cannot reset %s\n", SYSSTAT_DEV);
+                        return 1;
+                }
+                close(fd);
+                return 0;
+        }
+        if (0 == strcmp(argv[1], "-p")) {
+                if (argc != 3) {
+                        usage();
+                }
+                snapshot(atoi(argv[2]), &sys_after);
+                if (0 == sys_after.c_total.ss_calls) {
+                        fprintf(stderr, "syscount: no calls recorded for process %s\n", argv[2]);
+                        return 1;
+                }
+                print_summary(&sys_after);
+                return 0;
+        }
+
+        /*
+         * The child's own counters go away when we reap it, so count
+         * everything made system-wide while it runs, less what we do.
+         */
+        snapshot(SYSSTAT_SYSTEM, &sys_before);
+        snapshot(self, &self_before);
+
+        if (0 == (child = fork())) {
+                execve(argv[1], argv + 1, envp);
+                fprintf(stderr, "syscount: cannot execute %s\n", argv[1]);
+                exit(127);
+        } else if (0 > child) {
+                fprintf(stderr, "syscount: fork failed\n");
+                return 1;
+        }
+        waitpid(child, 0, &status);
+
+        snapshot(self, &self_after);
+        snapshot(SYSSTAT_SYSTEM, &sys_after);
+
+        counts_subtract(&sys_after, &sys_before);
+        counts_subtract(&self_after, &self_before);
+        counts_subtract(&sys_after, &self_after);
+        print_summary(&sys_after);
+        return 0;
+}
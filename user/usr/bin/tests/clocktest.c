@@ -0,0 +1,142 @@
+/*
+ * Tests the monotonic clock: that it never goes back, that it keeps time
+ * with nanosleep(), that the answer libc reads from the kernel data page
+ * agrees with the one from the system call, and that clocks we do not
+ * have are refused. Also prints what a clock_gettime() costs either way.
+ */
+
+#include <errno.h>
+#include <stdio.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <weenix/syscall.h>
+#include <weenix/trap.h>
+
+#include <test/test.h>
+
+#define syscall_success(expr)                                                                   \
+        test_assert(0 <= (expr), "\nunexpected error: %s (%d)",                                 \
+                    test_errstr(errno), errno)
+
+#define NSEC_PER_MSEC   1000000LL
+#define ITERATIONS      1000
+
+static unsigned long long
+rdtsc(void)
+{
+        unsigned long long t;
+        __asm__ __volatile__("rdtsc" : "=A"(t));
+        return t;
+}
+
+static long long
+ts_ns(const struct timespec *ts)
+{
+        return (long long)ts->tv_sec * NSEC_PER_SEC + ts->tv_nsec;
+}
+
+/* Always asks the kernel, skipping libc's fast path */
+static int
+sys_clock_gettime(clockid_t clock, struct timespec *tp)
+{
+        clock_gettime_args_t args;
+
+        args.clock = clock;
+        args.tp = tp;
+        return trap(SYS_clock_gettime, (uint32_t) &args);
+}
+
+static void
+test_monotonic(void)
+{
+        struct timespec ts;
+        long long last = 0, now;
+        int i;
+
+        for (i = 0; i < ITERATIONS; i++) {
+                syscall_success(clock_gettime(CLOCK_MONOTONIC, &ts));
+                test_assert(0 <= ts.tv_nsec && ts.tv_nsec < NSEC_PER_SEC,
+                            "tv_nsec out of range: %ld", ts.tv_nsec);
+                now = ts_ns(&ts);
+                test_assert(now >= last, "clock went back by %lld ns", last - now);
+                last = now;
+        }
+}
+
+static void
+test_sleep(void)
+{
+        struct timespec before, after, req;
+        long long slept;
+
+        req.tv_sec = 0;
+        req.tv_nsec = 100 * NSEC_PER_MSEC;
+        syscall_success(clock_gettime(CLOCK_MONOTONIC, &before));
+        syscall_success(nanosleep(&req, NULL));
+        syscall_success(clock_gettime(CLOCK_MONOTONIC, &after));
+
+        slept = ts_ns(&after) - ts_ns(&before);
+        test_assert(slept >= 100 * NSEC_PER_MSEC, "100ms sleep measured as %lld ns", slept);
+        test_assert(slept < 1000 * NSEC_PER_MSEC, "100ms sleep measured as %lld ns", slept);
+        printf("  100ms sleep measured as %lld ns\n", slept);
+}
+
+/* The fast path and the system call read the same clock */
+static void
+test_agree(void)
+{
+        struct timespec a, b, c;
+
+        syscall_success(clock_gettime(CLOCK_MONOTONIC, &a));
+        syscall_success(sys_clock_gettime(CLOCK_MONOTONIC, &b));
+        syscall_success(clock_gettime(CLOCK_MONOTONIC, &c));
+        test_assert(ts_ns(&a) <= ts_ns(&b) && ts_ns(&b) <= ts_ns(&c),
+                    "system call says %lld ns, libc %lld then %lld ns",
+                    ts_ns(&b), ts_ns(&a), ts_ns(&c));
+}
+
+static void
+test_errors(void)
+{
+        struct timespec ts;
+
+        test_assert(-1 == clock_gettime(0, &ts) && EINVAL == errno, "no EINVAL for clock 0");
+        test_assert(-1 == clock_gettime(42, &ts) && EINVAL == errno, "no EINVAL for clock 42");
+        test_assert(-1 == sys_clock_gettime(CLOCK_MONOTONIC, NULL) && EFAULT == errno,
+                    "no EFAULT for NULL");
+}
+
+static void
+bench(void)
+{
+        struct timespec ts;
+        unsigned long long t, fast, slow;
+        int i;
+
+        t = rdtsc();
+        for (i = 0; i < ITERATIONS; i++) {
+                clock_gettime(CLOCK_MONOTONIC, &ts);
+        }
+        fast = (rdtsc() - t) / ITERATIONS;
+        t = rdtsc();
+        for (i = 0; i < ITERATIONS; i++) {
+                sys_clock_gettime(CLOCK_MONOTONIC, &ts);
+        }
+        slow = (rdtsc() - t) / ITERATIONS;
+        printf("  clock_gettime: %llu cycles from libc, %llu by system call\n", fast, slow);
+}
+
+int main(int argc, char **argv)
+{
+        test_init();
+
+        test_monotonic();
+        test_sleep();
+        test_agree();
+        test_errors();
+        bench();
+
+        test_fini();
+        return 0;
+}
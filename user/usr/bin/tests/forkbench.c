@@ -0,0 +1,99 @@
+/*
+ * Measures fork+exit throughput: how long it takes to fork a child that
+ * exits at once and reap it, on average, over several rounds. A round
+ * may fork its children one at a time or all together before reaping
+ * any, which keeps many threads (and their kernel stacks) alive at once.
+ * Times are in TSC cycles.
+ *
+ * Usage: forkbench [children per round]
+ */
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <test/test.h>
+
+#define syscall_success(expr)                                                                   \
+        test_assert(0 <= (expr), "\nunexpected error: %s (%d)",                                 \
+                    test_errstr(errno), errno)
+
+#define DEFAULT_CHILDREN        64
+#define MAX_CHILDREN            256
+#define ROUNDS                  4
+
+static unsigned long long
+rdtsc(void)
+{
+        unsigned long long t;
+        __asm__ __volatile__("rdtsc" : "=A"(t));
+        return t;
+}
+
+/* Forks and reaps n children one after another */
+static unsigned long long
+serial(int n)
+{
+        unsigned long long start;
+        int i, status;
+        pid_t pid;
+
+        start = rdtsc();
+        for (i = 0; i < n; i++) {
+                syscall_success(pid = fork());
+                if (0 == pid) {
+                        exit(0);
+                }
+                syscall_success(waitpid(pid, 0, &status));
+                test_assert(0 == status, "child %d exited with %d", i, status);
+        }
+        return rdtsc() - start;
+}
+
+/* Forks n children, then reaps them all */
+static unsigned long long
+batch(int n)
+{
+        static pid_t pids[MAX_CHILDREN];
+        unsigned long long start;
+        int i, status;
+
+        start = rdtsc();
+        for (i = 0; i < n; i++) {
+                syscall_success(pids[i] = fork());
+                if (0 == pids[i]) {
+                        exit(0);
+                }
+        }
+        for (i = 0; i < n; i++) {
+                syscall_success(waitpid(pids[i], 0, &status));
+                test_assert(0 == status, "child %d exited with %d", i, status);
+        }
+        return rdtsc() - start;
+}
+
+int main(int argc, char **argv)
+{
+        unsigned long long s, b;
+        int n = DEFAULT_CHILDREN;
+        int r;
+
+        if (argc > 2 || (argc == 2 && ((n = atoi(argv[1])) <= 0 || n > MAX_CHILDREN))) {
+                fprintf(stderr, "USAGE: forkbench [children per round, at most %d]\n", MAX_CHILDREN);
+                return 1;
+        }
+
+        test_init();
+
+        printf("%d children per round, cycles per fork+exit+wait:\n", n);
+        printf("round      serial       batch\n");
+        for (r = 0; r < ROUNDS; r++) {
+                s = serial(n);
+                b = batch(n);
+                printf("  %3d %11llu %11llu\n", r, s / n, b / n);
+        }
+
+        test_fini();
+        return 0;
+}
@@ -2,23 +2,51 @@
 #include <fcntl.h>
 #include <unistd.h>
 #include <stdlib.h>
+#include <string.h>
 
-/* TODO add options for different ways of forkbombing
-   (kind of low priority but would be fun) */
+/*
+ * Usage: forkbomb
+ *        forkbomb -t [processes]
+ *
+ * With no options, forks a chain of processes, each exiting as soon as
+ * it has forked the next, for as long as it can, and reports how long
+ * forking took over every FORKS_PER_REPORT forks. With -t, forks the
+ * given number of processes, all alive at once, and reports how long
+ * each batch of forks took and how long looking up a PID took as the
+ * number of processes grew; neither should grow with it. Times are in
+ * TSC cycles.
+ */
 
-int main(int argc, char **argv)
+#define FORKS_PER_REPORT        1000
+#define DEFAULT_WIDE            2000
+#define WIDE_BATCH              250
+#define LOOKUPS                 1000
+
+static unsigned long long
+rdtsc(void)
+{
+        unsigned long long t;
+        __asm__ __volatile__("rdtsc" : "=A"(t));
+        return t;
+}
+
+static int storm(void)
 {
         int n = 1;
         pid_t pid;
+        unsigned long long start = rdtsc(), now;
 
-        open("/dev/tty0", O_RDONLY, 0);
-        open("/dev/tty0", O_WRONLY, 0);
         printf("Forking up a storm!\n");
         printf("If this runs for 10 minutes without crashing, then you ");
         printf("probably aren't \nleaking resources\n");
         if (!fork()) {
                 for (;;) {
-                        printf("I am fork number %d\n", n);
+                        if (0 == n % FORKS_PER_REPORT) {
+                                now = rdtsc();
+                                printf("I am fork number %d: %llu cycles per fork\n",
+                                       n, (now - start) / FORKS_PER_REPORT);
+                                start = now;
+                        }
                         if ((pid = fork())) {
                                 /* parent */
                                 /* pid should be > 2 or pid should be -1 if
@@ -40,3 +68,69 @@ int main(int argc, char **argv)
         }
         return 0;
 }
+
+/*
+ * Every child waits to read from a pipe that nobody writes to, and exits
+ * when the parent closes it. Looking up a PID is timed with
+ * getpriority() on the most recent child.
+ */
+static int wide(int n)
+{
+        int fds[2], i, j, batch = 0, status;
+        pid_t pid = 0;
+        unsigned long long start, t, lookup;
+        char c;
+
+        if (0 > pipe(fds)) {
+                printf("pipe failed\n");
+                return 1;
+        }
+
+        printf("%8s %16s %16s\n", "procs", "cycles/fork", "cycles/lookup");
+        start = rdtsc();
+        for (i = 1; i <= n; i++) {
+                if (0 > (pid = fork())) {
+                        printf("fork %d failed, stopping there\n", i);
+                        n = i - 1;
+                        break;
+                }
+                if (0 == pid) {
+                        close(fds[1]);
+                        read(fds[0], &c, 1);
+                        exit(0);
+                }
+                if (++batch == WIDE_BATCH || i == n) {
+                        t = (rdtsc() - start) / batch;
+                        lookup = rdtsc();
+                        for (j = 0; j < LOOKUPS; j++) {
+                                getpriority(pid);
+                        }
+                        lookup = (rdtsc() - lookup) / LOOKUPS;
+                        printf("%8d %16llu %16llu\n", i, t, lookup);
+                        batch = 0;
+                        start = rdtsc();
+                }
+        }
+
+        close(fds[0]);
+        close(fds[1]);
+        start = rdtsc();
+        for (i = 0; i < n; i++) {
+                wait(&status);
+        }
+        if (n > 0) {
+                printf("reaped %d: %llu cycles each\n", n, (rdtsc() - start) / n);
+        }
+        return 0;
+}
+
+int main(int argc, char **argv)
+{
+        open("/dev/tty0", O_RDONLY, 0);
+        open("/dev/tty0", O_WRONLY, 0);
+
+        if (argc > 1 && 0 == strcmp(argv[1], "-t")) {
+                return wide((argc > 2) ? atoi(argv[2]) : DEFAULT_WIDE);
+        }
+        return storm();
+}
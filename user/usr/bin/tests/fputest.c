@@ -0,0 +1,308 @@
+/*
+ * Checks that the FPU and SSE registers are each process's own, which the
+ * kernel only saves and loads when it must (see kernel/include/main/fpu.h):
+ *
+ *  - several processes keep different values in the SSE registers and
+ *    different x87 and SSE control words while yielding to each other;
+ *  - a forked child starts with its parent's registers, and the parent
+ *    keeps them;
+ *  - a program starts with fresh registers, whatever the process that
+ *    called exec had in them.
+ *
+ * Then it measures a round trip between two processes taking turns
+ * through a pipe, with neither, one or both of them using SSE in between.
+ * Only when both do should the registers have to be saved each time.
+ * Times are in TSC cycles.
+ *
+ * Usage: fputest [processes]
+ */
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <weenix/cpuid.h>
+
+#include <test/test.h>
+
+#define syscall_success(expr)                                                                   \
+        test_assert(0 <= (expr), "\nunexpected error: %s (%d)",                                 \
+                    test_errstr(errno), errno)
+
+#define DEFAULT_PROCS   4
+#define MAX_PROCS       16
+#define YIELDS          200
+#define ROUND_TRIPS     2000
+
+#define NXMM            8
+#define XMM_WORDS       (NXMM * 4)
+
+#define FPUTEST_PATH    "/usr/bin/fputest"
+#define CHILD_ARG       "-i"
+
+static char *child_argv[] = { FPUTEST_PATH, CHILD_ARG, NULL };
+static char *child_envp[] = { NULL };
+
+static unsigned long long
+rdtsc(void)
+{
+        unsigned long long t;
+        __asm__ __volatile__("rdtsc" : "=A"(t));
+        return t;
+}
+
+static void
+xmm_load(const unsigned int *v)
+{
+        __asm__ __volatile__("movups   0(%0), %%xmm0\n\t"
+                             "movups  16(%0), %%xmm1\n\t"
+                             "movups  32(%0), %%xmm2\n\t"
+                             "movups  48(%0), %%xmm3\n\t"
+                             "movups  64(%0), %%xmm4\n\t"
+                             "movups  80(%0), %%xmm5\n\t"
+                             "movups  96(%0), %%xmm6\n\t"
+                             "movups 112(%0), %%xmm7"
+                             :: "r"(v) : "memory");
+}
+
+static void
+xmm_store(unsigned int *v)
+{
+        __asm__ __volatile__("movups %%xmm0,   0(%0)\n\t"
+                             "movups %%xmm1,  16(%0)\n\t"
+                             "movups %%xmm2,  32(%0)\n\t"
+                             "movups %%xmm3,  48(%0)\n\t"
+                             "movups %%xmm4,  64(%0)\n\t"
+                             "movups %%xmm5,  80(%0)\n\t"
+                             "movups %%xmm6,  96(%0)\n\t"
+                             "movups %%xmm7, 112(%0)"
+                             :: "r"(v) : "memory");
+}
+
+static unsigned short
+fcw_get(void)
+{
+        unsigned short cw;
+        __asm__ __volatile__("fnstcw %0" : "=m"(cw));
+        return cw;
+}
+
+static void
+fcw_set(unsigned short cw)
+{
+        __asm__ __volatile__("fldcw %0" :: "m"(cw));
+}
+
+static unsigned int
+mxcsr_get(void)
+{
+        unsigned int csr;
+        __asm__ __volatile__("stmxcsr %0" : "=m"(csr));
+        return csr;
+}
+
+static void
+mxcsr_set(unsigned int csr)
+{
+        __asm__ __volatile__("ldmxcsr %0" :: "m"(csr));
+}
+
+static void
+xmm_pattern(unsigned int *v, unsigned int seed)
+{
+        int i;
+
+        for (i = 0; i < XMM_WORDS; i++) {
+                v[i] = seed * 0x9e3779b9 + i;
+        }
+}
+
+static int
+xmm_check(const unsigned int *want)
+{
+        unsigned int got[XMM_WORDS];
+
+        xmm_store(got);
+        return 0 == memcmp(got, want, sizeof(got));
+}
+
+/* Fresh registers have every exception masked and round to nearest */
+static void
+test_initial(void)
+{
+        pid_t pid;
+        int status;
+
+        syscall_success(pid = fork());
+        if (0 == pid) {
+                execve(FPUTEST_PATH, child_argv, child_envp);
+                exit(2);
+        }
+        syscall_success(waitpid(pid, 0, &status));
+        test_assert(0 == status, "a new program did not start with fresh registers");
+}
+
+static int
+check_initial(void)
+{
+        unsigned int zero[XMM_WORDS];
+
+        memset(zero, 0, sizeof(zero));
+        if (0x037f != fcw_get() || 0x1f80 != (mxcsr_get() & 0xffff) || !xmm_check(zero)) {
+                return 1;
+        }
+        return 0;
+}
+
+/*
+ * Each process uses its own rounding modes, so a control word left
+ * behind by another process is noticed as well.
+ */
+static int
+juggle(int me)
+{
+        unsigned int want[XMM_WORDS];
+        unsigned short cw = 0x037f | ((me & 3) << 10);
+        unsigned int csr = 0x1f80 | (((me + 1) & 3) << 13);
+        int i;
+
+        xmm_pattern(want, me + 1);
+        xmm_load(want);
+        fcw_set(cw);
+        mxcsr_set(csr);
+        for (i = 0; i < YIELDS; i++) {
+                yield();
+                if (!xmm_check(want) || cw != fcw_get() || csr != mxcsr_get()) {
+                        return 1;
+                }
+        }
+        return 0;
+}
+
+static void
+test_juggle(int n)
+{
+        pid_t pids[MAX_PROCS];
+        int i, status;
+
+        for (i = 0; i < n; i++) {
+                syscall_success(pids[i] = fork());
+                if (0 == pids[i]) {
+                        exit(juggle(i));
+                }
+        }
+        for (i = 0; i < n; i++) {
+                syscall_success(waitpid(pids[i], 0, &status));
+                test_assert(0 == status, "process %d lost its registers", i);
+        }
+}
+
+static void
+test_fork(void)
+{
+        unsigned int want[XMM_WORDS], other[XMM_WORDS];
+        pid_t pid;
+        int status;
+
+        xmm_pattern(want, 0x1234);
+        xmm_load(want);
+        syscall_success(pid = fork());
+        if (0 == pid) {
+                if (!xmm_check(want)) {
+                        exit(1);
+                }
+                xmm_pattern(other, 0x5678);
+                xmm_load(other);
+                yield();
+                exit(xmm_check(other) ? 0 : 2);
+        }
+        syscall_success(waitpid(pid, 0, &status));
+        test_assert(0 == status, "the child did not get its own copy of the registers (%d)",
+                    status);
+        test_assert(xmm_check(want), "the parent's registers changed");
+}
+
+/* Something to do with the SSE registers between turns */
+static void
+sse_work(void)
+{
+        __asm__ __volatile__("addps %%xmm1, %%xmm0\n\t"
+                             "mulps %%xmm2, %%xmm3" ::: "memory");
+}
+
+static unsigned long long
+pingpong(int parent_sse, int child_sse)
+{
+        int to_child[2], to_parent[2], i;
+        unsigned long long start, t;
+        pid_t pid;
+        char c = 0;
+
+        syscall_success(pipe(to_child));
+        syscall_success(pipe(to_parent));
+        syscall_success(pid = fork());
+        if (0 == pid) {
+                for (i = 0; i < ROUND_TRIPS; i++) {
+                        read(to_child[0], &c, 1);
+                        if (child_sse) {
+                                sse_work();
+                        }
+                        write(to_parent[1], &c, 1);
+                }
+                exit(0);
+        }
+
+        start = rdtsc();
+        for (i = 0; i < ROUND_TRIPS; i++) {
+                if (parent_sse) {
+                        sse_work();
+                }
+                write(to_child[1], &c, 1);
+                read(to_parent[0], &c, 1);
+        }
+        t = (rdtsc() - start) / ROUND_TRIPS;
+
+        waitpid(pid, 0, &i);
+        close(to_child[0]);
+        close(to_child[1]);
+        close(to_parent[0]);
+        close(to_parent[1]);
+        return t;
+}
+
+int main(int argc, char **argv)
+{
+        int n = DEFAULT_PROCS;
+
+        if (argc > 1 && 0 == strcmp(argv[1], CHILD_ARG)) {
+                return check_initial();
+        }
+        if (argc > 1) {
+                n = atoi(argv[1]);
+        }
+        if (n < 1 || n > MAX_PROCS) {
+                fprintf(stderr, "usage: fputest [processes (1 to %d)]\n", MAX_PROCS);
+                return 1;
+        }
+        if (!cpuid_has_sse()) {
+                printf("no SSE, nothing to test\n");
+                return 0;
+        }
+
+        test_init();
+
+        test_juggle(n);
+        test_fork();
+        /* The parent has used the registers, so the child starts with them */
+        test_initial();
+
+        /* The child of one round trip is reaped before the next starts */
+        printf("  round trip, no SSE:       %llu cycles\n", pingpong(0, 0));
+        printf("  round trip, parent SSE:   %llu cycles\n", pingpong(1, 0));
+        printf("  round trip, both SSE:     %llu cycles\n", pingpong(1, 1));
+
+        test_fini();
+        return 0;
+}
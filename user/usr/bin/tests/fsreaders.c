@@ -0,0 +1,170 @@
+/*
+ * Has several processes look up, list, stat and read the files of one
+ * directory while another keeps creating and removing files in it. The
+ * readers only need to share the directory's lock, so they can overlap
+ * each other's waits for the disk; the writer needs it to itself, and
+ * no reader may see a half-made change. Prints how long the readers
+ * took, in TSC cycles.
+ *
+ * Usage: fsreaders [readers]
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include <test/test.h>
+
+#define syscall_success(expr)                                                                   \
+        test_assert(0 <= (expr), "\nunexpected error: %s (%d)",                                 \
+                    test_errstr(errno), errno)
+
+#define DIR_PATH        "/fsreaders"
+#define DIR_FILES          8
+#define ROUNDS          64
+#define DEFAULT_READERS 4
+#define MAX_READERS     16
+
+static unsigned long long
+rdtsc(void)
+{
+        unsigned long long t;
+        __asm__ __volatile__("rdtsc" : "=A"(t));
+        return t;
+}
+
+/* Every file holds its own name */
+static void
+file_name(char *buf, const char *prefix, int i)
+{
+        snprintf(buf, 64, "%s%d", prefix, i);
+}
+
+/* Exits non-zero at the first thing out of place */
+static void
+reader(void)
+{
+        char name[64], path[64], buf[32];
+        struct dirent d;
+        struct stat st;
+        int round, i, fd, seen, n;
+
+        for (round = 0; round < ROUNDS; round++) {
+                if (0 > (fd = open(DIR_PATH, O_RDONLY, 0))) {
+                        exit(1);
+                }
+                seen = 0;
+                while (0 < (n = getdents(fd, &d, sizeof(d)))) {
+                        if (0 == strncmp(d.d_name, "file", 4)) {
+                                seen++;
+                        }
+                }
+                close(fd);
+                if (0 != n || DIR_FILES != seen) {
+                        exit(2);
+                }
+
+                for (i = 0; i < DIR_FILES; i++) {
+                        file_name(name, "file", i);
+                        snprintf(path, sizeof(path), "%s/%s", DIR_PATH, name);
+                        if (0 > stat(path, &st) || st.st_size != (int)strlen(name)) {
+                                exit(3);
+                        }
+                        if (0 > (fd = open(path, O_RDONLY, 0))) {
+                                exit(4);
+                        }
+                        n = read(fd, buf, sizeof(buf));
+                        close(fd);
+                        if (n != (int)strlen(name) || 0 != memcmp(buf, name, n)) {
+                                exit(5);
+                        }
+                }
+        }
+        exit(0);
+}
+
+/* Churns temporary files alongside the real ones, for about as long as
+ * the readers run */
+static void
+writer(void)
+{
+        char path[64];
+        int i, fd;
+
+        for (i = 0; i < ROUNDS * DIR_FILES; i++) {
+                file_name(path, DIR_PATH "/tmp", i % DIR_FILES);
+                if (0 > (fd = open(path, O_WRONLY | O_CREAT, 0))) {
+                        exit(1);
+                }
+                write(fd, path, strlen(path));
+                close(fd);
+                if (0 == (i + 1) % DIR_FILES) {
+                        for (fd = 0; fd < DIR_FILES; fd++) {
+                                file_name(path, DIR_PATH "/tmp", fd);
+                                if (0 > unlink(path)) {
+                                        exit(2);
+                                }
+                        }
+                }
+        }
+        exit(0);
+}
+
+int main(int argc, char **argv)
+{
+        char name[64], path[64];
+        int nreaders = DEFAULT_READERS;
+        pid_t readers[MAX_READERS], wpid;
+        unsigned long long start, cycles;
+        int i, fd, status;
+
+        if (argc > 2 || (argc == 2 && ((nreaders = atoi(argv[1])) <= 0 || nreaders > MAX_READERS))) {
+                fprintf(stderr, "USAGE: fsreaders [readers, at most %d]\n", MAX_READERS);
+                return 1;
+        }
+
+        test_init();
+        syscall_success(mkdir(DIR_PATH, 0));
+        for (i = 0; i < DIR_FILES; i++) {
+                file_name(name, "file", i);
+                snprintf(path, sizeof(path), "%s/%s", DIR_PATH, name);
+                syscall_success(fd = open(path, O_WRONLY | O_CREAT, 0));
+                test_assert((int)strlen(name) == write(fd, name, strlen(name)), "short write");
+                syscall_success(close(fd));
+        }
+
+        syscall_success(wpid = fork());
+        if (0 == wpid) {
+                writer();
+        }
+
+        start = rdtsc();
+        for (i = 0; i < nreaders; i++) {
+                syscall_success(readers[i] = fork());
+                if (0 == readers[i]) {
+                        reader();
+                }
+        }
+        for (i = 0; i < nreaders; i++) {
+                syscall_success(waitpid(readers[i], 0, &status));
+                test_assert(0 == status, "reader %d failed with status %d", i, status);
+        }
+        cycles = rdtsc() - start;
+        syscall_success(waitpid(wpid, 0, &status));
+        test_assert(0 == status, "writer failed with status %d", status);
+        printf("%d readers, %d rounds each: %llu cycles\n", nreaders, ROUNDS, cycles);
+
+        for (i = 0; i < DIR_FILES; i++) {
+                file_name(path, DIR_PATH "/file", i);
+                syscall_success(unlink(path));
+        }
+        syscall_success(rmdir(DIR_PATH));
+
+        test_fini();
+        return 0;
+}
@@ -0,0 +1,279 @@
+/*
+ * Checks futex(2) and the pthread mutex and condition variable built on
+ * it, then measures them. Processes share the locks through a MAP_SHARED
+ * mapping, as Weenix cannot yet run several threads in one process:
+ *
+ *  - an uncontended lock and unlock, which should not enter the kernel;
+ *  - several processes fighting over one mutex, against a lock that
+ *    spins calling yield() until it is free;
+ *  - two processes taking turns through a condition variable.
+ *
+ * Times are in TSC cycles.
+ *
+ * Usage: futexbench [processes]
+ */
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <pthread/pthread.h>
+#include <weenix/futex.h>
+
+#include <test/test.h>
+
+#define syscall_success(expr)                                                                   \
+        test_assert(0 <= (expr), "\nunexpected error: %s (%d)",                                 \
+                    test_errstr(errno), errno)
+
+#define DEFAULT_PROCS   4
+#define MAX_PROCS       16
+#define UNCONTENDED     100000
+#define CONTENDED       2000
+#define PINGPONGS       500
+
+typedef struct shared {
+        pthread_mutex_t sh_mtx;
+        pthread_cond_t  sh_cond;
+        int             sh_word;
+        int             sh_turn;
+        unsigned int    sh_count;
+} shared_t;
+
+static shared_t *sh;
+
+static unsigned long long
+rdtsc(void)
+{
+        unsigned long long t;
+        __asm__ __volatile__("rdtsc" : "=A"(t));
+        return t;
+}
+
+static void
+msleep(int msecs)
+{
+        struct timespec ts;
+
+        ts.tv_sec = 0;
+        ts.tv_nsec = msecs * 1000000L;
+        syscall_success(nanosleep(&ts, NULL));
+}
+
+static void
+wait_all(int n, pid_t *pids)
+{
+        int i, status;
+
+        for (i = 0; i < n; i++) {
+                syscall_success(waitpid(pids[i], 0, &status));
+                test_assert(0 == status, "child %d failed", i);
+        }
+}
+
+static void
+test_errors(void)
+{
+        struct timespec ts;
+        int word = 0;
+
+        test_assert(-1 == futex((int *)((char *)&word + 1), FUTEX_WAKE, 1, NULL)
+                    && EINVAL == errno, "no EINVAL for a misaligned word");
+        test_assert(-1 == futex(NULL, FUTEX_WAKE, 1, NULL) && EFAULT == errno,
+                    "no EFAULT for NULL");
+        test_assert(-1 == futex(&word, 2, 0, NULL) && EINVAL == errno,
+                    "no EINVAL for a bad op");
+        test_assert(-1 == futex(&word, FUTEX_WAIT, 1, NULL) && EAGAIN == errno,
+                    "waited though the word had changed");
+        test_assert(0 == futex(&word, FUTEX_WAKE, 1, NULL), "woke a waiter that was not there");
+
+        ts.tv_sec = 0;
+        ts.tv_nsec = 20000000;
+        test_assert(-1 == futex(&word, FUTEX_WAIT, 0, &ts) && ETIMEDOUT == errno,
+                    "no ETIMEDOUT");
+        ts.tv_nsec = -1;
+        test_assert(-1 == futex(&word, FUTEX_WAIT, 0, &ts) && EINVAL == errno,
+                    "no EINVAL for a bad timeout");
+}
+
+/*
+ * A word in a shared mapping is one futex across processes; a private
+ * word at the same address in a forked child is not.
+ */
+static void
+test_wake(void)
+{
+        struct timespec ts;
+        static int private_word = 0;
+        pid_t pid;
+
+        sh->sh_word = 0;
+        syscall_success(pid = fork());
+        if (0 == pid) {
+                while (0 == sh->sh_word) {
+                        futex(&sh->sh_word, FUTEX_WAIT, 0, NULL);
+                }
+                exit(0);
+        }
+        msleep(20);
+        sh->sh_word = 1;
+        syscall_success(futex(&sh->sh_word, FUTEX_WAKE, 1, NULL));
+        wait_all(1, &pid);
+
+        syscall_success(pid = fork());
+        if (0 == pid) {
+                ts.tv_sec = 0;
+                ts.tv_nsec = 100000000;
+                exit((-1 == futex(&private_word, FUTEX_WAIT, 0, &ts)
+                      && ETIMEDOUT == errno) ? 0 : 1);
+        }
+        msleep(20);
+        test_assert(0 == futex(&private_word, FUTEX_WAKE, 1, NULL),
+                    "woke another process's private futex");
+        wait_all(1, &pid);
+}
+
+static void
+bench_uncontended(void)
+{
+        pthread_mutex_t mtx = PTHREAD_MUTEX_INITIALIZER;
+        unsigned long long start, t;
+        int i;
+
+        start = rdtsc();
+        for (i = 0; i < UNCONTENDED; i++) {
+                pthread_mutex_lock(&mtx);
+                pthread_mutex_unlock(&mtx);
+        }
+        t = rdtsc() - start;
+        test_assert(0 == mtx.pm_state, "mutex left locked");
+
+        pthread_mutex_lock(&mtx);
+        test_assert(EBUSY == pthread_mutex_trylock(&mtx), "trylock took a locked mutex");
+        test_assert(0 == pthread_mutex_unlock(&mtx), "unlock failed");
+        test_assert(EPERM == pthread_mutex_unlock(&mtx), "unlocked an unlocked mutex");
+        printf("  uncontended lock+unlock: %llu cycles\n", t / UNCONTENDED);
+}
+
+static void
+lock(int yielding)
+{
+        if (yielding) {
+                while (0 != pthread_mutex_trylock(&sh->sh_mtx)) {
+                        yield();
+                }
+        } else {
+                pthread_mutex_lock(&sh->sh_mtx);
+        }
+}
+
+/* Each of n processes adds to a shared count with the lock held */
+static unsigned long long
+contend(int n, int yielding)
+{
+        unsigned long long start;
+        pid_t pids[MAX_PROCS];
+        unsigned int c;
+        int i, j;
+
+        pthread_mutex_init(&sh->sh_mtx, NULL);
+        sh->sh_count = 0;
+
+        start = rdtsc();
+        for (i = 0; i < n; i++) {
+                syscall_success(pids[i] = fork());
+                if (0 == pids[i]) {
+                        for (j = 0; j < CONTENDED; j++) {
+                                lock(yielding);
+                                c = sh->sh_count;
+                                /* Widen the window for anyone sneaking in */
+                                if (0 == j % 64) {
+                                        yield();
+                                }
+                                sh->sh_count = c + 1;
+                                pthread_mutex_unlock(&sh->sh_mtx);
+                        }
+                        exit(0);
+                }
+        }
+        wait_all(n, pids);
+
+        test_assert((unsigned int)(n * CONTENDED) == sh->sh_count,
+                    "count is %u, not %u", sh->sh_count, n * CONTENDED);
+        return (rdtsc() - start) / (n * CONTENDED);
+}
+
+/* Two processes take turns, each waiting on the condition for its own */
+static void
+pingpong_run(int me)
+{
+        int i;
+
+        for (i = 0; i < PINGPONGS; i++) {
+                pthread_mutex_lock(&sh->sh_mtx);
+                while (sh->sh_turn != me) {
+                        pthread_cond_wait(&sh->sh_cond, &sh->sh_mtx);
+                }
+                sh->sh_turn = !me;
+                pthread_cond_broadcast(&sh->sh_cond);
+                pthread_mutex_unlock(&sh->sh_mtx);
+        }
+}
+
+static void
+bench_pingpong(void)
+{
+        unsigned long long start, t;
+        pid_t pid;
+
+        pthread_mutex_init(&sh->sh_mtx, NULL);
+        pthread_cond_init(&sh->sh_cond, NULL);
+        sh->sh_turn = 0;
+
+        start = rdtsc();
+        syscall_success(pid = fork());
+        if (0 == pid) {
+                pingpong_run(1);
+                exit(0);
+        }
+        pingpong_run(0);
+        wait_all(1, &pid);
+        t = rdtsc() - start;
+
+        test_assert(0 == pthread_cond_destroy(&sh->sh_cond), "waiters left on the condition");
+        printf("  condition variable round trip: %llu cycles\n", t / PINGPONGS);
+}
+
+int main(int argc, char **argv)
+{
+        int n = DEFAULT_PROCS;
+
+        if (argc > 1) {
+                n = atoi(argv[1]);
+        }
+        if (n < 1 || n > MAX_PROCS) {
+                fprintf(stderr, "usage: futexbench [processes (1 to %d)]\n", MAX_PROCS);
+                return 1;
+        }
+
+        test_init();
+
+        sh = mmap(NULL, sizeof(*sh), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANON, -1, 0);
+        test_assert(MAP_FAILED != sh, "mmap failed: %s", test_errstr(errno));
+        if (MAP_FAILED == sh) {
+                return 1;
+        }
+
+        test_errors();
+        test_wake();
+        bench_uncontended();
+        printf("  %d processes, futex mutex:      %llu cycles per lock\n", n, contend(n, 0));
+        printf("  %d processes, yield spin lock:  %llu cycles per lock\n", n, contend(n, 1));
+        bench_pingpong();
+
+        test_fini();
+        return 0;
+}
@@ -0,0 +1,184 @@
+/*
+ * Measures pipe throughput for the equivalent of "cat bigfile | wc": a
+ * child copies a file into a pipe and we count the bytes and lines that
+ * come out the other end. The child copies either with read() and
+ * write(), as cat does, or with splice(), which moves the file's pages
+ * into the pipe without copying them through userland. Times are in TSC
+ * cycles.
+ *
+ * First it checks that a big write to a pipe whose reader goes away part
+ * way through returns what was delivered rather than failing.
+ *
+ * Usage: pipebench [kilobytes]
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <test/test.h>
+
+#define syscall_success(expr)                                                                   \
+        test_assert(0 <= (expr), "\nunexpected error: %s (%d)",                                 \
+                    test_errstr(errno), errno)
+
+#define PIPEBENCH_FILE  "pipebench-file"
+#define DEFAULT_KB      1024
+#define LINE_LEN        64
+#define BROKEN_PAGES    32      /* more than a pipe holds */
+#define BROKEN_READ     2       /* pages read before the reader goes away */
+
+static char buf[4096];
+static char big[BROKEN_PAGES * 4096];
+
+static unsigned long long
+rdtsc(void)
+{
+        unsigned long long t;
+        __asm__ __volatile__("rdtsc" : "=A"(t));
+        return t;
+}
+
+/* Fill the file with kb kilobytes of LINE_LEN-character lines */
+static void
+make_file(int kb)
+{
+        int fd, i;
+
+        for (i = 0; i < (int)sizeof(buf); i++) {
+                buf[i] = ((i + 1) % LINE_LEN) ? 'a' + i % 26 : '\n';
+        }
+        syscall_success(fd = open(PIPEBENCH_FILE, O_WRONLY | O_CREAT | O_TRUNC, 0));
+        for (i = 0; i < kb / 4; i++) {
+                test_assert(sizeof(buf) == write(fd, buf, sizeof(buf)),
+                            "could not write %s", PIPEBENCH_FILE);
+        }
+        syscall_success(close(fd));
+}
+
+/* The "cat" half, run in the child: copy the file to out and exit */
+static void
+cat(int out, int use_splice)
+{
+        int fd, n;
+
+        if (0 > (fd = open(PIPEBENCH_FILE, O_RDONLY, 0))) {
+                exit(1);
+        }
+        if (use_splice) {
+                while (0 < (n = splice(fd, NULL, out, NULL, 16 * sizeof(buf), 0))) {
+                        ;
+                }
+        } else {
+                while (0 < (n = read(fd, buf, sizeof(buf)))) {
+                        if (n != write(out, buf, n)) {
+                                exit(1);
+                        }
+                }
+        }
+        exit(0 == n ? 0 : 1);
+}
+
+/*
+ * The writer fills the pipe and blocks, we take a few pages and close the
+ * read end, and its write should then return everything it got in.
+ */
+static void
+test_broken_write(void)
+{
+        int pipefd[2], report[2], got[2], status, n, i;
+        pid_t pid;
+
+        syscall_success(pipe(pipefd));
+        syscall_success(pipe(report));
+        syscall_success(pid = fork());
+        if (0 == pid) {
+                close(pipefd[0]);
+                close(report[0]);
+                got[0] = write(pipefd[1], big, sizeof(big));
+                got[1] = errno;
+                write(report[1], got, sizeof(got));
+                exit(0);
+        }
+        syscall_success(close(pipefd[1]));
+        syscall_success(close(report[1]));
+
+        for (i = 0; i < BROKEN_READ; i++) {
+                syscall_success(n = read(pipefd[0], buf, sizeof(buf)));
+                test_assert(sizeof(buf) == n, "read %d bytes of a page", n);
+        }
+        syscall_success(close(pipefd[0]));
+
+        test_assert(sizeof(got) == read(report[0], got, sizeof(got)), "no report from the writer");
+        syscall_success(close(report[0]));
+        syscall_success(waitpid(pid, 0, &status));
+
+        test_assert(-1 != got[0], "write failed with %s after delivering pages",
+                    test_errstr(got[1]));
+        test_assert(BROKEN_READ * (int)sizeof(buf) <= got[0] && (int)sizeof(big) > got[0],
+                    "write returned %d of %d bytes", got[0], (int)sizeof(big));
+}
+
+static unsigned long long
+run(int kb, int use_splice)
+{
+        unsigned long long start;
+        int pipefd[2], status, n, i;
+        int bytes = 0, lines = 0;
+        pid_t pid;
+
+        start = rdtsc();
+        syscall_success(pipe(pipefd));
+        syscall_success(pid = fork());
+        if (0 == pid) {
+                close(pipefd[0]);
+                cat(pipefd[1], use_splice);
+        }
+        syscall_success(close(pipefd[1]));
+
+        /* The "wc" half */
+        while (0 < (n = read(pipefd[0], buf, sizeof(buf)))) {
+                bytes += n;
+                for (i = 0; i < n; i++) {
+                        lines += ('\n' == buf[i]);
+                }
+        }
+        syscall_success(n);
+        syscall_success(close(pipefd[0]));
+        syscall_success(waitpid(pid, 0, &status));
+        start = rdtsc() - start;
+
+        test_assert(0 == status, "cat child failed");
+        test_assert(kb * 1024 == bytes, "read %d bytes, expected %d", bytes, kb * 1024);
+        test_assert(kb * 1024 / LINE_LEN == lines, "counted %d lines, expected %d",
+                    lines, kb * 1024 / LINE_LEN);
+        return start;
+}
+
+int main(int argc, char **argv)
+{
+        int kb = DEFAULT_KB;
+        unsigned long long cycles;
+
+        if (argc > 2 || (argc == 2 && ((kb = atoi(argv[1])) <= 0 || kb % 4))) {
+                fprintf(stderr, "USAGE: pipebench [kilobytes, a multiple of 4]\n");
+                return 1;
+        }
+
+        test_init();
+        test_broken_write();
+        make_file(kb);
+
+        printf("cat %dK | wc, cycles per kilobyte:\n", kb);
+        cycles = run(kb, 0);
+        printf("  read/write:  %10llu\n", cycles / kb);
+        cycles = run(kb, 1);
+        printf("  splice:      %10llu\n", cycles / kb);
+
+        syscall_success(unlink(PIPEBENCH_FILE));
+        test_fini();
+        return 0;
+}
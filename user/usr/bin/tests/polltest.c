@@ -0,0 +1,161 @@
+/*
+ * Tests poll(2) on the memory devices, regular files and the ttys.
+ *
+ * With -i N it also waits for N lines typed on any of the terminals,
+ * sleeping in poll() rather than spinning, and reports which terminal
+ * each line came from.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <test/test.h>
+
+#define syscall_success(expr)                                                                   \
+        test_assert(0 <= (expr), "\nunexpected error: %s (%d)",                                 \
+                    test_errstr(errno), errno)
+
+#define POLLTEST_FILE "polltest-file"
+
+static void
+polltest_memdevs(void)
+{
+        struct pollfd fds[2];
+        int ret;
+
+        syscall_success(fds[0].fd = open("/dev/null", O_RDWR, 0));
+        syscall_success(fds[1].fd = open("/dev/zero", O_RDWR, 0));
+        fds[0].events = fds[1].events = POLLIN | POLLOUT;
+
+        syscall_success(ret = poll(fds, 2, 0));
+        test_assert(2 == ret, "poll returned %d", ret);
+        test_assert((POLLIN | POLLOUT) == fds[0].revents, "/dev/null revents %#x", fds[0].revents);
+        test_assert((POLLIN | POLLOUT) == fds[1].revents, "/dev/zero revents %#x", fds[1].revents);
+
+        /* only the requested events are reported */
+        fds[0].events = POLLOUT;
+        fds[1].events = POLLIN;
+        syscall_success(ret = poll(fds, 2, -1));
+        test_assert(2 == ret, "poll returned %d", ret);
+        test_assert(POLLOUT == fds[0].revents, "/dev/null revents %#x", fds[0].revents);
+        test_assert(POLLIN == fds[1].revents, "/dev/zero revents %#x", fds[1].revents);
+
+        syscall_success(close(fds[0].fd));
+        syscall_success(close(fds[1].fd));
+}
+
+static void
+polltest_files(void)
+{
+        struct pollfd fds[3];
+        int ret;
+
+        syscall_success(fds[0].fd = open(POLLTEST_FILE, O_RDWR | O_CREAT, 0));
+        fds[0].events = POLLIN | POLLOUT;
+        fds[1].fd = -1;
+        fds[1].events = POLLIN;
+        fds[2].fd = 25;
+        fds[2].events = POLLIN;
+
+        /* regular files never block, negative fds are ignored, closed fds are invalid */
+        syscall_success(ret = poll(fds, 3, 0));
+        test_assert(2 == ret, "poll returned %d", ret);
+        test_assert((POLLIN | POLLOUT) == fds[0].revents, "file revents %#x", fds[0].revents);
+        test_assert(0 == fds[1].revents, "negative fd revents %#x", fds[1].revents);
+        test_assert(POLLNVAL == fds[2].revents, "closed fd revents %#x", fds[2].revents);
+
+        syscall_success(close(fds[0].fd));
+        syscall_success(unlink(POLLTEST_FILE));
+
+        test_assert(-1 == poll(fds, NFILES_MAX + 1, 0) && EINVAL == errno, "too many fds accepted");
+}
+
+static int
+polltest_open_ttys(struct pollfd *fds)
+{
+        char path[16];
+        int i;
+
+        for (i = 0; i < __NTERMS__; i++) {
+                snprintf(path, sizeof(path), "/dev/tty%d", i);
+                syscall_success(fds[i].fd = open(path, O_RDONLY, 0));
+                fds[i].events = POLLIN;
+        }
+        return __NTERMS__;
+}
+
+static void
+polltest_ttys(void)
+{
+        struct pollfd fds[__NTERMS__];
+        int i, n, ret;
+
+        n = polltest_open_ttys(fds);
+        for (i = 0; i < n; i++) {
+                fds[i].events = POLLOUT;
+        }
+
+        /* a tty can always be written */
+        syscall_success(ret = poll(fds, n, 0));
+        test_assert(n == ret, "poll returned %d", ret);
+        for (i = 0; i < n; i++) {
+                test_assert(POLLOUT == fds[i].revents, "tty%d revents %#x", i, fds[i].revents);
+                syscall_success(close(fds[i].fd));
+        }
+}
+
+/* Echo nlines lines from whichever terminals they are typed on. */
+static void
+polltest_interactive(int nlines)
+{
+        struct pollfd fds[__NTERMS__];
+        char buf[128];
+        int i, n, ret;
+
+        n = polltest_open_ttys(fds);
+        printf("type %d lines on any of the %d terminals\n", nlines, n);
+
+        while (nlines > 0) {
+                syscall_success(ret = poll(fds, n, -1));
+                test_assert(ret > 0, "blocking poll returned %d", ret);
+                for (i = 0; i < n; i++) {
+                        if (!(fds[i].revents & POLLIN)) {
+                                continue;
+                        }
+                        syscall_success(ret = read(fds[i].fd, buf, sizeof(buf) - 1));
+                        buf[ret > 0 ? ret : 0] = '\0';
+                        printf("tty%d: %s", i, buf);
+                        nlines--;
+                }
+        }
+
+        for (i = 0; i < n; i++) {
+                syscall_success(close(fds[i].fd));
+        }
+}
+
+int main(int argc, char **argv)
+{
+        if (argc != 1 && !(argc == 3 && 0 == strcmp(argv[1], "-i"))) {
+                fprintf(stderr, "USAGE: polltest [-i nlines]\n");
+                return 1;
+        }
+
+        test_init();
+
+        polltest_memdevs();
+        polltest_files();
+        polltest_ttys();
+        if (argc == 3) {
+                polltest_interactive(atoi(argv[2]));
+        }
+
+        test_fini();
+
+        return 0;
+}
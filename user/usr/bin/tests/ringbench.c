@@ -0,0 +1,229 @@
+/*
+ * Checks the submission/completion ring and compares it against plain
+ * system calls: the same sequence of small writes and reads is done once
+ * with one pwrite/pread trap per block, and once through a ring, which
+ * needs one trap per batch. Times are reported in TSC cycles.
+ *
+ * Usage: ringbench [nblocks [batch]]
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <weenix/ring.h>
+
+#include <test/test.h>
+
+#define syscall_success(expr)                                                                   \
+        test_assert(0 <= (expr), "\nunexpected error: %s (%d)",                                 \
+                    test_errstr(errno), errno)
+
+#define RINGBENCH_FILE  "ringbench-file"
+#define BLOCK_SIZE      128
+#define MAX_BLOCKS      256
+
+static char wbuf[MAX_BLOCKS][BLOCK_SIZE];
+static char rbuf[MAX_BLOCKS][BLOCK_SIZE];
+
+static unsigned long long
+rdtsc(void)
+{
+        unsigned long long t;
+        __asm__ __volatile__("rdtsc" : "=A"(t));
+        return t;
+}
+
+static void
+fill_blocks(int seed, int nblocks)
+{
+        int i;
+
+        for (i = 0; i < nblocks; i++) {
+                memset(wbuf[i], 'a' + (seed + i) % 26, BLOCK_SIZE);
+        }
+        memset(rbuf, 0, sizeof(rbuf));
+}
+
+static void
+check_blocks(int nblocks)
+{
+        test_assert(0 == memcmp(wbuf, rbuf, nblocks * BLOCK_SIZE), "data read back differs");
+}
+
+/* Drain every completion, checking each result against what we expect. */
+static int
+reap(ring_t *ring, int expected)
+{
+        ring_cqe_t *cqe;
+        int n = 0;
+
+        while (NULL != (cqe = ring_peek_cqe(ring))) {
+                test_assert(expected == cqe->cqe_res, "entry %u completed with %d",
+                            cqe->cqe_user_data, cqe->cqe_res);
+                ring_cqe_seen(ring);
+                n++;
+        }
+        return n;
+}
+
+static void
+ringbench_basic(void)
+{
+        ring_t ring;
+        ring_sqe_t *sqe;
+        ring_cqe_t *cqe;
+        int fd, i;
+
+        test_assert(-1 == ring_setup(3) && EINVAL == errno, "non power of 2 accepted");
+        test_assert(-1 == ring_setup(RING_MAX_ENTRIES * 2) && EINVAL == errno,
+                    "too many entries accepted");
+        test_assert(-1 == ring_enter(0, 1) && EINVAL == errno, "ring_enter on a tty");
+        test_assert(-1 == ring_enter(25, 1) && EBADF == errno, "ring_enter on a closed fd");
+
+        syscall_success(ring_init(&ring, 8));
+
+        /* open, write, fsync and close in one go; the open's fd is known in advance */
+        fd = dup(0);
+        syscall_success(fd);
+        syscall_success(close(fd));
+        fill_blocks(0, 2);
+
+        test_assert(NULL != (sqe = ring_get_sqe(&ring)), "no sqe");
+        ring_prep_open(sqe, RINGBENCH_FILE, O_RDWR | O_CREAT);
+        sqe->sqe_user_data = 0;
+        test_assert(NULL != (sqe = ring_get_sqe(&ring)), "no sqe");
+        ring_prep_write(sqe, fd, wbuf, 2 * BLOCK_SIZE, -1);
+        sqe->sqe_user_data = 1;
+        test_assert(NULL != (sqe = ring_get_sqe(&ring)), "no sqe");
+        ring_prep_fsync(sqe, fd);
+        sqe->sqe_user_data = 2;
+        test_assert(NULL != (sqe = ring_get_sqe(&ring)), "no sqe");
+        ring_prep_read(sqe, fd, rbuf, 2 * BLOCK_SIZE, 0);
+        sqe->sqe_user_data = 3;
+        test_assert(NULL != (sqe = ring_get_sqe(&ring)), "no sqe");
+        ring_prep_close(sqe, fd);
+        sqe->sqe_user_data = 4;
+        test_assert(NULL != (sqe = ring_get_sqe(&ring)), "no sqe");
+        sqe->sqe_opcode = 200;
+        sqe->sqe_user_data = 5;
+
+        test_assert(6 == ring_submit(&ring), "not everything was submitted");
+        for (i = 0; i < 6; i++) {
+                static const int expect[] = { 0, 2 * BLOCK_SIZE, 0, 2 * BLOCK_SIZE, 0, -EINVAL };
+                test_assert(NULL != (cqe = ring_peek_cqe(&ring)), "missing completion %d", i);
+                test_assert(i == (int)cqe->cqe_user_data, "completion %u out of order",
+                            cqe->cqe_user_data);
+                test_assert((i == 0 ? fd : expect[i]) == cqe->cqe_res,
+                            "entry %d completed with %d", i, cqe->cqe_res);
+                ring_cqe_seen(&ring);
+        }
+        test_assert(NULL == ring_peek_cqe(&ring), "extra completion");
+        check_blocks(2);
+        test_assert(-1 == close(fd) && EBADF == errno, "ring did not close the file");
+
+        /* the kernel stops when the completion queue is full */
+        for (i = 0; i < 8; i++) {
+                test_assert(NULL != (sqe = ring_get_sqe(&ring)), "no sqe %d", i);
+        }
+        test_assert(NULL == ring_get_sqe(&ring), "submission queue overfilled");
+        test_assert(8 == ring_submit(&ring), "could not fill the completion queue");
+        for (i = 0; i < 4; i++) {
+                test_assert(NULL != ring_get_sqe(&ring), "no sqe %d", i);
+        }
+        test_assert(0 == ring_submit(&ring), "overflowed the completion queue");
+        test_assert(8 == reap(&ring, 0), "wrong number of completions");
+        test_assert(4 == ring_enter(ring.r_fd, 4), "queued entries not consumed");
+        test_assert(4 == reap(&ring, 0), "wrong number of completions");
+
+        ring_destroy(&ring);
+        syscall_success(unlink(RINGBENCH_FILE));
+}
+
+static void
+ringbench_compare(int nblocks, int batch)
+{
+        unsigned long long start, plain, ringed;
+        ring_t ring;
+        int fd, i, j;
+
+        syscall_success(fd = open(RINGBENCH_FILE, O_RDWR | O_CREAT, 0));
+
+        fill_blocks(1, nblocks);
+        start = rdtsc();
+        for (i = 0; i < nblocks; i++) {
+                test_assert(BLOCK_SIZE == pwrite(fd, wbuf[i], BLOCK_SIZE, i * BLOCK_SIZE),
+                            "pwrite of block %d failed", i);
+        }
+        for (i = 0; i < nblocks; i++) {
+                test_assert(BLOCK_SIZE == pread(fd, rbuf[i], BLOCK_SIZE, i * BLOCK_SIZE),
+                            "pread of block %d failed", i);
+        }
+        plain = rdtsc() - start;
+        check_blocks(nblocks);
+
+        syscall_success(ring_init(&ring, batch));
+        fill_blocks(2, nblocks);
+        start = rdtsc();
+        for (j = 0; j < 2; j++) {
+                for (i = 0; i < nblocks; i++) {
+                        ring_sqe_t *sqe = ring_get_sqe(&ring);
+                        if (0 == j) {
+                                ring_prep_write(sqe, fd, wbuf[i], BLOCK_SIZE, i * BLOCK_SIZE);
+                        } else {
+                                ring_prep_read(sqe, fd, rbuf[i], BLOCK_SIZE, i * BLOCK_SIZE);
+                        }
+                        sqe->sqe_user_data = i;
+                        if ((i + 1) % batch == 0 || i + 1 == nblocks) {
+                                ring_submit(&ring);
+                                reap(&ring, BLOCK_SIZE);
+                        }
+                }
+        }
+        ringed = rdtsc() - start;
+        check_blocks(nblocks);
+
+        printf("%d blocks of %d bytes, written then read back:\n", nblocks, BLOCK_SIZE);
+        printf("  plain syscalls:   %10llu cycles (%d traps)\n", plain, 2 * nblocks);
+        printf("  ring, batch %-3d:  %10llu cycles (%d traps)\n", batch, ringed,
+               2 * ((nblocks + batch - 1) / batch));
+
+        ring_destroy(&ring);
+        syscall_success(close(fd));
+        syscall_success(unlink(RINGBENCH_FILE));
+}
+
+int main(int argc, char **argv)
+{
+        int nblocks = MAX_BLOCKS;
+        int batch = RING_MAX_ENTRIES;
+
+        if (argc > 3) {
+                fprintf(stderr, "USAGE: ringbench [nblocks [batch]]\n");
+                return 1;
+        }
+        if (argc > 1) {
+                nblocks = atoi(argv[1]);
+        }
+        if (argc > 2) {
+                batch = atoi(argv[2]);
+        }
+        if (nblocks < 1 || nblocks > MAX_BLOCKS
+            || batch < 1 || batch > RING_MAX_ENTRIES || (batch & (batch - 1))) {
+                fprintf(stderr, "ringbench: need 1 <= nblocks <= %d and a power of 2 "
+                        "batch of at most %d\n", MAX_BLOCKS, RING_MAX_ENTRIES);
+                return 1;
+        }
+
+        test_init();
+
+        ringbench_basic();
+        ringbench_compare(nblocks, batch);
+
+        test_fini();
+
+        return 0;
+}
@@ -0,0 +1,126 @@
+/*
+ * Tests CPU accounting: getrusage() and its errors, user time growing
+ * while a process spins, voluntary switches counted when it sleeps,
+ * children's usage moving to RUSAGE_CHILDREN and times() once they have
+ * been waited for, and time spent waiting to run when two children
+ * compete for the CPU.
+ */
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/resource.h>
+#include <sys/times.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <test/test.h>
+
+#define syscall_success(expr)                                                                   \
+        test_assert(0 <= (expr), "\nunexpected error: %s (%d)",                                 \
+                    test_errstr(errno), errno)
+
+#define TV_USEC(tv)     ((tv).tv_sec * 1000000LL + (tv).tv_usec)
+
+/* Spins in userland until the given number of clock ticks have gone by */
+static void
+spin(clock_t ticks)
+{
+        struct tms t;
+        clock_t end = times(&t) + ticks;
+
+        while (times(&t) < end) {
+                volatile int i;
+                for (i = 0; i < 100000; i++) {
+                        continue;
+                }
+        }
+}
+
+static void
+test_errors(void)
+{
+        struct rusage ru;
+
+        test_assert(-1 == getrusage(1, &ru) && EINVAL == errno, "no EINVAL for who 1");
+        test_assert(-1 == getrusage(RUSAGE_SELF, NULL) && EFAULT == errno, "no EFAULT for NULL");
+        test_assert(-1 == times(NULL) && EFAULT == errno, "no EFAULT for NULL");
+}
+
+static void
+test_self(void)
+{
+        struct rusage before, after;
+        struct tms t;
+        struct timespec ts;
+
+        syscall_success(getrusage(RUSAGE_SELF, &before));
+        spin(CLK_TCK / 2);
+        syscall_success(getrusage(RUSAGE_SELF, &after));
+        test_assert(TV_USEC(after.ru_utime) + TV_USEC(after.ru_stime)
+                    > TV_USEC(before.ru_utime) + TV_USEC(before.ru_stime),
+                    "no CPU time charged for spinning");
+        test_assert(TV_USEC(after.ru_utime) > TV_USEC(before.ru_utime),
+                    "no user time charged for spinning");
+        printf("  spun for %d ticks: %lld us user, %lld us system\n", CLK_TCK / 2,
+               TV_USEC(after.ru_utime) - TV_USEC(before.ru_utime),
+               TV_USEC(after.ru_stime) - TV_USEC(before.ru_stime));
+
+        ts.tv_sec = 0;
+        ts.tv_nsec = 20000000;
+        syscall_success(nanosleep(&ts, NULL));
+        syscall_success(getrusage(RUSAGE_SELF, &before));
+        test_assert(before.ru_nvcsw > after.ru_nvcsw, "sleeping was not a voluntary switch");
+
+        syscall_success(times(&t));
+        test_assert(t.tms_utime * (1000000 / CLK_TCK) == TV_USEC(before.ru_utime),
+                    "times() and getrusage() disagree on user time");
+}
+
+static void
+test_children(void)
+{
+        struct rusage before, after;
+        struct tms t;
+        pid_t pids[2];
+        int i, status;
+
+        syscall_success(getrusage(RUSAGE_CHILDREN, &before));
+        for (i = 0; i < 2; i++) {
+                syscall_success(pids[i] = fork());
+                if (0 == pids[i]) {
+                        spin(CLK_TCK / 2);
+                        exit(0);
+                }
+        }
+        for (i = 0; i < 2; i++) {
+                syscall_success(waitpid(pids[i], 0, &status));
+                test_assert(0 == status, "spinner %d failed", i);
+        }
+        syscall_success(getrusage(RUSAGE_CHILDREN, &after));
+
+        test_assert(TV_USEC(after.ru_utime) > TV_USEC(before.ru_utime),
+                    "children's user time not added");
+        test_assert(TV_USEC(after.ru_wtime) > TV_USEC(before.ru_wtime),
+                    "children competing for the CPU never waited");
+        printf("  children: %lld us user, %ld involuntary switches, %lld us waiting\n",
+               TV_USEC(after.ru_utime) - TV_USEC(before.ru_utime),
+               after.ru_nivcsw - before.ru_nivcsw,
+               TV_USEC(after.ru_wtime) - TV_USEC(before.ru_wtime));
+
+        syscall_success(times(&t));
+        test_assert(t.tms_cutime * (1000000 / CLK_TCK) == TV_USEC(after.ru_utime),
+                    "times() and getrusage() disagree on children's user time");
+}
+
+int main(int argc, char **argv)
+{
+        test_init();
+
+        test_errors();
+        test_self();
+        test_children();
+
+        test_fini();
+        return 0;
+}
@@ -0,0 +1,183 @@
+/*
+ * Measures how long an interactive process waits for the CPU while
+ * CPU-bound processes are running. A child plays the part of a shell
+ * waiting on its tty: it blocks in read() on a pipe and answers each
+ * byte we send it. The round trip is timed with no spinners, and again
+ * with spinners running alongside, which only get off the CPU when the
+ * clock preempts them. Without preemption the child never runs again
+ * once a spinner has the CPU, and this test hangs. The spinners are then
+ * run again at the lowest priority. Times are in TSC cycles.
+ *
+ * Usage: schedlat [max spinners]
+ */
+
+#include <errno.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <test/test.h>
+
+#define syscall_success(expr)                                                                   \
+        test_assert(0 <= (expr), "\nunexpected error: %s (%d)",                                 \
+                    test_errstr(errno), errno)
+
+#define DEFAULT_SPINNERS        2
+#define ROUNDS                  20
+#define SPIN_CHECK              (1 << 22)
+
+static unsigned long long
+rdtsc(void)
+{
+        unsigned long long t;
+        __asm__ __volatile__("rdtsc" : "=A"(t));
+        return t;
+}
+
+/*
+ * Burn CPU until stop is closed. The pipe is only looked at every few
+ * million iterations, so the spinner almost never enters the kernel on
+ * its own.
+ */
+static void
+spin(int stop)
+{
+        struct pollfd pfd;
+        volatile int i;
+
+        pfd.fd = stop;
+        pfd.events = POLLIN;
+        for (;;) {
+                for (i = 0; i < SPIN_CHECK; i++) {
+                        ;
+                }
+                pfd.revents = 0;
+                if (0 != poll(&pfd, 1, 0)) {
+                        exit(0);
+                }
+        }
+}
+
+/* The "shell": echo bytes back until end of file */
+static void
+echo(int in, int out)
+{
+        char c;
+
+        while (1 == read(in, &c, 1)) {
+                if (1 != write(out, &c, 1)) {
+                        exit(1);
+                }
+        }
+        exit(0);
+}
+
+static void
+run(int nspin, int spin_nice)
+{
+        unsigned long long t, min = ~0ULL, max = 0, total = 0;
+        int to[2], from[2], stop[2], status, i;
+        pid_t echoer, spinners[16];
+        char c = 'x';
+
+        syscall_success(pipe(to));
+        syscall_success(pipe(from));
+        syscall_success(echoer = fork());
+        if (0 == echoer) {
+                close(to[1]);
+                close(from[0]);
+                echo(to[0], from[1]);
+        }
+        syscall_success(close(to[0]));
+        syscall_success(close(from[1]));
+
+        syscall_success(pipe(stop));
+        for (i = 0; i < nspin; i++) {
+                syscall_success(spinners[i] = fork());
+                if (0 == spinners[i]) {
+                        setpriority(0, spin_nice);
+                        close(stop[1]);
+                        close(to[1]);
+                        close(from[0]);
+                        spin(stop[0]);
+                }
+        }
+        syscall_success(close(stop[0]));
+
+        for (i = 0; i < ROUNDS; i++) {
+                t = rdtsc();
+                test_assert(1 == write(to[1], &c, 1), "could not write to echoer");
+                test_assert(1 == read(from[0], &c, 1), "could not read from echoer");
+                t = rdtsc() - t;
+
+                total += t;
+                min = (t < min) ? t : min;
+                max = (t > max) ? t : max;
+        }
+
+        syscall_success(close(stop[1]));
+        syscall_success(close(to[1]));
+        syscall_success(close(from[0]));
+        for (i = 0; i < nspin; i++) {
+                syscall_success(waitpid(spinners[i], 0, &status));
+        }
+        syscall_success(waitpid(echoer, 0, &status));
+        test_assert(0 == status, "echoer failed");
+
+        printf("  %2d %4d %14llu %14llu %14llu\n", nspin, spin_nice, min, total / ROUNDS, max);
+}
+
+static void
+test_nice(void)
+{
+        pid_t pid;
+        int status;
+
+        test_assert(0 == getpriority(0), "started with nice %d", getpriority(0));
+        syscall_success(setpriority(0, 5));
+        test_assert(5 == getpriority(0), "nice is %d, not 5", getpriority(0));
+        test_assert(-1 == nice(-6), "nice(-6) did not give -1");
+
+        /* Children inherit it */
+        syscall_success(pid = fork());
+        if (0 == pid) {
+                exit(-1 == getpriority(0) ? 0 : 1);
+        }
+        syscall_success(waitpid(pid, 0, &status));
+        test_assert(0 == status, "child did not inherit nice value");
+
+        /* Out of range values are clamped */
+        syscall_success(setpriority(getpid(), 100));
+        test_assert(19 == getpriority(0), "nice 100 gave %d", getpriority(0));
+        syscall_success(setpriority(0, -100));
+        test_assert(-20 == getpriority(0), "nice -100 gave %d", getpriority(0));
+
+        test_assert(0 > setpriority(12345, 0) && ESRCH == errno, "no ESRCH for bad pid");
+        syscall_success(setpriority(0, 0));
+}
+
+int main(int argc, char **argv)
+{
+        int nspin = DEFAULT_SPINNERS;
+        int i;
+
+        if (argc > 2 || (argc == 2 && ((nspin = atoi(argv[1])) < 0 || nspin > 16))) {
+                fprintf(stderr, "USAGE: schedlat [max spinners, at most 16]\n");
+                return 1;
+        }
+
+        test_init();
+        test_nice();
+
+        printf("round trip to a blocked reader, cycles:\n");
+        printf("spin nice            min            avg            max\n");
+        for (i = 0; i <= nspin; i++) {
+                run(i, 0);
+        }
+        for (i = 1; i <= nspin; i++) {
+                run(i, 19);
+        }
+        test_fini();
+        return 0;
+}
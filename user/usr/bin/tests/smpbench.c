@@ -0,0 +1,116 @@
+/*
+ * Measures how well fork/exec-heavy and CPU-bound work spreads over the
+ * CPUs. Each of N workers forks and execs this program (which exits at
+ * once when run as a child) a number of times and then burns a fixed
+ * amount of CPU; we time how long it takes for all N to finish. With one
+ * CPU the time grows in step with N; with several it should stay close
+ * to flat until N passes the number of CPUs. Times are in TSC cycles.
+ *
+ * Usage: smpbench [max workers]
+ */
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <test/test.h>
+
+#define syscall_success(expr)                                                                   \
+        test_assert(0 <= (expr), "\nunexpected error: %s (%d)",                                 \
+                    test_errstr(errno), errno)
+
+#define SMPBENCH_PATH   "/usr/bin/smpbench"
+#define CHILD_ARG       "-x"
+#define DEFAULT_WORKERS 4
+#define EXECS           8
+#define SPIN            (1 << 24)
+
+static char *child_argv[] = { SMPBENCH_PATH, CHILD_ARG, NULL };
+static char *child_envp[] = { NULL };
+
+static unsigned long long
+rdtsc(void)
+{
+        unsigned long long t;
+        __asm__ __volatile__("rdtsc" : "=A"(t));
+        return t;
+}
+
+/* Run in each worker: fork/exec EXECS children, then spin */
+static void
+work(void)
+{
+        volatile int j;
+        int i, status;
+        pid_t pid;
+
+        for (i = 0; i < EXECS; i++) {
+                if (0 > (pid = fork())) {
+                        exit(1);
+                }
+                if (0 == pid) {
+                        execve(SMPBENCH_PATH, child_argv, child_envp);
+                        exit(2);
+                }
+                if (0 > waitpid(pid, 0, &status) || 0 != status) {
+                        exit(3);
+                }
+        }
+        for (j = 0; j < SPIN; j++) {
+                ;
+        }
+        exit(0);
+}
+
+static unsigned long long
+run(int nworkers)
+{
+        unsigned long long start;
+        pid_t workers[16];
+        int i, status;
+
+        start = rdtsc();
+        for (i = 0; i < nworkers; i++) {
+                syscall_success(workers[i] = fork());
+                if (0 == workers[i]) {
+                        work();
+                }
+        }
+        for (i = 0; i < nworkers; i++) {
+                syscall_success(waitpid(workers[i], 0, &status));
+                test_assert(0 == status, "worker %d failed with status %d", i, status);
+        }
+        return rdtsc() - start;
+}
+
+int main(int argc, char **argv)
+{
+        int nworkers = DEFAULT_WORKERS;
+        unsigned long long one = 0, cycles;
+        int i;
+
+        if (argc == 2 && 0 == strcmp(argv[1], CHILD_ARG)) {
+                return 0;
+        }
+        if (argc > 2 || (argc == 2 && ((nworkers = atoi(argv[1])) <= 0 || nworkers > 16))) {
+                fprintf(stderr, "USAGE: smpbench [max workers, at most 16]\n");
+                return 1;
+        }
+
+        test_init();
+
+        printf("%d fork/execs and a spin per worker, cycles:\n", EXECS);
+        printf("workers          total    vs 1 worker\n");
+        for (i = 1; i <= nworkers; i++) {
+                cycles = run(i);
+                if (1 == i) {
+                        one = cycles;
+                }
+                printf("  %4d %14llu %10llu.%02llu\n", i, cycles,
+                       cycles / one, (cycles % one) * 100 / one);
+        }
+        test_fini();
+        return 0;
+}
@@ -0,0 +1,94 @@
+/*
+ * Measures the cost of a null system call (getpid) through each way of
+ * entering the kernel: the "int" software interrupt and, when the CPU has
+ * it, sysenter/sysexit, and compares them with libc's getpid(), which
+ * needs no trap at all. Times are in TSC cycles per call.
+ *
+ * Usage: syscallbench [iterations]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <weenix/cpuid.h>
+#include <weenix/trap.h>
+
+#define DEFAULT_ITERATIONS      100000
+
+static unsigned long long
+rdtsc(void)
+{
+        unsigned long long t;
+        __asm__ __volatile__("rdtsc" : "=A"(t));
+        return t;
+}
+
+static unsigned long long
+time_int(int iterations, pid_t pid)
+{
+        unsigned long long start = rdtsc();
+        int i;
+
+        for (i = 0; i < iterations; i++) {
+                if (pid != __trap_int(SYS_getpid, 0)) {
+                        fprintf(stderr, "syscallbench: getpid through int failed\n");
+                        exit(1);
+                }
+        }
+        return rdtsc() - start;
+}
+
+static unsigned long long
+time_sysenter(int iterations, pid_t pid)
+{
+        unsigned long long start = rdtsc();
+        int i;
+
+        for (i = 0; i < iterations; i++) {
+                if (pid != __trap_sysenter(SYS_getpid, 0)) {
+                        fprintf(stderr, "syscallbench: getpid through sysenter failed\n");
+                        exit(1);
+                }
+        }
+        return rdtsc() - start;
+}
+
+int main(int argc, char **argv)
+{
+        int iterations = DEFAULT_ITERATIONS;
+        unsigned long long cycles;
+        pid_t pid;
+        int i;
+
+        if (argc > 2 || (argc == 2 && (iterations = atoi(argv[1])) <= 0)) {
+                fprintf(stderr, "USAGE: syscallbench [iterations]\n");
+                return 1;
+        }
+
+        pid = __trap_int(SYS_getpid, 0);
+        printf("%d calls to getpid, cycles per call:\n", iterations);
+
+        cycles = time_int(iterations, pid);
+        printf("  int $%s:   %8llu\n", TRAP_INTR_STRING, cycles / iterations);
+
+        if (cpuid_has_sysenter()) {
+                cycles = time_sysenter(iterations, pid);
+                printf("  sysenter:    %8llu\n", cycles / iterations);
+        } else {
+                printf("  sysenter:    not supported by this CPU\n");
+        }
+
+        /* libc's getpid() reads the kernel data page instead */
+        cycles = rdtsc();
+        for (i = 0; i < iterations; i++) {
+                if (pid != getpid()) {
+                        fprintf(stderr, "syscallbench: getpid from the kernel data page failed\n");
+                        return 1;
+                }
+        }
+        cycles = rdtsc() - cycles;
+        printf("  getpid():    %8llu (no trap)\n", cycles / iterations);
+
+        return 0;
+}
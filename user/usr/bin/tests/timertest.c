@@ -0,0 +1,203 @@
+/*
+ * Tests timed sleeps: nanosleep() and its errors, sleepers waking in
+ * the order their times run out (some far enough off to be cascaded
+ * down the timer wheel), poll() timeouts, and alarm() killing a process
+ * whether it is asleep or spinning in userland.
+ */
+
+#include <errno.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <test/test.h>
+
+#define syscall_success(expr)                                                                   \
+        test_assert(0 <= (expr), "\nunexpected error: %s (%d)",                                 \
+                    test_errstr(errno), errno)
+
+/* What a process killed by its alarm exits with; see proc/proc.h */
+#define ALARM_STATUS    (128 + 14)
+
+static unsigned long long
+rdtsc(void)
+{
+        unsigned long long t;
+        __asm__ __volatile__("rdtsc" : "=A"(t));
+        return t;
+}
+
+static void
+msleep(int msecs)
+{
+        struct timespec ts;
+
+        ts.tv_sec = msecs / 1000;
+        ts.tv_nsec = (msecs % 1000) * 1000000L;
+        syscall_success(nanosleep(&ts, NULL));
+}
+
+static void
+test_nanosleep(void)
+{
+        unsigned long long t, t10, t100;
+        struct timespec ts;
+
+        ts.tv_sec = 0;
+        ts.tv_nsec = NSEC_PER_SEC;
+        test_assert(-1 == nanosleep(&ts, NULL) && EINVAL == errno, "no EINVAL for 1e9 ns");
+        ts.tv_nsec = -1;
+        test_assert(-1 == nanosleep(&ts, NULL) && EINVAL == errno, "no EINVAL for -1 ns");
+        ts.tv_sec = -1;
+        ts.tv_nsec = 0;
+        test_assert(-1 == nanosleep(&ts, NULL) && EINVAL == errno, "no EINVAL for -1 s");
+        test_assert(-1 == nanosleep(NULL, NULL) && EFAULT == errno, "no EFAULT for NULL");
+
+        ts.tv_sec = 0;
+        ts.tv_nsec = 0;
+        syscall_success(nanosleep(&ts, NULL));
+
+        t = rdtsc();
+        msleep(10);
+        t10 = rdtsc() - t;
+        t = rdtsc();
+        msleep(100);
+        t100 = rdtsc() - t;
+        test_assert(t100 > t10 * 2, "100ms sleep took %llu cycles, 10ms took %llu", t100, t10);
+        printf("  10ms sleep: %llu cycles, 100ms sleep: %llu cycles\n", t10, t100);
+
+        syscall_success(usleep(1000));
+        test_assert(0 == sleep(0), "sleep(0) did not return 0");
+}
+
+/*
+ * Children go to sleep in the opposite order to the one they should wake
+ * in, and each writes its index to a pipe when it does. The last few are
+ * more than a turn of the wheel's first level (256 ticks) away.
+ */
+static void
+test_order(void)
+{
+        static const int msecs[] = { 3000, 2700, 1200, 400, 150, 60, 20 };
+        int n = sizeof(msecs) / sizeof(msecs[0]);
+        int fds[2], i, status;
+        pid_t pids[sizeof(msecs) / sizeof(msecs[0])];
+        char c;
+
+        syscall_success(pipe(fds));
+        for (i = 0; i < n; i++) {
+                syscall_success(pids[i] = fork());
+                if (0 == pids[i]) {
+                        close(fds[0]);
+                        msleep(msecs[i]);
+                        c = (char)i;
+                        exit(1 == write(fds[1], &c, 1) ? 0 : 1);
+                }
+        }
+        syscall_success(close(fds[1]));
+
+        for (i = n - 1; i >= 0; i--) {
+                test_assert(1 == read(fds[0], &c, 1), "sleeper %d never woke", i);
+                test_assert(i == c, "sleeper %d woke when sleeper %d should have", c, i);
+        }
+        for (i = 0; i < n; i++) {
+                syscall_success(waitpid(pids[i], 0, &status));
+                test_assert(0 == status, "sleeper %d failed", i);
+        }
+        syscall_success(close(fds[0]));
+}
+
+static void
+test_poll(void)
+{
+        struct pollfd pfd;
+        int fds[2], status;
+        pid_t pid;
+        char c = 'x';
+
+        syscall_success(pipe(fds));
+        pfd.fd = fds[0];
+        pfd.events = POLLIN;
+
+        /* Nothing comes, so it times out */
+        test_assert(0 == poll(&pfd, 1, 50), "poll on an empty pipe did not time out");
+        test_assert(0 == pfd.revents, "revents set after a timeout");
+
+        /* Something comes well before the timeout */
+        syscall_success(pid = fork());
+        if (0 == pid) {
+                msleep(20);
+                exit(1 == write(fds[1], &c, 1) ? 0 : 1);
+        }
+        test_assert(1 == poll(&pfd, 1, 10000), "poll did not see the write");
+        test_assert(POLLIN & pfd.revents, "POLLIN not set");
+        syscall_success(waitpid(pid, 0, &status));
+        test_assert(0 == status, "writer failed");
+
+        syscall_success(close(fds[0]));
+        syscall_success(close(fds[1]));
+}
+
+static void
+test_alarm(void)
+{
+        volatile int spin = 0;
+        unsigned int left;
+        pid_t pid;
+        int status;
+
+        test_assert(0 == alarm(0), "an alarm was already set");
+        test_assert(0 == alarm(10), "an alarm was already set");
+        left = alarm(0);
+        test_assert(9 <= left && left <= 10, "alarm(10) had %u seconds left", left);
+        test_assert(0 == alarm(0), "alarm(0) did not cancel");
+
+        /* Asleep, it is woken to die */
+        syscall_success(pid = fork());
+        if (0 == pid) {
+                alarm(1);
+                sleep(100);
+                exit(0);
+        }
+        syscall_success(waitpid(pid, 0, &status));
+        test_assert(ALARM_STATUS == status, "sleeper exited with %d", status);
+
+        /* Spinning, it dies at the next clock tick after the alarm */
+        syscall_success(pid = fork());
+        if (0 == pid) {
+                alarm(1);
+                for (;;) {
+                        spin++;
+                }
+        }
+        syscall_success(waitpid(pid, 0, &status));
+        test_assert(ALARM_STATUS == status, "spinner exited with %d", status);
+
+        /* A new alarm replaces the old one */
+        syscall_success(pid = fork());
+        if (0 == pid) {
+                alarm(100);
+                alarm(1);
+                sleep(10);
+                exit(0);
+        }
+        alarm(30);
+        syscall_success(waitpid(pid, 0, &status));
+        test_assert(ALARM_STATUS == status, "sleeper exited with %d", status);
+        test_assert(0 != alarm(0), "our own alarm was lost");
+}
+
+int main(int argc, char **argv)
+{
+        test_init();
+
+        test_nanosleep();
+        test_order();
+        test_poll();
+        test_alarm();
+
+        test_fini();
+        return 0;
+}
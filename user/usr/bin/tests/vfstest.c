@@ -38,6 +38,7 @@
 #include <weenix/syscall.h>
 #include <fcntl.h>
 #include <sys/mman.h>
+#include <sys/uio.h>
 #include <stdio.h>
 
 #include <test/test.h>
@@ -493,6 +494,29 @@ vfstest_fd(void)
         syscall_success(lseek(fd2, 5, SEEK_SET));
         test_fpos(fd1, 5); test_fpos(fd2, 5);
 
+        /* the table grows past its initial size, always handing out the
+         * lowest free descriptor */
+#define MANY_FDS 100
+        int fds[MANY_FDS], nfds, i;
+        for (nfds = 0; nfds < MANY_FDS; nfds++) {
+                syscall_success(fds[nfds] = dup(fd1));
+        }
+        for (i = 1; i < MANY_FDS; i++) {
+                test_assert(fds[i] == fds[i - 1] + 1, "dup() returned %d after %d",
+                            fds[i], fds[i - 1]);
+        }
+        syscall_success(close(fds[MANY_FDS / 2]));
+        syscall_success(fd2 = dup(fd1));
+        test_assert(fds[MANY_FDS / 2] == fd2, "dup() returned %d, not the free %d",
+                    fd2, fds[MANY_FDS / 2]);
+        syscall_success(fd2 = dup2(fd1, 500));
+        test_assert(500 == fd2, "dup2(%d, 500) returned %d", fd1, fd2);
+        test_fpos(fd2, 5);
+        syscall_success(close(500));
+        for (i = 0; i < MANY_FDS; i++) {
+                syscall_success(close(fds[i]));
+        }
+
         syscall_success(chdir(".."));
 }
 
@@ -710,6 +734,108 @@ vfstest_read(void)
         test_assert(0 == memcmp(buf, "hello\0\0\0\0\0again", 15), "unexpected data read");
         syscall_success(close(fd));
 
+        /* pread and pwrite use their own offset and leave f_pos alone */
+        create_file("file05");
+        syscall_success(fd = open("file05", O_RDWR, 0));
+        syscall_success(write(fd, "hello", 5));
+        test_fpos(fd, 5);
+        syscall_success(ret = pwrite(fd, "J", 1, 0));
+        test_assert(1 == ret, "pwrite(%d, \"J\", 1, 0) returned %d", fd, ret);
+        test_fpos(fd, 5);
+        syscall_success(ret = pwrite(fd, "again", 5, 10));
+        test_fpos(fd, 5);
+        syscall_success(ret = pread(fd, buf, READ_BUFSIZE, 0));
+        test_assert(15 == ret, "pread(%d, buf, %d, 0) returned %d", fd, READ_BUFSIZE, ret);
+        test_assert(0 == memcmp(buf, "Jello\0\0\0\0\0again", 15), "unexpected data read");
+        syscall_success(ret = pread(fd, buf, 3, 11));
+        test_assert(3 == ret && 0 == memcmp(buf, "gai", 3), "unexpected pread result");
+        syscall_success(ret = pread(fd, buf, READ_BUFSIZE, 20));
+        test_assert(0 == ret, "pread past EOF returned %d", ret);
+        test_fpos(fd, 5);
+        syscall_fail(pread(fd, buf, READ_BUFSIZE, -1), EINVAL);
+        syscall_fail(pwrite(fd, "x", 1, -1), EINVAL);
+        syscall_success(close(fd));
+        syscall_fail(pread(fd, buf, READ_BUFSIZE, 0), EBADF);
+
+        syscall_success(fd = open("dir01", O_RDONLY, 0));
+        syscall_fail(pread(fd, buf, READ_BUFSIZE, 0), EISDIR);
+        syscall_success(close(fd));
+
+        /* copy_file_range copies between files without a user buffer */
+        {
+                int fd2;
+                off_t inoff, outoff;
+
+                create_file("file07");
+                syscall_success(fd = open("file05", O_RDONLY, 0));
+                syscall_success(fd2 = open("file07", O_RDWR, 0));
+                syscall_success(ret = copy_file_range(fd, NULL, fd2, NULL, READ_BUFSIZE, 0));
+                test_assert(15 == ret, "copy_file_range returned %d", ret);
+                test_fpos(fd, 15);
+                test_fpos(fd2, 15);
+                syscall_success(ret = copy_file_range(fd, NULL, fd2, NULL, READ_BUFSIZE, 0));
+                test_assert(0 == ret, "copy_file_range at EOF returned %d", ret);
+
+                inoff = 10;
+                outoff = 20;
+                syscall_success(ret = copy_file_range(fd, &inoff, fd2, &outoff, 5, 0));
+                test_assert(5 == ret, "copy_file_range returned %d", ret);
+                test_assert(15 == inoff && 25 == outoff, "offsets not advanced: %d %d",
+                            inoff, outoff);
+                test_fpos(fd, 15);
+                test_fpos(fd2, 15);
+
+                syscall_success(ret = pread(fd2, buf, READ_BUFSIZE, 0));
+                test_assert(25 == ret, "copied file has size %d", ret);
+                test_assert(0 == memcmp(buf, "Jello\0\0\0\0\0again", 15), "unexpected data copied");
+                test_assert(0 == memcmp(buf + 20, "again", 5), "unexpected data copied");
+
+                syscall_fail(copy_file_range(fd2, NULL, fd, NULL, 1, 0), EBADF);
+                inoff = 0;
+                outoff = 2;
+                syscall_fail(copy_file_range(fd2, &inoff, fd2, &outoff, 5, 0), EINVAL);
+                syscall_success(close(fd2));
+                syscall_success(close(fd));
+        }
+
+#ifndef __KERNEL__
+        /* readv and writev scatter and gather across segments */
+        {
+                struct iovec iov[3];
+                char a[2], b[4], c[8];
+
+                create_file("file06");
+                syscall_success(fd = open("file06", O_RDWR, 0));
+                iov[0].iov_base = "he";
+                iov[0].iov_len = 2;
+                iov[1].iov_base = "";
+                iov[1].iov_len = 0;
+                iov[2].iov_base = "llo world";
+                iov[2].iov_len = 9;
+                syscall_success(ret = writev(fd, iov, 3));
+                test_assert(11 == ret, "writev returned %d", ret);
+                test_fpos(fd, 11);
+
+                syscall_success(lseek(fd, 0, SEEK_SET));
+                iov[0].iov_base = a;
+                iov[0].iov_len = sizeof(a);
+                iov[1].iov_base = b;
+                iov[1].iov_len = sizeof(b);
+                iov[2].iov_base = c;
+                iov[2].iov_len = sizeof(c);
+                syscall_success(ret = readv(fd, iov, 3));
+                test_assert(11 == ret, "readv returned %d", ret);
+                test_assert(0 == memcmp(a, "he", 2), "unexpected data in first segment");
+                test_assert(0 == memcmp(b, "llo ", 4), "unexpected data in second segment");
+                test_assert(0 == memcmp(c, "world", 5), "unexpected data in third segment");
+                test_fpos(fd, 11);
+
+                syscall_fail(readv(fd, iov, -1), EINVAL);
+                syscall_fail(writev(fd, iov, IOV_MAX + 1), EINVAL);
+                syscall_success(close(fd));
+        }
+#endif
+
         syscall_success(chdir(".."));
 }
 
@@ -744,6 +870,46 @@ vfstest_getdents(void)
         test_assert(0 == ret, NULL);
         syscall_success(close(fd));
 
+        /* buffer too small for a single entry */
+        syscall_success(fd = open("dir01", O_RDONLY, 0));
+        syscall_fail(getdents(fd, dirents, sizeof(dirent_t) - 1), EINVAL);
+        syscall_success(close(fd));
+
+#ifdef __S5FS__
+        /* a single getdents returns many entries, across directory blocks */
+        {
+/* 128 entries fill a block, and the disk only has 240 inodes */
+#define GETDENTS_NFILES 130
+                dirent_t *many;
+                char name[16];
+                int i, nfound;
+
+                syscall_success(mkdir("dir02", 0));
+                for (i = 0; i < GETDENTS_NFILES; i++) {
+                        sprintf(name, "dir02/f%d", i);
+                        create_file(name);
+                }
+
+                many = malloc((GETDENTS_NFILES + 2) * sizeof(dirent_t));
+                test_assert(NULL != many, "malloc failed");
+                syscall_success(fd = open("dir02", O_RDONLY, 0));
+                syscall_success(ret = getdents(fd, many, (GETDENTS_NFILES + 2) * sizeof(dirent_t)));
+                test_assert((GETDENTS_NFILES + 2) * sizeof(dirent_t) == (size_t)ret,
+                            "getdents returned %d", ret);
+                for (i = 0, nfound = 0; i < GETDENTS_NFILES + 2; i++) {
+                        if ('f' == many[i].d_name[0]) {
+                                nfound++;
+                        }
+                }
+                test_assert(GETDENTS_NFILES == nfound, "found %d of %d files",
+                            nfound, GETDENTS_NFILES);
+                syscall_success(ret = getdents(fd, many, sizeof(dirent_t)));
+                test_assert(0 == ret, NULL);
+                syscall_success(close(fd));
+                free(many);
+        }
+#endif
+
         /* Cannot call getdents on regular file */
         create_file("file01");
         syscall_success(fd = open("file01", O_RDONLY, 0));